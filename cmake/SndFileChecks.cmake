@@ -134,6 +134,15 @@ endif ()
 
 check_library_exists (sqlite3 sqlite3_close "" HAVE_SQLITE3)
 
+set (THREADS_PREFER_PTHREAD_FLAG ON)
+find_package (Threads)
+if (CMAKE_USE_PTHREADS_INIT)
+	set (HAVE_PTHREAD 1)
+	set (PTHREAD_LIBS "${CMAKE_THREAD_LIBS_INIT}")
+else ()
+	set (HAVE_PTHREAD 0)
+endif ()
+
 check_function_exists (fstat     		HAVE_FSTAT)
 check_function_exists (fstat64			HAVE_FSTAT64)
 check_function_exists (gettimeofday		HAVE_GETTIMEOFDAY)
@@ -151,6 +160,8 @@ check_function_exists (lrintf			HAVE_LRINTF)
 if (NOT WIN32)
 	check_function_exists (ftruncate	HAVE_FTRUNCATE)
 	check_function_exists (fsync    	HAVE_FSYNC)
+	check_function_exists (mmap			HAVE_MMAP)
+	check_function_exists (pread		HAVE_PREAD)
 endif ()
 
 if (BUILD_TESTING)
@@ -171,7 +182,6 @@ endif ()
 # check_function_exists (fmod			HAVE_FMOD)
 
 # Never used
-# check_function_exists (mmap			HAVE_MMAP)
 # check_function_exists (ceil			HAVE_CEIL)
 # check_function_exists (lround			HAVE_LROUND)
 # check_function_exists (lseek64		HAVE_LSEEK64)
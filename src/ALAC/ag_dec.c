@@ -83,6 +83,9 @@ void set_ag_params (AGParamRecPtr params, uint32_t m, uint32_t p, uint32_t k, ui
 // note: implementing this with some kind of "count leading zeros" assembly is a big performance win
 static inline int32_t lead (int32_t m)
 {
+#if __GNUC__
+	return m == 0 ? 32 : __builtin_clz ((uint32_t) m) ;
+#else
 	long j ;
 	unsigned long c = (1ul << 31) ;
 
@@ -93,6 +96,7 @@ static inline int32_t lead (int32_t m)
 		c >>= 1 ;
 	}
 	return j ;
+#endif
 }
 
 #define arithmin(a, b) ((a) < (b) ? (a) : (b))
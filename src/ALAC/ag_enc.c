@@ -58,6 +58,9 @@
 // note: implementing this with some kind of "count leading zeros" assembly is a big performance win
 static inline int32_t lead (int32_t m)
 {
+#if __GNUC__
+	return m == 0 ? 32 : __builtin_clz ((uint32_t) m) ;
+#else
 	long j ;
 	unsigned long c = (1ul << 31) ;
 
@@ -68,6 +71,7 @@ static inline int32_t lead (int32_t m)
 		c >>= 1 ;
 	}
 	return j ;
+#endif
 }
 
 #define arithmin (a, b) ((a) < (b) ? (a) : (b))
@@ -31,6 +31,7 @@
 
 #include "dplib.h"
 #include "shift.h"
+#include "simd.h"
 
 #if __GNUC__
 #define ALWAYS_INLINE		__attribute__ ((always_inline))
@@ -100,6 +101,9 @@ unpc_block (const int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs, in
 
 	lim = numactive + 1 ;
 
+	// the vector kernels do as much as they can, the code below does the rest
+	j = lim + psf_simd ()->alac_unpc (pc1, out, num, coefs, numactive, (int) chanshift, denshift) ;
+
 	if (numactive == 4)
 	{
 		// optimization for numactive == 4
@@ -111,7 +115,7 @@ unpc_block (const int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs, in
 		ia2 = coefs [2] ;
 		ia3 = coefs [3] ;
 
-		for (j = lim ; j < num ; j++)
+		for ( ; j < num ; j++)
 		{
 			LOOP_ALIGN
 
@@ -199,7 +203,7 @@ unpc_block (const int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs, in
 		a6 = coefs [6] ;
 		a7 = coefs [7] ;
 
-		for (j = lim ; j < num ; j++)
+		for ( ; j < num ; j++)
 		{
 			LOOP_ALIGN
 
@@ -333,7 +337,7 @@ unpc_block (const int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs, in
 	else
 	{
 		// general case
-		for (j = lim ; j < num ; j++)
+		for ( ; j < num ; j++)
 		{
 			LOOP_ALIGN
 
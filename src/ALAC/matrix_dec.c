@@ -30,6 +30,7 @@
 #include "matrixlib.h"
 #include "ALACAudioTypes.h"
 #include "shift.h"
+#include "simd.h"
 
 // up to 24-bit "offset" macros for the individual bytes of a 20/24-bit word
 #if TARGET_RT_BIG_ENDIAN
@@ -57,17 +58,33 @@
     R = L - v ;
 */
 
+// interleaved stereo is handed to the vector kernels first, this returns how many samples they did
+static int32_t
+unmix_simd (const int32_t * u, const int32_t * v, int32_t ** out, uint32_t stride, int32_t numSamples, int32_t mixbits, int32_t mixres, int32_t shift)
+{
+	int32_t		done ;
+
+	if (stride != 2)
+		return 0 ;
+
+	done = psf_simd ()->alac_unmix (u, v, *out, numSamples, mixbits, mixres, shift) ;
+	*out += 2 * done ;
+	return done ;
+}
+
 // 16-bit routines
 
 void
 unmix16 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t numSamples, int32_t mixbits, int32_t mixres)
 {
-	int32_t 	j ;
+	int32_t 	j, done ;
+
+	done = unmix_simd (u, v, &out, stride, numSamples, mixbits, mixres, 16) ;
 
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
-		for (j = 0 ; j < numSamples ; j++)
+		for (j = done ; j < numSamples ; j++)
 		{
 			int32_t		l, r ;
 
@@ -82,7 +99,7 @@ unmix16 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 	else
 	{
 		/* Conventional separated stereo. */
-		for (j = 0 ; j < numSamples ; j++)
+		for (j = done ; j < numSamples ; j++)
 		{
 			out [0] = u [j] << 16 ;
 			out [1] = v [j] << 16 ;
@@ -97,12 +114,14 @@ unmix16 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 void
 unmix20 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t numSamples, int32_t mixbits, int32_t mixres)
 {
-	int32_t 	j ;
+	int32_t 	j, done ;
+
+	done = unmix_simd (u, v, &out, stride, numSamples, mixbits, mixres, 12) ;
 
 	if (mixres != 0)
 	{
 		/* matrixed stereo */
-		for (j = 0 ; j < numSamples ; j++)
+		for (j = done ; j < numSamples ; j++)
 		{
 			int32_t		l, r ;
 
@@ -117,7 +136,7 @@ unmix20 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 	else
 	{
 		/* Conventional separated stereo. */
-		for (j = 0 ; j < numSamples ; j++)
+		for (j = done ; j < numSamples ; j++)
 		{
 			out [0] = arith_shift_left (u [j], 12) ;
 			out [1] = arith_shift_left (v [j], 12) ;
@@ -157,7 +176,7 @@ unmix24 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 		}
 		else
 		{
-			for (j = 0 ; j < numSamples ; j++)
+			for (j = unmix_simd (u, v, &out, stride, numSamples, mixbits, mixres, 8) ; j < numSamples ; j++)
 			{
 				l = u [j] + v [j] - ((mixres * v [j]) >> mixbits) ;
 				r = l - v [j] ;
@@ -188,7 +207,7 @@ unmix24 (const int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 		}
 		else
 		{
-			for (j = 0 ; j < numSamples ; j++)
+			for (j = unmix_simd (u, v, &out, stride, numSamples, mixbits, mixres, 8) ; j < numSamples ; j++)
 			{
 				out [0] = u [j] << 8 ;
 				out [1] = v [j] << 8 ;
@@ -71,6 +71,8 @@ static short _witab [16] = { -12, 18, 41, 64, 112, 198, 355, 1122,
 static short _fitab [16] = { 0, 0, 0, 0x200, 0x200, 0x200, 0x600, 0xE00,
 							0xE00, 0x600, 0x200, 0x200, 0x200, 0, 0, 0 } ;
 
+const G72x_TABLES g721_tables = { qtab_721, _dqlntab, _witab, _fitab } ;
+
 /*
  * g721_encoder ()
  *
@@ -72,6 +72,7 @@ static short _fitab [4] = { 0, 0xE00, 0xE00, 0 } ;
  */
 static short qtab_723_16 [1] = { 261 } ;
 
+const G72x_TABLES g723_16_tables = { qtab_723_16, _dqlntab, _witab, _fitab } ;
 
 /*
  * g723_16_encoder ()
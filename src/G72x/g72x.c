@@ -41,6 +41,9 @@ static G72x_STATE * g72x_state_new (void) ;
 static int unpack_bytes (int bits, int blocksize, const unsigned char * block, short * samples) ;
 static int pack_bytes (int bits, const short * samples, unsigned char * block) ;
 
+static inline void fast_encode_block (G72x_STATE *pstate, const G72x_TABLES *tables, int bits, short *samples, int count) ;
+static inline void fast_decode_block (G72x_STATE *pstate, const G72x_TABLES *tables, int bits, short *samples, int count) ;
+
 static
 short power2 [15] =
 {	1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
@@ -245,8 +248,24 @@ int g72x_decode_block (G72x_STATE *pstate, const unsigned char *block, short *sa
 
 	count = unpack_bytes (pstate->codec_bits, pstate->blocksize, block, samples) ;
 
-	for (k = 0 ; k < count ; k++)
-		samples [k] = pstate->decoder (samples [k], pstate) ;
+	switch (pstate->codec_bits)
+	{	case 2 :
+			fast_decode_block (pstate, &g723_16_tables, 2, samples, count) ;
+			break ;
+		case 3 :
+			fast_decode_block (pstate, &g723_24_tables, 3, samples, count) ;
+			break ;
+		case 4 :
+			fast_decode_block (pstate, &g721_tables, 4, samples, count) ;
+			break ;
+		case 5 :
+			fast_decode_block (pstate, &g723_40_tables, 5, samples, count) ;
+			break ;
+		default :
+			for (k = 0 ; k < count ; k++)
+				samples [k] = pstate->decoder (samples [k], pstate) ;
+			break ;
+		} ;
 
 	return 0 ;
 }	/* g72x_decode_block */
@@ -254,14 +273,34 @@ int g72x_decode_block (G72x_STATE *pstate, const unsigned char *block, short *sa
 int g72x_encode_block (G72x_STATE *pstate, short *samples, unsigned char *block)
 {	int k, count ;
 
-	for (k = 0 ; k < pstate->samplesperblock ; k++)
-		samples [k] = pstate->encoder (samples [k], pstate) ;
+	switch (pstate->codec_bits)
+	{	case 2 :
+			fast_encode_block (pstate, &g723_16_tables, 2, samples, pstate->samplesperblock) ;
+			break ;
+		case 3 :
+			fast_encode_block (pstate, &g723_24_tables, 3, samples, pstate->samplesperblock) ;
+			break ;
+		case 4 :
+			fast_encode_block (pstate, &g721_tables, 4, samples, pstate->samplesperblock) ;
+			break ;
+		case 5 :
+			fast_encode_block (pstate, &g723_40_tables, 5, samples, pstate->samplesperblock) ;
+			break ;
+		default :
+			for (k = 0 ; k < pstate->samplesperblock ; k++)
+				samples [k] = pstate->encoder (samples [k], pstate) ;
+			break ;
+		} ;
 
 	count = pack_bytes (pstate->codec_bits, samples, block) ;
 
 	return count ;
 }	/* g72x_encode_block */
 
+int g72x_state_size (void)
+{	return sizeof (G72x_STATE) ;
+}	/* g72x_state_size */
+
 /*
  * predictor_zero ()
  *
@@ -598,6 +637,331 @@ update (
 	return ;
 } /* update */
 
+/*------------------------------------------------------------------------------
+**	The block coder.
+**
+**	This does exactly what the per sample encoders and decoders do with the
+**	functions above, but keeps the state in a local copy for the whole block,
+**	takes logs from a table instead of searching power2 and works out the
+**	prediction for each sample with a branch free fmult (). Everything that
+**	differs between the codecs is passed in as constants so the compiler can
+**	build a separate loop for each.
+*/
+
+/* The number of bits in 0 to 255. */
+static const unsigned char log2_tab [256] =
+{	0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8
+} ;
+
+/* The same as quan (val, power2, 15) for any val below 0x8000. */
+static inline int ALWAYS_INLINE
+fast_log2 (int val)
+{	if (val >= 0x100)
+		return 8 + log2_tab [val >> 8] ;
+	return val > 0 ? log2_tab [val] : 0 ;
+} /* fast_log2 */
+
+/*
+**	The same as quan (val, table, size) for a table in ascending order, which
+**	all the quantizer tables are: counting the entries at or below val needs
+**	no branches.
+*/
+static inline int ALWAYS_INLINE
+fast_quan (int val, const short *table, int size)
+{	int k, i = 0 ;
+
+	for (k = 0 ; k < size ; k++)
+		i += (val >= table [k]) ;
+
+	return i ;
+} /* fast_quan */
+
+static inline int ALWAYS_INLINE
+fast_fmult (int an, int srn)
+{	int anmag, anlog, anmant, wanmant, shift, retval ;
+
+	anmag = (an > 0) ? an : ((-an) & 0x1FFF) ;
+	anlog = fast_log2 (anmag) ;
+
+	/* Normalise to six bits like fmult (), with 32 for zero. */
+	anmant = ((anmag << (15 - anlog)) >> 9) + ((anmag == 0) << 5) ;
+	wanmant = (anmant * (srn & 0x3F)) >> 4 ;
+
+	/*
+	**	fmult () shifts wanmant by wanexp = anlog + srn exponent - 19, either
+	**	way. Shifting it up 19 first makes that a single right shift, and
+	**	anything more than 27 leaves nothing.
+	*/
+	shift = 38 - anlog - ((srn >> 6) & 0xF) ;
+	shift = shift > 31 ? 31 : shift ;
+	retval = ((wanmant << 19) >> shift) & 0x7FFF ;
+
+	return ((an ^ srn) < 0) ? -retval : retval ;
+} /* fast_fmult */
+
+static inline int ALWAYS_INLINE
+fast_predictor_zero (const G72x_STATE *st)
+{	int k, sezi = 0 ;
+
+	for (k = 0 ; k < 6 ; k++)
+		sezi += fast_fmult (st->b [k] >> 2, st->dq [k]) ;
+
+	return sezi ;
+} /* fast_predictor_zero */
+
+static inline int ALWAYS_INLINE
+fast_predictor_pole (const G72x_STATE *st)
+{	return fast_fmult (st->a [1] >> 2, st->sr [1]) + fast_fmult (st->a [0] >> 2, st->sr [0]) ;
+} /* fast_predictor_pole */
+
+static inline int ALWAYS_INLINE
+fast_quantize (int d, int y, const short *table, int size)
+{	short dqm, expon, mant, dl, dln ;
+	int i ;
+
+	dqm = abs (d) ;
+	expon = fast_log2 (dqm >> 1) ;
+	mant = ((dqm << 7) >> expon) & 0x7F ;
+	dl = (expon << 7) + mant ;
+	dln = dl - (y >> 2) ;
+
+	i = fast_quan (dln, table, size) ;
+	if (d < 0)
+		return ((size << 1) + 1 - i) ;
+	else if (i == 0)
+		return ((size << 1) + 1) ;
+
+	return i ;
+} /* fast_quantize */
+
+/* update () with fast_log2 (). */
+static inline void ALWAYS_INLINE
+fast_update (int code_size, int y, int wi, int fi, int dq, int sr, int dqsez, G72x_STATE *st)
+{	int cnt ;
+	short mag, expon, a2p = 0, a1ul, pks1, fa1, ylint, thr2, dqthr, ylfrac, thr1, pk0 ;
+	char tr ;
+
+	pk0 = (dqsez < 0) ? 1 : 0 ;
+
+	/* TRANS */
+	mag = dq & 0x7FFF ;
+	ylint = st->yl >> 15 ;
+	ylfrac = (st->yl >> 10) & 0x1F ;
+	thr1 = (32 + ylfrac) << ylint ;
+	thr2 = (ylint > 9) ? 31 << 10 : thr1 ;
+	dqthr = (thr2 + (thr2 >> 1)) >> 1 ;
+	tr = (st->td != 0 && mag > dqthr) ? 1 : 0 ;
+
+	/* FUNCTW & FILTD & DELAY & LIMB */
+	st->yu = y + ((wi - y) >> 5) ;
+	if (st->yu < 544)
+		st->yu = 544 ;
+	else if (st->yu > 5120)
+		st->yu = 5120 ;
+
+	/* FILTE & DELAY */
+	st->yl += st->yu + ((-st->yl) >> 6) ;
+
+	if (tr == 1)
+	{	st->a [0] = st->a [1] = 0 ;
+		for (cnt = 0 ; cnt < 6 ; cnt++)
+			st->b [cnt] = 0 ;
+		}
+	else
+	{	pks1 = pk0 ^ st->pk [0] ;
+
+		/* UPA2 */
+		a2p = st->a [1] - (st->a [1] >> 7) ;
+		if (dqsez != 0)
+		{	fa1 = (pks1) ? st->a [0] : -st->a [0] ;
+			if (fa1 < -8191)
+				a2p -= 0x100 ;
+			else if (fa1 > 8191)
+				a2p += 0xFF ;
+			else
+				a2p += fa1 >> 5 ;
+
+			/* LIMC */
+			if (pk0 ^ st->pk [1])
+			{	if (a2p <= -12160)
+					a2p = -12288 ;
+				else if (a2p >= 12416)
+					a2p = 12288 ;
+				else
+					a2p -= 0x80 ;
+				}
+			else if (a2p <= -12416)
+				a2p = -12288 ;
+			else if (a2p >= 12160)
+				a2p = 12288 ;
+			else
+				a2p += 0x80 ;
+			} ;
+
+		/* TRIGB & DELAY */
+		st->a [1] = a2p ;
+
+		/* UPA1 */
+		st->a [0] -= st->a [0] >> 8 ;
+		if (dqsez != 0)
+			st->a [0] += (pks1 == 0) ? 192 : -192 ;
+
+		/* LIMD */
+		a1ul = 15360 - a2p ;
+		if (st->a [0] < -a1ul)
+			st->a [0] = -a1ul ;
+		else if (st->a [0] > a1ul)
+			st->a [0] = a1ul ;
+
+		/* UPB */
+		for (cnt = 0 ; cnt < 6 ; cnt++)
+		{	st->b [cnt] -= st->b [cnt] >> (code_size == 5 ? 9 : 8) ;
+			if (dq & 0x7FFF)
+				st->b [cnt] += ((dq ^ st->dq [cnt]) >= 0) ? 128 : -128 ;
+			} ;
+		} ;
+
+	for (cnt = 5 ; cnt > 0 ; cnt--)
+		st->dq [cnt] = st->dq [cnt - 1] ;
+
+	/* FLOAT A */
+	if (mag == 0)
+		st->dq [0] = (dq >= 0) ? 0x20 : 0xFC20 ;
+	else
+	{	expon = fast_log2 (mag) ;
+		st->dq [0] = (expon << 6) + ((mag << 6) >> expon) - ((dq >= 0) ? 0 : 0x400) ;
+		} ;
+
+	/* FLOAT B */
+	st->sr [1] = st->sr [0] ;
+	if (sr == 0)
+		st->sr [0] = 0x20 ;
+	else if (sr > 0)
+	{	expon = fast_log2 (sr) ;
+		st->sr [0] = (expon << 6) + ((sr << 6) >> expon) ;
+		}
+	else if (sr > -32768)
+	{	mag = -sr ;
+		expon = fast_log2 (mag) ;
+		st->sr [0] = (expon << 6) + ((mag << 6) >> expon) - 0x400 ;
+		}
+	else
+		st->sr [0] = (short) 0xFC20 ;
+
+	/* DELAY A */
+	st->pk [1] = st->pk [0] ;
+	st->pk [0] = pk0 ;
+
+	/* TONE */
+	st->td = (tr == 0 && a2p < -11776) ? 1 : 0 ;
+
+	/* FILTA & FILTB & SUBTC */
+	st->dms += (fi - st->dms) >> 5 ;
+	st->dml += (((fi << 2) - st->dml) >> 7) ;
+
+	if (tr == 1)
+		st->ap = 256 ;
+	else if (y < 1536 || st->td == 1 || abs ((st->dms << 2) - st->dml) >= (st->dml >> 3))
+		st->ap += (0x200 - st->ap) >> 4 ;
+	else
+		st->ap += (-st->ap) >> 4 ;
+} /* fast_update */
+
+/*
+**	One sample of any of the codecs. bits picks the codec, and with it the
+**	quirks of the per sample functions in g721.c, g723_16.c and so on.
+*/
+static inline int ALWAYS_INLINE
+fast_encode (G72x_STATE *st, const G72x_TABLES *tables, int bits, int sl)
+{	short sezi, sei, sez, se, d, y, sr, dqsez, dq, i ;
+
+	sl >>= 2 ;
+
+	sezi = fast_predictor_zero (st) ;
+	sez = sezi >> 1 ;
+	if (bits == 4)
+		se = (sezi + fast_predictor_pole (st)) >> 1 ;
+	else
+	{	sei = sezi + fast_predictor_pole (st) ;
+		se = sei >> 1 ;
+		} ;
+
+	d = sl - se ;
+
+	y = step_size (st) ;
+	i = fast_quantize (d, y, tables->qtab, (bits == 2 ? 1 : (1 << (bits - 1)) - 1)) ;
+
+	/* The 16 kbps quantizer only has three levels. */
+	if (bits == 2 && i == 3 && (d & 0x8000) == 0)
+		i = 0 ;
+
+	dq = reconstruct (i & (1 << (bits - 1)), tables->dqlntab [i], y) ;
+	sr = (dq < 0) ? se - (dq & (bits == 5 ? 0x7FFF : 0x3FFF)) : se + dq ;
+	dqsez = sr + sez - se ;
+
+	fast_update (bits, y, arith_shift_left (tables->witab [i], bits == 4 ? 5 : 0), tables->fitab [i], dq, sr, dqsez, st) ;
+
+	return i ;
+} /* fast_encode */
+
+static inline int ALWAYS_INLINE
+fast_decode (G72x_STATE *st, const G72x_TABLES *tables, int bits, int i)
+{	short sezi, sei, sez, se, y, sr, dq, dqsez ;
+
+	i &= (1 << bits) - 1 ;
+
+	sezi = fast_predictor_zero (st) ;
+	sez = sezi >> 1 ;
+	sei = sezi + fast_predictor_pole (st) ;
+	se = sei >> 1 ;
+
+	y = step_size (st) ;
+	dq = reconstruct (i & (1 << (bits - 1)), tables->dqlntab [i], y) ;
+	sr = (dq < 0) ? (se - (dq & (bits == 5 ? 0x7FFF : 0x3FFF))) : (se + dq) ;
+	dqsez = sr - se + sez ;
+
+	fast_update (bits, y, arith_shift_left (tables->witab [i], bits == 4 ? 5 : 0), tables->fitab [i], dq, sr, dqsez, st) ;
+
+	return arith_shift_left (sr, 2) ;
+} /* fast_decode */
+
+static inline void ALWAYS_INLINE
+fast_encode_block (G72x_STATE *pstate, const G72x_TABLES *tables, int bits, short *samples, int count)
+{	G72x_STATE st = *pstate ;
+	int k ;
+
+	for (k = 0 ; k < count ; k++)
+		samples [k] = fast_encode (&st, tables, bits, samples [k]) ;
+
+	*pstate = st ;
+} /* fast_encode_block */
+
+static inline void ALWAYS_INLINE
+fast_decode_block (G72x_STATE *pstate, const G72x_TABLES *tables, int bits, short *samples, int count)
+{	G72x_STATE st = *pstate ;
+	int k ;
+
+	for (k = 0 ; k < count ; k++)
+		samples [k] = fast_decode (&st, tables, bits, samples [k]) ;
+
+	*pstate = st ;
+} /* fast_decode_block */
+
 /*------------------------------------------------------------------------------
 */
 
@@ -87,5 +87,11 @@ int g72x_encode_block (struct g72x_state *pstate, short *samples, unsigned char
 **	When it returns, the caller can read out bytes encoded bytes.
 */
 
+int g72x_state_size (void) ;
+/*
+**	Returns the size of struct g72x_state. The state holds no pointers to
+**	memory of its own, so it can be saved and restored with memcpy ().
+*/
+
 #endif /* !G72X_HEADER_FILE */
 
@@ -80,6 +80,22 @@ struct g72x_state
 
 typedef struct g72x_state G72x_STATE ;
 
+/*
+** The tables that make one codec different from another, used by the block
+** coder in g72x.c. Each codec file has one of these.
+*/
+typedef struct
+{	const short *qtab ;		/* Quantizer decision levels. */
+	const short *dqlntab ;	/* Log of the reconstructed difference for each code. */
+	const short *witab ;	/* Scale factor multiplier for each code. */
+	const short *fitab ;	/* Transition detector input for each code. */
+} G72x_TABLES ;
+
+extern const G72x_TABLES g721_tables ;
+extern const G72x_TABLES g723_16_tables ;
+extern const G72x_TABLES g723_24_tables ;
+extern const G72x_TABLES g723_40_tables ;
+
 int	predictor_zero (G72x_STATE *state_ptr) ;
 
 int	predictor_pole (G72x_STATE *state_ptr) ;
@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #include "g72x.h"
 #include "g72x_priv.h"
@@ -41,6 +42,8 @@
 
 static void g721_test	(void) ;
 static void g723_test	(double margin) ;
+static void block_test	(void) ;
+static void block_bench	(void) ;
 
 static void	gen_signal_double (double *data, double scale, int datalen) ;
 static int error_function (double data, double orig, double margin) ;
@@ -57,6 +60,8 @@ main (int argc, char *argv [])
 		printf ("    Where <test> is one of the following:\n") ;
 		printf ("           g721  - test G721 encoder and decoder\n") ;
 		printf ("           g723  - test G721 encoder and decoder\n") ;
+		printf ("           block - test the block coder against the sample coders\n") ;
+		printf ("           bench - time the block coder against the sample coders\n") ;
 		printf ("           all   - perform all tests\n") ;
 		exit (1) ;
 		} ;
@@ -73,6 +78,17 @@ main (int argc, char *argv [])
 		nTests++ ;
 		} ;
 
+	if (bDoAll || ! strcmp (argv [1], "block"))
+	{	block_test	() ;
+		nTests++ ;
+		} ;
+
+	/* Not part of "all", it only prints timings. */
+	if (! strcmp (argv [1], "bench"))
+	{	block_bench	() ;
+		nTests++ ;
+		} ;
+
 	if (nTests == 0)
 	{	printf ("Mono : ************************************\n") ;
 		printf ("Mono : *  No '%s' test defined.\n", argv [1]) ;
@@ -146,6 +162,177 @@ g723_test	(double margin)
 	return ;
 } /* g723_test */
 
+/*------------------------------------------------------------------------------
+**	g72x_encode_block () and g72x_decode_block () have their own coder, which
+**	must give exactly what the per sample encoders and decoders give.
+*/
+
+#define		BLOCK_TEST_BLOCKS	400
+
+static const int block_codecs [] =
+{	G723_16_BITS_PER_SAMPLE, G723_24_BITS_PER_SAMPLE, G721_32_BITS_PER_SAMPLE, G721_40_BITS_PER_SAMPLE
+} ;
+
+static void
+block_test_signal (short *data, int datalen)
+{	static double	buffer [BLOCK_TEST_BLOCKS * G72x_BLOCK_SIZE] ;
+	int		k ;
+
+	gen_signal_double (buffer, 32000.0, datalen) ;
+
+	/* Add noise and a stretch of full scale square wave to reach the limits. */
+	srand (1234) ;
+	for (k = 0 ; k < datalen ; k++)
+	{	if (k > datalen / 2 && k < datalen / 2 + 2000)
+			data [k] = (k & 16) ? 32767 : -32768 ;
+		else
+			data [k] = (short) (buffer [k] * 0.9 + (rand () % 2001) - 1000) ;
+		} ;
+} /* block_test_signal */
+
+/* The same bit order as g72x.c uses. */
+static void
+block_test_unpack (int bits, const unsigned char *block, short *codes, int count)
+{	int k, bit ;
+
+	for (k = 0 ; k < count ; k++)
+	{	bit = k * bits ;
+		codes [k] = (((block [bit / 8] | (block [bit / 8 + 1] << 8)) >> (bit % 8))) & ((1 << bits) - 1) ;
+		} ;
+} /* block_test_unpack */
+
+static void
+block_test (void)
+{	static short	orig [BLOCK_TEST_BLOCKS * G72x_BLOCK_SIZE] ;
+	short			samples [G72x_BLOCK_SIZE], codes [G72x_BLOCK_SIZE], decoded [G72x_BLOCK_SIZE] ;
+	unsigned char	block [G72x_BLOCK_SIZE + 1] ;
+	G72x_STATE		*writer, *reader, ref_writer, ref_reader ;
+	int				codec, blocksize, samplesperblock, b, k, expected ;
+
+	printf ("    block_test   : ") ;
+	fflush (stdout) ;
+
+	block_test_signal (orig, BLOCK_TEST_BLOCKS * G72x_BLOCK_SIZE) ;
+
+	for (codec = 0 ; codec < (int) (sizeof (block_codecs) / sizeof (block_codecs [0])) ; codec++)
+	{	writer = g72x_writer_init (block_codecs [codec], &blocksize, &samplesperblock) ;
+		reader = g72x_reader_init (block_codecs [codec], &blocksize, &samplesperblock) ;
+		if (writer == NULL || reader == NULL)
+		{	printf ("\n\nLine %d : g72x init failed for %d bits.\n\n", __LINE__, block_codecs [codec]) ;
+			exit (1) ;
+			} ;
+
+		ref_writer = *writer ;
+		ref_reader = *reader ;
+
+		/* Encode the signal, then decode what was encoded followed by random blocks. */
+		for (b = 0 ; b < 2 * BLOCK_TEST_BLOCKS ; b++)
+		{	memset (block, 0, sizeof (block)) ;
+
+			if (b < BLOCK_TEST_BLOCKS)
+			{	memcpy (samples, orig + b * samplesperblock, samplesperblock * sizeof (short)) ;
+				g72x_encode_block (writer, samples, block) ;
+
+				for (k = 0 ; k < samplesperblock ; k++)
+				{	expected = ref_writer.encoder (orig [b * samplesperblock + k], &ref_writer) ;
+					if (samples [k] != expected)
+					{	printf ("\n\nLine %d : %d bits, block %d, sample %d : code %d should be %d.\n\n", __LINE__,
+										block_codecs [codec], b, k, samples [k], expected) ;
+						exit (1) ;
+						} ;
+					} ;
+				}
+			else
+			{	for (k = 0 ; k < blocksize ; k++)
+					block [k] = rand () & 0xFF ;
+				} ;
+
+			block_test_unpack (block_codecs [codec], block, codes, samplesperblock) ;
+			g72x_decode_block (reader, block, decoded) ;
+
+			for (k = 0 ; k < samplesperblock ; k++)
+			{	expected = ref_reader.decoder (codes [k], &ref_reader) ;
+				if (decoded [k] != (short) expected)
+				{	printf ("\n\nLine %d : %d bits, block %d, sample %d : decoded %d should be %d.\n\n", __LINE__,
+									block_codecs [codec], b, k, decoded [k], expected) ;
+					exit (1) ;
+					} ;
+				} ;
+			} ;
+
+		free (writer) ;
+		free (reader) ;
+		} ;
+
+	printf ("ok\n") ;
+
+	return ;
+} /* block_test */
+
+static void
+block_bench (void)
+{	static short	orig [BLOCK_TEST_BLOCKS * G72x_BLOCK_SIZE] ;
+	short			samples [G72x_BLOCK_SIZE] ;
+	unsigned char	block [G72x_BLOCK_SIZE + 1] ;
+	G72x_STATE		*writer, *reader, ref ;
+	clock_t			start ;
+	double			ref_secs, block_secs ;
+	int				codec, blocksize, samplesperblock, pass, b, k ;
+
+	puts ("    block_bench  :") ;
+
+	block_test_signal (orig, BLOCK_TEST_BLOCKS * G72x_BLOCK_SIZE) ;
+
+	for (codec = 0 ; codec < (int) (sizeof (block_codecs) / sizeof (block_codecs [0])) ; codec++)
+	{	writer = g72x_writer_init (block_codecs [codec], &blocksize, &samplesperblock) ;
+		reader = g72x_reader_init (block_codecs [codec], &blocksize, &samplesperblock) ;
+		if (writer == NULL || reader == NULL)
+		{	printf ("\n\nLine %d : g72x init failed for %d bits.\n\n", __LINE__, block_codecs [codec]) ;
+			exit (1) ;
+			} ;
+
+		/* Encode, sample by sample then a block at a time. */
+		ref = *writer ;
+		start = clock () ;
+		for (pass = 0 ; pass < 10 ; pass++)
+			for (k = 0 ; k < BLOCK_TEST_BLOCKS * samplesperblock ; k++)
+				samples [k % samplesperblock] = ref.encoder (orig [k], &ref) ;
+		ref_secs = (clock () - start) / (double) CLOCKS_PER_SEC ;
+
+		start = clock () ;
+		for (pass = 0 ; pass < 10 ; pass++)
+			for (b = 0 ; b < BLOCK_TEST_BLOCKS ; b++)
+			{	memcpy (samples, orig + b * samplesperblock, samplesperblock * sizeof (short)) ;
+				g72x_encode_block (writer, samples, block) ;
+				} ;
+		block_secs = (clock () - start) / (double) CLOCKS_PER_SEC ;
+
+		printf ("        %d bit encode : sample coder %6.3f s, block coder %6.3f s\n", block_codecs [codec], ref_secs, block_secs) ;
+
+		/* Decode the last block over and over. */
+		ref = *reader ;
+		start = clock () ;
+		for (pass = 0 ; pass < 10 * BLOCK_TEST_BLOCKS ; pass++)
+		{	block_test_unpack (block_codecs [codec], block, samples, samplesperblock) ;
+			for (k = 0 ; k < samplesperblock ; k++)
+				samples [k] = ref.decoder (samples [k], &ref) ;
+			} ;
+		ref_secs = (clock () - start) / (double) CLOCKS_PER_SEC ;
+
+		start = clock () ;
+		for (pass = 0 ; pass < 10 * BLOCK_TEST_BLOCKS ; pass++)
+			g72x_decode_block (reader, block, samples) ;
+		block_secs = (clock () - start) / (double) CLOCKS_PER_SEC ;
+
+		printf ("        %d bit decode : sample coder %6.3f s, block coder %6.3f s\n", block_codecs [codec], ref_secs, block_secs) ;
+
+		free (writer) ;
+		free (reader) ;
+		} ;
+
+	return ;
+} /* block_bench */
+
 
 #define		SIGNAL_MAXVAL	30000.0
 #define		DECAY_COUNT		1000
@@ -8,6 +8,7 @@
 #include <assert.h>
 
 #include "gsm610_priv.h"
+#include "simd.h"
 
 /*
  *  4.2.11 .. 4.2.12 LONG TERM PREDICTOR (LTP) SECTION
@@ -470,6 +471,7 @@ static void Calculation_of_the_LTP_parameters (
 
 	float	wt_float [40] ;
 	float	dp_float_base [120], * dp_float = dp_float_base + 120 ;
+	float	xcorr [81] ;
 
 	int32_t	L_max, L_power ;
 	int16_t		R, S, dmax, scal ;
@@ -507,7 +509,11 @@ static void Calculation_of_the_LTP_parameters (
 	L_max = 0 ;
 	Nc = 40 ;	/* index for the maximum cross-correlation */
 
-	for (lambda = 40 ; lambda <= 120 ; lambda += 9)
+	if (psf_simd ()->gsm_ltp_xcorr (wt_float, dp_float, xcorr) == 81)
+	{	for (k = 0 ; k <= 80 ; k++)
+			if (xcorr [k] > L_max) { L_max = xcorr [k] ; Nc = 40 + k ; }
+		}
+	else for (lambda = 40 ; lambda <= 120 ; lambda += 9)
 	{	/*  Calculate L_result for l = lambda .. lambda + 9. */
 		register float *lp = dp_float - lambda ;
 
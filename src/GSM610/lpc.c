@@ -9,6 +9,7 @@
 #include <assert.h>
 
 #include "gsm610_priv.h"
+#include "simd.h"
 
 /*
  *  4.2.4 .. 4.2.7 LPC ANALYSIS SECTION
@@ -16,6 +17,60 @@
 
 /* 4.2.4 */
 
+static void Autocorrelation_sums (
+#ifdef	USE_FLOAT_MUL
+	register float	* sp,		/* [0..159]	IN	*/
+#else
+	int16_t		* sp,		/* [0..159]	IN	*/
+#endif
+	int32_t		* L_ACF)	/* [0..8]	OUT	*/
+/*
+ *  Sum the products of the scaled signal for L_ACF [0..8].
+ */
+{
+	register int	k, i ;
+
+# ifdef	USE_FLOAT_MUL
+	register float	sl = *sp ;
+
+#	define STEP(k)	L_ACF [k] += (int32_t) (sl * sp [- (k)]) ;
+# else
+	int16_t	sl = *sp ;
+
+#	define STEP(k)	L_ACF [k] += ((int32_t) sl * sp [- (k)]) ;
+# endif
+
+#	define NEXTI	sl = *++sp
+
+	for (k = 9 ; k-- ; L_ACF [k] = 0) ;
+
+	STEP (0) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ; STEP (2) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ; STEP (6) ;
+	NEXTI ;
+	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ; STEP (6) ; STEP (7) ;
+
+	for (i = 8 ; i <= 159 ; i++)
+	{	NEXTI ;
+
+		STEP (0) ;
+		STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ;
+		STEP (5) ; STEP (6) ; STEP (7) ; STEP (8) ;
+		}
+
+#	undef	NEXTI
+#	undef	STEP
+}
 
 static void Autocorrelation (
 	int16_t		* s,		/* [0..159]	IN/OUT  */
@@ -25,7 +80,7 @@ static void Autocorrelation (
  *  be scaled in order to avoid an overflow situation.
  */
 {
-	register int	k, i ;
+	register int	k ;
 
 	int16_t		temp, smax, scalauto ;
 
@@ -84,52 +139,16 @@ static void Autocorrelation (
 
 	/*  Compute the L_ACF [..].
 	 */
-	{
-# ifdef	USE_FLOAT_MUL
-		register float	*sp = float_s ;
-		register float	sl = *sp ;
-
-#		define STEP(k)	L_ACF [k] += (int32_t) (sl * sp [- (k)]) ;
-# else
-		int16_t	*sp = s ;
-		int16_t	sl = *sp ;
-
-#		define STEP(k)	L_ACF [k] += ((int32_t) sl * sp [- (k)]) ;
-# endif
-
-#	define NEXTI	sl = *++sp
-
-
-	for (k = 9 ; k-- ; L_ACF [k] = 0) ;
-
-	STEP (0) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ; STEP (6) ;
-	NEXTI ;
-	STEP (0) ; STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ; STEP (5) ; STEP (6) ; STEP (7) ;
-
-	for (i = 8 ; i <= 159 ; i++)
-	{	NEXTI ;
-
-		STEP (0) ;
-		STEP (1) ; STEP (2) ; STEP (3) ; STEP (4) ;
-		STEP (5) ; STEP (6) ; STEP (7) ; STEP (8) ;
-		}
+#ifdef	USE_FLOAT_MUL
+	if (psf_simd ()->gsm_acf (float_s, L_ACF) != 9)
+		Autocorrelation_sums (float_s, L_ACF) ;
+#else
+	Autocorrelation_sums (s, L_ACF) ;
+#endif
 
 	for (k = 9 ; k-- ; )
 		L_ACF [k] = SASL_L (L_ACF [k], 1) ;
 
-	}
 	/*   Rescaling of the array s [0..159]
 	 */
 	if (scalauto > 0)
@@ -8,6 +8,7 @@
 #include <assert.h>
 
 #include "gsm610_priv.h"
+#include "simd.h"
 
 /*
  *  SHORT TERM ANALYSIS FILTERING SECTION
@@ -190,6 +191,10 @@ static void Short_term_analysis_filtering (
 	register int		i ;
 	register int16_t		di, zzz, ui, sav, rpi ;
 
+	i = psf_simd ()->gsm_st_analysis (u, rp, s, k_n) ;
+	s += i ;
+	k_n -= i ;
+
 	for ( ; k_n-- ; s++)
 	{	di = sav = *s ;
 
@@ -260,6 +265,11 @@ static void Short_term_synthesis_filtering (
 	register int		i ;
 	register int16_t		sri, tmp1, tmp2 ;
 
+	i = psf_simd ()->gsm_st_synthesis (v, rrp, wt, sr, k) ;
+	wt += i ;
+	sr += i ;
+	k -= i ;
+
 	while (k--)
 	{	sri = *wt++ ;
 		for (i = 8 ; i-- ; )
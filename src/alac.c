@@ -22,11 +22,11 @@
 #include	<stdlib.h>
 #include	<string.h>
 #include	<math.h>
-#include	<errno.h>
 
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"thread_pool.h"
 #include	"ALAC/alac_codec.h"
 #include	"ALAC/ALACBitUtilities.h"
 
@@ -34,11 +34,68 @@
 #define		ALAC_BYTE_BUFFER_SIZE	0x20000
 #define		ALAC_MAX_CHANNEL_COUNT	8	// Same as kALACMaxChannels in /ALACAudioTypes.h
 
+/* Packet sizes are decoded from the 'pakt' chunk PAKT_WINDOW at a time. */
+#define		PAKT_WINDOW				64
+
+/*
+**	Packets encoded in a row by one worker thread. The encoder adapts its
+**	predictor from packet to packet, so this is a trade off between memory
+**	use and the compression lost when a worker starts afresh.
+*/
+#define		ALAC_SEGMENT_PACKETS	32
+
+typedef struct
+{	sf_count_t	offset ;	/* Of the packet in the audio data. */
+	uint32_t	pos ;		/* Of its size in the 'pakt' chunk data. */
+} PAKT_MARK ;
+
+/*
+**	The packet sizes are never all held as an array, which for a day long
+**	file would be megabytes per handle. A writer keeps them in the variable
+**	length form that goes in the file. A reader keeps a seek index with one
+**	entry for each window of PAKT_WINDOW packets, about a quarter of a byte
+**	per packet, and reads the sizes from the file a window at a time. Seeking
+**	then reads a single window however long the file is.
+*/
 typedef struct
-{	uint32_t	current, count, allocated ;
-	uint32_t	packet_size [] ;
+{	uint32_t	current, count ;
+	sf_count_t	total ;			/* Sum of all the packet sizes. */
+
+	/* Writing. */
+	uint8_t		* data ;
+	uint32_t	data_len, data_allocated ;
+
+	/* Reading. */
+	sf_count_t	chunk_offset ;	/* File offset of the packet sizes. */
+	uint32_t	chunk_len ;
+
+	PAKT_MARK	* index ;
+	uint32_t	marks, allocated ;
+
+	uint32_t	window_start, window_count ;
+	sf_count_t	window_offset ;
+	uint32_t	window [PAKT_WINDOW] ;
 } PAKT_INFO ;
 
+/*
+**	With SFC_SET_THREADS full blocks are collected here and then encoded on
+**	worker threads, one segment of ALAC_SEGMENT_PACKETS per job. Each segment
+**	starts with a freshly initialised encoder so that it does not depend on
+**	the ones before it, which makes the file the same for any thread count.
+*/
+typedef struct
+{	PSF_THREAD_POOL	* pool ;
+	ALAC_ENCODER	* encoders ;	/* One per worker. */
+
+	int			blocks, used ;
+	uint32_t	input_len, output_len ;
+
+	int			* input ;
+	uint8_t		* output ;
+	uint32_t	* frames ;
+	uint32_t	* bytes ;
+} ALAC_BATCH ;
+
 typedef struct
 {	sf_count_t	input_data_pos ;
 
@@ -47,8 +104,9 @@ typedef struct
 	int			channels, final_write_block ;
 
 	uint32_t	frames_this_block, partial_block_frames, frames_per_block ;
-	uint32_t	bits_per_sample, kuki_size ;
+	uint32_t	bits_per_sample, kuki_size, format_flags ;
 
+	ALAC_BATCH	* batch ;
 
 	/* Can't have a decoder and an encoder at the same time so stick
 	** them in an un-named union.
@@ -58,9 +116,6 @@ typedef struct
 		ALAC_ENCODER encoder ;
 	} ;
 
-	char enctmpname [512] ;
-	FILE *enctmp ;
-
 	uint8_t	byte_buffer [ALAC_MAX_CHANNEL_COUNT * ALAC_BYTE_BUFFER_SIZE] ;
 
 	int	buffer	[] ;
@@ -91,17 +146,23 @@ static int	alac_close		(SF_PRIVATE *psf) ;
 static int	alac_byterate	(SF_PRIVATE *psf) ;
 
 static int alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
-static int alac_encode_block (ALAC_PRIVATE *plac) ;
+static int alac_encode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
+
+static ALAC_BATCH * alac_batch_alloc (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
+static void alac_batch_free (ALAC_BATCH *batch) ;
+static int alac_batch_flush (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
 
 static uint32_t alac_kuki_read (SF_PRIVATE * psf, uint32_t kuki_offset, uint8_t * kuki, size_t kuki_maxlen) ;
 
-static PAKT_INFO * alac_pakt_alloc (uint32_t initial_count) ;
-static PAKT_INFO * alac_pakt_read_decode (SF_PRIVATE * psf, uint32_t pakt_offset) ;
-static PAKT_INFO * alac_pakt_append (PAKT_INFO * info, uint32_t value) ;
+static void alac_pakt_free (PAKT_INFO * info) ;
+static PAKT_INFO * alac_pakt_read_index (SF_PRIVATE * psf) ;
+static int alac_pakt_append (PAKT_INFO * info, uint32_t value) ;
 static uint8_t * alac_pakt_encode (const SF_PRIVATE *psf, uint32_t * pakt_size) ;
-static sf_count_t alac_pakt_block_offset (const PAKT_INFO *info, uint32_t block) ;
+static int alac_pakt_load_window (SF_PRIVATE * psf, PAKT_INFO * info, uint32_t block) ;
+static sf_count_t alac_pakt_block_offset (SF_PRIVATE * psf, PAKT_INFO * info, uint32_t block) ;
 
 static const char * alac_error_string (int error) ;
+static void alac_save_kuki (SF_PRIVATE *psf, ALAC_PRIVATE *plac) ;
 
 /*============================================================================================
 ** ALAC Reader initialisation function.
@@ -164,15 +225,11 @@ alac_get_desc_chunk_items (int subformat, uint32_t *fmt_flags, uint32_t *frames_
 static int
 alac_close	(SF_PRIVATE *psf)
 {	ALAC_PRIVATE *plac ;
-	BUF_UNION	ubuf ;
 
 	plac = psf->codec_data ;
 
 	if (psf->file.mode == SFM_WRITE)
-	{	ALAC_ENCODER *penc = &plac->encoder ;
-		SF_CHUNK_INFO chunk_info ;
-		sf_count_t readcount ;
-		uint8_t kuki_data [1024] ;
+	{	SF_CHUNK_INFO chunk_info ;
 		uint32_t pakt_size = 0, saved_partial_block_frames ;
 
 		plac->final_write_block = 1 ;
@@ -180,18 +237,27 @@ alac_close	(SF_PRIVATE *psf)
 
 		/*	If a block has been partially assembled, write it out as the final block. */
 		if (plac->partial_block_frames && plac->partial_block_frames < plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
+
+		if (plac->batch != NULL)
+		{	alac_batch_flush (psf, plac) ;
+			alac_batch_free (plac->batch) ;
+			plac->batch = NULL ;
+			} ;
 
 		plac->partial_block_frames = saved_partial_block_frames ;
 
-		alac_get_magic_cookie (penc, kuki_data, &plac->kuki_size) ;
+		/* The cookie now has the real maximum packet size and bit rate. */
+		alac_save_kuki (psf, plac) ;
 
-		memset (&chunk_info, 0, sizeof (chunk_info)) ;
-		chunk_info.id_size = snprintf (chunk_info.id, sizeof (chunk_info.id), "kuki") ;
-		chunk_info.data = kuki_data ;
-		chunk_info.datalen = plac->kuki_size ;
-		psf_save_write_chunk (&psf->wchunks, &chunk_info) ;
+		/* Chunks may have been added since the header was written at open. */
+		if (psf->have_written == SF_FALSE)
+			psf->write_header (psf, SF_FALSE) ;
 
+		/*
+		**	The packets have gone straight to the file, so all that is left
+		**	is the 'pakt' chunk which the CAF code writes after the audio.
+		*/
 		memset (&chunk_info, 0, sizeof (chunk_info)) ;
 		chunk_info.id_size = snprintf (chunk_info.id, sizeof (chunk_info.id), "pakt") ;
 		chunk_info.data = alac_pakt_encode (psf, &pakt_size) ;
@@ -201,20 +267,10 @@ alac_close	(SF_PRIVATE *psf)
 		free (chunk_info.data) ;
 		chunk_info.data = NULL ;
 
-		psf->write_header (psf, 1) ;
-
-		if (plac->enctmp != NULL)
-		{	fseek (plac->enctmp, 0, SEEK_SET) ;
-
-			while ((readcount = fread (ubuf.ucbuf, 1, sizeof (ubuf.ucbuf), plac->enctmp)) > 0)
-				psf_fwrite (ubuf.ucbuf, 1, readcount, psf) ;
-			fclose (plac->enctmp) ;
-			remove (plac->enctmpname) ;
-			} ;
+		psf->dataend = psf->dataoffset + plac->pakt_info->total ;
 		} ;
 
-	if (plac->pakt_info)
-		free (plac->pakt_info) ;
+	alac_pakt_free (plac->pakt_info) ;
 	plac->pakt_info = NULL ;
 
 	return 0 ;
@@ -256,12 +312,11 @@ alac_reader_init (SF_PRIVATE *psf, const ALAC_DECODER_INFO * info)
 	plac->frames_per_block	= info->frames_per_packet ;
 	plac->bits_per_sample	= info->bits_per_sample ;
 
-	if (plac->pakt_info != NULL)
-		free (plac->pakt_info) ;
-	plac->pakt_info = alac_pakt_read_decode (psf, info->pakt_offset) ;
+	alac_pakt_free (plac->pakt_info) ;
+	plac->pakt_info = alac_pakt_read_index (psf) ;
 
 	if (plac->pakt_info == NULL)
-	{	psf_log_printf (psf, "%s : alac_pkt_read() returns NULL.\n", __func__) ;
+	{	psf_log_printf (psf, "%s : alac_pakt_read_index() returns NULL.\n", __func__) ;
 		return SFE_INTERNAL ;
 		} ;
 
@@ -350,46 +405,68 @@ alac_writer_init (SF_PRIVATE *psf)
 
 	plac->frames_per_block = ALAC_FRAME_LENGTH ;
 
-	plac->pakt_info = alac_pakt_alloc (2000) ;
-
-	if ((plac->enctmp = psf_open_tmpfile (plac->enctmpname, sizeof (plac->enctmpname))) == NULL)
-	{	psf_log_printf (psf, "Error : Failed to open temp file '%s' : \n", plac->enctmpname, strerror (errno)) ;
-		return SFE_ALAC_FAIL_TMPFILE ;
-		} ;
+	if ((plac->pakt_info = calloc (1, sizeof (PAKT_INFO))) == NULL)
+		return SFE_MALLOC_FAILED ;
 
+	plac->format_flags = alac_format_flags ;
 	alac_encoder_init (&plac->encoder, psf->sf.samplerate, psf->sf.channels, alac_format_flags, ALAC_FRAME_LENGTH) ;
 
-	return 0 ;
+	/*
+	**	Encoded packets are written straight into the data chunk. The cookie
+	**	has the same size now as when the file is closed, so a placeholder
+	**	goes in the header to fix the offset of the audio data.
+	*/
+	alac_save_kuki (psf, plac) ;
+
+	return psf->write_header (psf, SF_FALSE) ;
 } /* alac_writer_init */
 
+static void
+alac_save_kuki (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
+{	SF_CHUNK_INFO chunk_info ;
+	uint8_t kuki_data [1024] ;
+	uint32_t k ;
+
+	plac->kuki_size = sizeof (kuki_data) ;
+	alac_get_magic_cookie (&plac->encoder, kuki_data, &plac->kuki_size) ;
+
+	for (k = 0 ; k < psf->wchunks.used ; k++)
+		if (psf->wchunks.chunks [k].mark32 == MAKE_MARKER ('k', 'u', 'k', 'i'))
+		{	memcpy (psf->wchunks.chunks [k].data, kuki_data, plac->kuki_size) ;
+			return ;
+			} ;
+
+	memset (&chunk_info, 0, sizeof (chunk_info)) ;
+	chunk_info.id_size = snprintf (chunk_info.id, sizeof (chunk_info.id), "kuki") ;
+	chunk_info.data = kuki_data ;
+	chunk_info.datalen = plac->kuki_size ;
+	psf_save_write_chunk (&psf->wchunks, &chunk_info) ;
+} /* alac_save_kuki */
+
 /*============================================================================================
 ** ALAC block decoder and encoder.
 */
 
 static inline uint32_t
-alac_reader_next_packet_size (PAKT_INFO * info)
-{	if (info->current >= info->count)
+alac_reader_next_packet_size (SF_PRIVATE *psf, PAKT_INFO * info)
+{	uint32_t block = info->current ;
+
+	if (block >= info->count || alac_pakt_load_window (psf, info, block) == 0)
 		return 0 ;
-	return info->packet_size [info->current++] ;
+
+	info->current ++ ;
+	return info->window [block - info->window_start] ;
 } /* alac_reader_next_packet_size */
 
 static sf_count_t
 alac_reader_calc_frames (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 {	sf_count_t	frames = 0 ;
-	uint32_t	current_pos = 1, blocks = 0 ;
 
-	plac->pakt_info->current = 0 ;
-
-	while (current_pos < psf->filelength && current_pos > 0)
-	{	current_pos = alac_reader_next_packet_size (plac->pakt_info) ;
-		blocks = current_pos > 0 ? blocks + 1 : blocks ;
-		} ;
-
-	if (blocks == 0)
+	if (plac->pakt_info->count == 0)
 		return 0 ;
 
 	/* Only count full blocks. */
-	frames = plac->frames_per_block * (blocks - 1) ;
+	frames = (sf_count_t) plac->frames_per_block * (plac->pakt_info->count - 1) ;
 
 	alac_seek (psf, SFM_READ, frames) ;
 	alac_decode_block (psf, plac) ;
@@ -406,7 +483,7 @@ alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 	uint32_t	packet_size ;
 	BitBuffer	bit_buffer ;
 
-	packet_size = alac_reader_next_packet_size (plac->pakt_info) ;
+	packet_size = alac_reader_next_packet_size (psf, plac->pakt_info) ;
 	if (packet_size == 0)
 	{	if (plac->pakt_info->current < plac->pakt_info->count)
 			psf_log_printf (psf, "packet_size is 0 (%d of %d)\n", plac->pakt_info->current, plac->pakt_info->count) ;
@@ -436,15 +513,35 @@ alac_decode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 
 
 static int
-alac_encode_block (ALAC_PRIVATE *plac)
+alac_encode_block (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
 {	ALAC_ENCODER *penc = &plac->encoder ;
 	uint32_t num_bytes = 0 ;
 
+	/* SFC_SET_THREADS can't be changed after the first write, so decide at the first block. */
+	if (plac->batch == NULL && psf->threads > 1 && plac->pakt_info->count == 0)
+	{	if ((plac->batch = alac_batch_alloc (psf, plac)) == NULL)
+		{	psf->error = SFE_MALLOC_FAILED ;
+			return 0 ;
+			} ;
+		} ;
+
+	if (plac->batch != NULL)
+	{	ALAC_BATCH *batch = plac->batch ;
+
+		memcpy (batch->input + batch->used * batch->input_len, plac->buffer, plac->partial_block_frames * plac->channels * sizeof (int)) ;
+		batch->frames [batch->used ++] = plac->partial_block_frames ;
+		plac->partial_block_frames = 0 ;
+
+		if (batch->used < batch->blocks)
+			return 1 ;
+		return alac_batch_flush (psf, plac) ;
+		} ;
+
 	alac_encode (penc, plac->partial_block_frames, plac->buffer, plac->byte_buffer, &num_bytes) ;
 
-	if (fwrite (plac->byte_buffer, 1, num_bytes, plac->enctmp) != num_bytes)
+	if (psf_fwrite (plac->byte_buffer, 1, num_bytes, psf) != num_bytes)
 		return 0 ;
-	if ((plac->pakt_info = alac_pakt_append (plac->pakt_info, num_bytes)) == NULL)
+	if (alac_pakt_append (plac->pakt_info, num_bytes) == 0)
 		return 0 ;
 
 	plac->partial_block_frames = 0 ;
@@ -452,6 +549,91 @@ alac_encode_block (ALAC_PRIVATE *plac)
 	return 1 ;
 } /* alac_encode_block */
 
+static ALAC_BATCH *
+alac_batch_alloc (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
+{	ALAC_BATCH *batch ;
+	int workers ;
+
+	if ((batch = calloc (1, sizeof (ALAC_BATCH))) == NULL)
+		return NULL ;
+
+	/* Without thread support the packets are still encoded the same way, just serially. */
+	batch->pool = psf_thread_pool_new (psf->threads) ;
+	workers = psf_thread_pool_workers (batch->pool) ;
+
+	batch->blocks = workers * ALAC_SEGMENT_PACKETS ;
+	batch->input_len = plac->frames_per_block * plac->channels ;
+	batch->output_len = plac->encoder.mMaxOutputBytes ;
+
+	batch->encoders = calloc (workers, sizeof (ALAC_ENCODER)) ;
+	batch->input = malloc (batch->blocks * batch->input_len * sizeof (int)) ;
+	batch->output = malloc (batch->blocks * batch->output_len) ;
+	batch->frames = calloc (batch->blocks, sizeof (uint32_t)) ;
+	batch->bytes = calloc (batch->blocks, sizeof (uint32_t)) ;
+
+	if (batch->encoders == NULL || batch->input == NULL || batch->output == NULL || batch->frames == NULL || batch->bytes == NULL)
+	{	alac_batch_free (batch) ;
+		return NULL ;
+		} ;
+
+	return batch ;
+} /* alac_batch_alloc */
+
+static void
+alac_batch_free (ALAC_BATCH *batch)
+{
+	psf_thread_pool_free (batch->pool) ;
+	free (batch->encoders) ;
+	free (batch->input) ;
+	free (batch->output) ;
+	free (batch->frames) ;
+	free (batch->bytes) ;
+	free (batch) ;
+} /* alac_batch_free */
+
+static void
+alac_batch_encode (void *data, int job, int worker)
+{	ALAC_PRIVATE *plac = data ;
+	ALAC_BATCH *batch = plac->batch ;
+	ALAC_ENCODER *penc = batch->encoders + worker ;
+	int k, end ;
+
+	alac_encoder_init (penc, plac->encoder.mOutputSampleRate, plac->channels, plac->format_flags, plac->frames_per_block) ;
+
+	end = SF_MIN ((job + 1) * ALAC_SEGMENT_PACKETS, batch->used) ;
+	for (k = job * ALAC_SEGMENT_PACKETS ; k < end ; k++)
+	{	batch->bytes [k] = 0 ;
+		alac_encode (penc, batch->frames [k], batch->input + k * batch->input_len, batch->output + k * batch->output_len, &batch->bytes [k]) ;
+		} ;
+} /* alac_batch_encode */
+
+static int
+alac_batch_flush (SF_PRIVATE *psf, ALAC_PRIVATE *plac)
+{	ALAC_BATCH *batch = plac->batch ;
+	uint32_t num_bytes ;
+	int k, used ;
+
+	used = batch->used ;
+
+	psf_thread_pool_run (batch->pool, (used + ALAC_SEGMENT_PACKETS - 1) / ALAC_SEGMENT_PACKETS, alac_batch_encode, plac) ;
+	batch->used = 0 ;
+
+	for (k = 0 ; k < used ; k++)
+	{	num_bytes = batch->bytes [k] ;
+
+		if (psf_fwrite (batch->output + k * batch->output_len, 1, num_bytes, psf) != num_bytes)
+			return 0 ;
+		if (alac_pakt_append (plac->pakt_info, num_bytes) == 0)
+			return 0 ;
+
+		/* The cookie is made from the main encoder's statistics. */
+		plac->encoder.mTotalBytesGenerated += num_bytes ;
+		plac->encoder.mMaxFrameBytes = SF_MAX (plac->encoder.mMaxFrameBytes, num_bytes) ;
+		} ;
+
+	return 1 ;
+} /* alac_batch_flush */
+
 /*============================================================================================
 ** ALAC read functions.
 */
@@ -608,7 +790,7 @@ alac_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 		return 0 ;
 		} ;
 
-	if (offset < 0 || offset > plac->pakt_info->count * plac->frames_per_block)
+	if (offset < 0 || offset > (sf_count_t) plac->pakt_info->count * plac->frames_per_block)
 	{	psf->error = SFE_BAD_SEEK ;
 		return	PSF_SEEK_ERROR ;
 		} ;
@@ -617,7 +799,14 @@ alac_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	newsample	= offset % plac->frames_per_block ;
 
 	if (mode == SFM_READ)
-	{	plac->input_data_pos = psf->dataoffset + alac_pakt_block_offset (plac->pakt_info, newblock) ;
+	{	sf_count_t block_offset ;
+
+		if ((block_offset = alac_pakt_block_offset (psf, plac->pakt_info, newblock)) < 0)
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
+
+		plac->input_data_pos = psf->dataoffset + block_offset ;
 
 		plac->pakt_info->current = newblock ;
 		alac_decode_block (psf, plac) ;
@@ -661,7 +850,7 @@ alac_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -692,7 +881,7 @@ alac_write_i (SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -725,7 +914,7 @@ alac_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -758,7 +947,7 @@ alac_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 		ptr += writecount ;
 
 		if (plac->partial_block_frames >= plac->frames_per_block)
-			alac_encode_block (plac) ;
+			alac_encode_block (psf, plac) ;
 		} ;
 
 	return total ;
@@ -768,177 +957,208 @@ alac_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 ** PAKT_INFO handling.
 */
 
-static PAKT_INFO *
-alac_pakt_alloc (uint32_t initial_count)
-{	PAKT_INFO * info ;
-
-	if ((info = calloc (1, sizeof (PAKT_INFO) + initial_count * sizeof (info->packet_size [0]))) == NULL)
-		return NULL ;
-
-	info->allocated = initial_count ;
-	info->current = 0 ;
-	info->count = 0 ;
+static void
+alac_pakt_free (PAKT_INFO * info)
+{
+	if (info == NULL)
+		return ;
 
-	return info ;
-} /* alac_pakt_alloc */
+	free (info->data) ;
+	free (info->index) ;
+	free (info) ;
+} /* alac_pakt_free */
 
-static PAKT_INFO *
+static int
 alac_pakt_append (PAKT_INFO * info, uint32_t value)
-{
-	if (info->count >= info->allocated)
-	{	PAKT_INFO * temp ;
-		uint32_t newcount = info->allocated + info->allocated / 2 ;
+{	uint32_t shift ;
 
-		if ((temp = realloc (info, sizeof (PAKT_INFO) + newcount * sizeof (info->packet_size [0]))) == NULL)
-			return NULL ;
+	/* Each size is stored in the 'pakt' form, big endian 7 bits per byte. */
+	if (info->data_len + 5 > info->data_allocated)
+	{	uint8_t * temp ;
+		uint32_t newsize = info->data_allocated + info->data_allocated / 2 + 4096 ;
 
-		info = temp ;
-		info->allocated = newcount ;
+		if ((temp = realloc (info->data, newsize)) == NULL)
+			return 0 ;
+
+		info->data = temp ;
+		info->data_allocated = newsize ;
 		} ;
 
-	info->packet_size [info->count++] = value ;
-	return info ;
+	for (shift = 28 ; shift > 0 && (value >> shift) == 0 ; shift -= 7)
+		;
+	for ( ; shift > 0 ; shift -= 7)
+		info->data [info->data_len++] = ((value >> shift) & 0x7f) | 0x80 ;
+	info->data [info->data_len++] = value & 0x7f ;
+
+	info->count ++ ;
+	info->total += value ;
+
+	return 1 ;
 } /* alac_pakt_append */
 
-static PAKT_INFO *
-alac_pakt_read_decode (SF_PRIVATE * psf, uint32_t UNUSED (pakt_offset))
-{	SF_CHUNK_INFO chunk_info ;
-	PAKT_INFO * info = NULL ;
-	uint8_t *pakt_data = NULL ;
-	uint32_t bcount, value = 1, pakt_size ;
-	SF_CHUNK_ITERATOR * chunk_iterator ;
+/*
+**	Decode up to count packet sizes from position *pos in the 'pakt' chunk
+**	data, stopping early at a zero size or the end of the chunk. Returns the
+**	number of sizes decoded, or -1 on a read error.
+*/
+static int
+alac_pakt_read_sizes (SF_PRIVATE * psf, PAKT_INFO * info, uint32_t * pos, uint32_t * sizes, int count)
+{	uint8_t buffer [PAKT_WINDOW * 5] ;
+	uint32_t value, bytes, bcount ;
+	int k, len ;
 
+	count = SF_MIN (count, PAKT_WINDOW) ;
+	bytes = SF_MIN (info->chunk_len - *pos, (uint32_t) (count * 5)) ;
 
-	memset (&chunk_info, 0, sizeof (chunk_info)) ;
-	snprintf (chunk_info.id, sizeof (chunk_info.id), "pakt") ;
-	chunk_info.id_size = 4 ;
+	if (psf_fseek (psf, info->chunk_offset + *pos, SEEK_SET) < 0 || psf_fread (buffer, 1, bytes, psf) != bytes)
+		return -1 ;
 
-	if ((chunk_iterator = psf_get_chunk_iterator (psf, chunk_info.id)) == NULL)
-	{	psf_log_printf (psf, "%s : no chunk iterator found\n", __func__) ;
-		free (chunk_info.data) ;
-		chunk_info.data = NULL ;
-		return NULL ;
+	for (k = 0, bcount = 0 ; k < count && bcount < bytes ; k++)
+	{	value = 0 ;
+		len = 0 ;
+		do
+		{	if (len == 5 || bcount + len >= bytes)
+			{	psf_log_printf (psf, "%s : bad size at byte %u of 'pakt' chunk.\n", __func__, *pos + bcount) ;
+				return k ;
+				} ;
+			value = (value << 7) + (buffer [bcount + len] & 0x7F) ;
+			}
+			while (buffer [bcount + len++] & 0x80) ;
+
+		if (value == 0)
+			break ;
+
+		sizes [k] = value ;
+		bcount += len ;
 		} ;
 
-	psf->get_chunk_size (psf, chunk_iterator, &chunk_info) ;
+	*pos += bcount ;
 
-	pakt_size = chunk_info.datalen ;
-	chunk_info.data = pakt_data = malloc (pakt_size + 5) ;
+	return k ;
+} /* alac_pakt_read_sizes */
 
-	if ((bcount = psf->get_chunk_data (psf, chunk_iterator, &chunk_info)) != SF_ERR_NO_ERROR)
-	{	while (chunk_iterator)
-			chunk_iterator = psf->next_chunk_iterator (psf, chunk_iterator) ;
-		free (chunk_info.data) ;
-		chunk_info.data = NULL ;
+static PAKT_INFO *
+alac_pakt_read_index (SF_PRIVATE * psf)
+{	PAKT_INFO * info ;
+	uint32_t sizes [PAKT_WINDOW], pos = 0 ;
+	int indx, k, count = 0 ;
+
+	if ((indx = psf_find_read_chunk_m32 (&psf->rchunks, MAKE_MARKER ('p', 'a', 'k', 't'))) < 0)
+	{	psf_log_printf (psf, "%s : no 'pakt' chunk found\n", __func__) ;
 		return NULL ;
 		} ;
 
-	while (chunk_iterator)
-		chunk_iterator = psf->next_chunk_iterator (psf, chunk_iterator) ;
+	if ((info = calloc (1, sizeof (PAKT_INFO))) == NULL)
+		return NULL ;
 
-	info = alac_pakt_alloc (pakt_size / 4) ;
+	/* Skip over the 24 byte header at the start of the chunk. */
+	info->chunk_offset = psf->rchunks.chunks [indx].offset + 24 ;
+	info->chunk_len = psf->rchunks.chunks [indx].len > 24 ? psf->rchunks.chunks [indx].len - 24 : 0 ;
 
-	/* Start at 24 bytes in, skipping over the 'pakt' chunks header. */
-	for (bcount = 24 ; bcount < pakt_size && value != 0 ; )
-	{	uint8_t byte ;
-		int32_t count = 0 ;
+	/* Every window starts with an index entry. */
+	while (pos < info->chunk_len)
+	{	if (info->marks >= info->allocated)
+		{	PAKT_MARK * temp ;
+			uint32_t newsize = info->allocated + info->allocated / 2 + 256 ;
 
-		value = 0 ;
-		do
-		{	byte = pakt_data [bcount + count] ;
-			value = (value << 7) + (byte & 0x7F) ;
-
-			count ++ ;
-			if (count > 5 || bcount + count > pakt_size)
-			{	printf ("%s %d : Ooops! count %d    bcount %d\n", __func__, __LINE__, count, bcount) ;
-				value = 0 ;
-				break ;
+			if ((temp = realloc (info->index, newsize * sizeof (PAKT_MARK))) == NULL)
+			{	alac_pakt_free (info) ;
+				return NULL ;
 				} ;
-			}
-			while (byte & 0x80) ;
+			info->index = temp ;
+			info->allocated = newsize ;
+			} ;
 
-		bcount += count ;
+		info->index [info->marks].offset = info->total ;
+		info->index [info->marks].pos = pos ;
+
+		if ((count = alac_pakt_read_sizes (psf, info, &pos, sizes, PAKT_WINDOW)) <= 0)
+			break ;
 
-		if ((info = alac_pakt_append (info, value)) == NULL)
-			goto FreeExit ;
+		for (k = 0 ; k < count ; k++)
+			info->total += sizes [k] ;
+		info->count += count ;
+		info->marks ++ ;
+
+		if (count < PAKT_WINDOW)
+			break ;
 		} ;
 
-	free (pakt_data) ;
+	if (count < 0)
+	{	alac_pakt_free (info) ;
+		return NULL ;
+		} ;
 
 	return info ;
+} /* alac_pakt_read_index */
 
-FreeExit :
-	free (pakt_data) ;
-	free (info) ;
-	return NULL ;
-} /* alac_pakt_read_decode */
+/* Make sure the packet size for block is in the window. */
+static int
+alac_pakt_load_window (SF_PRIVATE * psf, PAKT_INFO * info, uint32_t block)
+{	const PAKT_MARK * mark ;
+	uint32_t start, pos ;
+	int count ;
+
+	if (block - info->window_start < info->window_count)
+		return 1 ;
+	if (block >= info->count || info->index == NULL)
+		return 0 ;
+
+	start = block & ~(PAKT_WINDOW - 1) ;
+	mark = info->index + block / PAKT_WINDOW ;
+	pos = mark->pos ;
+
+	info->window_count = 0 ;
+	if ((count = alac_pakt_read_sizes (psf, info, &pos, info->window, (int) SF_MIN ((uint32_t) PAKT_WINDOW, info->count - start))) <= 0)
+		return 0 ;
+
+	info->window_start = start ;
+	info->window_count = count ;
+	info->window_offset = mark->offset ;
+
+	return block - start < (uint32_t) count ;
+} /* alac_pakt_load_window */
 
 static uint8_t *
 alac_pakt_encode (const SF_PRIVATE *psf, uint32_t * pakt_size_out)
 {	const ALAC_PRIVATE *plac ;
 	const PAKT_INFO *info ;
 	uint8_t	*data ;
-	uint32_t k, allocated, pakt_size ;
 
 	plac = psf->codec_data ;
 	info = plac->pakt_info ;
 
-	allocated = 100 + 2 * info->count ;
-	if ((data = calloc (1, allocated)) == NULL)
+	if ((data = calloc (1, 24 + info->data_len)) == NULL)
+	{	*pakt_size_out = 0 ;
 		return NULL ;
+		} ;
 
 	psf_put_be64 (data, 0, info->count) ;
 	psf_put_be64 (data, 8, psf->sf.frames) ;
 	psf_put_be32 (data, 20, kALACDefaultFramesPerPacket - plac->partial_block_frames) ;
 
 	/* Real 'pakt' data starts after 24 byte header. */
-	pakt_size = 24 ;
-
-	for (k = 0 ; k < info->count ; k++)
-	{	int32_t value = info->packet_size [k] ;
-
-		if ((value & 0x7f) == value)
-		{	data [pakt_size++] = value ;
-			continue ;
-			} ;
-
-		if ((value & 0x3fff) == value)
-		{	data [pakt_size++] = (value >> 7) | 0x80 ;
-			data [pakt_size++] = value & 0x7f ;
-			continue ;
-			} ;
+	if (info->data_len > 0)
+		memcpy (data + 24, info->data, info->data_len) ;
 
-		if ((value & 0x1fffff) == value)
-		{	data [pakt_size++] = (value >> 14) | 0x80 ;
-			data [pakt_size++] = ((value >> 7) & 0x7f) | 0x80 ;
-			data [pakt_size++] = value & 0x7f ;
-			continue ;
-		} ;
-
-		if ((value & 0x0fffffff) == value)
-		{	data [pakt_size++] = (value >> 21) | 0x80 ;
-			data [pakt_size++] = ((value >> 14) & 0x7f) | 0x80 ;
-			data [pakt_size++] = ((value >> 7) & 0x7f) | 0x80 ;
-			data [pakt_size++] = value & 0x7f ;
-			continue ;
-			} ;
-
-		*pakt_size_out = 0 ;
-		free (data) ;
-		return NULL ;
-		} ;
-
-	*pakt_size_out = pakt_size ;
+	*pakt_size_out = 24 + info->data_len ;
 	return data ;
 } /* alac_pakt_encode */
 
 static sf_count_t
-alac_pakt_block_offset (const PAKT_INFO *info, uint32_t block)
-{	sf_count_t offset = 0 ;
+alac_pakt_block_offset (SF_PRIVATE * psf, PAKT_INFO * info, uint32_t block)
+{	sf_count_t offset ;
 	uint32_t k ;
 
-	for (k = 0 ; k < block ; k++)
-		offset += info->packet_size [k] ;
+	if (block >= info->count)
+		return info->total ;
+
+	if (alac_pakt_load_window (psf, info, block) == 0)
+		return -1 ;
+
+	offset = info->window_offset ;
+	for (k = info->window_start ; k < block ; k++)
+		offset += info->window [k - info->window_start] ;
 
 	return offset ;
 } /* alac_pakt_block_offset */
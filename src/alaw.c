@@ -23,6 +23,7 @@
 
 #include	"sndfile.h"
 #include	"common.h"
+#include	"simd.h"
 
 static sf_count_t alaw_read_alaw2s (SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
 static sf_count_t alaw_read_alaw2i (SF_PRIVATE *psf, int *ptr, sf_count_t len) ;
@@ -53,6 +54,7 @@ alaw_init (SF_PRIVATE *psf)
 		psf->read_int		= alaw_read_alaw2i ;
 		psf->read_float		= alaw_read_alaw2f ;
 		psf->read_double	= alaw_read_alaw2d ;
+		psf->can_select_channels = SF_TRUE ;
 		} ;
 
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
@@ -292,31 +294,46 @@ unsigned char alaw_encode [2048 + 1] =
 
 static inline void
 alaw2s_array (unsigned char *buffer, int count, short *ptr)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_s (buffer, ptr, count, PSF_G711_ALAW) ;
+	while (--count >= done)
 		ptr [count] = alaw_decode [(int) buffer [count]] ;
 } /* alaw2s_array */
 
 static inline void
 alaw2i_array (unsigned char *buffer, int count, int *ptr)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_i (buffer, ptr, count, PSF_G711_ALAW) ;
+	while (--count >= done)
 		ptr [count] = ((uint32_t) alaw_decode [(int) buffer [count]]) << 16 ;
 } /* alaw2i_array */
 
 static inline void
 alaw2f_array (unsigned char *buffer, int count, float *ptr, float normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_f (buffer, ptr, count, PSF_G711_ALAW, normfact) ;
+	while (--count >= done)
 		ptr [count] = normfact * alaw_decode [(int) buffer [count]] ;
 } /* alaw2f_array */
 
 static inline void
 alaw2d_array (unsigned char *buffer, int count, double *ptr, double normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_d (buffer, ptr, count, PSF_G711_ALAW, normfact) ;
+	while (--count >= done)
 		ptr [count] = normfact * alaw_decode [(int) buffer [count]] ;
 } /* alaw2d_array */
 
 static inline void
 s2alaw_array (const short *ptr, int count, unsigned char *buffer)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->s_to_g711 (ptr, buffer, count, PSF_G711_ALAW) ;
+	while (--count >= done)
 	{	if (ptr [count] >= 0)
 			buffer [count] = alaw_encode [ptr [count] / 16] ;
 		else
@@ -326,7 +343,10 @@ s2alaw_array (const short *ptr, int count, unsigned char *buffer)
 
 static inline void
 i2alaw_array (const int *ptr, int count, unsigned char *buffer)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->i_to_g711 (ptr, buffer, count, PSF_G711_ALAW) ;
+	while (--count >= done)
 	{	if (ptr [count] == INT_MIN)
 			buffer [count] = alaw_encode [INT_MAX >> (16 + 4)] ;
 		else if (ptr [count] >= 0)
@@ -338,7 +358,10 @@ i2alaw_array (const int *ptr, int count, unsigned char *buffer)
 
 static inline void
 f2alaw_array (const float *ptr, int count, unsigned char *buffer, float normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->f_to_g711 (ptr, buffer, count, PSF_G711_ALAW, normfact) ;
+	while (--count >= done)
 	{	if (ptr [count] >= 0)
 			buffer [count] = alaw_encode [lrintf (normfact * ptr [count])] ;
 		else
@@ -348,7 +371,10 @@ f2alaw_array (const float *ptr, int count, unsigned char *buffer, float normfact
 
 static inline void
 d2alaw_array (const double *ptr, int count, unsigned char *buffer, double normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->d_to_g711 (ptr, buffer, count, PSF_G711_ALAW, normfact) ;
+	while (--count >= done)
 	{	if (!isfinite (ptr [count]))
 			buffer [count] = 0 ;
 		else if (ptr [count] >= 0)
@@ -372,7 +398,7 @@ alaw_read_alaw2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		alaw2s_array (ubuf.ucbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -394,7 +420,7 @@ alaw_read_alaw2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		alaw2i_array (ubuf.ucbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -419,7 +445,7 @@ alaw_read_alaw2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		alaw2f_array (ubuf.ucbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -443,7 +469,7 @@ alaw_read_alaw2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		alaw2d_array (ubuf.ucbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
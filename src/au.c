@@ -163,17 +163,14 @@ au_open	(SF_PRIVATE *psf)
 
 		case SF_FORMAT_G721_32 :
 				error = g72x_init (psf) ;
-				psf->sf.seekable = SF_FALSE ;
 				break ;
 
 		case SF_FORMAT_G723_24 :
 				error = g72x_init (psf) ;
-				psf->sf.seekable = SF_FALSE ;
 				break ;
 
 		case SF_FORMAT_G723_40 :
 				error = g72x_init (psf) ;
-				psf->sf.seekable = SF_FALSE ;
 				break ;
 		/* Lite remove end */
 
@@ -735,9 +735,10 @@ caf_write_header (SF_PRIVATE *psf, int calc_length)
 	if (psf->channel_map && pcaf->chanmap_tag)
 		psf_binheader_writef (psf, "Em8444", BHWm (chan_MARKER), BHW8 ((sf_count_t) 12), BHW4 (pcaf->chanmap_tag), BHW4 (0), BHW4 (0)) ;
 
-	/* Write custom headers. */
+	/* Write custom headers. The ALAC 'pakt' chunk goes after the audio data. */
 	for (uk = 0 ; uk < psf->wchunks.used ; uk++)
-		psf_binheader_writef (psf, "m44b", BHWm ((int) psf->wchunks.chunks [uk].mark32), BHW4 (0), BHW4 (psf->wchunks.chunks [uk].len), BHWv (psf->wchunks.chunks [uk].data), BHWz (psf->wchunks.chunks [uk].len)) ;
+		if (psf->wchunks.chunks [uk].mark32 != pakt_MARKER)
+			psf_binheader_writef (psf, "m44b", BHWm ((int) psf->wchunks.chunks [uk].mark32), BHW4 (0), BHW4 (psf->wchunks.chunks [uk].len), BHWv (psf->wchunks.chunks [uk].data), BHWz (psf->wchunks.chunks [uk].len)) ;
 
 	if (append_free_block)
 	{	/* Add free chunk so that the actual audio data starts at a multiple 0x1000. */
@@ -764,7 +765,8 @@ caf_write_header (SF_PRIVATE *psf, int calc_length)
 
 static int
 caf_write_tailer (SF_PRIVATE *psf)
-{
+{	uint32_t uk ;
+
 	/* Reset the current header buffer length to zero. */
 	psf->header.ptr [0] = 0 ;
 	psf->header.indx = 0 ;
@@ -779,6 +781,14 @@ caf_write_tailer (SF_PRIVATE *psf)
 	else
 		psf->dataend = psf_fseek (psf, 0, SEEK_END) ;
 
+	/*
+	**	The size of the ALAC packet table is only known once all the audio has
+	**	been encoded, so it follows the data chunk rather than preceding it.
+	*/
+	for (uk = 0 ; uk < psf->wchunks.used ; uk++)
+		if (psf->wchunks.chunks [uk].mark32 == pakt_MARKER)
+			psf_binheader_writef (psf, "Em8b", BHWm (pakt_MARKER), BHW8 ((sf_count_t) psf->wchunks.chunks [uk].len), BHWv (psf->wchunks.chunks [uk].data), BHWz (psf->wchunks.chunks [uk].len)) ;
+
 	if (psf->dataend & 1)
 		psf_binheader_writef (psf, "z", BHWz (1)) ;
 
@@ -0,0 +1,134 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include	"sfconfig.h"
+
+#include	<stdlib.h>
+#include	<string.h>
+
+#include	"sndfile.h"
+#include	"common.h"
+#include	"checkpoint.h"
+
+struct PSF_CHECKPOINTS
+{	sf_count_t		interval ;
+	int				state_size ;
+
+	/* Snapshot k was taken at frame k * interval. */
+	int				count, allocated ;
+	unsigned char	*states ;
+} ;
+
+PSF_CHECKPOINTS *
+psf_checkpoints_new (sf_count_t interval, int state_size)
+{	PSF_CHECKPOINTS *cp ;
+
+	if (interval < 1 || state_size < 1)
+		return NULL ;
+
+	if ((cp = calloc (1, sizeof (PSF_CHECKPOINTS))) == NULL)
+		return NULL ;
+
+	cp->interval = interval ;
+	cp->state_size = state_size ;
+
+	return cp ;
+} /* psf_checkpoints_new */
+
+void
+psf_checkpoints_free (PSF_CHECKPOINTS *cp)
+{
+	if (cp == NULL)
+		return ;
+
+	free (cp->states) ;
+	free (cp) ;
+} /* psf_checkpoints_free */
+
+sf_count_t
+psf_checkpoints_interval (const PSF_CHECKPOINTS *cp)
+{	return cp == NULL ? SF_COUNT_MAX : cp->interval ;
+} /* psf_checkpoints_interval */
+
+sf_count_t
+psf_checkpoints_ahead (const PSF_CHECKPOINTS *cp, sf_count_t frame)
+{	sf_count_t next ;
+
+	if (cp == NULL)
+		return SF_COUNT_MAX ;
+
+	next = cp->count * cp->interval ;
+
+	/* Past the next snapshot without taking it, so it can't be taken now. */
+	if (frame > next)
+		return SF_COUNT_MAX ;
+
+	return next - frame ;
+} /* psf_checkpoints_ahead */
+
+void
+psf_checkpoints_add (PSF_CHECKPOINTS *cp, sf_count_t frame, const void *state)
+{	unsigned char *states ;
+	int allocated ;
+
+	if (cp == NULL || frame != cp->count * cp->interval)
+		return ;
+
+	if (cp->count >= cp->allocated)
+	{	allocated = cp->allocated > 0 ? 2 * cp->allocated : 64 ;
+		if ((states = realloc (cp->states, (size_t) allocated * cp->state_size)) == NULL)
+			return ;
+		cp->states = states ;
+		cp->allocated = allocated ;
+		} ;
+
+	memcpy (cp->states + (size_t) cp->count * cp->state_size, state, cp->state_size) ;
+	cp->count ++ ;
+} /* psf_checkpoints_add */
+
+sf_count_t
+psf_checkpoints_find (const PSF_CHECKPOINTS *cp, sf_count_t frame, void *state)
+{	sf_count_t k ;
+
+	if (cp == NULL || cp->count == 0 || frame < 0)
+		return -1 ;
+
+	k = SF_MIN (frame / cp->interval, (sf_count_t) cp->count - 1) ;
+	if (state != NULL)
+		memcpy (state, cp->states + (size_t) k * cp->state_size, cp->state_size) ;
+
+	return k * cp->interval ;
+} /* psf_checkpoints_find */
+
+int
+psf_checkpoints_build (SF_PRIVATE *psf)
+{	sf_count_t current = psf->read_current ;
+
+	if (psf->checkpoints == NULL || psf->file.mode != SFM_READ || psf->seek == NULL)
+		return SF_FALSE ;
+
+	if (psf->seek (psf, SFM_READ, psf->sf.frames) == PSF_SEEK_ERROR)
+		return SF_FALSE ;
+
+	if (psf->seek (psf, SFM_READ, current) != current)
+	{	psf->error = SFE_BAD_SEEK ;
+		return SF_FALSE ;
+		} ;
+
+	return SF_TRUE ;
+} /* psf_checkpoints_build */
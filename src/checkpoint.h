@@ -0,0 +1,71 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef SNDFILE_CHECKPOINT_H
+#define SNDFILE_CHECKPOINT_H
+
+/*
+**	Decoder state checkpoints for codecs that can only seek by decoding.
+**
+**	The state of codecs like G72x or DWVW depends on everything decoded
+**	before it, so a file offset alone is not enough to start decoding. While
+**	reading, such a codec saves a snapshot of its state (including whatever
+**	it needs to find its place in the file) every interval frames. A seek then
+**	restores the last snapshot at or before the target and decodes only the
+**	rest.
+**
+**	Snapshots are taken in order from the start of the file, so the codec only
+**	has to check psf_checkpoints_ahead () at places where it could stop, and
+**	save when it returns zero. The codec must be able to stop at every
+**	multiple of interval. A NULL PSF_CHECKPOINTS is valid and never asks for a
+**	snapshot.
+*/
+
+/* Frames between checkpoints when a codec has no reason to pick another. */
+#define	PSF_CHECKPOINT_INTERVAL		8192
+
+typedef struct PSF_CHECKPOINTS PSF_CHECKPOINTS ;
+
+PSF_CHECKPOINTS * psf_checkpoints_new (sf_count_t interval, int state_size) ;
+void psf_checkpoints_free (PSF_CHECKPOINTS *cp) ;
+
+sf_count_t psf_checkpoints_interval (const PSF_CHECKPOINTS *cp) ;
+
+/*
+** Return how many frames can be decoded from frame before the next snapshot
+** is due, zero if it is due now, or SF_COUNT_MAX if none is needed.
+*/
+sf_count_t psf_checkpoints_ahead (const PSF_CHECKPOINTS *cp, sf_count_t frame) ;
+
+/* Save state as the snapshot for frame. Ignored unless the snapshot is due. */
+void psf_checkpoints_add (PSF_CHECKPOINTS *cp, sf_count_t frame, const void *state) ;
+
+/*
+** Copy the last snapshot at or before frame into state and return the frame
+** it was taken at, or return -1 if there is none. With a NULL state only the
+** frame is returned.
+*/
+sf_count_t psf_checkpoints_find (const PSF_CHECKPOINTS *cp, sf_count_t frame, void *state) ;
+
+/*
+** Decode to the end of the file to take all the snapshots of psf->checkpoints,
+** then seek back. Returns SF_TRUE on success.
+*/
+int psf_checkpoints_build (SF_PRIVATE *psf) ;
+
+#endif /* SNDFILE_CHECKPOINT_H */
@@ -19,11 +19,14 @@
 #include	"sfconfig.h"
 
 #include	<stdio.h>
+#include	<stdlib.h>
 #include	<string.h>
 #include	<math.h>
 
 #include	"sndfile.h"
 #include	"common.h"
+#include	"simd.h"
+#include	"thread_pool.h"
 
 static SF_FORMAT_INFO const simple_formats [] =
 {
@@ -277,59 +280,281 @@ psf_get_format_info (SF_FORMAT_INFO *data)
 /*==============================================================================
 */
 
-double
-psf_calc_signal_max (SF_PRIVATE *psf, int normalize)
-{	BUF_UNION	ubuf ;
+/*
+**	Peak scanning for SFC_CALC_SIGNAL_MAX, SFC_CALC_MAX_ALL_CHANNELS and their
+**	normalised versions. The peaks of each channel are kept in psf->peak_cache
+**	until the next write, so asking again is free.
+**
+**	With SFC_SET_THREADS, large files opened read only are scanned in
+**	parallel. Each worker gets a handle of its own, opened with virtual I/O
+**	which reads this file's descriptor with psf_fread_at () from a cursor
+**	of its own. The file is never opened again by name, so it doesn't
+**	matter if it has been renamed or the working directory has changed.
+**	That is only done for data which decodes the same wherever reading
+**	starts.
+*/
+
+#define	PEAK_SCAN_MIN_FRAMES	(1 << 18)
+#define	PEAK_SCAN_JOBS			4		/* Per worker, to even out the load. */
+
+typedef struct
+{	SF_PRIVATE	*psf ;
 	sf_count_t	position ;
-	double 		max_val, temp, *data ;
-	int			k, len, readcount, save_state ;
+} PEAK_SCAN_CURSOR ;
+
+typedef struct
+{	SNDFILE		*handles [PSF_MAX_THREADS] ;
+	PEAK_SCAN_CURSOR	cursors [PSF_MAX_THREADS] ;
+	int			failed [PSF_MAX_THREADS] ;
+	double		*peaks ;	/* One set of channel peaks per worker. */
+	sf_count_t	frames ;
+	int			channels, jobs ;
+} PEAK_SCAN ;
+
+static sf_count_t
+peak_scan_get_filelen (void *user_data)
+{	PEAK_SCAN_CURSOR *cursor = user_data ;
+
+	return cursor->psf->filelength ;
+} /* peak_scan_get_filelen */
+
+static sf_count_t
+peak_scan_seek (sf_count_t offset, int whence, void *user_data)
+{	PEAK_SCAN_CURSOR *cursor = user_data ;
+
+	switch (whence)
+	{	case SEEK_SET :
+			break ;
+
+		case SEEK_CUR :
+			offset += cursor->position ;
+			break ;
+
+		case SEEK_END :
+			offset += cursor->psf->filelength ;
+			break ;
+
+		default :
+			return -1 ;
+		} ;
 
-	/* If the file is not seekable, there is nothing we can do. */
-	if (! psf->sf.seekable)
-	{	psf->error = SFE_NOT_SEEKABLE ;
-		return	0.0 ;
+	if (offset < 0)
+		return -1 ;
+
+	cursor->position = offset ;
+
+	return cursor->position ;
+} /* peak_scan_seek */
+
+static sf_count_t
+peak_scan_read (void *ptr, sf_count_t count, void *user_data)
+{	PEAK_SCAN_CURSOR *cursor = user_data ;
+
+	count = psf_fread_at (cursor->psf, ptr, count, cursor->position) ;
+	if (count <= 0)
+		return 0 ;
+
+	cursor->position += count ;
+
+	return count ;
+} /* peak_scan_read */
+
+static sf_count_t
+peak_scan_write (const void *UNUSED (ptr), sf_count_t UNUSED (count), void *UNUSED (user_data))
+{	return 0 ;
+} /* peak_scan_write */
+
+static sf_count_t
+peak_scan_tell (void *user_data)
+{	PEAK_SCAN_CURSOR *cursor = user_data ;
+
+	return cursor->position ;
+} /* peak_scan_tell */
+
+static void
+peak_update (const double *data, int count, int channels, double *peaks)
+{	double	temp ;
+	int		k, chan ;
+
+	/* The kernel does whole frames, so the rest starts at channel 0. */
+	k = psf_simd ()->peak_d (data, count, channels, peaks) ;
+
+	for (chan = 0 ; k < count ; k++)
+	{	temp = fabs (data [k]) ;
+		peaks [chan] = temp > peaks [chan] ? temp : peaks [chan] ;
+		chan = (chan + 1 == channels) ? 0 : chan + 1 ;
 		} ;
+} /* peak_update */
 
-	if (! psf->read_double)
-	{	psf->error = SFE_UNIMPLEMENTED ;
-		return	0.0 ;
+static void
+peak_scan_job (void *data, int job, int worker)
+{	PEAK_SCAN	*scan = data ;
+	BUF_UNION	ubuf ;
+	sf_count_t	start, end, readcount ;
+	int			len ;
+
+	if (scan->failed [worker])
+		return ;
+
+	start = scan->frames * job / scan->jobs ;
+	end = scan->frames * (job + 1) / scan->jobs ;
+	len = ARRAY_LEN (ubuf.dbuf) / scan->channels ;
+
+	if (sf_seek (scan->handles [worker], start, SEEK_SET) != start)
+	{	scan->failed [worker] = SF_TRUE ;
+		return ;
+		} ;
+
+	for ( ; start < end ; start += readcount)
+	{	readcount = sf_readf_double (scan->handles [worker], ubuf.dbuf, SF_MIN ((sf_count_t) len, end - start)) ;
+		if (readcount <= 0)
+		{	scan->failed [worker] = SF_TRUE ;
+			return ;
+			} ;
+		peak_update (ubuf.dbuf, (int) readcount * scan->channels, scan->channels, scan->peaks + worker * scan->channels) ;
+		} ;
+} /* peak_scan_job */
+
+static int
+peak_scan_possible (SF_PRIVATE *psf)
+{	unsigned char byte ;
+
+	if (psf->threads < 2 || psf->sf.frames < PEAK_SCAN_MIN_FRAMES)
+		return SF_FALSE ;
+
+	/* The workers read the file at offsets of their own choosing. */
+	if (psf->fileoffset > 0 || psf_fread_at (psf, &byte, 1, 0) != 1)
+		return SF_FALSE ;
+	/* Set with SFC_SET_RAW_START_OFFSET, which a new handle wouldn't know. */
+	if (SF_CONTAINER (psf->sf.format) == SF_FORMAT_RAW && psf->dataoffset != 0)
+		return SF_FALSE ;
+
+	switch (SF_CODEC (psf->sf.format))
+	{	case SF_FORMAT_PCM_S8 :
+		case SF_FORMAT_PCM_U8 :
+		case SF_FORMAT_PCM_16 :
+		case SF_FORMAT_PCM_24 :
+		case SF_FORMAT_PCM_32 :
+		case SF_FORMAT_FLOAT :
+		case SF_FORMAT_DOUBLE :
+		case SF_FORMAT_ULAW :
+		case SF_FORMAT_ALAW :
+			return SF_TRUE ;
+
+		default :
+			break ;
 		} ;
 
+	return SF_FALSE ;
+} /* peak_scan_possible */
+
+/* Returns zero if it found the peaks, non-zero to have the caller do it. */
+static int
+peak_scan_parallel (SF_PRIVATE *psf, double *peaks, int normalize)
+{	PEAK_SCAN		scan ;
+	PSF_THREAD_POOL	*pool ;
+	SF_VIRTUAL_IO	vio ;
+	SF_INFO			info ;
+	int				workers, k, chan, error = 0 ;
+
+	if (peak_scan_possible (psf) == SF_FALSE)
+		return 1 ;
+
+	if ((pool = psf_thread_pool_new (psf->threads)) == NULL)
+		return 1 ;
+	workers = psf_thread_pool_workers (pool) ;
+
+	memset (&scan, 0, sizeof (scan)) ;
+	scan.frames = psf->sf.frames ;
+	scan.channels = psf->sf.channels ;
+	scan.jobs = workers * PEAK_SCAN_JOBS ;
+
+	if ((scan.peaks = calloc (workers * scan.channels, sizeof (double))) == NULL)
+		error = 1 ;
+
+	vio.get_filelen = peak_scan_get_filelen ;
+	vio.seek = peak_scan_seek ;
+	vio.read = peak_scan_read ;
+	vio.write = peak_scan_write ;
+	vio.tell = peak_scan_tell ;
+
+	for (k = 0 ; error == 0 && k < workers ; k++)
+	{	/* Headerless files need to be described again. */
+		memset (&info, 0, sizeof (info)) ;
+		if (SF_CONTAINER (psf->sf.format) == SF_FORMAT_RAW)
+			info = psf->sf ;
+
+		scan.cursors [k].psf = psf ;
+		scan.cursors [k].position = 0 ;
+
+		if ((scan.handles [k] = sf_open_virtual (&vio, SFM_READ, &info, scan.cursors + k)) == NULL
+				|| info.frames != psf->sf.frames || info.channels != psf->sf.channels || info.format != psf->sf.format)
+		{	error = 1 ;
+			break ;
+			} ;
+
+		sf_command (scan.handles [k], SFC_SET_NORM_DOUBLE, NULL, normalize) ;
+		} ;
+
+	if (error == 0)
+		psf_thread_pool_run (pool, scan.jobs, peak_scan_job, &scan) ;
+
+	for (k = 0 ; k < workers ; k++)
+	{	error |= scan.failed [k] ;
+		if (scan.handles [k] != NULL)
+			sf_close (scan.handles [k]) ;
+		} ;
+
+	if (error == 0)
+	{	for (k = 0 ; k < workers ; k++)
+			for (chan = 0 ; chan < scan.channels ; chan++)
+				peaks [chan] = SF_MAX (peaks [chan], scan.peaks [k * scan.channels + chan]) ;
+		psf_log_printf (psf, "Peak scan : %d threads.\n", workers) ;
+		} ;
+
+	free (scan.peaks) ;
+	psf_thread_pool_free (pool) ;
+
+	return error ;
+} /* peak_scan_parallel */
+
+/* Returns the number of frames it read. */
+static sf_count_t
+peak_scan_serial (SF_PRIVATE *psf, double *peaks, int normalize)
+{	BUF_UNION	ubuf ;
+	sf_count_t	position, readcount, frames = 0 ;
+	int			len, save_state, *read_channels ;
+
 	save_state = sf_command ((SNDFILE*) psf, SFC_GET_NORM_DOUBLE, NULL, 0) ;
 	sf_command ((SNDFILE*) psf, SFC_SET_NORM_DOUBLE, NULL, normalize) ;
 
-	/* Brute force. Read the whole file and find the biggest sample. */
-	/* Get current position in file */
-	position = sf_seek ((SNDFILE*) psf, 0, SEEK_CUR) ;
-	/* Go to start of file. */
-	sf_seek ((SNDFILE*) psf, 0, SEEK_SET) ;
+	/* Scan every channel, whichever ones the caller is reading. */
+	read_channels = psf->read_channels ;
+	psf->read_channels = NULL ;
+
+	position = sf_seek ((SNDFILE*) psf, 0, SEEK_CUR) ;	/* Get current position in file */
+	sf_seek ((SNDFILE*) psf, 0, SEEK_SET) ;				/* Go to start of file. */
 
-	data = ubuf.dbuf ;
 	/* Make sure len is an integer multiple of the channel count. */
 	len = ARRAY_LEN (ubuf.dbuf) - (ARRAY_LEN (ubuf.dbuf) % psf->sf.channels) ;
 
-	for (readcount = 1, max_val = 0.0 ; readcount > 0 ; /* nothing */)
-	{	readcount = sf_read_double ((SNDFILE*) psf, data, len) ;
-		for (k = 0 ; k < readcount ; k++)
-		{	temp = fabs (data [k]) ;
-			max_val = temp > max_val ? temp : max_val ;
-			} ;
+	while ((readcount = sf_read_double ((SNDFILE*) psf, ubuf.dbuf, len)) > 0)
+	{	peak_update (ubuf.dbuf, (int) readcount, psf->sf.channels, peaks) ;
+		frames += readcount / psf->sf.channels ;
 		} ;
 
-	/* Return to SNDFILE to original state. */
-	sf_seek ((SNDFILE*) psf, position, SEEK_SET) ;
+	sf_seek ((SNDFILE*) psf, position, SEEK_SET) ;		/* Return to original position. */
+
+	psf->read_channels = read_channels ;
 	sf_command ((SNDFILE*) psf, SFC_SET_NORM_DOUBLE, NULL, save_state) ;
 
-	return	max_val ;
-} /* psf_calc_signal_max */
+	return frames ;
+} /* peak_scan_serial */
 
-int
-psf_calc_max_all_channels (SF_PRIVATE *psf, double *peaks, int normalize)
-{	BUF_UNION	ubuf ;
-	sf_count_t	position ;
-	double 		temp, *data ;
-	int			k, len, readcount, save_state ;
-	int			chan ;
+static int
+calc_peaks (SF_PRIVATE *psf, double *peaks, int normalize)
+{	double	**cache ;
+	size_t	size ;
 
 	/* If the file is not seekable, there is nothing we can do. */
 	if (! psf->sf.seekable)
@@ -338,35 +563,55 @@ psf_calc_max_all_channels (SF_PRIVATE *psf, double *peaks, int normalize)
 	if (! psf->read_double)
 		return (psf->error = SFE_UNIMPLEMENTED) ;
 
-	save_state = sf_command ((SNDFILE*) psf, SFC_GET_NORM_DOUBLE, NULL, 0) ;
-	sf_command ((SNDFILE*) psf, SFC_SET_NORM_DOUBLE, NULL, normalize) ;
-
-	memset (peaks, 0, sizeof (double) * psf->sf.channels) ;
+	cache = &psf->peak_cache [normalize ? 1 : 0] ;
+	size = psf->sf.channels * sizeof (double) ;
 
-	/* Brute force. Read the whole file and find the biggest sample for each channel. */
-	position = sf_seek ((SNDFILE*) psf, 0, SEEK_CUR) ; /* Get current position in file */
-	sf_seek ((SNDFILE*) psf, 0, SEEK_SET) ;			/* Go to start of file. */
+	if (*cache != NULL)
+	{	memcpy (peaks, *cache, size) ;
+		return 0 ;
+		} ;
 
-	len = ARRAY_LEN (ubuf.dbuf) - (ARRAY_LEN (ubuf.dbuf) % psf->sf.channels) ;
+	memset (peaks, 0, size) ;
 
-	data = ubuf.dbuf ;
+	if (peak_scan_parallel (psf, peaks, normalize) != 0)
+	{	memset (peaks, 0, size) ;
 
-	chan = 0 ;
-	readcount = len ;
-	while (readcount > 0)
-	{	readcount = sf_read_double ((SNDFILE*) psf, data, len) ;
-		for (k = 0 ; k < readcount ; k++)
-		{	temp = fabs (data [k]) ;
-			peaks [chan] = temp > peaks [chan] ? temp : peaks [chan] ;
-			chan = (chan + 1) % psf->sf.channels ;
-			} ;
+		/* Brute force. Read the whole file and find the biggest sample for each channel. */
+		if (peak_scan_serial (psf, peaks, normalize) != psf->sf.frames)
+			return 0 ;
 		} ;
 
-	sf_seek ((SNDFILE*) psf, position, SEEK_SET) ;		/* Return to original position. */
+	/* Not being able to keep the result doesn't matter. */
+	if ((*cache = malloc (size)) != NULL)
+		memcpy (*cache, peaks, size) ;
 
-	sf_command ((SNDFILE*) psf, SFC_SET_NORM_DOUBLE, NULL, save_state) ;
+	return 0 ;
+} /* calc_peaks */
+
+void
+psf_clear_peak_cache (SF_PRIVATE *psf)
+{	free (psf->peak_cache [0]) ;
+	free (psf->peak_cache [1]) ;
+	psf->peak_cache [0] = psf->peak_cache [1] = NULL ;
+} /* psf_clear_peak_cache */
 
-	return	0 ;
+double
+psf_calc_signal_max (SF_PRIVATE *psf, int normalize)
+{	double	peaks [SF_MAX_CHANNELS], max_val = 0.0 ;
+	int		chan ;
+
+	if (calc_peaks (psf, peaks, normalize) != 0)
+		return 0.0 ;
+
+	for (chan = 0 ; chan < psf->sf.channels ; chan++)
+		max_val = peaks [chan] > max_val ? peaks [chan] : max_val ;
+
+	return	max_val ;
+} /* psf_calc_signal_max */
+
+int
+psf_calc_max_all_channels (SF_PRIVATE *psf, double *peaks, int normalize)
+{	return calc_peaks (psf, peaks, normalize) ;
 } /* psf_calc_max_all_channels */
 
 int
@@ -34,6 +34,7 @@
 #include "sndfile.h"
 #include "sfendian.h"
 #include "common.h"
+#include "simd.h"
 
 #define	INITIAL_HEADER_SIZE	256
 
@@ -1614,10 +1615,12 @@ psf_f2s_array (const float *src, short *dest, int count, int normalize)
 void
 psf_f2s_clip_array (const float *src, short *dest, int count, int normalize)
 {	float			normfact, scaled_value ;
+	int				done ;
 
 	normfact = normalize ? (1.0 * 0x8000) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_s_clip (src, dest, count, normfact, 0, SF_FALSE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFF))
 		{	dest [count] = 0x7FFF ;
@@ -1648,10 +1651,12 @@ psf_d2s_array (const double *src, short *dest, int count, int normalize)
 void
 psf_d2s_clip_array (const double *src, short *dest, int count, int normalize)
 {	double			normfact, scaled_value ;
+	int				done ;
 
 	normfact = normalize ? (1.0 * 0x8000) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_s_clip (src, dest, count, normfact, 0, SF_FALSE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFF))
 		{	dest [count] = 0x7FFF ;
@@ -1683,10 +1688,12 @@ psf_f2i_array (const float *src, int *dest, int count, int normalize)
 void
 psf_f2i_clip_array (const float *src, int *dest, int count, int normalize)
 {	float			normfact, scaled_value ;
+	int				done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_i_clip (src, dest, count, normfact, SF_FALSE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
 		{	dest [count] = 0x7FFFFFFF ;
@@ -1717,10 +1724,12 @@ psf_d2i_array (const double *src, int *dest, int count, int normalize)
 void
 psf_d2i_clip_array (const double *src, int *dest, int count, int normalize)
 {	double			normfact, scaled_value ;
+	int				done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_i_clip (src, dest, count, normfact, SF_FALSE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
 		{	dest [count] = 0x7FFFFFFF ;
@@ -359,6 +359,46 @@ typedef struct
 	int 			filedes, savedes ;
 #endif
 
+	/*
+	**	Read only memory mapping of the whole file, only set up on request
+	**	by psf_use_mmap (). The position is absolute (includes fileoffset).
+	*/
+	struct
+	{	void			*ptr ;
+		sf_count_t		len, pos ;
+	} map ;
+
+	/*
+	**	Read-ahead buffer for regular files. The start field is the absolute
+	**	file position of ptr [0] (or -1 if unknown), indx is the read position
+	**	within the buffer and len the number of valid bytes. When start is
+	**	known, the descriptor is positioned at start + len.
+	**	If write_behind is set, writes are collected in the buffer as well.
+	**	While dirty, the buffer holds data not yet written at start, the
+	**	descriptor is positioned at start and indx == len.
+	**	For virtual I/O the same fields are used as a block cache in front
+	**	of the user's callbacks.
+	*/
+	struct
+	{	unsigned char	*ptr ;
+		sf_count_t		size, start, indx, len ;
+		int				write_behind, dirty ;
+	} buf ;
+
+	/*
+	**	In memory file set up by sf_open_memory () or sf_open_memory_write ().
+	**	When writing, buffer is owned by the library until sf_close () and
+	**	user_ptr / user_len are kept up to date after every write.
+	*/
+	struct
+	{	const unsigned char	*data ;
+		unsigned char	*buffer ;
+		sf_count_t		len, alloc, pos ;
+		void			**user_ptr ;
+		sf_count_t		*user_len ;
+		int				active ;
+	} mem ;
+
 	int				do_not_close_descriptor ;
 	int				mode ;			/* Open mode : SFM_READ, SFM_WRITE or SFM_RDWR. */
 } PSF_FILE ;
@@ -469,6 +509,26 @@ typedef struct sf_private_tag
 	/* Channel map data (if present) : an array of ints. */
 	int				*channel_map ;
 
+	/*
+	** Channels picked with SFC_SET_READ_CHANNELS (NULL to read them all) and
+	** whether the codec's read functions can return just those channels.
+	*/
+	int				*read_channels ;
+	int				read_channel_count ;
+	int				can_select_channels ;
+
+	/* Worker threads codecs may use, set with SFC_SET_THREADS (0 or 1 for none). */
+	int				threads ;
+
+	/*
+	** Peaks of each channel found by psf_calc_max_all_channels (), without
+	** and with normalisation, or NULL. Dropped by the next write.
+	*/
+	double			*peak_cache [2] ;
+
+	/* Decoder state snapshots for codecs that can only seek by decoding. */
+	struct PSF_CHECKPOINTS	*checkpoints ;
+
 	sf_count_t		filelength ;	/* Overall length of (embedded) file. */
 	sf_count_t		fileoffset ;	/* Offset in number of bytes from beginning of file. */
 
@@ -760,6 +820,9 @@ enum
 
 	SFE_OPUS_BAD_SAMPLERATE,
 
+	SFE_BAD_MEMORY_IO,
+	SFE_BAD_PLANAR_ARGS,
+
 	SFE_MAX_ERROR			/* This must be last in list. */
 } ;
 
@@ -827,6 +890,7 @@ void	psf_generate_format_desc (SF_PRIVATE *psf) ;
 
 double	psf_calc_signal_max			(SF_PRIVATE *psf, int normalize) ;
 int		psf_calc_max_all_channels	(SF_PRIVATE *psf, double *peaks, int normalize) ;
+void	psf_clear_peak_cache		(SF_PRIVATE *psf) ;
 
 int		psf_get_signal_max			(SF_PRIVATE *psf, double *peak) ;
 int		psf_get_max_all_channels	(SF_PRIVATE *psf, double *peaks) ;
@@ -854,11 +918,25 @@ int psf_file_valid (SF_PRIVATE *psf) ;
 void psf_set_file (SF_PRIVATE *psf, int fd) ;
 void psf_init_files (SF_PRIVATE *psf) ;
 void psf_use_rsrc (SF_PRIVATE *psf, int on_off) ;
+int psf_use_mmap (SF_PRIVATE *psf, int on_off) ;
+int psf_set_write_buffer (SF_PRIVATE *psf, int size) ;
+void psf_set_virtual_io (SF_PRIVATE *psf, const SF_VIRTUAL_IO *sfvirtual, void *user_data) ;
+int psf_set_vio_block_size (SF_PRIVATE *psf, int size) ;
+void psf_set_memory (SF_PRIVATE *psf, const void *data, sf_count_t datalen) ;
+void psf_set_memory_write (SF_PRIVATE *psf, void **data, sf_count_t *datalen) ;
 
 SNDFILE * psf_open_file (SF_PRIVATE *psf, SF_INFO *sfinfo) ;
 
 sf_count_t psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence) ;
 sf_count_t psf_fread (void *ptr, sf_count_t bytes, sf_count_t count, SF_PRIVATE *psf) ;
+
+/*
+** Read len bytes at offset (as for psf_fseek () with SEEK_SET) without
+** moving the file position, so that several threads can read a file opened
+** read only at once. Returns the number of bytes read, or -1 if this file
+** can't be read that way.
+*/
+sf_count_t psf_fread_at (SF_PRIVATE *psf, void *ptr, sf_count_t len, sf_count_t offset) ;
 sf_count_t psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t count, SF_PRIVATE *psf) ;
 sf_count_t psf_fgets (char *buffer, sf_count_t bufsize, SF_PRIVATE *psf) ;
 sf_count_t psf_ftell (SF_PRIVATE *psf) ;
@@ -948,6 +1026,11 @@ int		aiff_ima_init (SF_PRIVATE *psf, int blockalign, int samplesperblock) ;
 
 int		interleave_init (SF_PRIVATE *psf) ;
 
+void	psf_deinterleave (const void *src, void * const *dest, int itemsize, int channels, sf_count_t offset, sf_count_t stride, int frames) ;
+void	psf_interleave (const void * const *src, void *dest, int itemsize, int channels, sf_count_t offset, sf_count_t stride, int frames) ;
+sf_count_t	psf_fread_samples (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf) ;
+void	psf_planar_clear (void * const *dest, int itemsize, int channels, sf_count_t offset, sf_count_t stride, sf_count_t frames) ;
+
 /*------------------------------------------------------------------------------------
 ** Chunk logging functions.
 */
@@ -121,6 +121,12 @@
 /* Define to 1 if you have the `open' function. */
 #cmakedefine01 HAVE_OPEN
 
+/* Define to 1 if you have the `pread' function. */
+#cmakedefine01 HAVE_PREAD
+
+/* Define to 1 if you have POSIX threads. */
+#cmakedefine01 HAVE_PTHREAD
+
 /* Define to 1 if you have the `pipe' function. */
 #cmakedefine01 HAVE_PIPE
 
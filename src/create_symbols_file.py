@@ -57,6 +57,10 @@ ALL_SYMBOLS = (
 	(	"sf_read_int",			22	),
 	(	"sf_read_float",		23	),
 	(	"sf_read_double",		24	),
+	(	"sf_readf_short_planar",	25	),
+	(	"sf_readf_int_planar",		26	),
+	(	"sf_readf_float_planar",	27	),
+	(	"sf_readf_double_planar",	28	),
 	(	"sf_write_raw",			32	),
 	(	"sf_writef_short",		33	),
 	(	"sf_writef_int",		34	),
@@ -66,6 +70,10 @@ ALL_SYMBOLS = (
 	(	"sf_write_int",			38	),
 	(	"sf_write_float",		39	),
 	(	"sf_write_double",		40	),
+	(	"sf_writef_short_planar",	41	),
+	(	"sf_writef_int_planar",		42	),
+	(	"sf_writef_float_planar",	43	),
+	(	"sf_writef_double_planar",	44	),
 	(	"sf_strerror",			50	),
 	(	"sf_get_string",		60	),
 	(	"sf_set_string",		61	),
@@ -73,6 +81,9 @@ ALL_SYMBOLS = (
 	(	"sf_open_fd",			70	),
 	(	"sf_wchar_open",		71  ),
 	(	"sf_open_virtual",		80	),
+	(	"sf_open_memory",		81	),
+	(	"sf_open_memory_write",	82	),
+	(	"sf_memory_free",		83	),
 	(	"sf_write_sync",		90	),
 	(	"sf_set_chunk",			100	),
 	(	"sf_get_chunk_size",	101 ),
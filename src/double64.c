@@ -27,6 +27,7 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"simd.h"
 
 #if CPU_IS_LITTLE_ENDIAN
 	#define DOUBLE64_READ	double64_le_read
@@ -101,7 +102,9 @@ double64_init	(SF_PRIVATE *psf)
 	psf->blockwidth = sizeof (double) * psf->sf.channels ;
 
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
-	{	switch (psf->endian + double64_caps)
+	{	psf->can_select_channels = SF_TRUE ;
+
+		switch (psf->endian + double64_caps)
 		{	case (SF_ENDIAN_BIG + DOUBLE_CAN_RW_BE) :
 					psf->data_endswap = SF_FALSE ;
 					psf->read_short		= host_read_d2s ;
@@ -493,7 +496,10 @@ d2s_array (const double *src, int count, short *dest, double scale)
 
 static void
 d2s_clip_array (const double *src, int count, short *dest, double scale)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->d_to_s_clip (src, dest, count, scale, 0, SF_FALSE) ;
+	while (--count >= done)
 	{	double tmp = scale * src [count] ;
 
 		if (CPU_CLIPS_POSITIVE == 0 && tmp > 32767.0)
@@ -514,12 +520,15 @@ d2i_array (const double *src, int count, int *dest, double scale)
 
 static void
 d2i_clip_array (const double *src, int count, int *dest, double scale)
-{	while (--count >= 0)
-	{	float tmp = scale * src [count] ;
+{	int done ;
+
+	done = psf_simd ()->d_to_i_clip (src, dest, count, scale, SF_FALSE) ;
+	while (--count >= done)
+	{	double tmp = scale * src [count] ;
 
 		if (CPU_CLIPS_POSITIVE == 0 && tmp > (1.0 * INT_MAX))
 			dest [count] = INT_MAX ;
-		else if (CPU_CLIPS_NEGATIVE == 0 && tmp < (-1.0 * INT_MAX))
+		else if (CPU_CLIPS_NEGATIVE == 0 && tmp < (1.0 * INT_MIN))
 			dest [count] = INT_MIN ;
 		else
 			dest [count] = lrint (tmp) ;
@@ -572,7 +581,7 @@ host_read_d2s	(SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, readcount) ;
@@ -602,7 +611,7 @@ host_read_d2i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, bufferlen) ;
@@ -628,7 +637,7 @@ host_read_d2f	(SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, bufferlen) ;
@@ -648,7 +657,7 @@ host_read_d	(SF_PRIVATE *psf, double *ptr, sf_count_t len)
 {	int			bufferlen ;
 	sf_count_t	readcount, total = 0 ;
 
-	readcount = psf_fread (ptr, sizeof (double), len, psf) ;
+	readcount = psf_fread_samples (ptr, sizeof (double), len, psf) ;
 
 	if (psf->data_endswap != SF_TRUE)
 		return readcount ;
@@ -811,7 +820,7 @@ replace_read_d2s	(SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, bufferlen) ;
@@ -841,7 +850,7 @@ replace_read_d2i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, bufferlen) ;
@@ -869,7 +878,7 @@ replace_read_d2f	(SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, bufferlen) ;
@@ -899,7 +908,7 @@ replace_read_d	(SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.dbuf, sizeof (double), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_double_array (ubuf.dbuf, readcount) ;
@@ -36,10 +36,11 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"checkpoint.h"
 
 typedef struct
 {	int		bit_width, dwm_maxsize, max_delta, span ;
-	int		samplecount ;
+	sf_count_t	samplecount ;
 	int		bit_count, bits, last_delta_width, last_sample ;
 	struct
 	{	int				index, end ;
@@ -47,6 +48,13 @@ typedef struct
 	} b ;
 } DWVW_PRIVATE ;
 
+/* Decoder state at a checkpoint, with the file offset of the buffer contents. */
+typedef struct
+{	sf_count_t	offset ;
+	int			index, end ;
+	int			bit_count, bits, last_delta_width, last_sample ;
+} DWVW_CHECKPOINT ;
+
 /*============================================================================================
 */
 
@@ -71,6 +79,9 @@ static int	dwvw_encode_data (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, const int *pt
 static void dwvw_encode_store_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int data, int new_bits) ;
 static void dwvw_read_reset (DWVW_PRIVATE *pdwvw) ;
 
+static sf_count_t	dwvw_checkpoint_due (SF_PRIVATE *psf, sf_count_t sample) ;
+static sf_count_t	dwvw_checkpoint_restore (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, sf_count_t frame) ;
+
 /*============================================================================================
 ** DWVW initialisation function.
 */
@@ -116,8 +127,12 @@ dwvw_init (SF_PRIVATE *psf, int bitwidth)
 	psf->byterate = dwvw_byterate ;
 
 	if (psf->file.mode == SFM_READ)
-	{	psf->sf.frames = psf_decode_frame_count (psf) ;
+	{	/* Counting the frames also fills in the checkpoints. */
+		if ((psf->checkpoints = psf_checkpoints_new (PSF_CHECKPOINT_INTERVAL, sizeof (DWVW_CHECKPOINT))) == NULL)
+			return SFE_MALLOC_FAILED ;
+		psf->sf.frames = psf_decode_frame_count (psf) ;
 		dwvw_read_reset (pdwvw) ;
+		psf->sf.seekable = psf->is_pipe ? SF_FALSE : SF_TRUE ;
 		} ;
 
 	return 0 ;
@@ -151,8 +166,11 @@ dwvw_close (SF_PRIVATE *psf)
 } /* dwvw_close */
 
 static sf_count_t
-dwvw_seek	(SF_PRIVATE *psf, int UNUSED (mode), sf_count_t offset)
+dwvw_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset)
 {	DWVW_PRIVATE *pdwvw ;
+	BUF_UNION	ubuf ;
+	sf_count_t	target ;
+	int			len, count ;
 
 	if (! psf->codec_data)
 	{	psf->error = SFE_INTERNAL ;
@@ -167,8 +185,30 @@ dwvw_seek	(SF_PRIVATE *psf, int UNUSED (mode), sf_count_t offset)
 		return 0 ;
 		} ;
 
-	psf->error = SFE_BAD_SEEK ;
-	return	PSF_SEEK_ERROR ;
+	if (mode != SFM_READ || psf->checkpoints == NULL || offset < 0)
+	{	psf->error = SFE_BAD_SEEK ;
+		return	PSF_SEEK_ERROR ;
+		} ;
+
+	target = offset > SF_COUNT_MAX / psf->sf.channels ? SF_COUNT_MAX : offset * psf->sf.channels ;
+
+	/* Go back to a checkpoint, unless decoding on from here is quicker. */
+	if (target < pdwvw->samplecount
+			|| psf_checkpoints_find (psf->checkpoints, offset, NULL) * psf->sf.channels > pdwvw->samplecount)
+	{	if (dwvw_checkpoint_restore (psf, pdwvw, offset) < 0)
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
+		} ;
+
+	while (pdwvw->samplecount < target)
+	{	len = (int) SF_MIN (target - pdwvw->samplecount, (sf_count_t) ARRAY_LEN (ubuf.ibuf)) ;
+		count = dwvw_decode_data (psf, pdwvw, ubuf.ibuf, len) ;
+		if (count < len)
+			break ;
+		} ;
+
+	return pdwvw->samplecount / psf->sf.channels ;
 } /* dwvw_seek */
 
 static int
@@ -303,15 +343,37 @@ dwvw_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 
 static int
 dwvw_decode_data (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int *ptr, int len)
-{	int	count ;
+{	DWVW_CHECKPOINT	snapshot ;
+	sf_count_t	due ;
+	int	count ;
 	int delta_width_modifier, delta_width, delta_negative, delta, sample ;
 
 	/* Restore state from last decode call. */
 	delta_width = pdwvw->last_delta_width ;
 	sample = pdwvw->last_sample ;
 
+	due = dwvw_checkpoint_due (psf, pdwvw->samplecount) ;
+
 	for (count = 0 ; count < len ; count++)
-	{	/* If bit_count parameter is zero get the delta_width_modifier. */
+	{	/*
+		**	Once the last read has hit the end of the file the buffer can't be
+		**	reloaded, so only take snapshots before that.
+		*/
+		if (pdwvw->samplecount + count == due)
+		{	if (pdwvw->samplecount == 0 || pdwvw->b.end > 0)
+			{	snapshot.offset = psf_ftell (psf) - pdwvw->b.end ;
+				snapshot.index = pdwvw->b.index ;
+				snapshot.end = pdwvw->b.end ;
+				snapshot.bit_count = pdwvw->bit_count ;
+				snapshot.bits = pdwvw->bits ;
+				snapshot.last_delta_width = delta_width ;
+				snapshot.last_sample = sample ;
+				psf_checkpoints_add (psf->checkpoints, due / psf->sf.channels, &snapshot) ;
+				} ;
+			due = dwvw_checkpoint_due (psf, due + 1) ;
+			} ;
+
+		/* If bit_count parameter is zero get the delta_width_modifier. */
 		delta_width_modifier = dwvw_decode_load_bits (psf, pdwvw, -1) ;
 
 		/* Check for end of input bit stream. Break loop if end. */
@@ -412,6 +474,43 @@ dwvw_decode_load_bits (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, int bit_count)
 	return output ;
 } /* dwvw_decode_load_bits */
 
+/* Return the sample the next checkpoint is due at, or SF_COUNT_MAX if none is. */
+static sf_count_t
+dwvw_checkpoint_due (SF_PRIVATE *psf, sf_count_t sample)
+{	sf_count_t frame, ahead ;
+
+	frame = (sample + psf->sf.channels - 1) / psf->sf.channels ;
+	if ((ahead = psf_checkpoints_ahead (psf->checkpoints, frame)) == SF_COUNT_MAX)
+		return SF_COUNT_MAX ;
+
+	return (frame + ahead) * psf->sf.channels ;
+} /* dwvw_checkpoint_due */
+
+static sf_count_t
+dwvw_checkpoint_restore (SF_PRIVATE *psf, DWVW_PRIVATE *pdwvw, sf_count_t frame)
+{	DWVW_CHECKPOINT	snapshot ;
+
+	if ((frame = psf_checkpoints_find (psf->checkpoints, frame, &snapshot)) < 0)
+		return -1 ;
+
+	dwvw_read_reset (pdwvw) ;
+
+	if (psf_fseek (psf, snapshot.offset, SEEK_SET) < 0)
+		return -1 ;
+	if (snapshot.end > 0 && psf_fread (pdwvw->b.buffer, 1, snapshot.end, psf) != snapshot.end)
+		return -1 ;
+
+	pdwvw->b.index = snapshot.index ;
+	pdwvw->b.end = snapshot.end ;
+	pdwvw->bit_count = snapshot.bit_count ;
+	pdwvw->bits = snapshot.bits ;
+	pdwvw->last_delta_width = snapshot.last_delta_width ;
+	pdwvw->last_sample = snapshot.last_sample ;
+	pdwvw->samplecount = frame * psf->sf.channels ;
+
+	return frame ;
+} /* dwvw_checkpoint_restore */
+
 static void
 dwvw_read_reset (DWVW_PRIVATE *pdwvw)
 {	int bitwidth = pdwvw->bit_width ;
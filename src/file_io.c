@@ -60,11 +60,17 @@
 #include <errno.h>
 #include <sys/stat.h>
 
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #include "sndfile.h"
 #include "common.h"
 
 #define	SENSIBLE_SIZE	(0x40000000)
 
+#define	READ_AHEAD_SIZE	(SF_BUFFER_LEN)
+
 /*
 **	Neat solution to the Win32/OS2 binary file flage requirement.
 **	If O_BINARY isn't already defined by the inclusion of the system
@@ -76,6 +82,19 @@
 
 static void psf_log_syserr (SF_PRIVATE *psf, int error) ;
 
+static sf_count_t psf_memory_get_filelen (void *user_data) ;
+static sf_count_t psf_memory_seek (sf_count_t offset, int whence, void *user_data) ;
+static sf_count_t psf_memory_read (void *ptr, sf_count_t count, void *user_data) ;
+static sf_count_t psf_memory_write (const void *ptr, sf_count_t count, void *user_data) ;
+static sf_count_t psf_memory_tell (void *user_data) ;
+static int psf_memory_truncate (SF_PRIVATE *psf, sf_count_t len) ;
+
+static sf_count_t psf_vio_seek (SF_PRIVATE *psf, sf_count_t offset, int whence) ;
+static sf_count_t psf_vio_read (SF_PRIVATE *psf, void *ptr, sf_count_t len) ;
+static sf_count_t psf_vio_write (SF_PRIVATE *psf, const void *ptr, sf_count_t len) ;
+static sf_count_t psf_vio_tell (SF_PRIVATE *psf) ;
+static int psf_vio_close (SF_PRIVATE *psf) ;
+
 #if (USE_WINDOWS_API == 0)
 
 /*------------------------------------------------------------------------------
@@ -85,12 +104,21 @@ static void psf_log_syserr (SF_PRIVATE *psf, int error) ;
 static int psf_close_fd (int fd) ;
 static int psf_open_fd (PSF_FILE * pfile) ;
 static sf_count_t psf_get_filelen_fd (int fd) ;
+static void psf_munmap (SF_PRIVATE *psf) ;
+static sf_count_t psf_mmap_read (SF_PRIVATE *psf, void *ptr, sf_count_t len) ;
+static sf_count_t psf_read_fd (SF_PRIVATE *psf, void *ptr, sf_count_t len) ;
+static sf_count_t psf_write_fd (SF_PRIVATE *psf, const void *ptr, sf_count_t len) ;
+static sf_count_t psf_buffer_read (SF_PRIVATE *psf, void *ptr, sf_count_t len) ;
+static sf_count_t psf_buffer_write (SF_PRIVATE *psf, const void *ptr, sf_count_t len) ;
+static void psf_buffer_reset (PSF_FILE *pfile, sf_count_t start) ;
+static int psf_buffer_sync (SF_PRIVATE *psf) ;
 
 int
 psf_fopen (SF_PRIVATE *psf)
 {
 	psf->error = 0 ;
 	psf->file.filedes = psf_open_fd (&psf->file) ;
+	psf_buffer_reset (&psf->file, 0) ;
 
 	if (psf->file.filedes == - SFE_BAD_OPEN_MODE)
 	{	psf->error = SFE_BAD_OPEN_MODE ;
@@ -106,18 +134,32 @@ psf_fopen (SF_PRIVATE *psf)
 
 int
 psf_fclose (SF_PRIVATE *psf)
-{	int retval ;
+{	int retval = 0 ;
 
 	if (psf->virtual_io)
-		return 0 ;
+		return psf_vio_close (psf) ;
+
+	psf_munmap (psf) ;
+
+	/* Write out pending data and leave the descriptor at the logical position. */
+	if (psf->file.buf.dirty || psf->file.do_not_close_descriptor)
+		retval = psf_buffer_sync (psf) ;
+
+	free (psf->file.buf.ptr) ;
+	psf->file.buf.ptr = NULL ;
+	psf->file.buf.size = 0 ;
+	psf->file.buf.write_behind = SF_FALSE ;
+	psf_buffer_reset (&psf->file, -1) ;
 
 	if (psf->file.do_not_close_descriptor)
 	{	psf->file.filedes = -1 ;
-		return 0 ;
+		return retval ;
 		} ;
 
-	if ((retval = psf_close_fd (psf->file.filedes)) == -1)
-		psf_log_syserr (psf, errno) ;
+	if (psf_close_fd (psf->file.filedes) == -1)
+	{	psf_log_syserr (psf, errno) ;
+		retval = -1 ;
+		} ;
 
 	psf->file.filedes = -1 ;
 
@@ -199,6 +241,10 @@ psf_get_filelen (SF_PRIVATE *psf)
 		return (sf_count_t) -1 ;
 		} ;
 
+	/* Pending data in the write buffer may extend the file. */
+	if (psf->file.buf.dirty)
+		filelen = SF_MAX (filelen, psf->file.buf.start + psf->file.buf.len) ;
+
 	if (filelen == -SFE_BAD_STAT_SIZE)
 	{	psf->error = SFE_BAD_STAT_SIZE ;
 		return (sf_count_t) -1 ;
@@ -259,6 +305,7 @@ psf_set_stdio (SF_PRIVATE *psf)
 				break ;
 		} ;
 	psf->filelength = 0 ;
+	psf_buffer_reset (&psf->file, -1) ;
 
 	return error ;
 } /* psf_set_stdio */
@@ -266,6 +313,7 @@ psf_set_stdio (SF_PRIVATE *psf)
 void
 psf_set_file (SF_PRIVATE *psf, int fd)
 {	psf->file.filedes = fd ;
+	psf_buffer_reset (&psf->file, -1) ;
 } /* psf_set_file */
 
 int
@@ -277,8 +325,11 @@ sf_count_t
 psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence)
 {	sf_count_t	absolute_position ;
 
+	if (psf->file.mem.active)
+		return psf_memory_seek (offset, whence, psf) ;
+
 	if (psf->virtual_io)
-		return psf->vio.seek (offset, whence, psf->vio_user_data) ;
+		return psf_vio_seek (psf, offset, whence) ;
 
 	/* When decoding from pipes sometimes see seeks to the pipeoffset, which appears to mean do nothing. */
 	if (psf->is_pipe)
@@ -304,21 +355,60 @@ psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence)
 				return 0 ;
 		} ;
 
+	if (psf->file.buf.dirty && psf_buffer_sync (psf) != 0)
+		return -1 - psf->fileoffset ;
+
+	/* A seek relative to the end of a file which has grown drops the mapping. */
+	if (psf->file.map.ptr != NULL && whence == SEEK_END
+			&& psf_get_filelen_fd (psf->file.filedes) != psf->file.map.len)
+		psf_munmap (psf) ;
+
+	if (psf->file.map.ptr != NULL)
+	{	if (whence == SEEK_CUR)
+			offset += psf->file.map.pos ;
+		else if (whence == SEEK_END)
+			offset += psf->file.map.len ;
+
+		if (offset < 0)
+		{	psf_log_syserr (psf, EINVAL) ;
+			return -1 - psf->fileoffset ;
+			} ;
+
+		psf->file.map.pos = offset ;
+		return offset - psf->fileoffset ;
+		} ;
+
+	/* Seeks which land inside the read-ahead buffer don't need a system call. */
+	if (psf->file.buf.start >= 0 && whence != SEEK_END)
+	{	if (whence == SEEK_CUR)
+			offset += psf->file.buf.start + psf->file.buf.indx ;
+		whence = SEEK_SET ;
+
+		if (offset >= psf->file.buf.start && offset <= psf->file.buf.start + psf->file.buf.len)
+		{	psf->file.buf.indx = offset - psf->file.buf.start ;
+			return offset - psf->fileoffset ;
+			} ;
+		} ;
+
 	absolute_position = lseek (psf->file.filedes, offset, whence) ;
 
 	if (absolute_position < 0)
 		psf_log_syserr (psf, errno) ;
 
+	psf_buffer_reset (&psf->file, absolute_position) ;
+
 	return absolute_position - psf->fileoffset ;
 } /* psf_fseek */
 
 sf_count_t
 psf_fread (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 {	sf_count_t total = 0 ;
-	ssize_t	count ;
+
+	if (psf->file.mem.active)
+		return psf_memory_read (ptr, bytes * items, psf) / bytes ;
 
 	if (psf->virtual_io)
-		return psf->vio.read (ptr, bytes*items, psf->vio_user_data) / bytes ;
+		return psf_vio_read (psf, ptr, bytes * items) / bytes ;
 
 	items *= bytes ;
 
@@ -326,9 +416,45 @@ psf_fread (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 	if (items <= 0)
 		return 0 ;
 
-	while (items > 0)
+	if (psf->file.map.ptr != NULL)
+	{	sf_count_t filelen = psf_get_filelen_fd (psf->file.filedes) ;
+
+		/*
+		** Copying from a page which a truncation has cut off the end of the
+		** file raises SIGBUS, so a file that has shrunk is read with read ().
+		*/
+		if (filelen < psf->file.map.len)
+			psf_munmap (psf) ;
+		else
+		{	total = psf_mmap_read (psf, ptr, items) ;
+
+			if (total == items || filelen == psf->file.map.len)
+				return total / bytes ;
+
+			/* The file has grown since it was mapped so fall back to read (). */
+			psf_munmap (psf) ;
+			items -= total ;
+			} ;
+		} ;
+
+	if (psf->is_pipe)
+	{	total += psf_read_fd (psf, ((char*) ptr) + total, items) ;
+		psf->pipeoffset += total ;
+		}
+	else
+		total += psf_buffer_read (psf, ((char*) ptr) + total, items) ;
+
+	return total / bytes ;
+} /* psf_fread */
+
+static sf_count_t
+psf_read_fd (SF_PRIVATE *psf, void *ptr, sf_count_t len)
+{	sf_count_t total = 0 ;
+	ssize_t	count ;
+
+	while (len > 0)
 	{	/* Break the read down to a sensible size. */
-		count = (items > SENSIBLE_SIZE) ? SENSIBLE_SIZE : (ssize_t) items ;
+		count = (len > SENSIBLE_SIZE) ? SENSIBLE_SIZE : (ssize_t) len ;
 
 		count = read (psf->file.filedes, ((char*) ptr) + total, (size_t) count) ;
 
@@ -344,25 +470,72 @@ psf_fread (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 			break ;
 
 		total += count ;
-		items -= count ;
+		len -= count ;
 		} ;
 
-	if (psf->is_pipe)
-		psf->pipeoffset += total ;
-
-	return total / bytes ;
-} /* psf_fread */
+	return total ;
+} /* psf_read_fd */
 
 sf_count_t
-psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
+psf_fread_at (SF_PRIVATE *psf, void *ptr, sf_count_t len, sf_count_t offset)
 {	sf_count_t total = 0 ;
 	ssize_t	count ;
 
+	if (psf->file.mem.active || psf->virtual_io || psf->is_pipe || psf->file.mode != SFM_READ || offset < 0)
+		return -1 ;
+
+	offset += psf->fileoffset ;
+
+	/*
+	** The mapping is only read, its position is left alone. It may be in use
+	** on other threads, so if the file has shrunk it is not dropped here.
+	*/
+	if (psf->file.map.ptr != NULL && offset + len <= psf->file.map.len
+			&& psf_get_filelen_fd (psf->file.filedes) >= offset + len)
+	{	memcpy (ptr, ((const unsigned char *) psf->file.map.ptr) + offset, (size_t) len) ;
+		return len ;
+		} ;
+
+#if HAVE_PREAD
+	while (len > 0)
+	{	count = (len > SENSIBLE_SIZE) ? SENSIBLE_SIZE : (ssize_t) len ;
+
+		count = pread (psf->file.filedes, ((char*) ptr) + total, (size_t) count, (off_t) (offset + total)) ;
+
+		if (count == -1)
+		{	if (errno == EINTR)
+				continue ;
+			/* No psf_log_syserr (), this may be running on several threads. */
+			return -1 ;
+			} ;
+
+		if (count == 0)
+			break ;
+
+		total += count ;
+		len -= count ;
+		} ;
+
+	return total ;
+#else
+	(void) total ;
+	(void) count ;
+	return -1 ;
+#endif
+} /* psf_fread_at */
+
+sf_count_t
+psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
+{	sf_count_t total ;
+
 	if (bytes == 0 || items == 0)
 		return 0 ;
 
+	if (psf->file.mem.active)
+		return psf_memory_write (ptr, bytes * items, psf) / bytes ;
+
 	if (psf->virtual_io)
-		return psf->vio.write (ptr, bytes*items, psf->vio_user_data) / bytes ;
+		return psf_vio_write (psf, ptr, bytes * items) / bytes ;
 
 	items *= bytes ;
 
@@ -370,9 +543,30 @@ psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf
 	if (items <= 0)
 		return 0 ;
 
-	while (items > 0)
+	if (psf->file.buf.write_behind && psf->is_pipe == SF_FALSE)
+		return psf_buffer_write (psf, ptr, items) / bytes ;
+
+	psf_buffer_sync (psf) ;
+
+	total = psf_write_fd (psf, ptr, items) ;
+
+	if (psf->is_pipe)
+		psf->pipeoffset += total ;
+
+	/* The descriptor may have been opened with O_APPEND, so forget the position. */
+	psf_buffer_reset (&psf->file, -1) ;
+
+	return total / bytes ;
+} /* psf_fwrite */
+
+static sf_count_t
+psf_write_fd (SF_PRIVATE *psf, const void *ptr, sf_count_t len)
+{	sf_count_t total = 0 ;
+	ssize_t	count ;
+
+	while (len > 0)
 	{	/* Break the writes down to a sensible size. */
-		count = (items > SENSIBLE_SIZE) ? SENSIBLE_SIZE : items ;
+		count = (len > SENSIBLE_SIZE) ? SENSIBLE_SIZE : len ;
 
 		count = write (psf->file.filedes, ((const char*) ptr) + total, count) ;
 
@@ -388,25 +582,31 @@ psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf
 			break ;
 
 		total += count ;
-		items -= count ;
+		len -= count ;
 		} ;
 
-	if (psf->is_pipe)
-		psf->pipeoffset += total ;
-
-	return total / bytes ;
-} /* psf_fwrite */
+	return total ;
+} /* psf_write_fd */
 
 sf_count_t
 psf_ftell (SF_PRIVATE *psf)
 {	sf_count_t pos ;
 
+	if (psf->file.mem.active)
+		return psf->file.mem.pos ;
+
 	if (psf->virtual_io)
-		return psf->vio.tell (psf->vio_user_data) ;
+		return psf_vio_tell (psf) ;
 
 	if (psf->is_pipe)
 		return psf->pipeoffset ;
 
+	if (psf->file.map.ptr != NULL)
+		return psf->file.map.pos - psf->fileoffset ;
+
+	if (psf->file.buf.start >= 0)
+		return psf->file.buf.start + psf->file.buf.indx - psf->fileoffset ;
+
 	pos = lseek (psf->file.filedes, 0, SEEK_CUR) ;
 
 	if (pos == ((sf_count_t) -1))
@@ -414,6 +614,8 @@ psf_ftell (SF_PRIVATE *psf)
 		return -1 ;
 		} ;
 
+	psf_buffer_reset (&psf->file, pos) ;
+
 	return pos - psf->fileoffset ;
 } /* psf_ftell */
 
@@ -436,15 +638,8 @@ psf_fgets (char *buffer, sf_count_t bufsize, SF_PRIVATE *psf)
 	sf_count_t		count ;
 
 	while (k < bufsize - 1)
-	{	count = read (psf->file.filedes, &(buffer [k]), 1) ;
-
-		if (count == -1)
-		{	if (errno == EINTR)
-				continue ;
-
-			psf_log_syserr (psf, errno) ;
-			break ;
-			} ;
+	{	/* Reads from the mapping or the read-ahead buffer, not the descriptor. */
+		count = psf_fread (&(buffer [k]), 1, 1, psf) ;
 
 		if (count == 0 || buffer [k++] == '\n')
 			break ;
@@ -502,9 +697,15 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	if (len < 0)
 		return -1 ;
 
+	if (psf->file.mem.active)
+		return psf_memory_truncate (psf, len) ;
+
 	if ((sizeof (off_t) < sizeof (sf_count_t)) && len > 0x7FFFFFFF)
 		return -1 ;
 
+	if (psf_buffer_sync (psf) != 0)
+		return -1 ;
+
 	retval = ftruncate (psf->file.filedes, len) ;
 
 	if (retval == -1)
@@ -518,11 +719,16 @@ psf_init_files (SF_PRIVATE *psf)
 {	psf->file.filedes = -1 ;
 	psf->rsrc.filedes = -1 ;
 	psf->file.savedes = -1 ;
+	psf_buffer_reset (&psf->file, -1) ;
 } /* psf_init_files */
 
 void
 psf_use_rsrc (SF_PRIVATE *psf, int on_off)
 {
+	/* The mapping and the read-ahead buffer only ever cover one fork. */
+	psf_munmap (psf) ;
+	psf_buffer_sync (psf) ;
+
 	if (on_off)
 	{	if (psf->file.filedes != psf->rsrc.filedes)
 		{	psf->file.savedes = psf->file.filedes ;
@@ -532,9 +738,245 @@ psf_use_rsrc (SF_PRIVATE *psf, int on_off)
 	else if (psf->file.filedes == psf->rsrc.filedes)
 		psf->file.filedes = psf->file.savedes ;
 
+	psf_buffer_reset (&psf->file, -1) ;
+
 	return ;
 } /* psf_use_rsrc */
 
+int
+psf_use_mmap (SF_PRIVATE *psf, int on_off)
+{
+#if HAVE_MMAP
+	sf_count_t	filelen, position ;
+	void		*ptr ;
+
+	if (on_off == SF_FALSE)
+	{	psf_munmap (psf) ;
+		return SF_FALSE ;
+		} ;
+
+	if (psf->file.map.ptr != NULL)
+		return SF_TRUE ;
+
+	/* Only regular files opened read only can be mapped. */
+	if (psf->virtual_io || psf->is_pipe || psf->file.mode != SFM_READ || psf->file.filedes < 0)
+		return SF_FALSE ;
+
+	if ((filelen = psf_get_filelen_fd (psf->file.filedes)) <= 0 || (uint64_t) filelen > SIZE_MAX)
+		return SF_FALSE ;
+
+	psf_buffer_sync (psf) ;
+
+	if ((position = lseek (psf->file.filedes, 0, SEEK_CUR)) < 0)
+		return SF_FALSE ;
+
+	ptr = mmap (NULL, (size_t) filelen, PROT_READ, MAP_SHARED, psf->file.filedes, 0) ;
+	if (ptr == MAP_FAILED)
+	{	psf_log_printf (psf, "psf_use_mmap : mmap failed (%s), using read ().\n", strerror (errno)) ;
+		return SF_FALSE ;
+		} ;
+
+	psf->file.map.ptr = ptr ;
+	psf->file.map.len = filelen ;
+	psf->file.map.pos = position ;
+
+	return SF_TRUE ;
+#else
+	(void) psf ;
+	(void) on_off ;
+	return SF_FALSE ;
+#endif
+} /* psf_use_mmap */
+
+int
+psf_set_write_buffer (SF_PRIVATE *psf, int size)
+{
+	/* Write buffering is only done for regular files. */
+	if (psf->virtual_io || psf->is_pipe || psf->file.mode == SFM_READ || size < 0)
+		return SF_FALSE ;
+
+	if (psf_buffer_sync (psf) != 0)
+		return SF_FALSE ;
+
+	free (psf->file.buf.ptr) ;
+	psf->file.buf.ptr = NULL ;
+	psf->file.buf.size = 0 ;
+	psf->file.buf.write_behind = SF_FALSE ;
+
+	if (size == 0 || (psf->file.buf.ptr = malloc (size)) == NULL)
+		return SF_FALSE ;
+
+	psf->file.buf.size = size ;
+	psf->file.buf.write_behind = SF_TRUE ;
+
+	return SF_TRUE ;
+} /* psf_set_write_buffer */
+
+static void
+psf_munmap (SF_PRIVATE *psf)
+{
+#if HAVE_MMAP
+	if (psf->file.map.ptr == NULL)
+		return ;
+
+	/* Leave the descriptor where reading from the mapping left off. */
+	lseek (psf->file.filedes, psf->file.map.pos, SEEK_SET) ;
+	psf_buffer_reset (&psf->file, psf->file.map.pos) ;
+
+	munmap (psf->file.map.ptr, (size_t) psf->file.map.len) ;
+	psf->file.map.ptr = NULL ;
+	psf->file.map.len = 0 ;
+	psf->file.map.pos = 0 ;
+#else
+	(void) psf ;
+#endif
+} /* psf_munmap */
+
+static sf_count_t
+psf_mmap_read (SF_PRIVATE *psf, void *ptr, sf_count_t len)
+{	sf_count_t count ;
+
+	count = psf->file.map.len - psf->file.map.pos ;
+	if (count <= 0)
+		return 0 ;
+
+	count = SF_MIN (count, len) ;
+	memcpy (ptr, ((const unsigned char *) psf->file.map.ptr) + psf->file.map.pos, (size_t) count) ;
+	psf->file.map.pos += count ;
+
+	return count ;
+} /* psf_mmap_read */
+
+static void
+psf_buffer_reset (PSF_FILE *pfile, sf_count_t start)
+{	pfile->buf.start = (start < 0) ? -1 : start ;
+	pfile->buf.indx = 0 ;
+	pfile->buf.len = 0 ;
+} /* psf_buffer_reset */
+
+static int
+psf_buffer_sync (SF_PRIVATE *psf)
+{	PSF_FILE *pfile = &psf->file ;
+	sf_count_t position ;
+
+	/*
+	** Empty the buffer, writing out pending data or moving the descriptor
+	** back to the logical position. Returns 0 on success.
+	*/
+	if (pfile->buf.start < 0)
+		return 0 ;
+
+	position = pfile->buf.start + pfile->buf.indx ;
+
+	if (pfile->buf.dirty)
+	{	pfile->buf.dirty = SF_FALSE ;
+		if (psf_write_fd (psf, pfile->buf.ptr, pfile->buf.len) != pfile->buf.len)
+		{	psf_buffer_reset (pfile, -1) ;
+			return -1 ;
+			} ;
+		}
+	else if (pfile->buf.indx < pfile->buf.len && lseek (pfile->filedes, position, SEEK_SET) < 0)
+	{	psf_log_syserr (psf, errno) ;
+		psf_buffer_reset (pfile, -1) ;
+		return -1 ;
+		} ;
+
+	psf_buffer_reset (pfile, position) ;
+
+	return 0 ;
+} /* psf_buffer_sync */
+
+static sf_count_t
+psf_buffer_read (SF_PRIVATE *psf, void *ptr, sf_count_t len)
+{	PSF_FILE *pfile = &psf->file ;
+	sf_count_t total = 0, count ;
+
+	if (pfile->buf.dirty && psf_buffer_sync (psf) != 0)
+		return 0 ;
+
+	while (len > 0)
+	{	if ((count = pfile->buf.len - pfile->buf.indx) > 0)
+		{	count = SF_MIN (count, len) ;
+			memcpy (((char*) ptr) + total, pfile->buf.ptr + pfile->buf.indx, (size_t) count) ;
+			pfile->buf.indx += count ;
+			total += count ;
+			len -= count ;
+			continue ;
+			} ;
+
+		/* The buffer is exhausted so the descriptor is at the logical position. */
+		if (pfile->buf.start >= 0)
+			psf_buffer_reset (pfile, pfile->buf.start + pfile->buf.len) ;
+		else
+			psf_buffer_reset (pfile, lseek (pfile->filedes, 0, SEEK_CUR)) ;
+
+		if (pfile->buf.ptr == NULL && pfile->buf.start >= 0 && (pfile->buf.ptr = malloc (READ_AHEAD_SIZE)) != NULL)
+			pfile->buf.size = READ_AHEAD_SIZE ;
+
+		/* Large reads (or unseekable descriptors) bypass the buffer. */
+		if (len >= pfile->buf.size || pfile->buf.ptr == NULL || pfile->buf.start < 0)
+		{	count = psf_read_fd (psf, ((char*) ptr) + total, len) ;
+			if (pfile->buf.start >= 0)
+				pfile->buf.start += count ;
+			total += count ;
+			break ;
+			} ;
+
+		if ((pfile->buf.len = psf_read_fd (psf, pfile->buf.ptr, pfile->buf.size)) == 0)
+			break ;
+		} ;
+
+	return total ;
+} /* psf_buffer_read */
+
+static sf_count_t
+psf_buffer_write (SF_PRIVATE *psf, const void *ptr, sf_count_t len)
+{	PSF_FILE *pfile = &psf->file ;
+	sf_count_t total = 0, count, limit ;
+
+	if (pfile->buf.dirty == SF_FALSE)
+	{	/* Drop any read-ahead data and start collecting at the logical position. */
+		if (psf_buffer_sync (psf) != 0)
+			return 0 ;
+
+		if (pfile->buf.start < 0 && (pfile->buf.start = lseek (pfile->filedes, 0, SEEK_CUR)) < 0)
+		{	psf_log_syserr (psf, errno) ;
+			psf_buffer_reset (pfile, -1) ;
+			return 0 ;
+			} ;
+		} ;
+
+	while (len > 0)
+	{	/* Keep the writes aligned to multiples of the buffer size in the file. */
+		limit = pfile->buf.size - pfile->buf.start % pfile->buf.size ;
+
+		if (pfile->buf.len == 0 && len >= limit)
+		{	/* Whole blocks go straight to the file. */
+			limit += ((len - limit) / pfile->buf.size) * pfile->buf.size ;
+			count = psf_write_fd (psf, ((const char*) ptr) + total, limit) ;
+			pfile->buf.start += count ;
+			total += count ;
+			if (count != limit)
+				break ;
+			len -= count ;
+			continue ;
+			} ;
+
+		count = SF_MIN (limit - pfile->buf.len, len) ;
+		memcpy (pfile->buf.ptr + pfile->buf.len, ((const char*) ptr) + total, (size_t) count) ;
+		pfile->buf.len += count ;
+		pfile->buf.indx = pfile->buf.len ;
+		pfile->buf.dirty = SF_TRUE ;
+		total += count ;
+		len -= count ;
+
+		if (pfile->buf.len == limit && psf_buffer_sync (psf) != 0)
+			break ;
+		} ;
+
+	return total ;
+} /* psf_buffer_write */
+
 static int
 psf_open_fd (PSF_FILE * pfile)
 {	int fd, oflag, mode ;
@@ -594,11 +1036,12 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 void
 psf_fsync (SF_PRIVATE *psf)
 {
+	if (psf->file.buf.dirty)
+		psf_buffer_sync (psf) ;
+
 #if HAVE_FSYNC
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
 		fsync (psf->file.filedes) ;
-#else
-	psf = NULL ;
 #endif
 } /* psf_fsync */
 
@@ -631,7 +1074,7 @@ psf_fclose (SF_PRIVATE *psf)
 {	int retval ;
 
 	if (psf->virtual_io)
-		return 0 ;
+		return psf_vio_close (psf) ;
 
 	if (psf->file.do_not_close_descriptor)
 	{	psf->file.handle = NULL ;
@@ -741,6 +1184,7 @@ psf_init_files (SF_PRIVATE *psf)
 {	psf->file.handle = NULL ;
 	psf->rsrc.handle = NULL ;
 	psf->file.hsaved = NULL ;
+	psf->file.buf.start = -1 ;
 } /* psf_init_files */
 
 /* USE_WINDOWS_API */ void
@@ -758,6 +1202,22 @@ psf_use_rsrc (SF_PRIVATE *psf, int on_off)
 	return ;
 } /* psf_use_rsrc */
 
+/* USE_WINDOWS_API */ int
+psf_use_mmap (SF_PRIVATE *psf, int on_off)
+{	/* Memory mapped reads are not implemented for the windows API. */
+	(void) psf ;
+	(void) on_off ;
+	return SF_FALSE ;
+} /* psf_use_mmap */
+
+/* USE_WINDOWS_API */ int
+psf_set_write_buffer (SF_PRIVATE *psf, int size)
+{	/* Write buffering is not implemented for the windows API. */
+	(void) psf ;
+	(void) size ;
+	return SF_FALSE ;
+} /* psf_set_write_buffer */
+
 /* USE_WINDOWS_API */ static HANDLE
 psf_open_handle (PSF_FILE * pfile)
 {	DWORD dwDesiredAccess ;
@@ -924,8 +1384,11 @@ psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence)
 	BOOL fResult ;
 	DWORD dwError ;
 
+	if (psf->file.mem.active)
+		return psf_memory_seek (offset, whence, psf) ;
+
 	if (psf->virtual_io)
-		return psf->vio.seek (offset, whence, psf->vio_user_data) ;
+		return psf_vio_seek (psf, offset, whence) ;
 
 	switch (whence)
 	{	case SEEK_SET :
@@ -967,8 +1430,11 @@ psf_fread (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 	ssize_t count ;
 	DWORD dwNumberOfBytesRead ;
 
+	if (psf->file.mem.active)
+		return psf_memory_read (ptr, bytes * items, psf) / bytes ;
+
 	if (psf->virtual_io)
-		return psf->vio.read (ptr, bytes*items, psf->vio_user_data) / bytes ;
+		return psf_vio_read (psf, ptr, bytes * items) / bytes ;
 
 	items *= bytes ;
 
@@ -1000,14 +1466,31 @@ psf_fread (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 	return total / bytes ;
 } /* psf_fread */
 
+/* USE_WINDOWS_API */ sf_count_t
+psf_fread_at (SF_PRIVATE *psf, void *ptr, sf_count_t len, sf_count_t offset)
+{	/*
+	** ReadFile () with an offset still moves the file pointer of a handle
+	** opened for synchronous access, so there is no way to do this without
+	** upsetting other reads.
+	*/
+	(void) psf ;
+	(void) ptr ;
+	(void) len ;
+	(void) offset ;
+	return -1 ;
+} /* psf_fread_at */
+
 /* USE_WINDOWS_API */ sf_count_t
 psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 {	sf_count_t total = 0 ;
 	ssize_t	count ;
 	DWORD dwNumberOfBytesWritten ;
 
+	if (psf->file.mem.active)
+		return psf_memory_write (ptr, bytes * items, psf) / bytes ;
+
 	if (psf->virtual_io)
-		return psf->vio.write (ptr, bytes * items, psf->vio_user_data) / bytes ;
+		return psf_vio_write (psf, ptr, bytes * items) / bytes ;
 
 	items *= bytes ;
 
@@ -1046,8 +1529,11 @@ psf_ftell (SF_PRIVATE *psf)
 	BOOL fResult ;
 	DWORD dwError ;
 
+	if (psf->file.mem.active)
+		return psf->file.mem.pos ;
+
 	if (psf->virtual_io)
-		return psf->vio.tell (psf->vio_user_data) ;
+		return psf_vio_tell (psf) ;
 
 	if (psf->is_pipe)
 		return psf->pipeoffset ;
@@ -1161,6 +1647,9 @@ psf_ftruncate (SF_PRIVATE *psf, sf_count_t len)
 	if (len < 0)
 		return 1 ;
 
+	if (psf->file.mem.active)
+		return psf_memory_truncate (psf, len) ;
+
 	liDistanceToMove.QuadPart = (sf_count_t) len ;
 
 	fResult = SetFilePointerEx (psf->file.handle, liDistanceToMove, NULL, FILE_BEGIN) ;
@@ -1249,7 +1738,7 @@ psf_fseek (SF_PRIVATE *psf, sf_count_t offset, int whence)
 {	sf_count_t	new_position ;
 
 	if (psf->virtual_io)
-		return psf->vio.seek (offset, whence, psf->vio_user_data) ;
+		return psf_vio_seek (psf, offset, whence) ;
 
 	switch (whence)
 	{	case SEEK_SET :
@@ -1304,7 +1793,7 @@ psf_fread (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
 	ssize_t	count ;
 
 	if (psf->virtual_io)
-		return psf->vio.read (ptr, bytes*items, psf->vio_user_data) / bytes ;
+		return psf_vio_read (psf, ptr, bytes * items) / bytes ;
 
 	items *= bytes ;
 
@@ -1342,7 +1831,7 @@ psf_fwrite (const void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf
 	ssize_t	count ;
 
 	if (psf->virtual_io)
-		return psf->vio.write (ptr, bytes*items, psf->vio_user_data) / bytes ;
+		return psf_vio_write (psf, ptr, bytes * items) / bytes ;
 
 	items *= bytes ;
 
@@ -1379,7 +1868,7 @@ psf_ftell (SF_PRIVATE *psf)
 {	sf_count_t pos ;
 
 	if (psf->virtual_io)
-		return psf->vio.tell (psf->vio_user_data) ;
+		return psf_vio_tell (psf) ;
 
 	pos = _telli64 (psf->file.filedes) ;
 
@@ -1570,3 +2059,355 @@ psf_log_syserr (SF_PRIVATE *psf, int error)
 
 #endif
 
+
+/*==============================================================================
+** Block cache for virtual I/O, the same on all platforms. Small reads are
+** served from psf->file.buf so that header parsing and nearby seeks don't
+** each cost a call into the user's SF_VIRTUAL_IO callbacks. The buf.start
+** field is the position of buf.ptr [0] in the virtual file (or -1 if not
+** known) and while it is known, the virtual file is positioned at
+** buf.start + buf.len.
+*/
+
+#define	VIO_BLOCK_SIZE	(SF_BUFFER_LEN)
+
+void
+psf_set_virtual_io (SF_PRIVATE *psf, const SF_VIRTUAL_IO *sfvirtual, void *user_data)
+{
+	psf->virtual_io = SF_TRUE ;
+	psf->vio = *sfvirtual ;
+	psf->vio_user_data = user_data ;
+
+	psf->file.buf.ptr = NULL ;
+	psf->file.buf.size = VIO_BLOCK_SIZE ;
+	psf->file.buf.start = -1 ;
+	psf->file.buf.indx = 0 ;
+	psf->file.buf.len = 0 ;
+} /* psf_set_virtual_io */
+
+static int
+psf_vio_sync (SF_PRIVATE *psf)
+{	PSF_FILE *pfile = &psf->file ;
+	sf_count_t unread ;
+
+	/* Empty the cache, moving the virtual file back to the logical position. */
+	unread = pfile->buf.len - pfile->buf.indx ;
+
+	if (unread > 0 && (psf->vio.seek == NULL || psf->vio.seek (- unread, SEEK_CUR, psf->vio_user_data) < 0))
+	{	psf_log_printf (psf, "psf_vio_sync : seek failed.\n") ;
+		pfile->buf.start = -1 ;
+		pfile->buf.indx = pfile->buf.len = 0 ;
+		return -1 ;
+		} ;
+
+	if (pfile->buf.start >= 0)
+		pfile->buf.start += pfile->buf.indx ;
+	pfile->buf.indx = pfile->buf.len = 0 ;
+
+	return 0 ;
+} /* psf_vio_sync */
+
+int
+psf_set_vio_block_size (SF_PRIVATE *psf, int size)
+{
+	if (psf->virtual_io == SF_FALSE || psf->file.mem.active || size < 0)
+		return SF_FALSE ;
+
+	if (psf_vio_sync (psf) != 0)
+		return SF_FALSE ;
+
+	free (psf->file.buf.ptr) ;
+	psf->file.buf.ptr = NULL ;
+	psf->file.buf.size = size ;
+
+	return (size > 0) ? SF_TRUE : SF_FALSE ;
+} /* psf_set_vio_block_size */
+
+static sf_count_t
+psf_vio_seek (SF_PRIVATE *psf, sf_count_t offset, int whence)
+{	PSF_FILE *pfile = &psf->file ;
+	sf_count_t position ;
+
+	if (pfile->buf.len > 0)
+	{	/* The virtual file is positioned at the end of the cached data. */
+		if (whence == SEEK_CUR)
+			offset -= pfile->buf.len - pfile->buf.indx ;
+
+		if (pfile->buf.start >= 0 && whence != SEEK_END)
+		{	position = (whence == SEEK_SET) ? offset : pfile->buf.start + pfile->buf.len + offset ;
+
+			if (position >= pfile->buf.start && position <= pfile->buf.start + pfile->buf.len)
+			{	pfile->buf.indx = position - pfile->buf.start ;
+				return position ;
+				} ;
+			} ;
+
+		pfile->buf.indx = pfile->buf.len = 0 ;
+		} ;
+
+	position = psf->vio.seek (offset, whence, psf->vio_user_data) ;
+	pfile->buf.start = (position < 0) ? -1 : position ;
+
+	return position ;
+} /* psf_vio_seek */
+
+static sf_count_t
+psf_vio_read (SF_PRIVATE *psf, void *ptr, sf_count_t len)
+{	PSF_FILE *pfile = &psf->file ;
+	sf_count_t total = 0, count ;
+
+	while (len > 0)
+	{	if ((count = pfile->buf.len - pfile->buf.indx) > 0)
+		{	count = SF_MIN (count, len) ;
+			memcpy (((char*) ptr) + total, pfile->buf.ptr + pfile->buf.indx, (size_t) count) ;
+			pfile->buf.indx += count ;
+			total += count ;
+			len -= count ;
+			continue ;
+			} ;
+
+		/* The cache is exhausted so the virtual file is at the logical position. */
+		if (pfile->buf.start >= 0)
+			pfile->buf.start += pfile->buf.len ;
+		pfile->buf.indx = pfile->buf.len = 0 ;
+
+		if (pfile->buf.ptr == NULL && pfile->buf.size > 0 && (pfile->buf.ptr = malloc (pfile->buf.size)) == NULL)
+			pfile->buf.size = 0 ;
+
+		/* Large reads bypass the cache. */
+		if (len >= pfile->buf.size)
+		{	count = psf->vio.read (((char*) ptr) + total, len, psf->vio_user_data) ;
+			if (count > 0)
+			{	if (pfile->buf.start >= 0)
+					pfile->buf.start += count ;
+				total += count ;
+				} ;
+			break ;
+			} ;
+
+		if ((count = psf->vio.read (pfile->buf.ptr, pfile->buf.size, psf->vio_user_data)) <= 0)
+			break ;
+		pfile->buf.len = count ;
+		} ;
+
+	return total ;
+} /* psf_vio_read */
+
+static sf_count_t
+psf_vio_write (SF_PRIVATE *psf, const void *ptr, sf_count_t len)
+{	sf_count_t count ;
+
+	if (psf->file.buf.len > 0 && psf_vio_sync (psf) != 0)
+		return 0 ;
+
+	count = psf->vio.write (ptr, len, psf->vio_user_data) ;
+
+	if (psf->file.buf.start >= 0 && count > 0)
+		psf->file.buf.start += count ;
+
+	return count ;
+} /* psf_vio_write */
+
+static sf_count_t
+psf_vio_tell (SF_PRIVATE *psf)
+{	PSF_FILE *pfile = &psf->file ;
+
+	if (pfile->buf.start < 0)
+	{	pfile->buf.start = psf->vio.tell (psf->vio_user_data) ;
+		if (pfile->buf.start < 0)
+		{	pfile->buf.start = -1 ;
+			return -1 ;
+			} ;
+		pfile->buf.start -= pfile->buf.len ;
+		} ;
+
+	return pfile->buf.start + pfile->buf.indx ;
+} /* psf_vio_tell */
+
+static int
+psf_vio_close (SF_PRIVATE *psf)
+{	int retval = 0 ;
+
+	/* Leave the virtual file where the library stopped reading. */
+	if (psf->file.buf.len > psf->file.buf.indx && psf->vio.seek != NULL)
+		retval = psf_vio_sync (psf) ;
+
+	free (psf->file.buf.ptr) ;
+	psf->file.buf.ptr = NULL ;
+	psf->file.buf.size = 0 ;
+	psf->file.buf.start = -1 ;
+	psf->file.buf.indx = psf->file.buf.len = 0 ;
+
+	return retval ;
+} /* psf_vio_close */
+
+/*==============================================================================
+** In memory files, the same on all platforms. These are installed as the
+** virtual I/O callbacks so that everything which checks psf->virtual_io
+** works unchanged, but psf_fread () and friends call them directly.
+*/
+
+#define	MEMORY_MIN_ALLOC	(1 << 14)
+
+static SF_VIRTUAL_IO memory_io =
+{	psf_memory_get_filelen,
+	psf_memory_seek,
+	psf_memory_read,
+	psf_memory_write,
+	psf_memory_tell
+} ;
+
+void
+psf_set_memory (SF_PRIVATE *psf, const void *data, sf_count_t datalen)
+{
+	memset (&psf->file.mem, 0, sizeof (psf->file.mem)) ;
+	psf->file.mem.data = data ;
+	psf->file.mem.len = datalen ;
+	psf->file.mem.active = SF_TRUE ;
+
+	psf->virtual_io = SF_TRUE ;
+	psf->vio = memory_io ;
+	psf->vio_user_data = psf ;
+} /* psf_set_memory */
+
+void
+psf_set_memory_write (SF_PRIVATE *psf, void **data, sf_count_t *datalen)
+{
+	psf_set_memory (psf, NULL, 0) ;
+
+	psf->file.mem.user_ptr = data ;
+	psf->file.mem.user_len = datalen ;
+
+	*data = NULL ;
+	*datalen = 0 ;
+} /* psf_set_memory_write */
+
+static int
+psf_memory_reserve (SF_PRIVATE *psf, sf_count_t len)
+{	unsigned char *ptr ;
+	sf_count_t alloc ;
+
+	if (len <= psf->file.mem.alloc)
+		return 0 ;
+
+	/* Only a buffer set up by psf_set_memory_write () can grow. */
+	if (psf->file.mem.user_ptr == NULL)
+		return -1 ;
+
+	alloc = SF_MAX (psf->file.mem.alloc, (sf_count_t) MEMORY_MIN_ALLOC) ;
+	while (alloc < len)
+		alloc *= 2 ;
+
+	if ((uint64_t) alloc > SIZE_MAX || (ptr = realloc (psf->file.mem.buffer, (size_t) alloc)) == NULL)
+	{	psf->error = SFE_MALLOC_FAILED ;
+		return -1 ;
+		} ;
+
+	psf->file.mem.buffer = ptr ;
+	psf->file.mem.data = ptr ;
+	psf->file.mem.alloc = alloc ;
+	*psf->file.mem.user_ptr = ptr ;
+
+	return 0 ;
+} /* psf_memory_reserve */
+
+static sf_count_t
+psf_memory_get_filelen (void *user_data)
+{	SF_PRIVATE *psf = user_data ;
+
+	return psf->file.mem.len ;
+} /* psf_memory_get_filelen */
+
+static sf_count_t
+psf_memory_seek (sf_count_t offset, int whence, void *user_data)
+{	SF_PRIVATE *psf = user_data ;
+
+	switch (whence)
+	{	case SEEK_SET :
+				break ;
+
+		case SEEK_CUR :
+				offset += psf->file.mem.pos ;
+				break ;
+
+		case SEEK_END :
+				offset += psf->file.mem.len ;
+				break ;
+
+		default :
+				psf_log_printf (psf, "psf_memory_seek : whence is %d *****.\n", whence) ;
+				return -1 ;
+		} ;
+
+	if (offset < 0)
+	{	psf_log_syserr (psf, EINVAL) ;
+		return -1 ;
+		} ;
+
+	psf->file.mem.pos = offset ;
+
+	return offset ;
+} /* psf_memory_seek */
+
+static sf_count_t
+psf_memory_read (void *ptr, sf_count_t count, void *user_data)
+{	SF_PRIVATE *psf = user_data ;
+
+	count = SF_MIN (count, psf->file.mem.len - psf->file.mem.pos) ;
+	if (count <= 0)
+		return 0 ;
+
+	memcpy (ptr, psf->file.mem.data + psf->file.mem.pos, (size_t) count) ;
+	psf->file.mem.pos += count ;
+
+	return count ;
+} /* psf_memory_read */
+
+static sf_count_t
+psf_memory_write (const void *ptr, sf_count_t count, void *user_data)
+{	SF_PRIVATE *psf = user_data ;
+	sf_count_t end ;
+
+	if (count <= 0)
+		return 0 ;
+
+	end = psf->file.mem.pos + count ;
+	if (psf_memory_reserve (psf, end) != 0)
+		return 0 ;
+
+	/* Fill any gap left by a seek past the end of the data. */
+	if (psf->file.mem.pos > psf->file.mem.len)
+		memset (psf->file.mem.buffer + psf->file.mem.len, 0, (size_t) (psf->file.mem.pos - psf->file.mem.len)) ;
+
+	memcpy (psf->file.mem.buffer + psf->file.mem.pos, ptr, (size_t) count) ;
+	psf->file.mem.pos = end ;
+
+	if (end > psf->file.mem.len)
+	{	psf->file.mem.len = end ;
+		*psf->file.mem.user_len = end ;
+		} ;
+
+	return count ;
+} /* psf_memory_write */
+
+static sf_count_t
+psf_memory_tell (void *user_data)
+{	SF_PRIVATE *psf = user_data ;
+
+	return psf->file.mem.pos ;
+} /* psf_memory_tell */
+
+static int
+psf_memory_truncate (SF_PRIVATE *psf, sf_count_t len)
+{
+	if (psf->file.mem.user_ptr == NULL || psf_memory_reserve (psf, len) != 0)
+		return -1 ;
+
+	if (len > psf->file.mem.len)
+		memset (psf->file.mem.buffer + psf->file.mem.len, 0, (size_t) (len - psf->file.mem.len)) ;
+
+	psf->file.mem.len = len ;
+	*psf->file.mem.user_len = len ;
+
+	return 0 ;
+} /* psf_memory_truncate */
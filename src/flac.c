@@ -28,6 +28,8 @@
 
 #include	"sndfile.h"
 #include	"common.h"
+#include	"simd.h"
+#include	"thread_pool.h"
 
 #if HAVE_EXTERNAL_XIPH_LIBS
 
@@ -43,6 +45,20 @@
 
 #define ENC_BUFFER_SIZE 8192
 
+/* Default spacing of the seek table written on encode. When the length of the
+** file is not known up front this many points are reserved and filled in at
+** close, using fewer points spaced further apart if the file turns out longer.
+*/
+#define	FLAC_SEEK_TABLE_SECONDS	10
+#define	FLAC_SEEK_TABLE_RESERVE	100
+
+/* Keeps the SEEKTABLE block well below the 16 MB metadata block limit. */
+#define	FLAC_SEEK_TABLE_MAX		32768
+
+/* Bytes in the header of a metadata block and in each seek point. */
+#define	FLAC_BLOCK_HEADER_LEN	4
+#define	FLAC_SEEK_POINT_LEN		18
+
 typedef enum
 {	PFLAC_PCM_SHORT = 50,
 	PFLAC_PCM_INT = 51,
@@ -50,6 +66,8 @@ typedef enum
 	PFLAC_PCM_DOUBLE = 53
 } PFLAC_PCM ;
 
+typedef struct FLAC_RANGE FLAC_RANGE ;
+
 typedef struct
 {
 	FLAC__StreamDecoder *fsd ;
@@ -71,6 +89,19 @@ typedef struct
 
 	unsigned compression ;
 
+	/* Seek table written on encode. The points are collected as frames are
+	** written and then written over the reserved placeholders at close.
+	*/
+	FLAC__StreamMetadata *seektable ;
+	sf_count_t seek_spacing, seek_frames ;
+	sf_count_t seektable_offset, audio_offset ;
+	sf_count_t encoded, seek_next ;
+	FLAC__StreamMetadata_SeekPoint *seek_points ;
+	unsigned seek_count, seek_allocated ;
+
+	/* Parallel decoding of large reads, see flac_read_range (). */
+	FLAC_RANGE *range ;
+
 } FLAC_PRIVATE ;
 
 typedef struct
@@ -84,6 +115,8 @@ static int			flac_close (SF_PRIVATE *psf) ;
 
 static int			flac_enc_init (SF_PRIVATE *psf) ;
 static int			flac_read_header (SF_PRIVATE *psf) ;
+static sf_count_t	flac_read_range (SF_PRIVATE *psf, void *ptr, sf_count_t len) ;
+static void			flac_range_free (FLAC_RANGE *range) ;
 
 static sf_count_t	flac_read_flac2s (SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
 static sf_count_t	flac_read_flac2i (SF_PRIVATE *psf, int *ptr, sf_count_t len) ;
@@ -162,12 +195,112 @@ i2flac24_array (const int *src, int32_t *dest, int count)
 		dest [count] = src [count] >> 8 ;
 } /* i2flac24_array */
 
+/*
+**	Interleave and convert frames of decoded audio from libFLAC's channel
+**	buffers. The vector kernels do one or two channels and these finish off.
+*/
+
+static void
+flac_planar_to_s (const int32_t * const *src, unsigned channels, short *dest, unsigned frames, int shift)
+{	unsigned k, j ;
+
+	k = psf_simd ()->planar_to_s (src, channels, dest, frames, shift) ;
+
+	if (shift < 0)
+	{	for ( ; k < frames ; k++)
+			for (j = 0 ; j < channels ; j++)
+				dest [k * channels + j] = src [j][k] >> -shift ;
+		}
+	else
+	{	for ( ; k < frames ; k++)
+			for (j = 0 ; j < channels ; j++)
+				dest [k * channels + j] = ((uint16_t) src [j][k]) << shift ;
+		} ;
+} /* flac_planar_to_s */
+
+static void
+flac_planar_to_i (const int32_t * const *src, unsigned channels, int *dest, unsigned frames, int shift)
+{	unsigned k, j ;
+
+	for (k = psf_simd ()->planar_to_i (src, channels, dest, frames, shift) ; k < frames ; k++)
+		for (j = 0 ; j < channels ; j++)
+			dest [k * channels + j] = ((uint32_t) src [j][k]) << shift ;
+} /* flac_planar_to_i */
+
+static void
+flac_planar_to_f (const int32_t * const *src, unsigned channels, float *dest, unsigned frames, float norm)
+{	unsigned k, j ;
+
+	for (k = psf_simd ()->planar_to_f (src, channels, dest, frames, norm) ; k < frames ; k++)
+		for (j = 0 ; j < channels ; j++)
+			dest [k * channels + j] = src [j][k] * norm ;
+} /* flac_planar_to_f */
+
+static void
+flac_planar_to_d (const int32_t * const *src, unsigned channels, double *dest, unsigned frames, double norm)
+{	unsigned k, j ;
+
+	for (k = psf_simd ()->planar_to_d (src, channels, dest, frames, norm) ; k < frames ; k++)
+		for (j = 0 ; j < channels ; j++)
+			dest [k * channels + j] = src [j][k] * norm ;
+} /* flac_planar_to_d */
+
+/*
+**	Convert frames samples of a decoded frame, starting at bufferpos, to
+**	interleaved pcmtype samples at ptr + offset. Also used by the workers of
+**	flac_read_range () so it only reads psf.
+*/
+static void
+flac_convert_frames (SF_PRIVATE *psf, PFLAC_PCM pcmtype, const int32_t * const *buffer, unsigned bufferpos, unsigned bits, void *ptr, sf_count_t offset, unsigned frames)
+{	const int32_t *chan [FLAC__MAX_CHANNELS] ;
+	unsigned j, outchannels ;
+
+	/* Only the channels picked with SFC_SET_READ_CHANNELS go to the output. */
+	if (psf->read_channels != NULL)
+	{	outchannels = psf->read_channel_count ;
+		for (j = 0 ; j < outchannels ; j++)
+			chan [j] = buffer [psf->read_channels [j]] + bufferpos ;
+		}
+	else
+	{	outchannels = SF_MIN ((unsigned) psf->sf.channels, (unsigned) FLAC__MAX_CHANNELS) ;
+		for (j = 0 ; j < outchannels ; j++)
+			chan [j] = buffer [j] + bufferpos ;
+		} ;
+
+	switch (pcmtype)
+	{	case PFLAC_PCM_SHORT :
+			flac_planar_to_s (chan, outchannels, (short*) ptr + offset, frames, 16 - (int) bits) ;
+			break ;
+
+		case PFLAC_PCM_INT :
+			flac_planar_to_i (chan, outchannels, (int*) ptr + offset, frames, 32 - bits) ;
+			break ;
+
+		case PFLAC_PCM_FLOAT :
+			{	float norm = (psf->norm_float == SF_TRUE) ? 1.0 / (1 << (bits - 1)) : 1.0 ;
+
+				flac_planar_to_f (chan, outchannels, (float*) ptr + offset, frames, norm) ;
+				} ;
+			break ;
+
+		case PFLAC_PCM_DOUBLE :
+			{	double norm = (psf->norm_double == SF_TRUE) ? 1.0 / (1 << (bits - 1)) : 1.0 ;
+
+				flac_planar_to_d (chan, outchannels, (double*) ptr + offset, frames, norm) ;
+				} ;
+			break ;
+
+		default :
+			break ;
+		} ;
+} /* flac_convert_frames */
+
 static sf_count_t
 flac_buffer_copy (SF_PRIVATE *psf)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
 	const FLAC__Frame *frame = pflac->frame ;
 	const int32_t* const *buffer = pflac->wbuffer ;
-	unsigned i = 0, j, offset, channels, len ;
+	unsigned i = 0, channels, outchannels, frames ;
 
 	if (psf->sf.channels != (int) frame->header.channels)
 	{	psf_log_printf (psf, "Error: FLAC frame changed from %d to %d channels\n"
@@ -210,124 +343,26 @@ flac_buffer_copy (SF_PRIVATE *psf)
 		return 0 ;
 		} ;
 
-	len = SF_MIN (pflac->len, frame->header.blocksize) ;
-
-	if (pflac->remain % channels != 0)
-	{	psf_log_printf (psf, "Error: pflac->remain %u    channels %u\n", pflac->remain, channels) ;
+	if (pflac->bufferpos >= frame->header.blocksize)
 		return 0 ;
-		} ;
-
-	switch (pflac->pcmtype)
-	{	case PFLAC_PCM_SHORT :
-			{	short *retpcm = (short*) pflac->ptr ;
-				int shift = 16 - frame->header.bits_per_sample ;
-				if (shift < 0)
-				{	shift = abs (shift) ;
-					for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-					{	offset = pflac->pos + i * channels ;
-
-						if (pflac->bufferpos >= frame->header.blocksize)
-							break ;
-
-						if (offset + channels > pflac->len)
-							break ;
-
-						for (j = 0 ; j < channels ; j++)
-							retpcm [offset + j] = buffer [j][pflac->bufferpos] >> shift ;
-						pflac->remain -= channels ;
-						pflac->bufferpos ++ ;
-						}
-					}
-				else
-				{	for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-					{	offset = pflac->pos + i * channels ;
-
-						if (pflac->bufferpos >= frame->header.blocksize)
-							break ;
-
-						if (offset + channels > pflac->len)
-							break ;
-
-						for (j = 0 ; j < channels ; j++)
-							retpcm [offset + j] = ((uint16_t) buffer [j][pflac->bufferpos]) << shift ;
-
-						pflac->remain -= channels ;
-						pflac->bufferpos ++ ;
-						} ;
-					} ;
-				} ;
-			break ;
-
-		case PFLAC_PCM_INT :
-			{	int *retpcm = (int*) pflac->ptr ;
-				int shift = 32 - frame->header.bits_per_sample ;
-				for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-				{	offset = pflac->pos + i * channels ;
-
-					if (pflac->bufferpos >= frame->header.blocksize)
-						break ;
-
-					if (offset + channels > pflac->len)
-						break ;
-
-					for (j = 0 ; j < channels ; j++)
-						retpcm [offset + j] = ((uint32_t) buffer [j][pflac->bufferpos]) << shift ;
-					pflac->remain -= channels ;
-					pflac->bufferpos++ ;
-					} ;
-				} ;
-			break ;
-
-		case PFLAC_PCM_FLOAT :
-			{	float *retpcm = (float*) pflac->ptr ;
-				float norm = (psf->norm_float == SF_TRUE) ? 1.0 / (1 << (frame->header.bits_per_sample - 1)) : 1.0 ;
-
-				for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-				{	offset = pflac->pos + i * channels ;
-
-					if (pflac->bufferpos >= frame->header.blocksize)
-						break ;
-
-					if (offset + channels > pflac->len)
-						break ;
 
-					for (j = 0 ; j < channels ; j++)
-						retpcm [offset + j] = buffer [j][pflac->bufferpos] * norm ;
-					pflac->remain -= channels ;
-					pflac->bufferpos++ ;
-					} ;
-				} ;
-			break ;
+	outchannels = psf->read_channels != NULL ? (unsigned) psf->read_channel_count : channels ;
 
-		case PFLAC_PCM_DOUBLE :
-			{	double *retpcm = (double*) pflac->ptr ;
-				double norm = (psf->norm_double == SF_TRUE) ? 1.0 / (1 << (frame->header.bits_per_sample - 1)) : 1.0 ;
-
-				for (i = 0 ; i < len && pflac->remain > 0 ; i++)
-				{	offset = pflac->pos + i * channels ;
+	if (pflac->remain % outchannels != 0)
+	{	psf_log_printf (psf, "Error: pflac->remain %u    channels %u\n", pflac->remain, outchannels) ;
+		return 0 ;
+		} ;
 
-					if (pflac->bufferpos >= frame->header.blocksize)
-						break ;
+	/* As much of the frame as fits, usually all of it, straight into the caller's buffer. */
+	frames = SF_MIN (frame->header.blocksize - pflac->bufferpos, pflac->remain / outchannels) ;
 
-					if (offset + channels > pflac->len)
-						break ;
+	flac_convert_frames (psf, pflac->pcmtype, buffer, pflac->bufferpos, frame->header.bits_per_sample, pflac->ptr, pflac->pos, frames) ;
 
-					for (j = 0 ; j < channels ; j++)
-						retpcm [offset + j] = buffer [j][pflac->bufferpos] * norm ;
-					pflac->remain -= channels ;
-					pflac->bufferpos++ ;
-					} ;
-				} ;
-			break ;
+	pflac->bufferpos += frames ;
+	pflac->remain -= frames * outchannels ;
+	pflac->pos += frames * outchannels ;
 
-		default :
-			return 0 ;
-		} ;
-
-	offset = i * channels ;
-	pflac->pos += i * channels ;
-
-	return offset ;
+	return frames * outchannels ;
 } /* flac_buffer_copy */
 
 
@@ -569,9 +604,54 @@ sf_flac_enc_tell_callback (const FLAC__StreamEncoder *UNUSED (encoder), FLAC__ui
 	return FLAC__STREAM_ENCODER_TELL_STATUS_OK ;
 } /* sf_flac_enc_tell_callback */
 
+static void
+flac_add_seek_point (SF_PRIVATE *psf, FLAC_PRIVATE* pflac, sf_count_t position, unsigned samples)
+{	FLAC__StreamMetadata_SeekPoint *points ;
+	unsigned allocated ;
+
+	if (pflac->seek_count >= pflac->seek_allocated)
+	{	allocated = SF_MAX (2 * pflac->seek_allocated, 256u) ;
+		if ((points = realloc (pflac->seek_points, allocated * sizeof (points [0]))) == NULL)
+		{	psf_log_printf (psf, "Out of memory for FLAC seek points, seek table will be incomplete.\n") ;
+			pflac->seek_spacing = 0 ;
+			return ;
+			} ;
+		pflac->seek_points = points ;
+		pflac->seek_allocated = allocated ;
+		} ;
+
+	points = pflac->seek_points + pflac->seek_count ++ ;
+	points->sample_number = pflac->encoded ;
+	points->stream_offset = position - pflac->audio_offset ;
+	points->frame_samples = samples ;
+} /* flac_add_seek_point */
+
 static FLAC__StreamEncoderWriteStatus
-sf_flac_enc_write_callback (const FLAC__StreamEncoder * UNUSED (encoder), const FLAC__byte buffer [], size_t bytes, unsigned UNUSED (samples), unsigned UNUSED (current_frame), void *client_data)
+sf_flac_enc_write_callback (const FLAC__StreamEncoder * UNUSED (encoder), const FLAC__byte buffer [], size_t bytes, unsigned samples, unsigned UNUSED (current_frame), void *client_data)
 {	SF_PRIVATE *psf = (SF_PRIVATE*) client_data ;
+	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
+	sf_count_t position ;
+
+	position = psf_ftell (psf) ;
+
+	if (samples == 0)
+	{	/* libFLAC writes each metadata block with its own call, so note where the seek table goes. */
+		if (pflac->seektable != NULL && pflac->audio_offset < 0 && pflac->seektable_offset < 0
+				&& bytes >= FLAC_BLOCK_HEADER_LEN && (buffer [0] & 0x7F) == FLAC__METADATA_TYPE_SEEKTABLE)
+			pflac->seektable_offset = position ;
+		}
+	else
+	{	if (pflac->audio_offset < 0)
+			pflac->audio_offset = position ;
+
+		/* A seek point for each frame holding a multiple of the spacing. */
+		if (pflac->seektable != NULL && pflac->seek_spacing > 0 && pflac->seek_next < pflac->encoded + samples)
+		{	flac_add_seek_point (psf, pflac, position, samples) ;
+			pflac->seek_next = (pflac->encoded + samples + pflac->seek_spacing - 1) / pflac->seek_spacing * pflac->seek_spacing ;
+			} ;
+
+		pflac->encoded += samples ;
+		} ;
 
 	if (psf_fwrite (buffer, 1, bytes, psf) == (sf_count_t) bytes && psf->error == 0)
 		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK ;
@@ -641,20 +721,94 @@ flac_write_strings (SF_PRIVATE *psf, FLAC_PRIVATE* pflac)
 		FLAC__metadata_object_vorbiscomment_append_comment (pflac->metadata, entry, /* copy */ SF_FALSE) ;
 		} ;
 
-	if (! FLAC__stream_encoder_set_metadata (pflac->fse, &pflac->metadata, 1))
-	{	printf ("%s %d : fail\n", __func__, __LINE__) ;
+	return ;
+} /* flac_write_strings */
+
+static void
+flac_reserve_seek_table (SF_PRIVATE *psf, FLAC_PRIVATE* pflac)
+{	sf_count_t points ;
+
+	/* The table is filled in at close, which needs a seekable file. */
+	if (pflac->seek_spacing <= 0 || psf->is_pipe)
+		return ;
+
+	if (pflac->seek_frames > 0)
+		points = (pflac->seek_frames + pflac->seek_spacing - 1) / pflac->seek_spacing ;
+	else
+		points = FLAC_SEEK_TABLE_RESERVE ;
+	points = SF_MIN (points, (sf_count_t) FLAC_SEEK_TABLE_MAX) ;
+
+	if ((pflac->seektable = FLAC__metadata_object_new (FLAC__METADATA_TYPE_SEEKTABLE)) == NULL)
+	{	psf_log_printf (psf, "FLAC__metadata_object_new returned NULL\n") ;
 		return ;
 		} ;
 
-	return ;
-} /* flac_write_strings */
+	/*
+	** Only placeholders go in the header, libFLAC leaves them alone and
+	** flac_write_seek_table () writes the real points over them at close.
+	*/
+	if (! FLAC__metadata_object_seektable_template_append_placeholders (pflac->seektable, (unsigned) points))
+	{	psf_log_printf (psf, "FLAC__metadata_object_seektable_template_append_placeholders (%D) returned false.\n", points) ;
+		FLAC__metadata_object_delete (pflac->seektable) ;
+		pflac->seektable = NULL ;
+		return ;
+		} ;
+
+	psf_log_printf (psf, "FLAC seek table : %D points every %D frames.\n", points, pflac->seek_spacing) ;
+} /* flac_reserve_seek_table */
+
+static void
+flac_write_seek_table (SF_PRIVATE *psf, FLAC_PRIVATE* pflac)
+{	const FLAC__StreamMetadata_SeekPoint *point ;
+	unsigned k, step, reserved, written, used = 0 ;
+
+	if (pflac->seektable == NULL || pflac->seektable_offset < 0 || pflac->audio_offset < 0)
+		return ;
+
+	/* If more points were collected than reserved, keep every step'th one. */
+	reserved = pflac->seektable->data.seek_table.num_points ;
+	step = (pflac->seek_count + reserved - 1) / reserved ;
+
+	psf->header.indx = 0 ;
+	for (k = 0 ; k < pflac->seek_count ; k += step, used++)
+	{	point = pflac->seek_points + k ;
+		psf_binheader_writef (psf, "E882", BHW8 (point->sample_number), BHW8 (point->stream_offset), BHW2 (point->frame_samples)) ;
+		} ;
+
+	/* Unused points stay as placeholders, which must come last. */
+	for (written = used ; used < reserved ; used++)
+		psf_binheader_writef (psf, "E882", BHW8 (FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER), BHW8 (0), BHW2 (0)) ;
+
+	if (psf->header.indx != (sf_count_t) reserved * FLAC_SEEK_POINT_LEN)
+		return ;
+
+	psf_fseek (psf, pflac->seektable_offset + FLAC_BLOCK_HEADER_LEN, SEEK_SET) ;
+	psf_fwrite (psf->header.ptr, psf->header.indx, 1, psf) ;
+	psf_fseek (psf, 0, SEEK_END) ;
+
+	psf_log_printf (psf, "FLAC seek table : wrote %u of %u points.\n", written, reserved) ;
+} /* flac_write_seek_table */
 
 static int
 flac_write_header (SF_PRIVATE *psf, int UNUSED (calc_length))
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
+	FLAC__StreamMetadata *metadata [2] ;
+	unsigned count = 0 ;
 	int err ;
 
 	flac_write_strings (psf, pflac) ;
+	flac_reserve_seek_table (psf, pflac) ;
+
+	if (pflac->metadata != NULL)
+		metadata [count++] = pflac->metadata ;
+	if (pflac->seektable != NULL)
+		metadata [count++] = pflac->seektable ;
+
+	/* libFLAC keeps its own copy of the array but not of the blocks. */
+	if (count > 0 && ! FLAC__stream_encoder_set_metadata (pflac->fse, metadata, count))
+	{	psf_log_printf (psf, "FLAC__stream_encoder_set_metadata returned false.\n") ;
+		return SFE_FLAC_INIT_DECODER ;
+		} ;
 
 	if ((err = FLAC__stream_encoder_init_stream (pflac->fse, sf_flac_enc_write_callback, sf_flac_enc_seek_callback, sf_flac_enc_tell_callback, NULL, psf)) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
 	{	psf_log_printf (psf, "Error : FLAC encoder init returned error : %s\n", FLAC__StreamEncoderInitStatusString [err]) ;
@@ -685,6 +839,9 @@ flac_open	(SF_PRIVATE *psf)
 
 	/* Set the default value here. Over-ridden later if necessary. */
 	pflac->compression = FLAC_DEFAULT_COMPRESSION_LEVEL ;
+	pflac->seek_spacing = FLAC_SEEK_TABLE_SECONDS * (sf_count_t) psf->sf.samplerate ;
+	pflac->seektable_offset = -1 ;
+	pflac->audio_offset = -1 ;
 
 	if (psf->file.mode == SFM_RDWR)
 		return SFE_BAD_MODE_RW ;
@@ -748,18 +905,24 @@ flac_close	(SF_PRIVATE *psf)
 	if ((pflac = (FLAC_PRIVATE*) psf->codec_data) == NULL)
 		return 0 ;
 
-	if (pflac->metadata != NULL)
-		FLAC__metadata_object_delete (pflac->metadata) ;
-
 	if (psf->file.mode == SFM_WRITE)
 	{	FLAC__stream_encoder_finish (pflac->fse) ;
+		/* After finish (), which writes libFLAC's own copy of the table. */
+		flac_write_seek_table (psf, pflac) ;
 		FLAC__stream_encoder_delete (pflac->fse) ;
 		free (pflac->encbuffer) ;
 		} ;
 
+	if (pflac->metadata != NULL)
+		FLAC__metadata_object_delete (pflac->metadata) ;
+	if (pflac->seektable != NULL)
+		FLAC__metadata_object_delete (pflac->seektable) ;
+	free (pflac->seek_points) ;
+
 	if (psf->file.mode == SFM_READ)
 	{	FLAC__stream_decoder_finish (pflac->fsd) ;
 		FLAC__stream_decoder_delete (pflac->fsd) ;
+		flac_range_free (pflac->range) ;
 		} ;
 
 	for (k = 0 ; k < ARRAY_LEN (pflac->rbuffer) ; k++)
@@ -866,6 +1029,7 @@ flac_read_header (SF_PRIVATE *psf)
 static int
 flac_command (SF_PRIVATE * psf, int command, void * data, int datasize)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
+	const SF_SEEK_TABLE_INFO *seek_table ;
 	double quality ;
 
 	switch (command)
@@ -890,6 +1054,34 @@ flac_command (SF_PRIVATE * psf, int command, void * data, int datasize)
 
 			return SF_TRUE ;
 
+		case SFC_SET_SEEK_TABLE :
+			if (data == NULL || datasize != sizeof (SF_SEEK_TABLE_INFO))
+			{	psf->error = SFE_BAD_COMMAND_PARAM ;
+				return SF_FALSE ;
+				} ;
+
+			if (psf->file.mode != SFM_WRITE)
+			{	psf->error = SFE_NOT_WRITEMODE ;
+				return SF_FALSE ;
+				} ;
+
+			/* The table is reserved in the header before the first write. */
+			if (psf->have_written)
+			{	psf->error = SFE_CMD_HAS_DATA ;
+				return SF_FALSE ;
+				} ;
+
+			seek_table = (const SF_SEEK_TABLE_INFO *) data ;
+			if (seek_table->spacing < 0 || seek_table->frames < 0)
+			{	psf->error = SFE_BAD_COMMAND_PARAM ;
+				return SF_FALSE ;
+				} ;
+
+			pflac->seek_spacing = seek_table->spacing ;
+			pflac->seek_frames = seek_table->frames ;
+
+			return SF_TRUE ;
+
 		default :
 			return SF_FALSE ;
 		} ;
@@ -908,6 +1100,7 @@ flac_init (SF_PRIVATE *psf)
 		psf->read_int		= flac_read_flac2i ;
 		psf->read_float		= flac_read_flac2f ;
 		psf->read_double	= flac_read_flac2d ;
+		psf->can_select_channels = SF_TRUE ;
 		} ;
 
 	if (psf->file.mode == SFM_WRITE)
@@ -963,14 +1156,417 @@ flac_read_loop (SF_PRIVATE *psf, unsigned len)
 	return pflac->pos ;
 } /* flac_read_loop */
 
+/*==============================================================================
+**	Large reads with SFC_SET_THREADS.
+**
+**	The compressed data is read into memory and cut into one slice per job.
+**	Each job runs its own decoder on a copy of the STREAMINFO block followed
+**	by the bytes from the start of its slice, and the decoder syncs to the
+**	first frame after the cut by itself. A first pass finds the first sample
+**	of each slice. A second pass decodes each slice from there up to the
+**	first sample of the next one, straight into the caller's buffer. Every
+**	frame has to follow on from the one before, and anything unexpected
+**	makes the read carry on serially from the last slice boundary, so the
+**	output is always the same as a serial decode.
+*/
+
+#define	FLAC_RANGE_MIN_FRAMES	(1 << 18)
+#define	FLAC_RANGE_MAX_SLICE	(4 << 20)
+#define	FLAC_RANGE_MIN_SLICE	(64 << 10)
+
+/* "fLaC" followed by the STREAMINFO block, which must come first. */
+#define	FLAC_STREAMINFO_LEN		(4 + FLAC_BLOCK_HEADER_LEN + 34)
+
+typedef struct
+{	FLAC_RANGE			*range ;
+
+	/* Slice data from the start of the slice to the end of the buffer. */
+	const FLAC__byte	*data ;
+	size_t				len, pos, header_pos ;
+
+	sf_count_t			first, next, end ;
+	int					found, skip, failed ;
+} FLAC_RANGE_JOB ;
+
+struct FLAC_RANGE
+{	SF_PRIVATE			*psf ;
+	PSF_THREAD_POOL		*pool ;
+	int					threads ;
+	FLAC__StreamDecoder	*fsd [PSF_MAX_THREADS] ;	/* One per worker. */
+
+	FLAC__byte			header [FLAC_STREAMINFO_LEN] ;
+	sf_count_t			max_frame ;
+
+	FLAC__byte			*buffer ;
+	sf_count_t			allocated ;
+	int					at_eof ;
+
+	/* The current read, ptr holds samples from ptr_start on. */
+	PFLAC_PCM			pcmtype ;
+	void				*ptr ;
+	sf_count_t			ptr_start, ptr_end ;
+
+	int					pass ;
+	FLAC_RANGE_JOB		jobs [PSF_MAX_THREADS + 1] ;
+} ;
+
+static FLAC__StreamDecoderReadStatus
+flac_range_read_callback (const FLAC__StreamDecoder * UNUSED (decoder), FLAC__byte buffer [], size_t *bytes, void *client_data)
+{	FLAC_RANGE_JOB *job = (FLAC_RANGE_JOB *) client_data ;
+	size_t count = 0, n ;
+
+	if (job->header_pos < FLAC_STREAMINFO_LEN)
+	{	count = SF_MIN (*bytes, FLAC_STREAMINFO_LEN - job->header_pos) ;
+		memcpy (buffer, job->range->header + job->header_pos, count) ;
+		job->header_pos += count ;
+		} ;
+
+	n = SF_MIN (*bytes - count, job->len - job->pos) ;
+	memcpy (buffer + count, job->data + job->pos, n) ;
+	job->pos += n ;
+	count += n ;
+
+	*bytes = count ;
+	return count > 0 ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM ;
+} /* flac_range_read_callback */
+
+static FLAC__StreamDecoderWriteStatus
+flac_range_write_callback (const FLAC__StreamDecoder * UNUSED (decoder), const FLAC__Frame *frame, const int32_t * const buffer [], void *client_data)
+{	FLAC_RANGE_JOB *job = (FLAC_RANGE_JOB *) client_data ;
+	FLAC_RANGE *range = job->range ;
+	SF_PRIVATE *psf = range->psf ;
+	sf_count_t sample, start, end ;
+	unsigned outchannels ;
+
+	if (frame->header.number_type != FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER || (int) frame->header.channels != psf->sf.channels)
+	{	job->failed = 1 ;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT ;
+		} ;
+
+	/* libFLAC passes on frames that failed their CRC check as silence. */
+	if (job->skip)
+	{	job->skip = 0 ;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE ;
+		} ;
+
+	sample = frame->header.number.sample_number ;
+
+	if (range->pass == 1)
+	{	/* Two frames in a row rule out a false sync in the middle of a frame. */
+		if (job->found == 1 && sample == job->next)
+			job->found = 2 ;
+		else
+		{	job->first = sample ;
+			job->next = sample + frame->header.blocksize ;
+			job->found = 1 ;
+			} ;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE ;
+		} ;
+
+	/* Frames before the one the first pass found belong to the previous slice. */
+	if (job->found == 0)
+	{	if (sample != job->first)
+			return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE ;
+		job->found = 1 ;
+		} ;
+
+	if (sample != job->next)
+	{	job->failed = 1 ;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT ;
+		} ;
+
+	start = SF_MAX (sample, range->ptr_start) ;
+	end = SF_MIN (sample + (sf_count_t) frame->header.blocksize, job->end) ;
+	end = SF_MIN (end, range->ptr_end) ;
+	outchannels = psf->read_channels != NULL ? (unsigned) psf->read_channel_count : (unsigned) psf->sf.channels ;
+
+	if (start < end)
+		flac_convert_frames (psf, range->pcmtype, buffer, start - sample, frame->header.bits_per_sample,
+							range->ptr, (start - range->ptr_start) * outchannels, end - start) ;
+
+	job->next += frame->header.blocksize ;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE ;
+} /* flac_range_write_callback */
+
+static void
+flac_range_error_callback (const FLAC__StreamDecoder * UNUSED (decoder), FLAC__StreamDecoderErrorStatus status, void *client_data)
+{	FLAC_RANGE_JOB *job = (FLAC_RANGE_JOB *) client_data ;
+
+	/* Losing sync at the cut is expected, any error after that is not. */
+	if (job->range->pass == 2 && job->found)
+		job->failed = 1 ;
+
+	if (job->range->pass == 1)
+		job->found = 0 ;
+
+	/* A frame with a bad CRC still goes to the write callback. */
+	if (status == FLAC__STREAM_DECODER_ERROR_STATUS_FRAME_CRC_MISMATCH)
+		job->skip = 1 ;
+} /* flac_range_error_callback */
+
+static void
+flac_range_job (void *data, int job_num, int worker)
+{	FLAC_RANGE *range = (FLAC_RANGE *) data ;
+	FLAC_RANGE_JOB *job ;
+	FLAC__StreamDecoder *fsd ;
+	FLAC__StreamDecoderState state ;
+	sf_count_t stop ;
+
+	/* The first pass starts at the second slice. */
+	job = range->jobs + job_num + (range->pass == 1 ? 1 : 0) ;
+
+	job->pos = job->header_pos = 0 ;
+	job->found = job->skip = job->failed = 0 ;
+	job->next = job->first ;
+	stop = SF_MIN (job->end, range->ptr_end) ;
+
+	if (range->pass == 2 && job->first >= stop)
+		return ;
+
+	if (range->fsd [worker] == NULL)
+		range->fsd [worker] = FLAC__stream_decoder_new () ;
+
+	if ((fsd = range->fsd [worker]) == NULL || FLAC__stream_decoder_init_stream (fsd, flac_range_read_callback, NULL, NULL, NULL, NULL,
+				flac_range_write_callback, NULL, flac_range_error_callback, job) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+	{	job->failed = 1 ;
+		return ;
+		} ;
+
+	while (job->failed == 0 && (range->pass == 1 ? job->found < 2 : job->next < stop))
+	{	if (FLAC__stream_decoder_process_single (fsd) == 0)
+			break ;
+		if (FLAC__stream_decoder_get_state (fsd) >= FLAC__STREAM_DECODER_END_OF_STREAM)
+			break ;
+		} ;
+	state = FLAC__stream_decoder_get_state (fsd) ;
+
+	/* At the end of the file the last frame has nothing after it. */
+	if (range->pass == 1 && job->found < 2 && range->at_eof && state == FLAC__STREAM_DECODER_END_OF_STREAM)
+	{	if (job->found == 0)
+			job->first = range->psf->sf.frames ;
+		if (job->found == 0 || job->next == range->psf->sf.frames)
+			job->found = 2 ;
+		} ;
+
+	if (range->pass == 1 ? job->found < 2 : job->next < stop)
+		job->failed = 1 ;
+
+	FLAC__stream_decoder_finish (fsd) ;
+} /* flac_range_job */
+
+static void
+flac_range_free (FLAC_RANGE *range)
+{	int k ;
+
+	if (range == NULL)
+		return ;
+
+	psf_thread_pool_free (range->pool) ;
+	for (k = 0 ; k < PSF_MAX_THREADS ; k++)
+		if (range->fsd [k] != NULL)
+			FLAC__stream_decoder_delete (range->fsd [k]) ;
+	free (range->buffer) ;
+	free (range) ;
+} /* flac_range_free */
+
+static FLAC_RANGE *
+flac_range_get (SF_PRIVATE *psf, FLAC_PRIVATE* pflac)
+{	FLAC_RANGE *range = pflac->range ;
+	sf_count_t max_blocksize, saved ;
+	int ok ;
+
+	if (range == NULL)
+	{	if ((range = calloc (1, sizeof (FLAC_RANGE))) == NULL)
+			return NULL ;
+		range->psf = psf ;
+
+		/* The serial decoder's input must not move. */
+		saved = psf_ftell (psf) ;
+		ok = psf_fseek (psf, 0, SEEK_SET) == 0 && psf_fread (range->header, 1, FLAC_STREAMINFO_LEN, psf) == FLAC_STREAMINFO_LEN ;
+		psf_fseek (psf, saved, SEEK_SET) ;
+
+		if (! ok || memcmp (range->header, "fLaC", 4) != 0 || (range->header [4] & 0x7F) != FLAC__METADATA_TYPE_STREAMINFO)
+		{	/* Such as a file starting with an ID3 tag. */
+			psf_log_printf (psf, "FLAC : no STREAMINFO at the start of the file, reading serially.\n") ;
+			free (range) ;
+			return NULL ;
+			} ;
+
+		/* Mark STREAMINFO as the last metadata block. */
+		range->header [4] |= 0x80 ;
+
+		range->max_frame = (range->header [15] << 16) + (range->header [16] << 8) + range->header [17] ;
+		if (range->max_frame == 0)
+		{	/* Not known, so allow for an uncompressed frame. */
+			max_blocksize = (range->header [10] << 8) + range->header [11] ;
+			range->max_frame = max_blocksize * psf->sf.channels * 4 + 1024 ;
+			} ;
+
+		pflac->range = range ;
+		} ;
+
+	if (range->pool == NULL || range->threads != psf->threads)
+	{	psf_thread_pool_free (range->pool) ;
+		range->pool = psf_thread_pool_new (psf->threads) ;
+		range->threads = psf->threads ;
+		if (range->pool != NULL)
+			psf_log_printf (psf, "FLAC : decoding large reads on %d threads.\n", psf_thread_pool_workers (range->pool)) ;
+		} ;
+
+	return range->pool != NULL ? range : NULL ;
+} /* flac_range_get */
+
+/*
+**	Decode one batch of slices starting at the frame boundary or cut at
+**	*position whose first sample is *current. Returns SF_FALSE if anything
+**	didn't go to plan, leaving *position and *current alone.
+*/
+static int
+flac_range_batch (SF_PRIVATE *psf, FLAC_RANGE *range, sf_count_t *position, sf_count_t *current)
+{	FLAC__byte *buffer ;
+	sf_count_t slice, len, offset ;
+	int k, jobs, workers, decode ;
+
+	workers = psf_thread_pool_workers (range->pool) ;
+
+	/* Aim to end the batch near the end of the read, going by the average frame size. */
+	slice = (sf_count_t) ((range->ptr_end - *current) * ((psf->filelength - psf->dataoffset) / (double) psf->sf.frames) / workers) ;
+	slice = SF_MIN (slice, (sf_count_t) FLAC_RANGE_MAX_SLICE) ;
+	slice = SF_MAX (slice, (sf_count_t) FLAC_RANGE_MIN_SLICE) ;
+	/* Big enough that every cut is followed by a frame starting in the same slice. */
+	slice = SF_MAX (slice, 4 * range->max_frame) ;
+
+	for (jobs = 0 ; jobs < workers && *position + jobs * slice < psf->filelength ; jobs++)
+		/* Nothing. */ ;
+	if (jobs == 0)
+		return SF_FALSE ;
+
+	/* Room for the first pass to find two frames after the last cut. */
+	len = SF_MIN (jobs * slice + 3 * range->max_frame + 4096, psf->filelength - *position) ;
+	range->at_eof = (*position + len == psf->filelength) ;
+
+	if (len > range->allocated)
+	{	if ((buffer = realloc (range->buffer, len)) == NULL)
+			return SF_FALSE ;
+		range->buffer = buffer ;
+		range->allocated = len ;
+		} ;
+
+	if (psf_fseek (psf, *position, SEEK_SET) != *position || psf_fread (range->buffer, 1, len, psf) != len)
+		return SF_FALSE ;
+
+	for (k = 0 ; k <= jobs ; k++)
+	{	offset = SF_MIN (k * slice, len) ;
+		range->jobs [k].range = range ;
+		range->jobs [k].data = range->buffer + offset ;
+		range->jobs [k].len = len - offset ;
+		} ;
+
+	/* Find the first sample of each slice after the first. */
+	range->jobs [0].first = *current ;
+	range->pass = 1 ;
+	psf_thread_pool_run (range->pool, jobs, flac_range_job, range) ;
+
+	for (k = 1 ; k <= jobs ; k++)
+	{	if (range->jobs [k].failed || range->jobs [k].first <= range->jobs [k - 1].first)
+			return SF_FALSE ;
+		range->jobs [k - 1].end = range->jobs [k].first ;
+		} ;
+
+	/* Then decode the slices that hold part of the read. */
+	for (decode = 0 ; decode < jobs && range->jobs [decode].first < range->ptr_end ; decode++)
+		/* Nothing. */ ;
+
+	range->pass = 2 ;
+	psf_thread_pool_run (range->pool, decode, flac_range_job, range) ;
+
+	for (k = 0 ; k < decode ; k++)
+		if (range->jobs [k].failed)
+			return SF_FALSE ;
+
+	*position += decode * slice ;
+	*current = SF_MIN (range->jobs [decode].first, range->ptr_end) ;
+
+	return SF_TRUE ;
+} /* flac_range_batch */
+
+/*
+**	Try to do all of a large read in parallel. Returns the number of items
+**	read, the serial code does whatever is left.
+*/
+static sf_count_t
+flac_read_range (SF_PRIVATE *psf, void *ptr, sf_count_t len)
+{	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
+	FLAC_RANGE *range ;
+	FLAC__uint64 decode_position ;
+	sf_count_t position, current, total = 0 ;
+	unsigned outchannels ;
+
+	outchannels = psf->read_channels != NULL ? (unsigned) psf->read_channel_count : (unsigned) psf->sf.channels ;
+
+	if (psf->threads < 2 || psf->is_pipe || psf->sf.frames <= 0 || len / outchannels < FLAC_RANGE_MIN_FRAMES)
+		return 0 ;
+
+	if (pflac->frame == NULL && psf->read_current != 0)
+		return 0 ;
+
+	/* Finish the frame the serial decoder is part way through, if any. */
+	if (pflac->frame != NULL)
+	{	pflac->ptr = ptr ;
+		pflac->pos = 0 ;
+		pflac->len = pflac->remain = (unsigned) SF_MIN (len, (sf_count_t) 0x1000000) ;
+		if (pflac->bufferpos < pflac->frame->header.blocksize)
+			flac_buffer_copy (psf) ;
+		total = pflac->pos ;
+		pflac->ptr = NULL ;
+
+		current = pflac->frame->header.number.sample_number + pflac->frame->header.blocksize ;
+		}
+	else
+		current = 0 ;
+
+	/* The serial decoder's input should now be at the start of the frame holding current. */
+	if (psf->error || current != psf->read_current + total / outchannels
+			|| FLAC__stream_decoder_get_state (pflac->fsd) != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC
+			|| ! FLAC__stream_decoder_get_decode_position (pflac->fsd, &decode_position))
+		return total ;
+	position = decode_position ;
+
+	if ((range = flac_range_get (psf, pflac)) == NULL)
+		return total ;
+
+	range->pcmtype = pflac->pcmtype ;
+	range->ptr = ptr ;
+	range->ptr_start = psf->read_current ;
+	range->ptr_end = SF_MIN (psf->read_current + len / outchannels, psf->sf.frames) ;
+
+	while (current < range->ptr_end)
+		if (flac_range_batch (psf, range, &position, &current) == SF_FALSE)
+		{	psf_log_printf (psf, "FLAC : parallel read stopped at sample %D, carrying on serially.\n", current) ;
+			break ;
+			} ;
+
+	total = (current - psf->read_current) * outchannels ;
+
+	/* Leave the serial decoder at the end of the parallel read. */
+	pflac->frame = NULL ;
+	if (current < psf->sf.frames && ! FLAC__stream_decoder_seek_absolute (pflac->fsd, current))
+		psf->error = SFE_BAD_SEEK ;
+
+	return total ;
+} /* flac_read_range */
+
 static sf_count_t
 flac_read_flac2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
-	sf_count_t total = 0, current ;
+	sf_count_t total, current ;
 	unsigned readlen ;
 
 	pflac->pcmtype = PFLAC_PCM_SHORT ;
 
+	total = flac_read_range (psf, ptr, len) ;
+
 	while (total < len)
 	{	pflac->ptr = ptr + total ;
 		readlen = (len - total > 0x1000000) ? 0x1000000 : (unsigned) (len - total) ;
@@ -986,11 +1582,13 @@ flac_read_flac2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 static sf_count_t
 flac_read_flac2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
-	sf_count_t total = 0, current ;
+	sf_count_t total, current ;
 	unsigned readlen ;
 
 	pflac->pcmtype = PFLAC_PCM_INT ;
 
+	total = flac_read_range (psf, ptr, len) ;
+
 	while (total < len)
 	{	pflac->ptr = ptr + total ;
 		readlen = (len - total > 0x1000000) ? 0x1000000 : (unsigned) (len - total) ;
@@ -1006,11 +1604,13 @@ flac_read_flac2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 static sf_count_t
 flac_read_flac2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
-	sf_count_t total = 0, current ;
+	sf_count_t total, current ;
 	unsigned readlen ;
 
 	pflac->pcmtype = PFLAC_PCM_FLOAT ;
 
+	total = flac_read_range (psf, ptr, len) ;
+
 	while (total < len)
 	{	pflac->ptr = ptr + total ;
 		readlen = (len - total > 0x1000000) ? 0x1000000 : (unsigned) (len - total) ;
@@ -1026,11 +1626,13 @@ flac_read_flac2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 static sf_count_t
 flac_read_flac2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 {	FLAC_PRIVATE* pflac = (FLAC_PRIVATE*) psf->codec_data ;
-	sf_count_t total = 0, current ;
+	sf_count_t total, current ;
 	unsigned readlen ;
 
 	pflac->pcmtype = PFLAC_PCM_DOUBLE ;
 
+	total = flac_read_range (psf, ptr, len) ;
+
 	while (total < len)
 	{	pflac->ptr = ptr + total ;
 		readlen = (len - total > 0x1000000) ? 0x1000000 : (unsigned) (len - total) ;
@@ -27,6 +27,7 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"simd.h"
 
 #if CPU_IS_LITTLE_ENDIAN
 	#define FLOAT32_READ	float32_le_read
@@ -98,7 +99,9 @@ float32_init	(SF_PRIVATE *psf)
 	psf->blockwidth = sizeof (float) * psf->sf.channels ;
 
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
-	{	switch (psf->endian + float_caps)
+	{	psf->can_select_channels = SF_TRUE ;
+
+		switch (psf->endian + float_caps)
 		{	case (SF_ENDIAN_BIG + FLOAT_CAN_RW_BE) :
 					psf->data_endswap = SF_FALSE ;
 					psf->read_short		= host_read_f2s ;
@@ -444,7 +447,10 @@ f2s_array (const float *src, int count, short *dest, float scale)
 
 static void
 f2s_clip_array (const float *src, int count, short *dest, float scale)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->f_to_s_clip (src, dest, count, scale, 0, SF_FALSE) ;
+	while (--count >= done)
 	{	float tmp = scale * src [count] ;
 
 		if (CPU_CLIPS_POSITIVE == 0 && tmp > 32767.0)
@@ -465,7 +471,10 @@ f2i_array (const float *src, int count, int *dest, float scale)
 
 static inline void
 f2i_clip_array (const float *src, int count, int *dest, float scale)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->f_to_i_clip (src, dest, count, scale, SF_FALSE) ;
+	while (--count >= done)
 	{	float tmp = scale * src [count] ;
 
 		if (CPU_CLIPS_POSITIVE == 0 && tmp > (1.0 * INT_MAX))
@@ -523,7 +532,7 @@ host_read_f2s	(SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 /* Fix me : Need lef2s_array */
 		if (psf->data_endswap == SF_TRUE)
@@ -554,7 +563,7 @@ host_read_f2i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_int_array (ubuf.ibuf, bufferlen) ;
@@ -576,14 +585,14 @@ host_read_f	(SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	sf_count_t	total = 0 ;
 
 	if (psf->data_endswap != SF_TRUE)
-		return psf_fread (ptr, sizeof (float), len, psf) ;
+		return psf_fread_samples (ptr, sizeof (float), len, psf) ;
 
 	bufferlen = ARRAY_LEN (ubuf.fbuf) ;
 
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		endswap_int_copy ((int*) (ptr + total), ubuf.ibuf, readcount) ;
 
@@ -607,7 +616,7 @@ host_read_f2d	(SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_int_array (ubuf.ibuf, bufferlen) ;
@@ -762,7 +771,7 @@ replace_read_f2s	(SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_int_array (ubuf.ibuf, bufferlen) ;
@@ -792,7 +801,7 @@ replace_read_f2i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_int_array (ubuf.ibuf, bufferlen) ;
@@ -822,7 +831,7 @@ replace_read_f	(SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_int_array (ubuf.ibuf, bufferlen) ;
@@ -851,7 +860,7 @@ replace_read_f2d	(SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.fbuf, sizeof (float), bufferlen, psf) ;
 
 		if (psf->data_endswap == SF_TRUE)
 			endswap_int_array (ubuf.ibuf, bufferlen) ;
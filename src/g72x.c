@@ -26,6 +26,7 @@
 #include "sndfile.h"
 #include "sfendian.h"
 #include "common.h"
+#include "checkpoint.h"
 #include "G72x/g72x.h"
 
 /* This struct is private to the G72x code. */
@@ -70,7 +71,7 @@ static	int	g72x_close (SF_PRIVATE *psf) ;
 int
 g72x_init (SF_PRIVATE * psf)
 {	G72x_PRIVATE	*pg72x ;
-	int	bitspersample, bytesperblock, codec ;
+	int	bitspersample, bytesperblock, codec, interval ;
 
 	if (psf->codec_data != NULL)
 	{	psf_log_printf (psf, "*** psf->codec_data is not NULL.\n") ;
@@ -125,6 +126,12 @@ g72x_init (SF_PRIVATE * psf)
 		if (pg72x->private == NULL)
 			return SFE_MALLOC_FAILED ;
 
+		/* Seeking restores the decoder state saved at the start of a block. */
+		interval = (PSF_CHECKPOINT_INTERVAL / pg72x->samplesperblock + 1) * pg72x->samplesperblock ;
+		if ((psf->checkpoints = psf_checkpoints_new (interval, g72x_state_size ())) == NULL)
+			return SFE_MALLOC_FAILED ;
+		psf->sf.seekable = psf->is_pipe ? SF_FALSE : SF_TRUE ;
+
 		pg72x->bytesperblock = bytesperblock ;
 
 		psf->read_short		= g72x_read_s ;
@@ -180,7 +187,8 @@ g72x_init (SF_PRIVATE * psf)
 
 static int
 psf_g72x_decode_block (SF_PRIVATE *psf, G72x_PRIVATE *pg72x)
-{	int	k ;
+{	sf_count_t frame ;
+	int	k ;
 
 	pg72x->block_curr ++ ;
 	pg72x->sample_curr = 0 ;
@@ -190,6 +198,10 @@ psf_g72x_decode_block (SF_PRIVATE *psf, G72x_PRIVATE *pg72x)
 		return 1 ;
 		} ;
 
+	frame = (sf_count_t) (pg72x->block_curr - 1) * pg72x->samplesperblock ;
+	if (psf_checkpoints_ahead (psf->checkpoints, frame) == 0)
+		psf_checkpoints_add (psf->checkpoints, frame, pg72x->private) ;
+
 	if ((k = psf_fread (pg72x->block, 1, pg72x->bytesperblock, psf)) != pg72x->bytesperblock)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pg72x->bytesperblock) ;
 
@@ -344,80 +356,51 @@ g72x_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 } /* g72x_read_d */
 
 static sf_count_t
-g72x_seek (SF_PRIVATE *psf, int UNUSED (mode), sf_count_t UNUSED (offset))
-{
-	psf_log_printf (psf, "seek unsupported\n") ;
+g72x_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
+{	BUF_UNION	ubuf ;
+	G72x_PRIVATE *pg72x ;
+	sf_count_t	current, frame, block ;
+	int			count, len ;
+
+	if ((pg72x = psf->codec_data) == NULL || mode != SFM_READ || psf->checkpoints == NULL)
+	{	psf->error = SFE_BAD_SEEK ;
+		return	PSF_SEEK_ERROR ;
+		} ;
+
+	current = (sf_count_t) (pg72x->block_curr - 1) * pg72x->samplesperblock + pg72x->sample_curr ;
 
-	/*	No simple solution. To do properly, would need to seek
-	**	to start of file and decode everything up to seek position.
-	**	Maybe implement SEEK_SET to 0 only?
+	/*
+	**	The decoder state depends on all the blocks before, so start from the
+	**	last checkpoint before the target, unless the current position is
+	**	closer.
 	*/
-	return 0 ;
+	frame = psf_checkpoints_find (psf->checkpoints, offset, NULL) ;
+	if (offset < current || frame > current)
+	{	if ((frame = psf_checkpoints_find (psf->checkpoints, offset, pg72x->private)) < 0)
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
 
-/*
-**		G72x_PRIVATE	*pg72x ;
-**		int			newblock, newsample, sample_curr ;
-**
-**		if (psf->codec_data == NULL)
-**			return 0 ;
-**		pg72x = (G72x_PRIVATE*) psf->codec_data ;
-**
-**		if (! (psf->datalength && psf->dataoffset))
-**		{	psf->error = SFE_BAD_SEEK ;
-**			return	PSF_SEEK_ERROR ;
-**			} ;
-**
-**		sample_curr = (8 * psf->datalength) / G721_32_BITS_PER_SAMPLE ;
-**
-**		switch (whence)
-**		{	case SEEK_SET :
-**					if (offset < 0 || offset > sample_curr)
-**					{	psf->error = SFE_BAD_SEEK ;
-**						return	PSF_SEEK_ERROR ;
-**						} ;
-**					newblock  = offset / pg72x->samplesperblock ;
-**					newsample = offset % pg72x->samplesperblock ;
-**					break ;
-**
-**			case SEEK_CUR :
-**					if (psf->current + offset < 0 || psf->current + offset > sample_curr)
-**					{	psf->error = SFE_BAD_SEEK ;
-**						return	PSF_SEEK_ERROR ;
-**						} ;
-**					newblock  = (8 * (psf->current + offset)) / pg72x->samplesperblock ;
-**					newsample = (8 * (psf->current + offset)) % pg72x->samplesperblock ;
-**					break ;
-**
-**			case SEEK_END :
-**					if (offset > 0 || sample_curr + offset < 0)
-**					{	psf->error = SFE_BAD_SEEK ;
-**						return	PSF_SEEK_ERROR ;
-**						} ;
-**					newblock  = (sample_curr + offset) / pg72x->samplesperblock ;
-**					newsample = (sample_curr + offset) % pg72x->samplesperblock ;
-**					break ;
-**
-**			default :
-**					psf->error = SFE_BAD_SEEK ;
-**					return	PSF_SEEK_ERROR ;
-**			} ;
-**
-**		if (psf->file.mode == SFM_READ)
-**		{	psf_fseek (psf, psf->dataoffset + newblock * pg72x->blocksize, SEEK_SET) ;
-**			pg72x->block_curr  = newblock ;
-**			psf_g72x_decode_block (psf, pg72x) ;
-**			pg72x->sample_curr = newsample ;
-**			}
-**		else
-**		{	/+* What to do about write??? *+/
-**			psf->error = SFE_BAD_SEEK ;
-**			return	PSF_SEEK_ERROR ;
-**			} ;
-**
-**		psf->current = newblock * pg72x->samplesperblock + newsample ;
-**		return psf->current ;
-**
-*/
+		block = frame / pg72x->samplesperblock ;
+		if (psf_fseek (psf, psf->dataoffset + block * pg72x->bytesperblock, SEEK_SET) < 0)
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
+
+		pg72x->block_curr = (int) block ;
+		psf_g72x_decode_block (psf, pg72x) ;
+		current = frame ;
+		} ;
+
+	while (current < offset)
+	{	len = (int) SF_MIN (offset - current, (sf_count_t) ARRAY_LEN (ubuf.sbuf)) ;
+		count = g72x_read_block (psf, pg72x, ubuf.sbuf, len) ;
+		current += count ;
+		if (count < len)
+			break ;
+		} ;
+
+	return current ;
 } /* g72x_seek */
 
 /*==========================================================================================
@@ -26,11 +26,53 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"thread_pool.h"
+
+/*
+**	With SFC_SET_THREADS blocks are decoded and encoded on worker threads,
+**	IMA_BATCH_BLOCKS per job. A block here is what one decode_block () or
+**	encode_block () call handles, which for AIFF is one block per channel.
+**
+**	Reading fetches a whole batch of blocks with one psf_fread () and decodes
+**	it before the first of them is needed. Writing collects full blocks and
+**	encodes a batch at a time. The encoder carries its step index (and for
+**	AIFF its predictor) from block to block, so each run of IMA_BATCH_BLOCKS
+**	after the first starts from the state reached by encoding the block before
+**	it from scratch. The state soon settles to the same values, but the file
+**	is not always byte for byte the serial one. It is the same for any number
+**	of threads of two or more.
+*/
+#define	IMA_BATCH_BLOCKS	32
+
+typedef struct
+{	PSF_THREAD_POOL	*pool ;
+	int				threads ;
+
+	int				blocks, used, next ;
+	int				blockbytes, blocksamples ;
+	int				short_read ;
+
+	unsigned char	*codes ;
+	short			*pcm ;
+	int				*errors ;	/* Synchronisation errors in each decoded block. */
+
+	short			*scratch ;	/* One block of 4 bit codes per worker. */
+	short			*last ;		/* Last block of the previous batch. */
+	int				have_last ;
+	int				previous [2], stepindx [2] ;
+} IMA_BATCH ;
 
 typedef struct IMA_ADPCM_PRIVATE_tag
 {	int 			(*decode_block) (SF_PRIVATE *psf, struct IMA_ADPCM_PRIVATE_tag *pima) ;
 	int 			(*encode_block) (SF_PRIVATE *psf, struct IMA_ADPCM_PRIVATE_tag *pima) ;
 
+	/* The coding itself, without file access or state in the struct. */
+	int				(*decode) (const struct IMA_ADPCM_PRIVATE_tag *pima, const unsigned char *block, short *samples) ;
+	void			(*encode) (const struct IMA_ADPCM_PRIVATE_tag *pima, int *previous, int *stepindx,
+							const short *samples, short *codes, unsigned char *block) ;
+
+	IMA_BATCH		*batch ;
+
 	int				channels, blocksize, samplesperblock, blocks ;
 	int				blockcount, samplecount ;
 	int				previous [2] ;
@@ -89,6 +131,21 @@ static int wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
 static int aiff_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
 static int aiff_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
 
+static int wavlike_ima_decode (const IMA_ADPCM_PRIVATE *pima, const unsigned char *block, short *samples) ;
+static void wavlike_ima_encode (const IMA_ADPCM_PRIVATE *pima, int *previous, int *stepindx,
+				const short *samples, short *codes, unsigned char *block) ;
+static int aiff_ima_decode (const IMA_ADPCM_PRIVATE *pima, const unsigned char *block, short *samples) ;
+static void aiff_ima_encode (const IMA_ADPCM_PRIVATE *pima, int *previous, int *stepindx,
+				const short *samples, short *codes, unsigned char *block) ;
+
+static int ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
+
+static IMA_BATCH * ima_batch_alloc (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
+static void ima_batch_free (IMA_BATCH *batch) ;
+static void ima_batch_reset (IMA_ADPCM_PRIVATE *pima) ;
+static int ima_batch_read (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
+static int ima_batch_flush (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima) ;
+
 
 static inline int
 clamp_ima_step_index (int indx)
@@ -161,12 +218,20 @@ ima_close	(SF_PRIVATE *psf)
 	{	/*	If a block has been partially assembled, write it out
 		**	as the final block.
 		*/
+		if (pima->batch != NULL)
+			ima_batch_flush (psf, pima) ;
+
 		if (pima->samplecount && pima->samplecount < pima->samplesperblock)
 			pima->encode_block (psf, pima) ;
 
 		psf->sf.frames = pima->samplesperblock * pima->blockcount / psf->sf.channels ;
 		} ;
 
+	if (pima->batch != NULL)
+	{	ima_batch_free (pima->batch) ;
+		pima->batch = NULL ;
+		} ;
+
 	return 0 ;
 } /* ima_close */
 
@@ -226,6 +291,7 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 					} ;
 
 				pima->decode_block = wavlike_ima_decode_block ;
+				pima->decode = wavlike_ima_decode ;
 
 				psf->sf.frames = pima->samplesperblock * pima->blocks ;
 				break ;
@@ -233,6 +299,7 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 		case SF_FORMAT_AIFF :
 				psf_log_printf (psf, "still need to check block count\n") ;
 				pima->decode_block = aiff_ima_decode_block ;
+				pima->decode = aiff_ima_decode ;
 				psf->sf.frames = pima->samplesperblock * pima->blocks / pima->channels ;
 				break ;
 
@@ -253,12 +320,7 @@ ima_reader_init (SF_PRIVATE *psf, int blockalign, int samplesperblock)
 
 static int
 aiff_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
-{	unsigned char *blockdata ;
-	int		chan, k, diff, bytecode, predictor ;
-	short	step, stepindx, *sampledata ;
-
-static int count = 0 ;
-count ++ ;
+{	int		k ;
 
 	pima->blockcount += pima->channels ;
 	pima->samplecount = 0 ;
@@ -268,13 +330,27 @@ count ++ ;
 		return 1 ;
 		} ;
 
+	if (ima_batch_read (psf, pima))
+		return 1 ;
+
 	if ((k = psf_fread (pima->block, 1, pima->blocksize * pima->channels, psf)) != pima->blocksize * pima->channels)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pima->blocksize) ;
 
+	aiff_ima_decode (pima, pima->block, pima->samples) ;
+
+	return 1 ;
+} /* aiff_ima_decode_block */
+
+static int
+aiff_ima_decode (const IMA_ADPCM_PRIVATE *pima, const unsigned char *block, short *samples)
+{	const unsigned char *blockdata ;
+	int		chan, k, diff, bytecode, predictor ;
+	short	step, stepindx, *sampledata ;
+
 	/* Read and check the block header. */
 	for (chan = 0 ; chan < pima->channels ; chan++)
-	{	blockdata = pima->block + chan * 34 ;
-		sampledata = pima->samples + chan ;
+	{	blockdata = block + chan * 34 ;
+		sampledata = samples + chan ;
 
 		/* Sign-extend from 16 bits to 32. */
 		predictor = (int) ((short) ((blockdata [0] << 8) | (blockdata [1] & 0x80))) ;
@@ -296,7 +372,7 @@ count ++ ;
 		for (k = 0 ; k < pima->samplesperblock ; k ++)
 		{	step = ima_step_size [stepindx] ;
 
-			bytecode = pima->samples [pima->channels * k + chan] ;
+			bytecode = samples [pima->channels * k + chan] ;
 
 			stepindx += ima_indx_adjust [bytecode] ;
 			stepindx = clamp_ima_step_index (stepindx) ;
@@ -313,31 +389,50 @@ count ++ ;
 			else if (predictor > 32767)
 				predictor = 32767 ;
 
-			pima->samples [pima->channels * k + chan] = predictor ;
+			samples [pima->channels * k + chan] = predictor ;
 			} ;
 		} ;
 
-	return 1 ;
-} /* aiff_ima_decode_block */
+	return 0 ;
+} /* aiff_ima_decode */
 
 static int
 aiff_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
+{	int		k ;
+
+	aiff_ima_encode (pima, pima->previous, pima->stepindx, pima->samples, NULL, pima->block) ;
+
+	/* Write the block to disk. */
+	if ((k = psf_fwrite (pima->block, 1, pima->channels * pima->blocksize, psf)) != pima->channels * pima->blocksize)
+		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pima->channels * pima->blocksize) ;
+
+	pima->samplecount = 0 ;
+	pima->blockcount ++ ;
+
+	return 1 ;
+} /* aiff_ima_encode_block */
+
+static void
+aiff_ima_encode (const IMA_ADPCM_PRIVATE *pima, int *previous, int *stepindx,
+				const short *samples, short * UNUSED (codes), unsigned char *block)
 {	int		chan, k, step, diff, vpdiff, blockindx, indx ;
 	short	bytecode, mask ;
 
+	memset (block, 0, pima->channels * pima->blocksize) ;
+
 	k = 0 ;
 	for (chan = 0 ; chan < pima->channels ; chan ++)
 	{	blockindx = chan * pima->blocksize ;
 		/* Encode the block header. */
-		pima->block [blockindx++] = (pima->previous [chan] >> 8) & 0xFF ;
-		pima->block [blockindx++] = (pima->previous [chan] & 0x80) + (pima->stepindx [chan] & 0x7F) ;
+		block [blockindx++] = (previous [chan] >> 8) & 0xFF ;
+		block [blockindx++] = (previous [chan] & 0x80) + (stepindx [chan] & 0x7F) ;
 
 		/* Encode the samples as 4 bit. */
 		for (indx = chan ; indx < pima->samplesperblock * pima->channels ; indx += pima->channels)
-		{	diff = pima->samples [indx] - pima->previous [chan] ;
+		{	diff = samples [indx] - previous [chan] ;
 
 			bytecode = 0 ;
-			step = ima_step_size [pima->stepindx [chan]] ;
+			step = ima_step_size [stepindx [chan]] ;
 			vpdiff = step >> 3 ;
 			if (diff < 0)
 			{	bytecode = 8 ;
@@ -356,37 +451,26 @@ aiff_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 
 			if (bytecode & 8)
 				vpdiff = -vpdiff ;
-			pima->previous [chan] += vpdiff ;
+			previous [chan] += vpdiff ;
 
-			if (pima->previous [chan] > 32767)
-				pima->previous [chan] = 32767 ;
-			else if (pima->previous [chan] < -32768)
-				pima->previous [chan] = -32768 ;
+			if (previous [chan] > 32767)
+				previous [chan] = 32767 ;
+			else if (previous [chan] < -32768)
+				previous [chan] = -32768 ;
 
-			pima->stepindx [chan] += ima_indx_adjust [bytecode] ;
+			stepindx [chan] += ima_indx_adjust [bytecode] ;
 
-			pima->stepindx [chan] = clamp_ima_step_index (pima->stepindx [chan]) ;
-			pima->block [blockindx] = (bytecode << (4 * k)) | pima->block [blockindx] ;
+			stepindx [chan] = clamp_ima_step_index (stepindx [chan]) ;
+			block [blockindx] = (bytecode << (4 * k)) | block [blockindx] ;
 			blockindx += k ;
 			k = 1 - k ;
 			} ;
 		} ;
-
-	/* Write the block to disk. */
-	if ((k = psf_fwrite (pima->block, 1, pima->channels * pima->blocksize, psf)) != pima->channels * pima->blocksize)
-		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pima->channels * pima->blocksize) ;
-
-	memset (pima->block, 0, pima->channels * pima->blocksize) ;
-	pima->samplecount = 0 ;
-	pima->blockcount ++ ;
-
-	return 1 ;
-} /* aiff_ima_encode_block */
+} /* aiff_ima_encode */
 
 static int
 wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
-{	int		chan, k, predictor, blockindx, indx, indxstart, diff ;
-	short	step, bytecode, stepindx [2] ;
+{	int		k ;
 
 	pima->blockcount ++ ;
 	pima->samplecount = 0 ;
@@ -396,24 +480,39 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 		return 1 ;
 		} ;
 
+	if (ima_batch_read (psf, pima))
+		return 1 ;
+
 	if ((k = psf_fread (pima->block, 1, pima->blocksize, psf)) != pima->blocksize)
 		psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pima->blocksize) ;
 
+	for (k = wavlike_ima_decode (pima, pima->block, pima->samples) ; k > 0 ; k--)
+		psf_log_printf (psf, "IMA ADPCM synchronisation error.\n") ;
+
+	return 1 ;
+} /* wavlike_ima_decode_block */
+
+/* Returns the number of channels with a bad block header. */
+static int
+wavlike_ima_decode (const IMA_ADPCM_PRIVATE *pima, const unsigned char *block, short *samples)
+{	int		chan, k, predictor, blockindx, indx, indxstart, diff, errors = 0 ;
+	short	step, bytecode, stepindx [2] ;
+
 	/* Read and check the block header. */
 
 	for (chan = 0 ; chan < pima->channels ; chan++)
-	{	predictor = pima->block [chan*4] | (pima->block [chan*4+1] << 8) ;
+	{	predictor = block [chan*4] | (block [chan*4+1] << 8) ;
 		if (predictor & 0x8000)
 			predictor -= 0x10000 ;
 
-		stepindx [chan] = pima->block [chan*4+2] ;
+		stepindx [chan] = block [chan*4+2] ;
 		stepindx [chan] = clamp_ima_step_index (stepindx [chan]) ;
 
 
-		if (pima->block [chan*4+3] != 0)
-			psf_log_printf (psf, "IMA ADPCM synchronisation error.\n") ;
+		if (block [chan*4+3] != 0)
+			errors ++ ;
 
-		pima->samples [chan] = predictor ;
+		samples [chan] = predictor ;
 		} ;
 
 	/*
@@ -428,10 +527,10 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	{	for (chan = 0 ; chan < pima->channels ; chan++)
 		{	indx = indxstart + chan ;
 			for (k = 0 ; k < 4 ; k++)
-			{	bytecode = pima->block [blockindx++] ;
-				pima->samples [indx] = bytecode & 0x0F ;
+			{	bytecode = block [blockindx++] ;
+				samples [indx] = bytecode & 0x0F ;
 				indx += pima->channels ;
-				pima->samples [indx] = (bytecode >> 4) & 0x0F ;
+				samples [indx] = (bytecode >> 4) & 0x0F ;
 				indx += pima->channels ;
 				} ;
 			} ;
@@ -443,10 +542,10 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	for (k = pima->channels ; k < (pima->samplesperblock * pima->channels) ; k ++)
 	{	chan = (pima->channels > 1) ? (k % 2) : 0 ;
 
-		bytecode = pima->samples [k] & 0xF ;
+		bytecode = samples [k] & 0xF ;
 
 		step = ima_step_size [stepindx [chan]] ;
-		predictor = pima->samples [k - pima->channels] ;
+		predictor = samples [k - pima->channels] ;
 
 		diff = step >> 3 ;
 		if (bytecode & 1)
@@ -468,26 +567,46 @@ wavlike_ima_decode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 		stepindx [chan] += ima_indx_adjust [bytecode] ;
 		stepindx [chan] = clamp_ima_step_index (stepindx [chan]) ;
 
-		pima->samples [k] = predictor ;
+		samples [k] = predictor ;
 		} ;
 
-	return 1 ;
-} /* wavlike_ima_decode_block */
+	return errors ;
+} /* wavlike_ima_decode */
 
 static int
 wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
+{	int		k ;
+
+	/* The codes overwrite the samples as they are used up. */
+	wavlike_ima_encode (pima, pima->previous, pima->stepindx, pima->samples, pima->samples, pima->block) ;
+
+	/* Write the block to disk. */
+
+	if ((k = psf_fwrite (pima->block, 1, pima->blocksize, psf)) != pima->blocksize)
+		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pima->blocksize) ;
+
+	memset (pima->samples, 0, pima->samplesperblock * sizeof (short)) ;
+	pima->samplecount = 0 ;
+	pima->blockcount ++ ;
+
+	return 1 ;
+} /* wavlike_ima_encode_block */
+
+static void
+wavlike_ima_encode (const IMA_ADPCM_PRIVATE *pima, int *previous, int *stepindx,
+				const short *samples, short *codes, unsigned char *block)
 {	int		chan, k, step, diff, vpdiff, blockindx, indx, indxstart ;
 	short	bytecode, mask ;
 
 	/* Encode the block header. */
 	for (chan = 0 ; chan < pima->channels ; chan++)
-	{	pima->block [chan*4]	= pima->samples [chan] & 0xFF ;
-		pima->block [chan*4+1]	= (pima->samples [chan] >> 8) & 0xFF ;
+	{	block [chan*4]		= samples [chan] & 0xFF ;
+		block [chan*4+1]	= (samples [chan] >> 8) & 0xFF ;
 
-		pima->block [chan*4+2] = pima->stepindx [chan] ;
-		pima->block [chan*4+3] = 0 ;
+		block [chan*4+2] = stepindx [chan] ;
+		block [chan*4+3] = 0 ;
 
-		pima->previous [chan] = pima->samples [chan] ;
+		previous [chan] = samples [chan] ;
 		} ;
 
 	/* Encode the samples as 4 bit. */
@@ -495,10 +614,10 @@ wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	for (k = pima->channels ; k < (pima->samplesperblock * pima->channels) ; k ++)
 	{	chan = (pima->channels > 1) ? (k % 2) : 0 ;
 
-		diff = pima->samples [k] - pima->previous [chan] ;
+		diff = samples [k] - previous [chan] ;
 
 		bytecode = 0 ;
-		step = ima_step_size [pima->stepindx [chan]] ;
+		step = ima_step_size [stepindx [chan]] ;
 		vpdiff = step >> 3 ;
 		if (diff < 0)
 		{	bytecode = 8 ;
@@ -516,19 +635,19 @@ wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 			} ;
 
 		if (bytecode & 8)
-			pima->previous [chan] -= vpdiff ;
+			previous [chan] -= vpdiff ;
 		else
-			pima->previous [chan] += vpdiff ;
+			previous [chan] += vpdiff ;
 
-		if (pima->previous [chan] > 32767)
-			pima->previous [chan] = 32767 ;
-		else if (pima->previous [chan] < -32768)
-			pima->previous [chan] = -32768 ;
+		if (previous [chan] > 32767)
+			previous [chan] = 32767 ;
+		else if (previous [chan] < -32768)
+			previous [chan] = -32768 ;
 
-		pima->stepindx [chan] += ima_indx_adjust [bytecode] ;
-		pima->stepindx [chan] = clamp_ima_step_index (pima->stepindx [chan]) ;
+		stepindx [chan] += ima_indx_adjust [bytecode] ;
+		stepindx [chan] = clamp_ima_step_index (stepindx [chan]) ;
 
-		pima->samples [k] = bytecode ;
+		codes [k] = bytecode ;
 		} ;
 
 	/* Pack the 4 bit encoded samples. */
@@ -540,27 +659,16 @@ wavlike_ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
 	{	for (chan = 0 ; chan < pima->channels ; chan++)
 		{	indx = indxstart + chan ;
 			for (k = 0 ; k < 4 ; k++)
-			{	pima->block [blockindx] = pima->samples [indx] & 0x0F ;
+			{	block [blockindx] = codes [indx] & 0x0F ;
 				indx += pima->channels ;
-				pima->block [blockindx] |= (pima->samples [indx] << 4) & 0xF0 ;
+				block [blockindx] |= (codes [indx] << 4) & 0xF0 ;
 				indx += pima->channels ;
 				blockindx ++ ;
 				} ;
 			} ;
 		indxstart += 8 * pima->channels ;
 		} ;
-
-	/* Write the block to disk. */
-
-	if ((k = psf_fwrite (pima->block, 1, pima->blocksize, psf)) != pima->blocksize)
-		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pima->blocksize) ;
-
-	memset (pima->samples, 0, pima->samplesperblock * sizeof (short)) ;
-	pima->samplecount = 0 ;
-	pima->blockcount ++ ;
-
-	return 1 ;
-} /* wavlike_ima_encode_block */
+} /* wavlike_ima_encode */
 
 static int
 ima_read_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima, short *ptr, int len)
@@ -718,6 +826,7 @@ aiff_ima_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (offset == 0)
 	{	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
 		pima->blockcount = 0 ;
+		ima_batch_reset (pima) ;
 		pima->decode_block (psf, pima) ;
 		pima->samplecount = 0 ;
 		return 0 ;
@@ -735,6 +844,7 @@ aiff_ima_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (mode == SFM_READ)
 	{	psf_fseek (psf, psf->dataoffset + newblockaiff * pima->blocksize, SEEK_SET) ;
 		pima->blockcount = newblockaiff ;
+		ima_batch_reset (pima) ;
 		pima->decode_block (psf, pima) ;
 		pima->samplecount = newsample ;
 		}
@@ -764,6 +874,7 @@ wavlike_ima_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (offset == 0)
 	{	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
 		pima->blockcount = 0 ;
+		ima_batch_reset (pima) ;
 		if (!pima->decode_block)
 			return PSF_SEEK_ERROR ;
 
@@ -783,6 +894,7 @@ wavlike_ima_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (mode == SFM_READ)
 	{	psf_fseek (psf, psf->dataoffset + newblock * pima->blocksize, SEEK_SET) ;
 		pima->blockcount = newblock ;
+		ima_batch_reset (pima) ;
 		pima->decode_block (psf, pima) ;
 		pima->samplecount = newsample ;
 		}
@@ -843,10 +955,12 @@ ima_writer_init (SF_PRIVATE *psf, int blockalign)
 	{	case SF_FORMAT_WAV :
 		case SF_FORMAT_W64 :
 				pima->encode_block = wavlike_ima_encode_block ;
+				pima->encode = wavlike_ima_encode ;
 				break ;
 
 		case SF_FORMAT_AIFF :
 				pima->encode_block = aiff_ima_encode_block ;
+				pima->encode = aiff_ima_encode ;
 				break ;
 
 		default :
@@ -881,7 +995,7 @@ ima_write_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima, const short *ptr, int
 		total = indx ;
 
 		if (pima->samplecount >= pima->samplesperblock)
-			pima->encode_block (psf, pima) ;
+			ima_encode_block (psf, pima) ;
 		} ;
 
 	return total ;
@@ -1001,3 +1115,233 @@ ima_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 	return total ;
 } /* ima_write_d */
 
+
+/*==========================================================================================
+** Batched decoding and encoding on worker threads.
+*/
+
+static IMA_BATCH *
+ima_batch_alloc (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
+{	IMA_BATCH *batch ;
+	int workers ;
+
+	if ((batch = calloc (1, sizeof (IMA_BATCH))) == NULL)
+		return NULL ;
+
+	batch->pool = psf_thread_pool_new (psf->threads) ;
+	batch->threads = psf->threads ;
+	workers = psf_thread_pool_workers (batch->pool) ;
+
+	batch->blocks = workers * IMA_BATCH_BLOCKS ;
+	batch->blockbytes = pima->blocksize ;
+	if (SF_CONTAINER (psf->sf.format) == SF_FORMAT_AIFF)
+		batch->blockbytes *= pima->channels ;
+	batch->blocksamples = pima->samplesperblock * pima->channels ;
+
+	batch->codes = malloc (batch->blocks * batch->blockbytes) ;
+	batch->pcm = malloc (batch->blocks * batch->blocksamples * sizeof (short)) ;
+	batch->errors = calloc (batch->blocks, sizeof (int)) ;
+	batch->scratch = malloc (workers * batch->blocksamples * sizeof (short)) ;
+	batch->last = calloc (batch->blocksamples, sizeof (short)) ;
+
+	if (batch->codes == NULL || batch->pcm == NULL || batch->errors == NULL
+			|| batch->scratch == NULL || batch->last == NULL)
+	{	ima_batch_free (batch) ;
+		return NULL ;
+		} ;
+
+	return batch ;
+} /* ima_batch_alloc */
+
+static void
+ima_batch_free (IMA_BATCH *batch)
+{
+	psf_thread_pool_free (batch->pool) ;
+	free (batch->codes) ;
+	free (batch->pcm) ;
+	free (batch->errors) ;
+	free (batch->scratch) ;
+	free (batch->last) ;
+	free (batch) ;
+} /* ima_batch_free */
+
+static void
+ima_batch_reset (IMA_ADPCM_PRIVATE *pima)
+{
+	if (pima->batch == NULL)
+		return ;
+
+	pima->batch->used = 0 ;
+	pima->batch->next = 0 ;
+	pima->batch->short_read = 0 ;
+} /* ima_batch_reset */
+
+static void
+ima_decode_job (void *data, int job, int UNUSED (worker))
+{	IMA_ADPCM_PRIVATE *pima = data ;
+	IMA_BATCH *batch = pima->batch ;
+	int k, end ;
+
+	end = SF_MIN ((job + 1) * IMA_BATCH_BLOCKS, batch->used) ;
+
+	for (k = job * IMA_BATCH_BLOCKS ; k < end ; k++)
+		batch->errors [k] = pima->decode (pima, batch->codes + k * batch->blockbytes, batch->pcm + k * batch->blocksamples) ;
+} /* ima_decode_job */
+
+/*
+**	Called from decode_block () once the block count has been checked. Returns 1
+**	with the next block in pima->samples, or 0 if the caller should read and
+**	decode the block itself.
+*/
+static int
+ima_batch_read (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
+{	IMA_BATCH *batch = pima->batch ;
+	sf_count_t available ;
+	int count, k ;
+
+	if (batch == NULL || batch->next >= batch->used)
+	{	if (psf->threads < 2)
+			return 0 ;
+
+		if (batch != NULL && batch->threads != psf->threads)
+		{	ima_batch_free (batch) ;
+			batch = pima->batch = NULL ;
+			} ;
+
+		if (batch == NULL && (batch = pima->batch = ima_batch_alloc (psf, pima)) == NULL)
+			return 0 ;
+
+		if (batch->short_read)
+			return 0 ;
+
+		/* Only whole blocks that the block count says are still to come. */
+		count = (pima->blocks - pima->blockcount) * pima->blocksize / batch->blockbytes + 1 ;
+		available = (psf->dataoffset + psf->datalength - psf_ftell (psf)) / batch->blockbytes ;
+		if (available < count)
+			count = (int) available ;
+		if (count > batch->blocks)
+			count = batch->blocks ;
+
+		if (count < 2)
+			return 0 ;
+
+		if ((k = psf_fread (batch->codes, 1, count * batch->blockbytes, psf)) != count * batch->blockbytes)
+		{	/* Leave the rest of the file to the block by block path. */
+			psf_fseek (psf, -k, SEEK_CUR) ;
+			batch->short_read = 1 ;
+			return 0 ;
+			} ;
+
+		batch->used = count ;
+		batch->next = 0 ;
+
+		psf_thread_pool_run (batch->pool, (count + IMA_BATCH_BLOCKS - 1) / IMA_BATCH_BLOCKS, ima_decode_job, pima) ;
+
+		/* Leave the last block where a block by block read would have left it. */
+		memcpy (pima->block, batch->codes + (count - 1) * batch->blockbytes, batch->blockbytes) ;
+		} ;
+
+	memcpy (pima->samples, batch->pcm + batch->next * batch->blocksamples, batch->blocksamples * sizeof (short)) ;
+
+	for (k = batch->errors [batch->next] ; k > 0 ; k--)
+		psf_log_printf (psf, "IMA ADPCM synchronisation error.\n") ;
+
+	batch->next ++ ;
+
+	return 1 ;
+} /* ima_batch_read */
+
+static void
+ima_encode_job (void *data, int job, int worker)
+{	IMA_ADPCM_PRIVATE *pima = data ;
+	IMA_BATCH *batch = pima->batch ;
+	const short *before ;
+	short *codes ;
+	int previous [2], stepindx [2], chan, k, start, end ;
+
+	start = job * IMA_BATCH_BLOCKS ;
+	end = SF_MIN (start + IMA_BATCH_BLOCKS, batch->used) ;
+	codes = batch->scratch + worker * batch->blocksamples ;
+
+	if (start == 0 && batch->have_last == 0)
+	{	for (chan = 0 ; chan < pima->channels ; chan++)
+		{	previous [chan] = pima->previous [chan] ;
+			stepindx [chan] = pima->stepindx [chan] ;
+			} ;
+		}
+	else
+	{	/* Warm up on the block before this run, output overwritten below. */
+		before = (start == 0) ? batch->last : batch->pcm + (start - 1) * batch->blocksamples ;
+		for (chan = 0 ; chan < pima->channels ; chan++)
+		{	previous [chan] = before [chan] ;
+			stepindx [chan] = 0 ;
+			} ;
+		pima->encode (pima, previous, stepindx, before, codes, batch->codes + start * batch->blockbytes) ;
+		} ;
+
+	for (k = start ; k < end ; k++)
+		pima->encode (pima, previous, stepindx, batch->pcm + k * batch->blocksamples, codes, batch->codes + k * batch->blockbytes) ;
+
+	if (end == batch->used)
+		for (chan = 0 ; chan < pima->channels ; chan++)
+		{	batch->previous [chan] = previous [chan] ;
+			batch->stepindx [chan] = stepindx [chan] ;
+			} ;
+} /* ima_encode_job */
+
+static int
+ima_batch_flush (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
+{	IMA_BATCH *batch = pima->batch ;
+	int chan, k, bytes ;
+
+	if (batch == NULL || batch->used == 0)
+		return 0 ;
+
+	psf_thread_pool_run (batch->pool, (batch->used + IMA_BATCH_BLOCKS - 1) / IMA_BATCH_BLOCKS, ima_encode_job, pima) ;
+
+	for (chan = 0 ; chan < pima->channels ; chan++)
+	{	pima->previous [chan] = batch->previous [chan] ;
+		pima->stepindx [chan] = batch->stepindx [chan] ;
+		} ;
+
+	memcpy (batch->last, batch->pcm + (batch->used - 1) * batch->blocksamples, batch->blocksamples * sizeof (short)) ;
+	batch->have_last = 1 ;
+
+	bytes = batch->used * batch->blockbytes ;
+	if ((k = psf_fwrite (batch->codes, 1, bytes, psf)) != bytes)
+		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, bytes) ;
+
+	pima->blockcount += batch->used ;
+	batch->used = 0 ;
+
+	return 1 ;
+} /* ima_batch_flush */
+
+static int
+ima_encode_block (SF_PRIVATE *psf, IMA_ADPCM_PRIVATE *pima)
+{	IMA_BATCH *batch = pima->batch ;
+
+	if (batch != NULL && batch->threads != psf->threads)
+	{	ima_batch_flush (psf, pima) ;
+		ima_batch_free (batch) ;
+		batch = pima->batch = NULL ;
+		} ;
+
+	/* Without the memory for a batch, encode block by block. */
+	if (batch == NULL && psf->threads > 1)
+		batch = pima->batch = ima_batch_alloc (psf, pima) ;
+
+	if (batch == NULL)
+		return pima->encode_block (psf, pima) ;
+
+	memcpy (batch->pcm + batch->used * batch->blocksamples, pima->samples, batch->blocksamples * sizeof (short)) ;
+	batch->used ++ ;
+
+	memset (pima->samples, 0, batch->blocksamples * sizeof (short)) ;
+	pima->samplecount = 0 ;
+
+	if (batch->used >= batch->blocks)
+		ima_batch_flush (psf, pima) ;
+
+	return 1 ;
+} /* ima_encode_block */
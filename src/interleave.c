@@ -19,6 +19,7 @@
 #include	"sfendian.h"
 
 #include	<stdlib.h>
+#include	<string.h>
 
 #include	"sndfile.h"
 #include	"common.h"
@@ -297,3 +298,200 @@ interleave_seek	(SF_PRIVATE * UNUSED (psf), int UNUSED (mode), sf_count_t sample
 	return samples_from_start ;
 } /* interleave_seek */
 
+
+/*==============================================================================
+**	Transposition between an interleaved buffer and per channel buffers for
+**	the sf_readf_*_planar () and sf_writef_*_planar () functions. The
+**	interleaved side is one of the small buffers those functions loop over,
+**	so it stays in cache. The channels are done a block at a time so that
+**	each pass only writes to (or reads from) a few channel buffers, rather
+**	than touching every one of them for each frame.
+**
+**	Channel buffer c is addressed as items of itemsize bytes, with frame k
+**	at item (offset + k * stride).
+*/
+
+#define		PLANAR_CHANNEL_BLOCK	8
+
+#define		PLANAR_ITEM(ptr, itemsize, index)	(((unsigned char *) (ptr)) + (itemsize) * (index))
+
+static void
+deinterleave_block (const unsigned char *src, void * const *dest, int itemsize, int channels,
+					int first, int last, sf_count_t offset, sf_count_t stride, int frames)
+{	int ch, k ;
+
+	/* Constant sizes so memcpy () becomes a plain load and store. */
+	switch (itemsize)
+	{	case 2 :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (PLANAR_ITEM (dest [ch], 2, offset + k * stride), src + 2 * (k * channels + ch), 2) ;
+			break ;
+
+		case 4 :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (PLANAR_ITEM (dest [ch], 4, offset + k * stride), src + 4 * (k * channels + ch), 4) ;
+			break ;
+
+		case 8 :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (PLANAR_ITEM (dest [ch], 8, offset + k * stride), src + 8 * (k * channels + ch), 8) ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (PLANAR_ITEM (dest [ch], itemsize, offset + k * stride), src + itemsize * (k * channels + ch), itemsize) ;
+			break ;
+		} ;
+} /* deinterleave_block */
+
+static void
+interleave_block (const void * const *src, unsigned char *dest, int itemsize, int channels,
+					int first, int last, sf_count_t offset, sf_count_t stride, int frames)
+{	int ch, k ;
+
+	switch (itemsize)
+	{	case 2 :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (dest + 2 * (k * channels + ch), PLANAR_ITEM (src [ch], 2, offset + k * stride), 2) ;
+			break ;
+
+		case 4 :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (dest + 4 * (k * channels + ch), PLANAR_ITEM (src [ch], 4, offset + k * stride), 4) ;
+			break ;
+
+		case 8 :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (dest + 8 * (k * channels + ch), PLANAR_ITEM (src [ch], 8, offset + k * stride), 8) ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++)
+				for (ch = first ; ch < last ; ch++)
+					memcpy (dest + itemsize * (k * channels + ch), PLANAR_ITEM (src [ch], itemsize, offset + k * stride), itemsize) ;
+			break ;
+		} ;
+} /* interleave_block */
+
+void
+psf_deinterleave (const void *src, void * const *dest, int itemsize, int channels, sf_count_t offset, sf_count_t stride, int frames)
+{	int first, last ;
+
+	for (first = 0 ; first < channels ; first = last)
+	{	last = SF_MIN (first + PLANAR_CHANNEL_BLOCK, channels) ;
+		deinterleave_block (src, dest, itemsize, channels, first, last, offset, stride, frames) ;
+		} ;
+} /* psf_deinterleave */
+
+void
+psf_interleave (const void * const *src, void *dest, int itemsize, int channels, sf_count_t offset, sf_count_t stride, int frames)
+{	int first, last ;
+
+	for (first = 0 ; first < channels ; first = last)
+	{	last = SF_MIN (first + PLANAR_CHANNEL_BLOCK, channels) ;
+		interleave_block (src, dest, itemsize, channels, first, last, offset, stride, frames) ;
+		} ;
+} /* psf_interleave */
+
+void
+psf_planar_clear (void * const *dest, int itemsize, int channels, sf_count_t offset, sf_count_t stride, sf_count_t frames)
+{	sf_count_t k ;
+	int ch ;
+
+	for (ch = 0 ; ch < channels ; ch++)
+	{	if (stride == 1)
+		{	memset (PLANAR_ITEM (dest [ch], itemsize, offset), 0, itemsize * frames) ;
+			continue ;
+			} ;
+		for (k = 0 ; k < frames ; k++)
+			memset (PLANAR_ITEM (dest [ch], itemsize, offset + k * stride), 0, itemsize) ;
+		} ;
+} /* psf_planar_clear */
+
+/*==============================================================================
+**	Reading a subset of the channels (SFC_SET_READ_CHANNELS). Codecs with a
+**	fixed number of bytes per sample read their raw data with
+**	psf_fread_samples () instead of psf_fread (). When a channel list is set,
+**	whole frames are read into a local buffer and only the wanted samples are
+**	copied to ptr, so the codec converts just those. The item count is in
+**	samples of the selected channels and must be a multiple of their number.
+*/
+
+static void
+select_samples (const unsigned char *src, unsigned char *dest, int bytes, int channels,
+					const int *map, int count, sf_count_t frames)
+{	sf_count_t k ;
+	int ch ;
+
+	switch (bytes)
+	{	case 1 :
+			for (k = 0 ; k < frames ; k++, src += channels, dest += count)
+				for (ch = 0 ; ch < count ; ch++)
+					dest [ch] = src [map [ch]] ;
+			break ;
+
+		case 2 :
+			for (k = 0 ; k < frames ; k++, src += 2 * channels, dest += 2 * count)
+				for (ch = 0 ; ch < count ; ch++)
+					memcpy (dest + 2 * ch, src + 2 * map [ch], 2) ;
+			break ;
+
+		case 4 :
+			for (k = 0 ; k < frames ; k++, src += 4 * channels, dest += 4 * count)
+				for (ch = 0 ; ch < count ; ch++)
+					memcpy (dest + 4 * ch, src + 4 * map [ch], 4) ;
+			break ;
+
+		case 8 :
+			for (k = 0 ; k < frames ; k++, src += 8 * channels, dest += 8 * count)
+				for (ch = 0 ; ch < count ; ch++)
+					memcpy (dest + 8 * ch, src + 8 * map [ch], 8) ;
+			break ;
+
+		default :
+			for (k = 0 ; k < frames ; k++, src += bytes * channels, dest += bytes * count)
+				for (ch = 0 ; ch < count ; ch++)
+					memcpy (dest + bytes * ch, src + bytes * map [ch], bytes) ;
+			break ;
+		} ;
+} /* select_samples */
+
+sf_count_t
+psf_fread_samples (void *ptr, sf_count_t bytes, sf_count_t items, SF_PRIVATE *psf)
+{	BUF_UNION	ubuf ;
+	sf_count_t	frames, chunk, want, readcount, total = 0 ;
+	int			count ;
+
+	if (psf->read_channels == NULL)
+		return psf_fread (ptr, bytes, items, psf) ;
+
+	count = psf->read_channel_count ;
+	frames = items / count ;
+
+	/* SF_MAX_CHANNELS doubles fit, so this is at least one frame. */
+	chunk = sizeof (ubuf) / (bytes * psf->sf.channels) ;
+
+	while (total < frames)
+	{	want = SF_MIN (chunk, frames - total) ;
+
+		readcount = psf_fread (ubuf.ucbuf, bytes * psf->sf.channels, want, psf) ;
+		if (readcount <= 0)
+			break ;
+
+		select_samples (ubuf.ucbuf, ((unsigned char *) ptr) + total * count * bytes, bytes,
+						psf->sf.channels, psf->read_channels, count, readcount) ;
+		total += readcount ;
+
+		if (readcount < want)
+			break ;
+		} ;
+
+	return total * count ;
+} /* psf_fread_samples */
@@ -27,7 +27,28 @@
 #include	"sfendian.h"
 #include	"common.h"
 #include	"wavlike.h"
+#include	"thread_pool.h"
 
+/*
+**	With SFC_SET_THREADS blocks are decoded and encoded on worker threads,
+**	MSADPCM_BATCH_BLOCKS per job. Each block carries its own predictor state
+**	in its header, so a batch gives exactly the same samples and bytes as
+**	coding the blocks one at a time.
+*/
+#define	MSADPCM_BATCH_BLOCKS	32
+
+typedef struct
+{	PSF_THREAD_POOL	*pool ;
+	int				threads ;
+
+	int				blocks, used, next ;
+	int				blocksamples ;
+	int				short_read ;
+
+	unsigned char	*codes ;
+	short			*pcm ;
+	int				*errors ;	/* First bad block predictor in each decoded block, or -1. */
+} MSADPCM_BATCH ;
 
 typedef struct
 {	int				channels, blocksize, samplesperblock, blocks, dataremaining ;
@@ -36,6 +57,7 @@ typedef struct
 	sf_count_t		samplecount ;
 	short			*samples ;
 	unsigned char	*block ;
+	MSADPCM_BATCH	*batch ;
 	short			dummydata [] ; /* ISO C99 struct flexible array. */
 } MSADPCM_PRIVATE ;
 
@@ -90,9 +112,11 @@ static int AdaptCoeff2 [WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT] =
 */
 
 static	int	msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms) ;
+static	int	msadpcm_decode			(const MSADPCM_PRIVATE *pms, const unsigned char *block, short *samples) ;
 static sf_count_t msadpcm_read_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, short *ptr, int len) ;
 
 static	int	msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms) ;
+static	void	msadpcm_encode		(const MSADPCM_PRIVATE *pms, short *samples, unsigned char *block) ;
 static sf_count_t msadpcm_write_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, const short *ptr, int len) ;
 
 static sf_count_t	msadpcm_read_s	(SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
@@ -110,6 +134,13 @@ static	int	msadpcm_close	(SF_PRIVATE *psf) ;
 
 static	void	choose_predictor (unsigned int channels, short *data, int *bpred, int *idelta) ;
 
+static MSADPCM_BATCH * msadpcm_batch_alloc (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms) ;
+static void	msadpcm_batch_free	(MSADPCM_BATCH *batch) ;
+static void	msadpcm_batch_reset	(MSADPCM_PRIVATE *pms) ;
+static int	msadpcm_batch_read	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms) ;
+static int	msadpcm_batch_write	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms) ;
+static void	msadpcm_batch_flush	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms) ;
+
 /*============================================================================================
 ** MS ADPCM Read Functions.
 */
@@ -195,12 +226,10 @@ wavlike_msadpcm_init	(SF_PRIVATE *psf, int blockalign, int samplesperblock)
 
 
 static inline short
-msadpcm_get_bpred (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, unsigned char value)
+msadpcm_get_bpred (unsigned char value, int *bad)
 {	if (value >= WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT)
-	{	if (pms->sync_error == 0)
-		{	pms->sync_error = 1 ;
-			psf_log_printf (psf, "MS ADPCM synchronisation error (%u should be < %u).\n", value, WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT) ;
-			} ;
+	{	if (*bad < 0)
+			*bad = value ;
 		return 0 ;
 		} ;
 	return value ;
@@ -209,12 +238,7 @@ msadpcm_get_bpred (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, unsigned char value)
 
 static int
 msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
-{	int		chan, k, blockindx, sampleindx ;
-	short	bytecode, bpred [2], chan_idelta [2] ;
-
-	int predict ;
-	int current ;
-	int idelta ;
+{	int		k, bad ;
 
 	pms->blockcount ++ ;
 	pms->samplecount = 0 ;
@@ -224,36 +248,57 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		return 1 ;
 		} ;
 
+	if (msadpcm_batch_read (psf, pms))
+		return 0 ;
+
 	if ((k = psf_fread (pms->block, 1, pms->blocksize, psf)) != pms->blocksize)
 	{	psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pms->blocksize) ;
 		if (k <= 0)
 			return 1 ;
 		} ;
 
+	if ((bad = msadpcm_decode (pms, pms->block, pms->samples)) >= 0 && pms->sync_error == 0)
+	{	pms->sync_error = 1 ;
+		psf_log_printf (psf, "MS ADPCM synchronisation error (%u should be < %u).\n", bad, WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT) ;
+		} ;
+
+	return 0 ;
+} /* msadpcm_decode_block */
+
+/* Returns the first out of range block predictor, or -1 if there was none. */
+static int
+msadpcm_decode	(const MSADPCM_PRIVATE *pms, const unsigned char *block, short *samples)
+{	int		chan, k, blockindx, sampleindx, bad = -1 ;
+	short	bytecode, bpred [2], chan_idelta [2] ;
+
+	int predict ;
+	int current ;
+	int idelta ;
+
 	/* Read and check the block header. */
 
 	if (pms->channels == 1)
-	{	bpred [0] = msadpcm_get_bpred (psf, pms, pms->block [0]) ;
+	{	bpred [0] = msadpcm_get_bpred (block [0], &bad) ;
 
-		chan_idelta [0] = pms->block [1] | (pms->block [2] << 8) ;
+		chan_idelta [0] = block [1] | (block [2] << 8) ;
 		chan_idelta [1] = 0 ;
 
-		pms->samples [1] = pms->block [3] | (pms->block [4] << 8) ;
-		pms->samples [0] = pms->block [5] | (pms->block [6] << 8) ;
+		samples [1] = block [3] | (block [4] << 8) ;
+		samples [0] = block [5] | (block [6] << 8) ;
 		blockindx = 7 ;
 		}
 	else
-	{	bpred [0] = msadpcm_get_bpred (psf, pms, pms->block [0]) ;
-		bpred [1] = msadpcm_get_bpred (psf, pms, pms->block [1]) ;
+	{	bpred [0] = msadpcm_get_bpred (block [0], &bad) ;
+		bpred [1] = msadpcm_get_bpred (block [1], &bad) ;
 
-		chan_idelta [0] = pms->block [2] | (pms->block [3] << 8) ;
-		chan_idelta [1] = pms->block [4] | (pms->block [5] << 8) ;
+		chan_idelta [0] = block [2] | (block [3] << 8) ;
+		chan_idelta [1] = block [4] | (block [5] << 8) ;
 
-		pms->samples [2] = pms->block [6] | (pms->block [7] << 8) ;
-		pms->samples [3] = pms->block [8] | (pms->block [9] << 8) ;
+		samples [2] = block [6] | (block [7] << 8) ;
+		samples [3] = block [8] | (block [9] << 8) ;
 
-		pms->samples [0] = pms->block [10] | (pms->block [11] << 8) ;
-		pms->samples [1] = pms->block [12] | (pms->block [13] << 8) ;
+		samples [0] = block [10] | (block [11] << 8) ;
+		samples [1] = block [12] | (block [13] << 8) ;
 
 		blockindx = 14 ;
 		} ;
@@ -275,9 +320,9 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 
 	sampleindx = 2 * pms->channels ;
 	while (blockindx < pms->blocksize)
-	{	bytecode = pms->block [blockindx++] ;
-		pms->samples [sampleindx++] = (bytecode >> 4) & 0x0F ;
-		pms->samples [sampleindx++] = bytecode & 0x0F ;
+	{	bytecode = block [blockindx++] ;
+		samples [sampleindx++] = (bytecode >> 4) & 0x0F ;
+		samples [sampleindx++] = bytecode & 0x0F ;
 		} ;
 
 	/* Decode the encoded 4 bit samples. */
@@ -285,7 +330,7 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 	for (k = 2 * pms->channels ; k < (pms->samplesperblock * pms->channels) ; k ++)
 	{	chan = (pms->channels > 1) ? (k % 2) : 0 ;
 
-		bytecode = pms->samples [k] & 0xF ;
+		bytecode = samples [k] & 0xF ;
 
 		/* Compute next Adaptive Scale Factor (ASF) */
 		idelta = chan_idelta [chan] ;
@@ -295,8 +340,8 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		if (bytecode & 0x8)
 			bytecode -= 0x10 ;
 
-		predict = ((pms->samples [k - pms->channels] * AdaptCoeff1 [bpred [chan]])
-					+ (pms->samples [k - 2 * pms->channels] * AdaptCoeff2 [bpred [chan]])) >> 8 ; /* => / 256 => FIXED_POINT_COEFF_BASE == 256 */
+		predict = ((samples [k - pms->channels] * AdaptCoeff1 [bpred [chan]])
+					+ (samples [k - 2 * pms->channels] * AdaptCoeff2 [bpred [chan]])) >> 8 ; /* => / 256 => FIXED_POINT_COEFF_BASE == 256 */
 		current = (bytecode * idelta) + predict ;
 
 		if (current > 32767)
@@ -304,11 +349,11 @@ msadpcm_decode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		else if (current < -32768)
 			current = -32768 ;
 
-		pms->samples [k] = current ;
+		samples [k] = current ;
 		} ;
 
-	return 0 ;
-} /* msadpcm_decode_block */
+	return bad ;
+} /* msadpcm_decode */
 
 static sf_count_t
 msadpcm_read_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, short *ptr, int len)
@@ -473,6 +518,7 @@ msadpcm_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (offset == 0)
 	{	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
 		pms->blockcount = 0 ;
+		msadpcm_batch_reset (pms) ;
 		msadpcm_decode_block (psf, pms) ;
 		pms->samplecount = 0 ;
 		return 0 ;
@@ -489,6 +535,7 @@ msadpcm_seek	(SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (mode == SFM_READ)
 	{	psf_fseek (psf, psf->dataoffset + newblock * pms->blocksize, SEEK_SET) ;
 		pms->blockcount = newblock ;
+		msadpcm_batch_reset (pms) ;
 		msadpcm_decode_block (psf, pms) ;
 		pms->samplecount = newsample ;
 		}
@@ -518,23 +565,46 @@ wavlike_msadpcm_write_adapt_coeffs	(SF_PRIVATE *psf)
 
 static int
 msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	int		k ;
+
+	if (msadpcm_batch_write (psf, pms))
+		return 1 ;
+
+	msadpcm_encode (pms, pms->samples, pms->block) ;
+
+	/* Write the block to disk. */
+
+	if ((k = psf_fwrite (pms->block, 1, pms->blocksize, psf)) != pms->blocksize)
+		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pms->blocksize) ;
+
+	memset (pms->samples, 0, pms->samplesperblock * sizeof (short)) ;
+
+	pms->blockcount ++ ;
+	pms->samplecount = 0 ;
+
+	return 1 ;
+} /* msadpcm_encode_block */
+
+/* Encodes one block, leaving the decoder's view of each sample in samples. */
+static void
+msadpcm_encode	(const MSADPCM_PRIVATE *pms, short *samples, unsigned char *block)
 {	unsigned int	blockindx ;
 	unsigned char	byte ;
 	int				chan, k, predict, bpred [2] = { 0 }, idelta [2] = { 0 },
 					errordelta, newsamp ;
 
-	choose_predictor (pms->channels, pms->samples, bpred, idelta) ;
+	choose_predictor (pms->channels, samples, bpred, idelta) ;
 
 	/* Write the block header. */
 
 	if (pms->channels == 1)
-	{	pms->block [0]	= bpred [0] ;
-		pms->block [1]	= idelta [0] & 0xFF ;
-		pms->block [2]	= idelta [0] >> 8 ;
-		pms->block [3]	= pms->samples [1] & 0xFF ;
-		pms->block [4]	= pms->samples [1] >> 8 ;
-		pms->block [5]	= pms->samples [0] & 0xFF ;
-		pms->block [6]	= pms->samples [0] >> 8 ;
+	{	block [0]	= bpred [0] ;
+		block [1]	= idelta [0] & 0xFF ;
+		block [2]	= idelta [0] >> 8 ;
+		block [3]	= samples [1] & 0xFF ;
+		block [4]	= samples [1] >> 8 ;
+		block [5]	= samples [0] & 0xFF ;
+		block [6]	= samples [0] >> 8 ;
 
 		blockindx = 7 ;
 		byte = 0 ;
@@ -542,8 +612,8 @@ msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		/* Encode the samples as 4 bit. */
 
 		for (k = 2 ; k < pms->samplesperblock ; k++)
-		{	predict = (pms->samples [k-1] * AdaptCoeff1 [bpred [0]] + pms->samples [k-2] * AdaptCoeff2 [bpred [0]]) >> 8 ;
-			errordelta = (pms->samples [k] - predict) / idelta [0] ;
+		{	predict = (samples [k-1] * AdaptCoeff1 [bpred [0]] + samples [k-2] * AdaptCoeff2 [bpred [0]]) >> 8 ;
+			errordelta = (samples [k] - predict) / idelta [0] ;
 			if (errordelta < -8)
 				errordelta = -8 ;
 			else if (errordelta > 7)
@@ -558,35 +628,35 @@ msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 
 			byte = (byte << 4) | (errordelta & 0xF) ;
 			if (k % 2)
-			{	pms->block [blockindx++] = byte ;
+			{	block [blockindx++] = byte ;
 				byte = 0 ;
 				} ;
 
 			idelta [0] = (idelta [0] * AdaptationTable [errordelta]) >> 8 ;
 			if (idelta [0] < 16)
 				idelta [0] = 16 ;
-			pms->samples [k] = newsamp ;
+			samples [k] = newsamp ;
 			} ;
 		}
 	else
 	{	/* Stereo file. */
-		pms->block [0]	= bpred [0] ;
-		pms->block [1]	= bpred [1] ;
+		block [0]	= bpred [0] ;
+		block [1]	= bpred [1] ;
 
-		pms->block [2]	= idelta [0] & 0xFF ;
-		pms->block [3]	= idelta [0] >> 8 ;
-		pms->block [4]	= idelta [1] & 0xFF ;
-		pms->block [5]	= idelta [1] >> 8 ;
+		block [2]	= idelta [0] & 0xFF ;
+		block [3]	= idelta [0] >> 8 ;
+		block [4]	= idelta [1] & 0xFF ;
+		block [5]	= idelta [1] >> 8 ;
 
-		pms->block [6]	= pms->samples [2] & 0xFF ;
-		pms->block [7]	= pms->samples [2] >> 8 ;
-		pms->block [8]	= pms->samples [3] & 0xFF ;
-		pms->block [9]	= pms->samples [3] >> 8 ;
+		block [6]	= samples [2] & 0xFF ;
+		block [7]	= samples [2] >> 8 ;
+		block [8]	= samples [3] & 0xFF ;
+		block [9]	= samples [3] >> 8 ;
 
-		pms->block [10]	= pms->samples [0] & 0xFF ;
-		pms->block [11]	= pms->samples [0] >> 8 ;
-		pms->block [12]	= pms->samples [1] & 0xFF ;
-		pms->block [13]	= pms->samples [1] >> 8 ;
+		block [10]	= samples [0] & 0xFF ;
+		block [11]	= samples [0] >> 8 ;
+		block [12]	= samples [1] & 0xFF ;
+		block [13]	= samples [1] >> 8 ;
 
 		blockindx = 14 ;
 		byte = 0 ;
@@ -595,8 +665,8 @@ msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 		for (k = 4 ; k < 2 * pms->samplesperblock ; k++)
 		{	chan = k & 1 ;
 
-			predict = (pms->samples [k-2] * AdaptCoeff1 [bpred [chan]] + pms->samples [k-4] * AdaptCoeff2 [bpred [chan]]) >> 8 ;
-			errordelta = (pms->samples [k] - predict) / idelta [chan] ;
+			predict = (samples [k-2] * AdaptCoeff1 [bpred [chan]] + samples [k-4] * AdaptCoeff2 [bpred [chan]]) >> 8 ;
+			errordelta = (samples [k] - predict) / idelta [chan] ;
 
 
 			if (errordelta < -8)
@@ -614,29 +684,17 @@ msadpcm_encode_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
 			byte = (byte << 4) | (errordelta & 0xF) ;
 
 			if (chan)
-			{	pms->block [blockindx++] = byte ;
+			{	block [blockindx++] = byte ;
 				byte = 0 ;
 				} ;
 
 			idelta [chan] = (idelta [chan] * AdaptationTable [errordelta]) >> 8 ;
 			if (idelta [chan] < 16)
 				idelta [chan] = 16 ;
-			pms->samples [k] = newsamp ;
+			samples [k] = newsamp ;
 			} ;
 		} ;
-
-	/* Write the block to disk. */
-
-	if ((k = psf_fwrite (pms->block, 1, pms->blocksize, psf)) != pms->blocksize)
-		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, pms->blocksize) ;
-
-	memset (pms->samples, 0, pms->samplesperblock * sizeof (short)) ;
-
-	pms->blockcount ++ ;
-	pms->samplecount = 0 ;
-
-	return 1 ;
-} /* msadpcm_encode_block */
+} /* msadpcm_encode */
 
 static sf_count_t
 msadpcm_write_block	(SF_PRIVATE *psf, MSADPCM_PRIVATE *pms, const short *ptr, int len)
@@ -785,10 +843,22 @@ msadpcm_close	(SF_PRIVATE *psf)
 		**  re-write the header.
 		*/
 
+		/* Batched blocks first, so the last partial block goes after them. */
+		msadpcm_batch_flush (psf, pms) ;
+		if (pms->batch != NULL)
+		{	msadpcm_batch_free (pms->batch) ;
+			pms->batch = NULL ;
+			} ;
+
 		if (pms->samplecount && pms->samplecount < pms->samplesperblock)
 			msadpcm_encode_block (psf, pms) ;
 		} ;
 
+	if (pms->batch != NULL)
+	{	msadpcm_batch_free (pms->batch) ;
+		pms->batch = NULL ;
+		} ;
+
 	return 0 ;
 } /* msadpcm_close */
 
@@ -849,3 +919,200 @@ choose_predictor (unsigned int channels, short *data, int *block_pred, int *idel
 	return ;
 } /* choose_predictor */
 
+
+/*========================================================================================
+** Batched decoding and encoding on worker threads.
+*/
+
+static MSADPCM_BATCH *
+msadpcm_batch_alloc (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	MSADPCM_BATCH *batch ;
+
+	if ((batch = calloc (1, sizeof (MSADPCM_BATCH))) == NULL)
+		return NULL ;
+
+	batch->pool = psf_thread_pool_new (psf->threads) ;
+	batch->threads = psf->threads ;
+
+	batch->blocks = psf_thread_pool_workers (batch->pool) * MSADPCM_BATCH_BLOCKS ;
+	batch->blocksamples = pms->samplesperblock * pms->channels ;
+
+	batch->codes = malloc (batch->blocks * pms->blocksize) ;
+	batch->pcm = malloc (batch->blocks * batch->blocksamples * sizeof (short)) ;
+	batch->errors = malloc (batch->blocks * sizeof (int)) ;
+
+	if (batch->codes == NULL || batch->pcm == NULL || batch->errors == NULL)
+	{	msadpcm_batch_free (batch) ;
+		return NULL ;
+		} ;
+
+	return batch ;
+} /* msadpcm_batch_alloc */
+
+static void
+msadpcm_batch_free (MSADPCM_BATCH *batch)
+{
+	psf_thread_pool_free (batch->pool) ;
+	free (batch->codes) ;
+	free (batch->pcm) ;
+	free (batch->errors) ;
+	free (batch) ;
+} /* msadpcm_batch_free */
+
+static void
+msadpcm_batch_reset (MSADPCM_PRIVATE *pms)
+{
+	if (pms->batch == NULL)
+		return ;
+
+	pms->batch->used = 0 ;
+	pms->batch->next = 0 ;
+	pms->batch->short_read = 0 ;
+} /* msadpcm_batch_reset */
+
+static void
+msadpcm_decode_job (void *data, int job, int UNUSED (worker))
+{	MSADPCM_PRIVATE *pms = data ;
+	MSADPCM_BATCH *batch = pms->batch ;
+	int k, end ;
+
+	end = SF_MIN ((job + 1) * MSADPCM_BATCH_BLOCKS, batch->used) ;
+
+	for (k = job * MSADPCM_BATCH_BLOCKS ; k < end ; k++)
+		batch->errors [k] = msadpcm_decode (pms, batch->codes + k * pms->blocksize, batch->pcm + k * batch->blocksamples) ;
+} /* msadpcm_decode_job */
+
+/*
+**	Called from msadpcm_decode_block () once the block count has been checked.
+**	Returns 1 with the next block in pms->samples, or 0 if the caller should
+**	read and decode the block itself.
+*/
+static int
+msadpcm_batch_read (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	MSADPCM_BATCH *batch = pms->batch ;
+	sf_count_t available ;
+	int count, k ;
+
+	if (batch == NULL || batch->next >= batch->used)
+	{	if (psf->threads < 2)
+			return 0 ;
+
+		if (batch != NULL && batch->threads != psf->threads)
+		{	msadpcm_batch_free (batch) ;
+			batch = pms->batch = NULL ;
+			} ;
+
+		if (batch == NULL && (batch = pms->batch = msadpcm_batch_alloc (psf, pms)) == NULL)
+			return 0 ;
+
+		if (batch->short_read)
+			return 0 ;
+
+		/* Only whole blocks that the block count says are still to come. */
+		count = pms->blocks - pms->blockcount + 1 ;
+		available = (psf->dataoffset + psf->datalength - psf_ftell (psf)) / pms->blocksize ;
+		if (available < count)
+			count = (int) available ;
+		if (count > batch->blocks)
+			count = batch->blocks ;
+
+		if (count < 2)
+			return 0 ;
+
+		if ((k = psf_fread (batch->codes, 1, count * pms->blocksize, psf)) != count * pms->blocksize)
+		{	/* Leave the rest of the file to the block by block path. */
+			psf_fseek (psf, -k, SEEK_CUR) ;
+			batch->short_read = 1 ;
+			return 0 ;
+			} ;
+
+		batch->used = count ;
+		batch->next = 0 ;
+
+		psf_thread_pool_run (batch->pool, (count + MSADPCM_BATCH_BLOCKS - 1) / MSADPCM_BATCH_BLOCKS, msadpcm_decode_job, pms) ;
+
+		/* Leave the last block where a block by block read would have left it. */
+		memcpy (pms->block, batch->codes + (count - 1) * pms->blocksize, pms->blocksize) ;
+		} ;
+
+	memcpy (pms->samples, batch->pcm + batch->next * batch->blocksamples, batch->blocksamples * sizeof (short)) ;
+
+	if ((k = batch->errors [batch->next]) >= 0 && pms->sync_error == 0)
+	{	pms->sync_error = 1 ;
+		psf_log_printf (psf, "MS ADPCM synchronisation error (%u should be < %u).\n", k, WAVLIKE_MSADPCM_ADAPT_COEFF_COUNT) ;
+		} ;
+
+	batch->next ++ ;
+
+	return 1 ;
+} /* msadpcm_batch_read */
+
+static void
+msadpcm_encode_job (void *data, int job, int UNUSED (worker))
+{	MSADPCM_PRIVATE *pms = data ;
+	MSADPCM_BATCH *batch = pms->batch ;
+	int k, end ;
+
+	end = SF_MIN ((job + 1) * MSADPCM_BATCH_BLOCKS, batch->used) ;
+
+	for (k = job * MSADPCM_BATCH_BLOCKS ; k < end ; k++)
+		msadpcm_encode (pms, batch->pcm + k * batch->blocksamples, batch->codes + k * pms->blocksize) ;
+} /* msadpcm_encode_job */
+
+/*
+**	Called from msadpcm_encode_block () with a full block in pms->samples.
+**	Returns 1 if the block was taken into the batch, 0 if the caller should
+**	encode it itself.
+*/
+static int
+msadpcm_batch_write (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	MSADPCM_BATCH *batch = pms->batch ;
+
+	if (batch == NULL)
+	{	/*
+		**	Batching starts with the first block. Without the memory for a batch,
+		**	or for the partial block written by msadpcm_close (), encode block by
+		**	block.
+		*/
+		if (psf->threads < 2 || pms->blockcount > 0)
+			return 0 ;
+		if ((batch = pms->batch = msadpcm_batch_alloc (psf, pms)) == NULL)
+			return 0 ;
+		} ;
+
+	memcpy (batch->pcm + batch->used * batch->blocksamples, pms->samples, batch->blocksamples * sizeof (short)) ;
+	batch->used ++ ;
+	pms->samplecount = 0 ;
+
+	if (batch->used >= batch->blocks)
+		msadpcm_batch_flush (psf, pms) ;
+
+	return 1 ;
+} /* msadpcm_batch_write */
+
+static void
+msadpcm_batch_flush (SF_PRIVATE *psf, MSADPCM_PRIVATE *pms)
+{	MSADPCM_BATCH *batch = pms->batch ;
+	const short *last ;
+	int k, bytes ;
+
+	if (batch == NULL || batch->used == 0)
+		return ;
+
+	psf_thread_pool_run (batch->pool, (batch->used + MSADPCM_BATCH_BLOCKS - 1) / MSADPCM_BATCH_BLOCKS, msadpcm_encode_job, pms) ;
+
+	bytes = batch->used * pms->blocksize ;
+	if ((k = psf_fwrite (batch->codes, 1, bytes, psf)) != bytes)
+		psf_log_printf (psf, "*** Warning : short write (%d != %d).\n", k, bytes) ;
+
+	/*
+	**	Whatever has not been written over since is left as the block by block
+	**	encoder leaves it, so a final partial block is padded the same way.
+	*/
+	last = batch->pcm + (batch->used - 1) * batch->blocksamples ;
+	for (k = pms->samplecount * pms->channels ; k < batch->blocksamples ; k++)
+		pms->samples [k] = (k < pms->samplesperblock) ? 0 : last [k] ;
+
+	pms->blockcount += batch->used ;
+	batch->used = 0 ;
+} /* msadpcm_batch_flush */
@@ -81,6 +81,7 @@
 #define OGG_PAGE_SIZE_MAX (65307)
 #define OGG_CHUNK_SIZE (65536)
 #define OGG_CHUNK_SIZE_MAX (1024*1024)
+#define OGG_PAGE_INDEX_MAX (1 << 18)
 
 /*
  * The Ogg container may seem overly complicated, particularly when used for a
@@ -140,6 +141,7 @@ static int		ogg_stream_classify (SF_PRIVATE *psf, OGG_PRIVATE * odata) ;
 static int		ogg_page_classify (SF_PRIVATE * psf, const ogg_page * og) ;
 static uint64_t	ogg_page_search_do_rescale (uint64_t x, uint64_t from, uint64_t to) ;
 static void		ogg_page_search_continued_data (OGG_PRIVATE *odata, ogg_page *page) ;
+static int		ogg_page_index_find (const OGG_PRIVATE *odata, uint64_t target_gp) ;
 
 /*-----------------------------------------------------------------------------------------------
 ** Exported functions.
@@ -325,6 +327,8 @@ ogg_stream_next_page (SF_PRIVATE *psf, OGG_PRIVATE *odata)
 			break ;
 		} ;
 
+	ogg_page_index_add (odata, &odata->opage, ogg_sync_ftell (psf) - nn) ;
+
 	if (ogg_page_eos (&odata->opage))
 		odata->eos = 1 ;
 
@@ -422,6 +426,7 @@ ogg_sync_last_page_before (SF_PRIVATE *psf, OGG_PRIVATE *odata, uint64_t *gp_out
 				return -1 ;
 			if (ogg_page_serialno (&odata->opage) == serialno)
 			{	uint64_t page_gp = ogg_page_granulepos (&odata->opage) ;
+				ogg_page_index_add (odata, &odata->opage, position) ;
 				if (page_gp != (uint64_t) -1)
 				{	offset = position ;
 					gp = page_gp ;
@@ -463,11 +468,38 @@ ogg_stream_seek_page_search (SF_PRIVATE *psf, OGG_PRIVATE *odata, uint64_t targe
 	int force_bisect = SF_FALSE ;
 	int ret ;
 	int has_packets ;
+	int k ;
+
+	/*
+	** If the pages either side of the target are in the index, only search
+	** between them. With a complete index that is a single short scan.
+	** Both ends of the interval are page ends, to go with the granule
+	** positions.
+	*/
+	k = ogg_page_index_find (odata, target_gp) ;
+	if (k > 0 && odata->index [k - 1].offset > begin
+			&& odata->index [k - 1].offset + odata->index [k - 1].len < end)
+	{	begin = odata->index [k - 1].offset + odata->index [k - 1].len ;
+		pcm_start = odata->index [k - 1].gp ;
+		} ;
+	if (k < odata->index_len && odata->index [k].offset >= begin
+			&& odata->index [k].offset + odata->index [k].len < end)
+	{	end = odata->index [k].offset + odata->index [k].len ;
+		pcm_end = odata->index [k].gp ;
+		} ;
 
 	*best_gp = pcm_start ;
 	best = best_start = begin ;
 	boundary = end ;
 
+	/*
+	** When starting just after a page from the index, and no later page
+	** before the target turns up, that page is read again at the end in
+	** case its last packet continues on the next page.
+	*/
+	if (k > 0 && begin == odata->index [k - 1].offset + odata->index [k - 1].len)
+		best_start = odata->index [k - 1].offset ;
+
 	ogg_stream_reset_serialno (&odata->ostream, odata->ostream.serialno) ;
 
 	/*
@@ -573,6 +605,8 @@ ogg_stream_seek_page_search (SF_PRIVATE *psf, OGG_PRIVATE *odata, uint64_t targe
 			if (odata->ostream.serialno != ogg_page_serialno (&page))
 				continue ;
 
+			ogg_page_index_add (odata, &page, page_offset) ;
+
 			/*
 			** The Ogg spec says that a page with a granule pos of -1 must not
 			** contain and packets which complete, but the lack of biconditional
@@ -700,6 +734,112 @@ ogg_stream_seek_page_search (SF_PRIVATE *psf, OGG_PRIVATE *odata, uint64_t targe
 	return 0 ;
 } /* ogg_stream_seek_page_search */
 
+void
+ogg_page_index_add (OGG_PRIVATE *odata, const ogg_page *page, sf_count_t offset)
+{	OGG_PAGE_INDEX *index ;
+	uint64_t gp ;
+	int lo, hi, mid, allocated ;
+
+	if (offset < 0 || ogg_page_serialno (page) != odata->ostream.serialno || ogg_page_packets (page) == 0)
+		return ;
+	if ((gp = ogg_page_granulepos (page)) == (uint64_t) -1)
+		return ;
+
+	/* Pages are nearly always seen in order, so check the end first. */
+	lo = hi = odata->index_len ;
+	if (hi > 0 && odata->index [hi - 1].offset >= offset)
+	{	lo = 0 ;
+		while (lo < hi)
+		{	mid = (lo + hi) / 2 ;
+			if (odata->index [mid].offset < offset)
+				lo = mid + 1 ;
+			else
+				hi = mid ;
+			} ;
+		} ;
+
+	if (lo < odata->index_len && odata->index [lo].offset == offset)
+		return ;
+
+	/* Keep the granule positions sorted too, so they can be searched. */
+	if ((lo > 0 && odata->index [lo - 1].gp > gp) || (lo < odata->index_len && odata->index [lo].gp < gp))
+		return ;
+
+	if (odata->index_len >= odata->index_allocated)
+	{	if (odata->index_allocated >= OGG_PAGE_INDEX_MAX)
+			return ;
+		allocated = odata->index_allocated > 0 ? 2 * odata->index_allocated : 256 ;
+		if ((index = realloc (odata->index, allocated * sizeof (OGG_PAGE_INDEX))) == NULL)
+			return ;
+		odata->index = index ;
+		odata->index_allocated = allocated ;
+		} ;
+
+	memmove (odata->index + lo + 1, odata->index + lo, (odata->index_len - lo) * sizeof (OGG_PAGE_INDEX)) ;
+	odata->index [lo].gp = gp ;
+	odata->index [lo].offset = offset ;
+	odata->index [lo].len = page->header_len + page->body_len ;
+	odata->index_len ++ ;
+} /* ogg_page_index_add */
+
+uint64_t
+ogg_page_index_before (const OGG_PRIVATE *odata, uint64_t target_gp)
+{	int k ;
+
+	k = ogg_page_index_find (odata, target_gp) ;
+
+	return k > 0 ? odata->index [k - 1].gp : 0 ;
+} /* ogg_page_index_before */
+
+int
+ogg_page_index_build (SF_PRIVATE *psf, OGG_PRIVATE *odata)
+{	ogg_sync_state osync ;
+	ogg_page page ;
+	sf_count_t position, offset, nb_read ;
+	char *buffer ;
+	int synced ;
+
+	if (psf->file.mode != SFM_READ)
+		return SF_FALSE ;
+
+	/*
+	** Use a separate sync state, so that whatever is buffered in odata->osync
+	** is still valid once the file position is restored.
+	*/
+	if ((position = psf_ftell (psf)) < 0 || psf_fseek (psf, psf->dataoffset, SEEK_SET) < 0)
+		return SF_FALSE ;
+
+	ogg_sync_init (&osync) ;
+	for (offset = psf->dataoffset ; ; )
+	{	synced = ogg_sync_pageseek (&osync, &page) ;
+		if (synced < 0)
+		{	offset -= synced ;
+			continue ;
+			} ;
+
+		if (synced > 0)
+		{	ogg_page_index_add (odata, &page, offset) ;
+			offset += synced ;
+			continue ;
+			} ;
+
+		buffer = ogg_sync_buffer (&osync, OGG_CHUNK_SIZE) ;
+		if ((nb_read = psf_fread (buffer, 1, OGG_CHUNK_SIZE, psf)) <= 0)
+			break ;
+		ogg_sync_wrote (&osync, nb_read) ;
+		} ;
+	ogg_sync_clear (&osync) ;
+
+	psf_log_printf (psf, "Ogg : Page index has %d pages.\n", odata->index_len) ;
+
+	if (psf_fseek (psf, position, SEEK_SET) != position)
+	{	psf->error = SFE_BAD_SEEK ;
+		return SF_FALSE ;
+		} ;
+
+	return SF_TRUE ;
+} /* ogg_page_index_build */
+
 int
 ogg_open (SF_PRIVATE *psf)
 {	OGG_PRIVATE* odata = calloc (1, sizeof (OGG_PRIVATE)) ;
@@ -764,6 +904,9 @@ ogg_close (SF_PRIVATE *psf)
 	ogg_sync_clear (&odata->osync) ;
 	ogg_stream_clear (&odata->ostream) ;
 
+	free (odata->index) ;
+	odata->index = NULL ;
+
 	return 0 ;
 } /* ogg_close */
 
@@ -897,6 +1040,25 @@ ogg_page_search_continued_data (OGG_PRIVATE *odata, ogg_page *page)
 	while (ogg_stream_packetout (&odata->ostream, &odata->opacket)) ;
 } /* ogg_page_search_continued_data */
 
+/*
+** Return the index of the first page in the page index ending at or after
+** target_gp.
+*/
+static int
+ogg_page_index_find (const OGG_PRIVATE *odata, uint64_t target_gp)
+{	int lo = 0, hi = odata->index_len, mid ;
+
+	while (lo < hi)
+	{	mid = (lo + hi) / 2 ;
+		if (odata->index [mid].gp < target_gp)
+			lo = mid + 1 ;
+		else
+			hi = mid ;
+		} ;
+
+	return lo ;
+} /* ogg_page_index_find */
+
 #else /* HAVE_EXTERNAL_XIPH_LIBS */
 
 int
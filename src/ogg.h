@@ -31,6 +31,16 @@ enum
 	OGG_OPUS,
 } ;
 
+/* One page of the logical bitstream in the page index. */
+typedef struct
+{	/* Granule position at the end of the page */
+	uint64_t gp ;
+	/* File offset of the start of the page */
+	sf_count_t offset ;
+	/* Page length in bytes */
+	int len ;
+} OGG_PAGE_INDEX ;
+
 typedef struct
 {	/* Sync and verify incoming physical bitstream */
 	ogg_sync_state osync ;
@@ -50,6 +60,11 @@ typedef struct
 
 	int eos ;
 	int codec ;
+
+	/* Pages seen so far that end a packet, sorted by file offset. */
+	OGG_PAGE_INDEX *index ;
+	int index_len ;
+	int index_allocated ;
 } OGG_PRIVATE ;
 
 
@@ -131,4 +146,26 @@ int ogg_stream_seek_page_search (SF_PRIVATE *psf, OGG_PRIVATE *odata,
 								uint64_t target_gp, uint64_t pcm_start, uint64_t pcm_end,
 								uint64_t *best_gp, sf_count_t begin, sf_count_t end) ;
 
+/*
+** Add a page starting at file offset to the page index. Pages from other
+** streams, without a granule position, or out of order with the pages already
+** in the index are ignored. Pages read by ogg_stream_next_page() and those
+** found while seeking are added automatically, so later seeks near them can
+** go straight to the right page.
+*/
+void ogg_page_index_add (OGG_PRIVATE *odata, const ogg_page *page, sf_count_t offset) ;
+
+/*
+** Return the granule position of the last page in the index ending before
+** target_gp, or zero if there is none.
+*/
+uint64_t ogg_page_index_before (const OGG_PRIVATE *odata, uint64_t target_gp) ;
+
+/*
+** Scan the whole file from psf->dataoffset and add every page of the stream to
+** the page index. The file position and decode state are left unchanged.
+** Returns SF_TRUE on success.
+*/
+int ogg_page_index_build (SF_PRIVATE *psf, OGG_PRIVATE *odata) ;
+
 #endif /* SF_SRC_OGG_H */
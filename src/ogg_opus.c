@@ -1586,9 +1586,11 @@ ogg_opus_seek_manual (SF_PRIVATE *psf, uint64_t target_gp)
 
 static sf_count_t
 ogg_opus_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
-{	OPUS_PRIVATE *oopus = (OPUS_PRIVATE *) psf->codec_data ;
+{	OGG_PRIVATE *odata = (OGG_PRIVATE *) psf->container_data ;
+	OPUS_PRIVATE *oopus = (OPUS_PRIVATE *) psf->codec_data ;
 	uint64_t target_gp ;
 	uint64_t current ;
+	uint64_t indexed_gp ;
 	int ret ;
 
 	/* Only support seeking in read mode. */
@@ -1615,9 +1617,14 @@ ogg_opus_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	{	/*
 		** Avoid seeking in the file if where we want is just ahead or exactly
 		** were we are. To avoid needing to flush the decoder we choose pre-
-		** roll plus 10ms.
+		** roll plus 10ms. Unless the page index already has a page between
+		** here and the pre-roll, which can be gone to directly.
 		*/
-		if (target_gp < current || target_gp - current > OGG_OPUS_PREROLL + 10 * 48)
+		indexed_gp = 0 ;
+		if (target_gp >= OGG_OPUS_PREROLL)
+			indexed_gp = ogg_page_index_before (odata, target_gp - OGG_OPUS_PREROLL) ;
+		if (target_gp < current || target_gp - current > OGG_OPUS_PREROLL + 10 * 48
+			|| indexed_gp > current + 10 * 48)
 		{	ret = ogg_opus_seek_page_search (psf, target_gp) ;
 			if (ret < 0)
 			{	/*
@@ -1733,6 +1740,9 @@ ogg_opus_command (SF_PRIVATE *psf, int command, void *data, int datasize)
 			*((int *) data) = oopus->header.input_samplerate ;
 			return SF_TRUE ;
 
+		case SFC_BUILD_SEEK_INDEX :
+			return ogg_page_index_build (psf, odata) ;
+
 		default :
 			break ;
 	}
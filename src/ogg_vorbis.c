@@ -517,7 +517,8 @@ ogg_vorbis_open (SF_PRIVATE *psf)
 
 static int
 vorbis_command (SF_PRIVATE *psf, int command, void * data, int datasize)
-{	VORBIS_PRIVATE *vdata = (VORBIS_PRIVATE *) psf->codec_data ;
+{	OGG_PRIVATE *odata = (OGG_PRIVATE *) psf->container_data ;
+	VORBIS_PRIVATE *vdata = (VORBIS_PRIVATE *) psf->codec_data ;
 
 	switch (command)
 	{	case SFC_SET_COMPRESSION_LEVEL :
@@ -535,6 +536,9 @@ vorbis_command (SF_PRIVATE *psf, int command, void * data, int datasize)
 			psf_log_printf (psf, "%s : Setting SFC_SET_VBR_ENCODING_QUALITY to %f.\n", __func__, vdata->quality) ;
 			return SF_TRUE ;
 
+		case SFC_BUILD_SEEK_INDEX :
+			return ogg_page_index_build (psf, odata) ;
+
 		default :
 			return SF_FALSE ;
 		} ;
@@ -811,24 +815,55 @@ vorbis_seek (SF_PRIVATE *psf, int UNUSED (mode), sf_count_t offset)
 
 		/*
 		** If the end of the file is know, and the seek isn't for the near
-		** future, do a search of the file for a good place to start.
+		** future, do a search of the file for a good place to start. A page
+		** in the index a little way ahead is cheaper to go to than decoding
+		** up to it.
 		*/
 		ret = 0 ;
 		if ((vdata->pcm_end != (uint64_t) -1) &&
-			(target < vdata->loc || target - vdata->loc > (2 * psf->sf.samplerate)))
-		{	uint64_t best_gp ;
+			(target < vdata->loc || target - vdata->loc > (2 * psf->sf.samplerate)
+				|| (sf_count_t) ogg_page_index_before (odata, target) > vdata->loc + psf->sf.samplerate / 4))
+		{	uint64_t best_gp, search_gp ;
+
+			/*
+			** After the restart the first packet only primes the decoder,
+			** so search a little early to keep the target out of it.
+			*/
+			search_gp = vdata->pcm_start ;
+			if (target - (sf_count_t) vdata->pcm_start > vorbis_info_blocksize (&vdata->vinfo, 1) / 2)
+				search_gp = target - vorbis_info_blocksize (&vdata->vinfo, 1) / 2 ;
+
+			for (;;)
+			{	best_gp = vdata->pcm_start ;
 
-			best_gp = vdata->pcm_start ;
+				ret = ogg_stream_seek_page_search (psf, odata, search_gp, vdata->pcm_start,
+					vdata->pcm_end, &best_gp, psf->dataoffset, vdata->last_page) ;
+				if (ret < 0 || (ret = ogg_stream_unpack_page (psf, odata)) <= 0)
+					break ;
 
-			ret = ogg_stream_seek_page_search (psf, odata, target, vdata->pcm_start,
-				vdata->pcm_end, &best_gp, psf->dataoffset, vdata->last_page) ;
-			if (ret >= 0)
-			{	ret = ogg_stream_unpack_page (psf, odata) ;
-				if (ret == 1)
+				/* The decoder starts the same way as at the start of the stream. */
+				if (best_gp == vdata->pcm_start)
 				{	vdata->loc = best_gp ;
-					vorbis_synthesis_restart (&vdata->vdsp) ;
+					break ;
 					} ;
+
+				/* Otherwise the audio starts where the first packet ends. */
+				if (odata->pkt [odata->pkt_len - 1].granulepos >= 0 && ! odata->pkt [odata->pkt_len - 1].e_o_s)
+				{	vdata->loc = odata->pkt [odata->pkt_len - 1].granulepos ;
+					vdata->loc -= vorbis_calculate_page_duration (psf) ;
+					break ;
+					} ;
+
+				/*
+				** The last page's granule position is cut to the end of the
+				** audio, so it can't be counted back from. Use the page
+				** before it.
+				*/
+				search_gp = best_gp ;
 				} ;
+
+			if (ret > 0)
+				vorbis_synthesis_restart (&vdata->vdsp) ;
 			} ;
 
 		if (ret >= 0 && offset + (sf_count_t) vdata->pcm_start >= vdata->loc)
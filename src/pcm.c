@@ -23,6 +23,7 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"simd.h"
 
 /* Need to be able to handle 3 byte (24 bit) integers. So defined a
 ** type and use SIZEOF_TRIBYTE instead of (tribyte).
@@ -140,7 +141,9 @@ pcm_init (SF_PRIVATE *psf)
 		psf->data_endswap = (psf->endian == SF_ENDIAN_LITTLE) ? SF_FALSE : SF_TRUE ;
 
 	if (psf->file.mode == SFM_READ || psf->file.mode == SFM_RDWR)
-	{	switch (psf->bytewidth * 0x10000 + psf->endian + chars)
+	{	psf->can_select_channels = SF_TRUE ;
+
+		switch (psf->bytewidth * 0x10000 + psf->endian + chars)
 		{	case (0x10000 + SF_ENDIAN_BIG + SF_CHARS_SIGNED) :
 			case (0x10000 + SF_ENDIAN_LITTLE + SF_CHARS_SIGNED) :
 					psf->read_short		= pcm_read_sc2s ;
@@ -279,18 +282,46 @@ pcm_init (SF_PRIVATE *psf)
 } /* pcm_init */
 
 /*==============================================================================
+**	Each of the conversions below first hands the array to the vectorised
+**	kernels from simd.h and then finishes whatever they left with the
+**	scalar loop.
+*/
+
+static inline void
+pcm_endswap_short_copy (short *dest, const short *src, int count)
+{	int done ;
+
+	done = psf_simd ()->swap16 (src, dest, count) ;
+	endswap_short_copy (dest + done, src + done, count - done) ;
+} /* pcm_endswap_short_copy */
+
+static inline void
+pcm_endswap_int_copy (int *dest, const int *src, int count)
+{	int done ;
+
+	done = psf_simd ()->swap32 (src, dest, count) ;
+	endswap_int_copy (dest + done, src + done, count - done) ;
+} /* pcm_endswap_int_copy */
+
+/*--------------------------------------------------------------------------
 */
 
 static inline void
 sc2s_array	(const signed char *src, int count, short *dest)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_s ((const unsigned char *) src, dest, count, SF_FALSE) ;
+	while (--count >= done)
 	{	dest [count] = ((uint16_t) src [count]) << 8 ;
 		} ;
 } /* sc2s_array */
 
 static inline void
 uc2s_array	(const unsigned char *src, int count, short *dest)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_s (src, dest, count, SF_TRUE) ;
+	while (--count >= done)
 	{	dest [count] = (((uint32_t) src [count]) - 0x80) << 8 ;
 		} ;
 } /* uc2s_array */
@@ -309,9 +340,10 @@ bet2s_array (const tribyte *src, int count, short *dest)
 
 static inline void
 lei2s_array (const int *src, int count, short *dest)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm32_to_s (src, dest, count, CPU_IS_BIG_ENDIAN) ;
+	while (--count >= done)
 	{	value = LE2H_32 (src [count]) ;
 		dest [count] = value >> 16 ;
 		} ;
@@ -319,9 +351,10 @@ lei2s_array (const int *src, int count, short *dest)
 
 static inline void
 bei2s_array (const int *src, int count, short *dest)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm32_to_s (src, dest, count, CPU_IS_LITTLE_ENDIAN) ;
+	while (--count >= done)
 	{	value = BE2H_32 (src [count]) ;
 		dest [count] = value >> 16 ;
 		} ;
@@ -332,14 +365,20 @@ bei2s_array (const int *src, int count, short *dest)
 
 static inline void
 sc2i_array	(const signed char *src, int count, int *dest)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_i ((const unsigned char *) src, dest, count, SF_FALSE) ;
+	while (--count >= done)
 	{	dest [count] = arith_shift_left ((int) src [count], 24) ;
 		} ;
 } /* sc2i_array */
 
 static inline void
 uc2i_array	(const unsigned char *src, int count, int *dest)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_i (src, dest, count, SF_TRUE) ;
+	while (--count >= done)
 	{	dest [count] = arith_shift_left (((int) src [count]) - 128, 24) ;
 		} ;
 } /* uc2i_array */
@@ -347,8 +386,10 @@ uc2i_array	(const unsigned char *src, int count, int *dest)
 static inline void
 bes2i_array (const short *src, int count, int *dest)
 {	short value ;
+	int done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm16_to_i (src, dest, count, CPU_IS_LITTLE_ENDIAN) ;
+	while (--count >= done)
 	{	value = BE2H_16 (src [count]) ;
 		dest [count] = arith_shift_left (value, 16) ;
 		} ;
@@ -357,8 +398,10 @@ bes2i_array (const short *src, int count, int *dest)
 static inline void
 les2i_array (const short *src, int count, int *dest)
 {	short value ;
+	int done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm16_to_i (src, dest, count, CPU_IS_BIG_ENDIAN) ;
+	while (--count >= done)
 	{	value = LE2H_16 (src [count]) ;
 		dest [count] = arith_shift_left (value, 16) ;
 		} ;
@@ -366,13 +409,19 @@ les2i_array (const short *src, int count, int *dest)
 
 static inline void
 bet2i_array (const tribyte *src, int count, int *dest)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm24_to_i ((const unsigned char *) src, dest, count, SF_TRUE) ;
+	while (--count >= done)
 		dest [count] = psf_get_be24 (src [count].bytes, 0) ;
 } /* bet2i_array */
 
 static inline void
 let2i_array (const tribyte *src, int count, int *dest)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm24_to_i ((const unsigned char *) src, dest, count, SF_FALSE) ;
+	while (--count >= done)
 		dest [count] = psf_get_le24 (src [count].bytes, 0) ;
 } /* let2i_array */
 
@@ -381,21 +430,29 @@ let2i_array (const tribyte *src, int count, int *dest)
 
 static inline void
 sc2f_array	(const signed char *src, int count, float *dest, float normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_f ((const unsigned char *) src, dest, count, SF_FALSE, normfact) ;
+	while (--count >= done)
 		dest [count] = ((float) src [count]) * normfact ;
 } /* sc2f_array */
 
 static inline void
 uc2f_array	(const unsigned char *src, int count, float *dest, float normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_f (src, dest, count, SF_TRUE, normfact) ;
+	while (--count >= done)
 		dest [count] = (((int) src [count]) - 128) * normfact ;
 } /* uc2f_array */
 
 static inline void
 les2f_array (const short *src, int count, float *dest, float normfact)
 {	short	value ;
+	int		done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm16_to_f (src, dest, count, CPU_IS_BIG_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = LE2H_16 (value) ;
 		dest [count] = ((float) value) * normfact ;
@@ -405,8 +462,10 @@ les2f_array (const short *src, int count, float *dest, float normfact)
 static inline void
 bes2f_array (const short *src, int count, float *dest, float normfact)
 {	short			value ;
+	int		done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm16_to_f (src, dest, count, CPU_IS_LITTLE_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = BE2H_16 (value) ;
 		dest [count] = ((float) value) * normfact ;
@@ -415,9 +474,10 @@ bes2f_array (const short *src, int count, float *dest, float normfact)
 
 static inline void
 let2f_array (const tribyte *src, int count, float *dest, float normfact)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm24_to_f ((const unsigned char *) src, dest, count, SF_FALSE, normfact) ;
+	while (--count >= done)
 	{	value = psf_get_le24 (src [count].bytes, 0) ;
 		dest [count] = ((float) value) * normfact ;
 		} ;
@@ -425,9 +485,10 @@ let2f_array (const tribyte *src, int count, float *dest, float normfact)
 
 static inline void
 bet2f_array (const tribyte *src, int count, float *dest, float normfact)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm24_to_f ((const unsigned char *) src, dest, count, SF_TRUE, normfact) ;
+	while (--count >= done)
 	{	value = psf_get_be24 (src [count].bytes, 0) ;
 		dest [count] = ((float) value) * normfact ;
 		} ;
@@ -435,9 +496,10 @@ bet2f_array (const tribyte *src, int count, float *dest, float normfact)
 
 static inline void
 lei2f_array (const int *src, int count, float *dest, float normfact)
-{	int 			value ;
+{	int 			value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm32_to_f (src, dest, count, CPU_IS_BIG_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = LE2H_32 (value) ;
 		dest [count] = ((float) value) * normfact ;
@@ -446,9 +508,10 @@ lei2f_array (const int *src, int count, float *dest, float normfact)
 
 static inline void
 bei2f_array (const int *src, int count, float *dest, float normfact)
-{	int 			value ;
+{	int 			value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm32_to_f (src, dest, count, CPU_IS_LITTLE_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = BE2H_32 (value) ;
 		dest [count] = ((float) value) * normfact ;
@@ -460,21 +523,29 @@ bei2f_array (const int *src, int count, float *dest, float normfact)
 
 static inline void
 sc2d_array	(const signed char *src, int count, double *dest, double normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_d ((const unsigned char *) src, dest, count, SF_FALSE, normfact) ;
+	while (--count >= done)
 		dest [count] = ((double) src [count]) * normfact ;
 } /* sc2d_array */
 
 static inline void
 uc2d_array	(const unsigned char *src, int count, double *dest, double normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->pcm8_to_d (src, dest, count, SF_TRUE, normfact) ;
+	while (--count >= done)
 		dest [count] = (((int) src [count]) - 128) * normfact ;
 } /* uc2d_array */
 
 static inline void
 les2d_array (const short *src, int count, double *dest, double normfact)
 {	short	value ;
+	int		done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm16_to_d (src, dest, count, CPU_IS_BIG_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = LE2H_16 (value) ;
 		dest [count] = ((double) value) * normfact ;
@@ -484,8 +555,10 @@ les2d_array (const short *src, int count, double *dest, double normfact)
 static inline void
 bes2d_array (const short *src, int count, double *dest, double normfact)
 {	short	value ;
+	int		done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm16_to_d (src, dest, count, CPU_IS_LITTLE_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = BE2H_16 (value) ;
 		dest [count] = ((double) value) * normfact ;
@@ -494,9 +567,10 @@ bes2d_array (const short *src, int count, double *dest, double normfact)
 
 static inline void
 let2d_array (const tribyte *src, int count, double *dest, double normfact)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm24_to_d ((const unsigned char *) src, dest, count, SF_FALSE, normfact) ;
+	while (--count >= done)
 	{	value = psf_get_le24 (src [count].bytes, 0) ;
 		dest [count] = ((double) value) * normfact ;
 		} ;
@@ -504,9 +578,10 @@ let2d_array (const tribyte *src, int count, double *dest, double normfact)
 
 static inline void
 bet2d_array (const tribyte *src, int count, double *dest, double normfact)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm24_to_d ((const unsigned char *) src, dest, count, SF_TRUE, normfact) ;
+	while (--count >= done)
 	{	value = psf_get_be24 (src [count].bytes, 0) ;
 		dest [count] = ((double) value) * normfact ;
 		} ;
@@ -514,9 +589,10 @@ bet2d_array (const tribyte *src, int count, double *dest, double normfact)
 
 static inline void
 lei2d_array (const int *src, int count, double *dest, double normfact)
-{	int 	value ;
+{	int 	value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm32_to_d (src, dest, count, CPU_IS_BIG_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = LE2H_32 (value) ;
 		dest [count] = ((double) value) * normfact ;
@@ -525,9 +601,10 @@ lei2d_array (const int *src, int count, double *dest, double normfact)
 
 static inline void
 bei2d_array (const int *src, int count, double *dest, double normfact)
-{	int 	value ;
+{	int 	value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->pcm32_to_d (src, dest, count, CPU_IS_LITTLE_ENDIAN, normfact) ;
+	while (--count >= done)
 	{	value = src [count] ;
 		value = BE2H_32 (value) ;
 		dest [count] = ((double) value) * normfact ;
@@ -539,13 +616,19 @@ bei2d_array (const int *src, int count, double *dest, double normfact)
 
 static inline void
 s2sc_array	(const short *src, signed char *dest, int count)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->s_to_pcm8 (src, (unsigned char *) dest, count, SF_FALSE) ;
+	while (--count >= done)
 		dest [count] = src [count] >> 8 ;
 } /* s2sc_array */
 
 static inline void
 s2uc_array	(const short *src, unsigned char *dest, int count)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->s_to_pcm8 (src, dest, count, SF_TRUE) ;
+	while (--count >= done)
 		dest [count] = (src [count] >> 8) + 0x80 ;
 } /* s2uc_array */
 
@@ -570,9 +653,11 @@ s2bet_array (const short *src, tribyte *dest, int count)
 static inline void
 s2lei_array (const short *src, int *dest, int count)
 {	unsigned char	*ucptr ;
+	int				done ;
 
+	done = psf_simd ()->s_to_pcm32 (src, dest, count, CPU_IS_BIG_ENDIAN) ;
 	ucptr = ((unsigned char*) dest) + 4 * count ;
-	while (--count >= 0)
+	while (--count >= done)
 	{	ucptr -= 4 ;
 		ucptr [0] = 0 ;
 		ucptr [1] = 0 ;
@@ -584,9 +669,11 @@ s2lei_array (const short *src, int *dest, int count)
 static inline void
 s2bei_array (const short *src, int *dest, int count)
 {	unsigned char	*ucptr ;
+	int				done ;
 
+	done = psf_simd ()->s_to_pcm32 (src, dest, count, CPU_IS_LITTLE_ENDIAN) ;
 	ucptr = ((unsigned char*) dest) + 4 * count ;
-	while (--count >= 0)
+	while (--count >= done)
 	{	ucptr -= 4 ;
 		ucptr [0] = src [count] >> 8 ;
 		ucptr [1] = src [count] ;
@@ -600,22 +687,30 @@ s2bei_array (const short *src, int *dest, int count)
 
 static inline void
 i2sc_array	(const int *src, signed char *dest, int count)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->i_to_pcm8 (src, (unsigned char *) dest, count, SF_FALSE) ;
+	while (--count >= done)
 		dest [count] = (src [count] >> 24) ;
 } /* i2sc_array */
 
 static inline void
 i2uc_array	(const int *src, unsigned char *dest, int count)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->i_to_pcm8 (src, dest, count, SF_TRUE) ;
+	while (--count >= done)
 		dest [count] = ((src [count] >> 24) + 128) ;
 } /* i2uc_array */
 
 static inline void
 i2bes_array (const int *src, short *dest, int count)
 {	unsigned char	*ucptr ;
+	int				done ;
 
+	done = psf_simd ()->i_to_pcm16 (src, dest, count, CPU_IS_LITTLE_ENDIAN) ;
 	ucptr = ((unsigned char*) dest) + 2 * count ;
-	while (--count >= 0)
+	while (--count >= done)
 	{	ucptr -= 2 ;
 		ucptr [0] = src [count] >> 24 ;
 		ucptr [1] = src [count] >> 16 ;
@@ -625,9 +720,11 @@ i2bes_array (const int *src, short *dest, int count)
 static inline void
 i2les_array (const int *src, short *dest, int count)
 {	unsigned char	*ucptr ;
+	int				done ;
 
+	done = psf_simd ()->i_to_pcm16 (src, dest, count, CPU_IS_BIG_ENDIAN) ;
 	ucptr = ((unsigned char*) dest) + 2 * count ;
-	while (--count >= 0)
+	while (--count >= done)
 	{	ucptr -= 2 ;
 		ucptr [0] = src [count] >> 16 ;
 		ucptr [1] = src [count] >> 24 ;
@@ -636,9 +733,10 @@ i2les_array (const int *src, short *dest, int count)
 
 static inline void
 i2let_array (const int *src, tribyte *dest, int count)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->i_to_pcm24 (src, (unsigned char *) dest, count, SF_FALSE) ;
+	while (--count >= done)
 	{	value = src [count] >> 8 ;
 		dest [count].bytes [0] = value ;
 		dest [count].bytes [1] = value >> 8 ;
@@ -648,9 +746,10 @@ i2let_array (const int *src, tribyte *dest, int count)
 
 static inline void
 i2bet_array (const int *src, tribyte *dest, int count)
-{	int value ;
+{	int value, done ;
 
-	while (--count >= 0)
+	done = psf_simd ()->i_to_pcm24 (src, (unsigned char *) dest, count, SF_TRUE) ;
+	while (--count >= done)
 	{	value = src [count] >> 8 ;
 		dest [count].bytes [2] = value ;
 		dest [count].bytes [1] = value >> 8 ;
@@ -672,7 +771,7 @@ pcm_read_sc2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
 		sc2s_array (ubuf.scbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -694,7 +793,7 @@ pcm_read_uc2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
 		uc2s_array (ubuf.ucbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -709,9 +808,9 @@ static sf_count_t
 pcm_read_bes2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 {	int		total ;
 
-	total = psf_fread (ptr, sizeof (short), len, psf) ;
+	total = psf_fread_samples (ptr, sizeof (short), len, psf) ;
 	if (CPU_IS_LITTLE_ENDIAN)
-		endswap_short_array (ptr, len) ;
+		pcm_endswap_short_copy (ptr, ptr, len) ;
 
 	return total ;
 } /* pcm_read_bes2s */
@@ -720,9 +819,9 @@ static sf_count_t
 pcm_read_les2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 {	int		total ;
 
-	total = psf_fread (ptr, sizeof (short), len, psf) ;
+	total = psf_fread_samples (ptr, sizeof (short), len, psf) ;
 	if (CPU_IS_BIG_ENDIAN)
-		endswap_short_array (ptr, len) ;
+		pcm_endswap_short_copy (ptr, ptr, len) ;
 
 	return total ;
 } /* pcm_read_les2s */
@@ -738,7 +837,7 @@ pcm_read_bet2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		bet2s_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -760,7 +859,7 @@ pcm_read_let2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		let2s_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -782,7 +881,7 @@ pcm_read_bei2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		bei2s_array (ubuf.ibuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -804,7 +903,7 @@ pcm_read_lei2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		lei2s_array (ubuf.ibuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -829,7 +928,7 @@ pcm_read_sc2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
 		sc2i_array (ubuf.scbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -851,7 +950,7 @@ pcm_read_uc2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
 		uc2i_array (ubuf.ucbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -873,7 +972,7 @@ pcm_read_bes2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		bes2i_array (ubuf.sbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -895,7 +994,7 @@ pcm_read_les2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		les2i_array (ubuf.sbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -917,7 +1016,7 @@ pcm_read_bet2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		bet2i_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -939,7 +1038,7 @@ pcm_read_let2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		let2i_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -954,9 +1053,9 @@ static sf_count_t
 pcm_read_bei2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 {	int		total ;
 
-	total = psf_fread (ptr, sizeof (int), len, psf) ;
+	total = psf_fread_samples (ptr, sizeof (int), len, psf) ;
 	if (CPU_IS_LITTLE_ENDIAN)
-		endswap_int_array	(ptr, len) ;
+		pcm_endswap_int_copy (ptr, ptr, len) ;
 
 	return total ;
 } /* pcm_read_bei2i */
@@ -965,9 +1064,9 @@ static sf_count_t
 pcm_read_lei2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 {	int		total ;
 
-	total = psf_fread (ptr, sizeof (int), len, psf) ;
+	total = psf_fread_samples (ptr, sizeof (int), len, psf) ;
 	if (CPU_IS_BIG_ENDIAN)
-		endswap_int_array	(ptr, len) ;
+		pcm_endswap_int_copy (ptr, ptr, len) ;
 
 	return total ;
 } /* pcm_read_lei2i */
@@ -989,7 +1088,7 @@ pcm_read_sc2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
 		sc2f_array (ubuf.scbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1014,7 +1113,7 @@ pcm_read_uc2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
 		uc2f_array (ubuf.ucbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1039,7 +1138,7 @@ pcm_read_bes2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		bes2f_array (ubuf.sbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1064,7 +1163,7 @@ pcm_read_les2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		les2f_array (ubuf.sbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1090,7 +1189,7 @@ pcm_read_bet2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		bet2f_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1116,7 +1215,7 @@ pcm_read_let2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		let2f_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1141,7 +1240,7 @@ pcm_read_bei2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		bei2f_array (ubuf.ibuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1166,7 +1265,7 @@ pcm_read_lei2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		lei2f_array (ubuf.ibuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1194,7 +1293,7 @@ pcm_read_sc2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
 		sc2d_array (ubuf.scbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1219,7 +1318,7 @@ pcm_read_uc2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, sizeof (unsigned char), bufferlen, psf) ;
 		uc2d_array (ubuf.ucbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1244,7 +1343,7 @@ pcm_read_bes2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		bes2d_array (ubuf.sbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1269,7 +1368,7 @@ pcm_read_les2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		les2d_array (ubuf.sbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1294,7 +1393,7 @@ pcm_read_bet2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		bet2d_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1320,7 +1419,7 @@ pcm_read_let2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, SIZEOF_TRIBYTE, bufferlen, psf) ;
 		let2d_array ((tribyte*) (ubuf.ucbuf), readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1345,7 +1444,7 @@ pcm_read_bei2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		bei2d_array (ubuf.ibuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1370,7 +1469,7 @@ pcm_read_lei2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		lei2d_array (ubuf.ibuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -1445,7 +1544,7 @@ pcm_write_s2bes	(SF_PRIVATE *psf, const short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		endswap_short_copy (ubuf.sbuf, ptr + total, bufferlen) ;
+		pcm_endswap_short_copy (ubuf.sbuf, ptr + total, bufferlen) ;
 		writecount = psf_fwrite (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		total += writecount ;
 		if (writecount < bufferlen)
@@ -1470,7 +1569,7 @@ pcm_write_s2les	(SF_PRIVATE *psf, const short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		endswap_short_copy (ubuf.sbuf, ptr + total, bufferlen) ;
+		pcm_endswap_short_copy (ubuf.sbuf, ptr + total, bufferlen) ;
 		writecount = psf_fwrite (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
 		total += writecount ;
 		if (writecount < bufferlen)
@@ -1718,7 +1817,7 @@ pcm_write_i2bei	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		endswap_int_copy (ubuf.ibuf, ptr + total, bufferlen) ;
+		pcm_endswap_int_copy (ubuf.ibuf, ptr + total, bufferlen) ;
 		writecount = psf_fwrite (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		total += writecount ;
 		if (writecount < bufferlen)
@@ -1743,7 +1842,7 @@ pcm_write_i2lei	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		endswap_int_copy (ubuf.ibuf, ptr + total, bufferlen) ;
+		pcm_endswap_int_copy (ubuf.ibuf, ptr + total, bufferlen) ;
 		writecount = psf_fwrite (ubuf.ibuf, sizeof (int), bufferlen, psf) ;
 		total += writecount ;
 		if (writecount < bufferlen)
@@ -1898,12 +1997,13 @@ static void
 f2bes_clip_array (const float *src, short *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
 	float			normfact, scaled_value ;
-	int				value ;
+	int				value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x10000) ;
 	ucptr = ((unsigned char*) dest) + 2 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_s_clip (src, dest, count, normfact, 16, CPU_IS_LITTLE_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 2 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
@@ -1971,12 +2071,13 @@ static void
 f2les_clip_array (const float *src, short *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
 	float			normfact, scaled_value ;
-	int				value ;
+	int				value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x10000) ;
 	ucptr = ((unsigned char*) dest) + 2 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_s_clip (src, dest, count, normfact, 16, CPU_IS_BIG_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 2 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
@@ -2026,11 +2127,12 @@ pcm_write_f2les	(SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 static void
 f2let_array (const float *src, tribyte *dest, int count, int normalize)
 {	float	normfact ;
-	int		value ;
+	int		value, done ;
 
 	normfact = normalize ? (1.0 * 0x7FFFFF) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_pcm24 (src, (unsigned char *) dest, count, SF_FALSE, normfact, SF_FALSE) ;
+	while (--count >= done)
 	{	value = lrintf (src [count] * normfact) ;
 		dest [count].bytes [0] = value ;
 		dest [count].bytes [1] = value >> 8 ;
@@ -2041,11 +2143,12 @@ f2let_array (const float *src, tribyte *dest, int count, int normalize)
 static void
 f2let_clip_array (const float *src, tribyte *dest, int count, int normalize)
 {	float	normfact, scaled_value ;
-	int		value ;
+	int		value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x100) ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_pcm24 (src, (unsigned char *) dest, count, SF_FALSE, normfact, SF_TRUE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
 		{	dest [count].bytes [0] = 0xFF ;
@@ -2097,11 +2200,12 @@ pcm_write_f2let	(SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 static void
 f2bet_array (const float *src, tribyte *dest, int count, int normalize)
 {	float	normfact ;
-	int		value ;
+	int		value, done ;
 
 	normfact = normalize ? (1.0 * 0x7FFFFF) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_pcm24 (src, (unsigned char *) dest, count, SF_TRUE, normfact, SF_FALSE) ;
+	while (--count >= done)
 	{	value = lrintf (src [count] * normfact) ;
 		dest [count].bytes [0] = value >> 16 ;
 		dest [count].bytes [1] = value >> 8 ;
@@ -2112,11 +2216,12 @@ f2bet_array (const float *src, tribyte *dest, int count, int normalize)
 static void
 f2bet_clip_array (const float *src, tribyte *dest, int count, int normalize)
 {	float	normfact, scaled_value ;
-	int		value ;
+	int		value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x100) ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_pcm24 (src, (unsigned char *) dest, count, SF_TRUE, normfact, SF_TRUE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
 		{	dest [count].bytes [0] = 0x7F ;
@@ -2187,12 +2292,13 @@ static void
 f2bei_clip_array (const float *src, int *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
 	float			normfact, scaled_value ;
-	int				value ;
+	int				value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : 1.0 ;
 	ucptr = ((unsigned char*) dest) + 4 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_i_clip (src, dest, count, normfact, CPU_IS_LITTLE_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 4 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= 1.0 * 0x7FFFFFFF)
@@ -2268,12 +2374,13 @@ static void
 f2lei_clip_array (const float *src, int *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
 	float			normfact, scaled_value ;
-	int				value ;
+	int				value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : 1.0 ;
 	ucptr = ((unsigned char*) dest) + 4 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->f_to_i_clip (src, dest, count, normfact, CPU_IS_BIG_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 4 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
@@ -2465,12 +2572,13 @@ static void
 d2bes_clip_array (const double *src, short *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
 	double			normfact, scaled_value ;
-	int				value ;
+	int				value, done ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x10000) ;
 	ucptr = ((unsigned char*) dest) + 2 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_s_clip (src, dest, count, normfact, 16, CPU_IS_LITTLE_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 2 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
@@ -2537,13 +2645,14 @@ d2les_array (const double *src, short *dest, int count, int normalize)
 static void
 d2les_clip_array (const double *src, short *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
-	int				value ;
+	int				value, done ;
 	double			normfact, scaled_value ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x10000) ;
 	ucptr = ((unsigned char*) dest) + 2 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_s_clip (src, dest, count, normfact, 16, CPU_IS_BIG_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 2 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
@@ -2592,12 +2701,13 @@ pcm_write_d2les	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 
 static void
 d2let_array (const double *src, tribyte *dest, int count, int normalize)
-{	int		value ;
+{	int		value, done ;
 	double	normfact ;
 
 	normfact = normalize ? (1.0 * 0x7FFFFF) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_pcm24 (src, (unsigned char *) dest, count, SF_FALSE, normfact, SF_FALSE) ;
+	while (--count >= done)
 	{	value = lrint (src [count] * normfact) ;
 		dest [count].bytes [0] = value ;
 		dest [count].bytes [1] = value >> 8 ;
@@ -2607,12 +2717,13 @@ d2let_array (const double *src, tribyte *dest, int count, int normalize)
 
 static void
 d2let_clip_array (const double *src, tribyte *dest, int count, int normalize)
-{	int		value ;
+{	int		value, done ;
 	double	normfact, scaled_value ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x100) ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_pcm24 (src, (unsigned char *) dest, count, SF_FALSE, normfact, SF_TRUE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
 		{	dest [count].bytes [0] = 0xFF ;
@@ -2663,12 +2774,13 @@ pcm_write_d2let	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 
 static void
 d2bet_array (const double *src, tribyte *dest, int count, int normalize)
-{	int		value ;
+{	int		value, done ;
 	double	normfact ;
 
 	normfact = normalize ? (1.0 * 0x7FFFFF) : 1.0 ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_pcm24 (src, (unsigned char *) dest, count, SF_TRUE, normfact, SF_FALSE) ;
+	while (--count >= done)
 	{	value = lrint (src [count] * normfact) ;
 		dest [count].bytes [2] = value ;
 		dest [count].bytes [1] = value >> 8 ;
@@ -2678,12 +2790,13 @@ d2bet_array (const double *src, tribyte *dest, int count, int normalize)
 
 static void
 d2bet_clip_array (const double *src, tribyte *dest, int count, int normalize)
-{	int		value ;
+{	int		value, done ;
 	double	normfact, scaled_value ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : (1.0 * 0x100) ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_pcm24 (src, (unsigned char *) dest, count, SF_TRUE, normfact, SF_TRUE) ;
+	while (--count >= done)
 	{	scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
 		{	dest [count].bytes [2] = 0xFF ;
@@ -2754,13 +2867,14 @@ d2bei_array (const double *src, int *dest, int count, int normalize)
 static void
 d2bei_clip_array (const double *src, int *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
-	int				value ;
+	int				value, done ;
 	double			normfact, scaled_value ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : 1.0 ;
 	ucptr = ((unsigned char*) dest) + 4 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_i_clip (src, dest, count, normfact, CPU_IS_LITTLE_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 4 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
@@ -2835,13 +2949,14 @@ d2lei_array (const double *src, int *dest, int count, int normalize)
 static void
 d2lei_clip_array (const double *src, int *dest, int count, int normalize)
 {	unsigned char	*ucptr ;
-	int				value ;
+	int				value, done ;
 	double			normfact, scaled_value ;
 
 	normfact = normalize ? (8.0 * 0x10000000) : 1.0 ;
 	ucptr = ((unsigned char*) dest) + 4 * count ;
 
-	while (--count >= 0)
+	done = psf_simd ()->d_to_i_clip (src, dest, count, normfact, CPU_IS_BIG_ENDIAN) ;
+	while (--count >= done)
 	{	ucptr -= 4 ;
 		scaled_value = src [count] * normfact ;
 		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
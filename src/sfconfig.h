@@ -124,6 +124,12 @@
 #define CPU_IS_X86_64	0
 #endif
 
+#if (defined __aarch64__) || (defined _M_ARM64)
+#define CPU_IS_AARCH64	1
+#else
+#define CPU_IS_AARCH64	0
+#endif
+
 #ifndef HAVE_SSIZE_T
 #define HAVE_SSIZE_T 0
 #endif
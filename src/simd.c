@@ -0,0 +1,3714 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+**	SSE2 is part of the x86_64 base line so those kernels are always built
+**	there. The AVX2 kernels are compiled for that instruction set on a per
+**	function basis and only used when the CPU says it has it, so a single
+**	binary runs everywhere. NEON is part of the aarch64 base line.
+*/
+
+#include "sfconfig.h"
+
+#include <stddef.h>
+
+#if HAVE_PTHREAD
+#include <pthread.h>
+#elif OS_IS_WIN32
+#include <windows.h>
+#endif
+
+#include "simd.h"
+
+#if CPU_IS_X86_64
+#include <emmintrin.h>
+
+#if COMPILER_IS_GCC
+#define	HAVE_AVX2_KERNELS	1
+#define	AVX2_FUNC			__attribute__ ((target ("avx2")))
+#include <immintrin.h>
+#elif defined (_MSC_VER)
+#define	HAVE_AVX2_KERNELS	1
+#define	AVX2_FUNC
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#define	HAVE_AVX2_KERNELS	0
+#endif
+
+#elif CPU_IS_AARCH64
+#if defined (_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+/*
+**	Where the CPU has fused multiply-add the compiler is free to use it for
+**	the scalar LTP search in GSM610/long_term.c, which changes the rounding,
+**	so vector versions built from separate multiplies and adds would not
+**	give the same results.
+*/
+#if defined (__FMA__) || defined (__ARM_FEATURE_FMA)
+#define	HAVE_GSM_LTP_KERNELS	0
+#else
+#define	HAVE_GSM_LTP_KERNELS	1
+#endif
+
+/*==============================================================================
+**	Kernels which convert nothing, leaving everything to the scalar code.
+*/
+
+static int
+none_swap16 (const short *src, short *dest, int count)
+{	(void) src ; (void) dest ; (void) count ;
+	return 0 ;
+} /* none_swap16 */
+
+static int
+none_swap32 (const int *src, int *dest, int count)
+{	(void) src ; (void) dest ; (void) count ;
+	return 0 ;
+} /* none_swap32 */
+
+static int
+none_pcm8_to_s (const unsigned char *src, short *dest, int count, int is_unsigned)
+{	(void) src ; (void) dest ; (void) count ; (void) is_unsigned ;
+	return 0 ;
+} /* none_pcm8_to_s */
+
+static int
+none_pcm8_to_i (const unsigned char *src, int *dest, int count, int is_unsigned)
+{	(void) src ; (void) dest ; (void) count ; (void) is_unsigned ;
+	return 0 ;
+} /* none_pcm8_to_i */
+
+static int
+none_pcm8_to_f (const unsigned char *src, float *dest, int count, int is_unsigned, float normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) is_unsigned ; (void) normfact ;
+	return 0 ;
+} /* none_pcm8_to_f */
+
+static int
+none_pcm8_to_d (const unsigned char *src, double *dest, int count, int is_unsigned, double normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) is_unsigned ; (void) normfact ;
+	return 0 ;
+} /* none_pcm8_to_d */
+
+static int
+none_pcm16_to_i (const short *src, int *dest, int count, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ;
+	return 0 ;
+} /* none_pcm16_to_i */
+
+static int
+none_pcm16_to_f (const short *src, float *dest, int count, int swap, float normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ; (void) normfact ;
+	return 0 ;
+} /* none_pcm16_to_f */
+
+static int
+none_pcm16_to_d (const short *src, double *dest, int count, int swap, double normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ; (void) normfact ;
+	return 0 ;
+} /* none_pcm16_to_d */
+
+static int
+none_pcm32_to_s (const int *src, short *dest, int count, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ;
+	return 0 ;
+} /* none_pcm32_to_s */
+
+static int
+none_pcm32_to_f (const int *src, float *dest, int count, int swap, float normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ; (void) normfact ;
+	return 0 ;
+} /* none_pcm32_to_f */
+
+static int
+none_pcm32_to_d (const int *src, double *dest, int count, int swap, double normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ; (void) normfact ;
+	return 0 ;
+} /* none_pcm32_to_d */
+
+static int
+none_s_to_pcm8 (const short *src, unsigned char *dest, int count, int is_unsigned)
+{	(void) src ; (void) dest ; (void) count ; (void) is_unsigned ;
+	return 0 ;
+} /* none_s_to_pcm8 */
+
+static int
+none_i_to_pcm8 (const int *src, unsigned char *dest, int count, int is_unsigned)
+{	(void) src ; (void) dest ; (void) count ; (void) is_unsigned ;
+	return 0 ;
+} /* none_i_to_pcm8 */
+
+static int
+none_i_to_pcm16 (const int *src, short *dest, int count, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ;
+	return 0 ;
+} /* none_i_to_pcm16 */
+
+static int
+none_s_to_pcm32 (const short *src, int *dest, int count, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) swap ;
+	return 0 ;
+} /* none_s_to_pcm32 */
+
+static int
+none_pcm24_to_i (const unsigned char *src, int *dest, int count, int big_endian)
+{	(void) src ; (void) dest ; (void) count ; (void) big_endian ;
+	return 0 ;
+} /* none_pcm24_to_i */
+
+static int
+none_pcm24_to_f (const unsigned char *src, float *dest, int count, int big_endian, float normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) big_endian ; (void) normfact ;
+	return 0 ;
+} /* none_pcm24_to_f */
+
+static int
+none_pcm24_to_d (const unsigned char *src, double *dest, int count, int big_endian, double normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) big_endian ; (void) normfact ;
+	return 0 ;
+} /* none_pcm24_to_d */
+
+static int
+none_i_to_pcm24 (const int *src, unsigned char *dest, int count, int big_endian)
+{	(void) src ; (void) dest ; (void) count ; (void) big_endian ;
+	return 0 ;
+} /* none_i_to_pcm24 */
+
+static int
+none_f_to_pcm24 (const float *src, unsigned char *dest, int count, int big_endian, float normfact, int clip)
+{	(void) src ; (void) dest ; (void) count ; (void) big_endian ; (void) normfact ; (void) clip ;
+	return 0 ;
+} /* none_f_to_pcm24 */
+
+static int
+none_d_to_pcm24 (const double *src, unsigned char *dest, int count, int big_endian, double normfact, int clip)
+{	(void) src ; (void) dest ; (void) count ; (void) big_endian ; (void) normfact ; (void) clip ;
+	return 0 ;
+} /* none_d_to_pcm24 */
+
+static int
+none_f_to_s_clip (const float *src, short *dest, int count, float normfact, int shift, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) normfact ; (void) shift ; (void) swap ;
+	return 0 ;
+} /* none_f_to_s_clip */
+
+static int
+none_f_to_i_clip (const float *src, int *dest, int count, float normfact, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) normfact ; (void) swap ;
+	return 0 ;
+} /* none_f_to_i_clip */
+
+static int
+none_d_to_s_clip (const double *src, short *dest, int count, double normfact, int shift, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) normfact ; (void) shift ; (void) swap ;
+	return 0 ;
+} /* none_d_to_s_clip */
+
+static int
+none_d_to_i_clip (const double *src, int *dest, int count, double normfact, int swap)
+{	(void) src ; (void) dest ; (void) count ; (void) normfact ; (void) swap ;
+	return 0 ;
+} /* none_d_to_i_clip */
+
+static int
+none_g711_to_s (const unsigned char *src, short *dest, int count, int law)
+{	(void) src ; (void) dest ; (void) count ; (void) law ;
+	return 0 ;
+} /* none_g711_to_s */
+
+static int
+none_g711_to_i (const unsigned char *src, int *dest, int count, int law)
+{	(void) src ; (void) dest ; (void) count ; (void) law ;
+	return 0 ;
+} /* none_g711_to_i */
+
+static int
+none_g711_to_f (const unsigned char *src, float *dest, int count, int law, float normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) law ; (void) normfact ;
+	return 0 ;
+} /* none_g711_to_f */
+
+static int
+none_g711_to_d (const unsigned char *src, double *dest, int count, int law, double normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) law ; (void) normfact ;
+	return 0 ;
+} /* none_g711_to_d */
+
+static int
+none_s_to_g711 (const short *src, unsigned char *dest, int count, int law)
+{	(void) src ; (void) dest ; (void) count ; (void) law ;
+	return 0 ;
+} /* none_s_to_g711 */
+
+static int
+none_i_to_g711 (const int *src, unsigned char *dest, int count, int law)
+{	(void) src ; (void) dest ; (void) count ; (void) law ;
+	return 0 ;
+} /* none_i_to_g711 */
+
+static int
+none_f_to_g711 (const float *src, unsigned char *dest, int count, int law, float normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) law ; (void) normfact ;
+	return 0 ;
+} /* none_f_to_g711 */
+
+static int
+none_d_to_g711 (const double *src, unsigned char *dest, int count, int law, double normfact)
+{	(void) src ; (void) dest ; (void) count ; (void) law ; (void) normfact ;
+	return 0 ;
+} /* none_d_to_g711 */
+
+static int
+none_alac_unpc (const int *pc, int *out, int num, short *coefs, int numactive, int chanshift, int denshift)
+{	(void) pc ; (void) out ; (void) num ; (void) coefs ; (void) numactive ; (void) chanshift ; (void) denshift ;
+	return 0 ;
+} /* none_alac_unpc */
+
+static int
+none_alac_unmix (const int *u, const int *v, int *out, int count, int mixbits, int mixres, int shift)
+{	(void) u ; (void) v ; (void) out ; (void) count ; (void) mixbits ; (void) mixres ; (void) shift ;
+	return 0 ;
+} /* none_alac_unmix */
+
+static int
+none_planar_to_s (const int * const *src, int channels, short *dest, int count, int shift)
+{	(void) src ; (void) channels ; (void) dest ; (void) count ; (void) shift ;
+	return 0 ;
+} /* none_planar_to_s */
+
+static int
+none_planar_to_i (const int * const *src, int channels, int *dest, int count, int shift)
+{	(void) src ; (void) channels ; (void) dest ; (void) count ; (void) shift ;
+	return 0 ;
+} /* none_planar_to_i */
+
+static int
+none_planar_to_f (const int * const *src, int channels, float *dest, int count, float normfact)
+{	(void) src ; (void) channels ; (void) dest ; (void) count ; (void) normfact ;
+	return 0 ;
+} /* none_planar_to_f */
+
+static int
+none_planar_to_d (const int * const *src, int channels, double *dest, int count, double normfact)
+{	(void) src ; (void) channels ; (void) dest ; (void) count ; (void) normfact ;
+	return 0 ;
+} /* none_planar_to_d */
+
+static int
+none_gsm_st_analysis (short *u, const short *rp, short *s, int count)
+{	(void) u ; (void) rp ; (void) s ; (void) count ;
+	return 0 ;
+} /* none_gsm_st_analysis */
+
+static int
+none_gsm_st_synthesis (short *v, const short *rrp, const short *wt, short *sr, int count)
+{	(void) v ; (void) rrp ; (void) wt ; (void) sr ; (void) count ;
+	return 0 ;
+} /* none_gsm_st_synthesis */
+
+static int
+none_gsm_acf (const float *s, int *acf)
+{	(void) s ; (void) acf ;
+	return 0 ;
+} /* none_gsm_acf */
+
+static int
+none_gsm_ltp_xcorr (const float *wt, const float *dp, float *xcorr)
+{	(void) wt ; (void) dp ; (void) xcorr ;
+	return 0 ;
+} /* none_gsm_ltp_xcorr */
+
+static int
+none_peak_d (const double *src, int count, int channels, double *peaks)
+{	(void) src ; (void) count ; (void) channels ; (void) peaks ;
+	return 0 ;
+} /* none_peak_d */
+
+static const PSF_SIMD none_kernels =
+{	PSF_SIMD_NONE, "none",
+	none_swap16, none_swap32,
+	none_pcm8_to_s, none_pcm8_to_i, none_pcm8_to_f, none_pcm8_to_d,
+	none_pcm16_to_i, none_pcm16_to_f, none_pcm16_to_d,
+	none_pcm32_to_s, none_pcm32_to_f, none_pcm32_to_d,
+	none_s_to_pcm8, none_i_to_pcm8, none_i_to_pcm16, none_s_to_pcm32,
+	none_pcm24_to_i, none_pcm24_to_f, none_pcm24_to_d,
+	none_i_to_pcm24, none_f_to_pcm24, none_d_to_pcm24,
+	none_f_to_s_clip, none_f_to_i_clip, none_d_to_s_clip, none_d_to_i_clip,
+	none_g711_to_s, none_g711_to_i, none_g711_to_f, none_g711_to_d,
+	none_s_to_g711, none_i_to_g711, none_f_to_g711, none_d_to_g711,
+	none_alac_unpc, none_alac_unmix,
+	none_planar_to_s, none_planar_to_i, none_planar_to_f, none_planar_to_d,
+	none_gsm_st_analysis, none_gsm_st_synthesis, none_gsm_acf, none_gsm_ltp_xcorr,
+	none_peak_d
+} ;
+
+/* The largest index into the G.711 encode tables. */
+static inline int
+g711_max_index (int law)
+{	return law == PSF_G711_ALAW ? 2048 : 8192 ;
+} /* g711_max_index */
+
+#if CPU_IS_X86_64
+/*==============================================================================
+**	SSE2 kernels.
+*/
+
+static inline __m128i
+sse2_bswap16 (__m128i v)
+{	return _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8)) ;
+} /* sse2_bswap16 */
+
+static inline __m128i
+sse2_bswap32 (__m128i v)
+{	v = _mm_shufflelo_epi16 (v, _MM_SHUFFLE (2, 3, 0, 1)) ;
+	v = _mm_shufflehi_epi16 (v, _MM_SHUFFLE (2, 3, 0, 1)) ;
+	return sse2_bswap16 (v) ;
+} /* sse2_bswap32 */
+
+/* Sign extend the low or high four 16 bit values to 32 bits. */
+static inline __m128i
+sse2_s16lo_to_s32 (__m128i v)
+{	return _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16) ;
+} /* sse2_s16lo_to_s32 */
+
+static inline __m128i
+sse2_s16hi_to_s32 (__m128i v)
+{	return _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16) ;
+} /* sse2_s16hi_to_s32 */
+
+/* Store four ints as doubles, scaled by normfact. */
+static inline void
+sse2_store_s32_as_d (double *dest, __m128i v, __m128d normfact)
+{	_mm_storeu_pd (dest, _mm_mul_pd (_mm_cvtepi32_pd (v), normfact)) ;
+	_mm_storeu_pd (dest + 2, _mm_mul_pd (_mm_cvtepi32_pd (_mm_shuffle_epi32 (v, _MM_SHUFFLE (3, 2, 3, 2))), normfact)) ;
+} /* sse2_store_s32_as_d */
+
+static int
+sse2_swap16 (const short *src, short *dest, int count)
+{	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+		_mm_storeu_si128 ((__m128i *) (dest + k), sse2_bswap16 (_mm_loadu_si128 ((const __m128i *) (src + k)))) ;
+
+	return k ;
+} /* sse2_swap16 */
+
+static int
+sse2_swap32 (const int *src, int *dest, int count)
+{	int k ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+		_mm_storeu_si128 ((__m128i *) (dest + k), sse2_bswap32 (_mm_loadu_si128 ((const __m128i *) (src + k)))) ;
+
+	return k ;
+} /* sse2_swap32 */
+
+static int
+sse2_pcm8_to_s (const unsigned char *src, short *dest, int count, int is_unsigned)
+{	__m128i bias, zero, v ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+	zero = _mm_setzero_si128 () ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (src + k)), bias) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_unpacklo_epi8 (zero, v)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k + 8), _mm_unpackhi_epi8 (zero, v)) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm8_to_s */
+
+static int
+sse2_pcm8_to_i (const unsigned char *src, int *dest, int count, int is_unsigned)
+{	__m128i bias, zero, v, lo, hi ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+	zero = _mm_setzero_si128 () ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (src + k)), bias) ;
+		lo = _mm_unpacklo_epi8 (zero, v) ;
+		hi = _mm_unpackhi_epi8 (zero, v) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_unpacklo_epi16 (zero, lo)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k + 4), _mm_unpackhi_epi16 (zero, lo)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k + 8), _mm_unpacklo_epi16 (zero, hi)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k + 12), _mm_unpackhi_epi16 (zero, hi)) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm8_to_i */
+
+static int
+sse2_pcm8_to_f (const unsigned char *src, float *dest, int count, int is_unsigned, float normfact)
+{	__m128i bias, v, lo, hi ;
+	__m128 fnorm ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+	fnorm = _mm_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (src + k)), bias) ;
+		/* Sign extended 16 bit values. */
+		lo = _mm_srai_epi16 (_mm_unpacklo_epi8 (v, v), 8) ;
+		hi = _mm_srai_epi16 (_mm_unpackhi_epi8 (v, v), 8) ;
+		_mm_storeu_ps (dest + k, _mm_mul_ps (_mm_cvtepi32_ps (sse2_s16lo_to_s32 (lo)), fnorm)) ;
+		_mm_storeu_ps (dest + k + 4, _mm_mul_ps (_mm_cvtepi32_ps (sse2_s16hi_to_s32 (lo)), fnorm)) ;
+		_mm_storeu_ps (dest + k + 8, _mm_mul_ps (_mm_cvtepi32_ps (sse2_s16lo_to_s32 (hi)), fnorm)) ;
+		_mm_storeu_ps (dest + k + 12, _mm_mul_ps (_mm_cvtepi32_ps (sse2_s16hi_to_s32 (hi)), fnorm)) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm8_to_f */
+
+static int
+sse2_pcm8_to_d (const unsigned char *src, double *dest, int count, int is_unsigned, double normfact)
+{	__m128i bias, v, lo, hi ;
+	__m128d dnorm ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+	dnorm = _mm_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (src + k)), bias) ;
+		lo = _mm_srai_epi16 (_mm_unpacklo_epi8 (v, v), 8) ;
+		hi = _mm_srai_epi16 (_mm_unpackhi_epi8 (v, v), 8) ;
+		sse2_store_s32_as_d (dest + k, sse2_s16lo_to_s32 (lo), dnorm) ;
+		sse2_store_s32_as_d (dest + k + 4, sse2_s16hi_to_s32 (lo), dnorm) ;
+		sse2_store_s32_as_d (dest + k + 8, sse2_s16lo_to_s32 (hi), dnorm) ;
+		sse2_store_s32_as_d (dest + k + 12, sse2_s16hi_to_s32 (hi), dnorm) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm8_to_d */
+
+static int
+sse2_pcm16_to_i (const short *src, int *dest, int count, int swap)
+{	__m128i zero, v ;
+	int k ;
+
+	zero = _mm_setzero_si128 () ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = sse2_bswap16 (v) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_unpacklo_epi16 (zero, v)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k + 4), _mm_unpackhi_epi16 (zero, v)) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm16_to_i */
+
+static int
+sse2_pcm16_to_f (const short *src, float *dest, int count, int swap, float normfact)
+{	__m128i v ;
+	__m128 fnorm ;
+	int k ;
+
+	fnorm = _mm_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = sse2_bswap16 (v) ;
+		_mm_storeu_ps (dest + k, _mm_mul_ps (_mm_cvtepi32_ps (sse2_s16lo_to_s32 (v)), fnorm)) ;
+		_mm_storeu_ps (dest + k + 4, _mm_mul_ps (_mm_cvtepi32_ps (sse2_s16hi_to_s32 (v)), fnorm)) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm16_to_f */
+
+static int
+sse2_pcm16_to_d (const short *src, double *dest, int count, int swap, double normfact)
+{	__m128i v ;
+	__m128d dnorm ;
+	int k ;
+
+	dnorm = _mm_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = sse2_bswap16 (v) ;
+		sse2_store_s32_as_d (dest + k, sse2_s16lo_to_s32 (v), dnorm) ;
+		sse2_store_s32_as_d (dest + k + 4, sse2_s16hi_to_s32 (v), dnorm) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm16_to_d */
+
+static int
+sse2_pcm32_to_s (const int *src, short *dest, int count, int swap)
+{	__m128i a, b ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		b = _mm_loadu_si128 ((const __m128i *) (src + k + 4)) ;
+		if (swap)
+		{	a = sse2_bswap32 (a) ;
+			b = sse2_bswap32 (b) ;
+			} ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_packs_epi32 (_mm_srai_epi32 (a, 16), _mm_srai_epi32 (b, 16))) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm32_to_s */
+
+static int
+sse2_pcm32_to_f (const int *src, float *dest, int count, int swap, float normfact)
+{	__m128i v ;
+	__m128 fnorm ;
+	int k ;
+
+	fnorm = _mm_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = sse2_bswap32 (v) ;
+		_mm_storeu_ps (dest + k, _mm_mul_ps (_mm_cvtepi32_ps (v), fnorm)) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm32_to_f */
+
+static int
+sse2_pcm32_to_d (const int *src, double *dest, int count, int swap, double normfact)
+{	__m128i v ;
+	__m128d dnorm ;
+	int k ;
+
+	dnorm = _mm_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = sse2_bswap32 (v) ;
+		sse2_store_s32_as_d (dest + k, v, dnorm) ;
+		} ;
+
+	return k ;
+} /* sse2_pcm32_to_d */
+
+static int
+sse2_s_to_pcm8 (const short *src, unsigned char *dest, int count, int is_unsigned)
+{	__m128i bias, a, b ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	a = _mm_srai_epi16 (_mm_loadu_si128 ((const __m128i *) (src + k)), 8) ;
+		b = _mm_srai_epi16 (_mm_loadu_si128 ((const __m128i *) (src + k + 8)), 8) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_xor_si128 (_mm_packs_epi16 (a, b), bias)) ;
+		} ;
+
+	return k ;
+} /* sse2_s_to_pcm8 */
+
+static int
+sse2_i_to_pcm8 (const int *src, unsigned char *dest, int count, int is_unsigned)
+{	__m128i bias, a, b, c, d ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	a = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *) (src + k)), 24) ;
+		b = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *) (src + k + 4)), 24) ;
+		c = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *) (src + k + 8)), 24) ;
+		d = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *) (src + k + 12)), 24) ;
+		a = _mm_packs_epi16 (_mm_packs_epi32 (a, b), _mm_packs_epi32 (c, d)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_xor_si128 (a, bias)) ;
+		} ;
+
+	return k ;
+} /* sse2_i_to_pcm8 */
+
+static int
+sse2_i_to_pcm16 (const int *src, short *dest, int count, int swap)
+{	__m128i a, b ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *) (src + k)), 16) ;
+		b = _mm_srai_epi32 (_mm_loadu_si128 ((const __m128i *) (src + k + 4)), 16) ;
+		a = _mm_packs_epi32 (a, b) ;
+		if (swap)
+			a = sse2_bswap16 (a) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), a) ;
+		} ;
+
+	return k ;
+} /* sse2_i_to_pcm16 */
+
+static int
+sse2_s_to_pcm32 (const short *src, int *dest, int count, int swap)
+{	__m128i zero, v, lo, hi ;
+	int k ;
+
+	zero = _mm_setzero_si128 () ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		lo = _mm_unpacklo_epi16 (zero, v) ;
+		hi = _mm_unpackhi_epi16 (zero, v) ;
+		if (swap)
+		{	lo = sse2_bswap32 (lo) ;
+			hi = sse2_bswap32 (hi) ;
+			} ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), lo) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k + 4), hi) ;
+		} ;
+
+	return k ;
+} /* sse2_s_to_pcm32 */
+
+/*
+**	Rounding conversion with saturation. The conversion gives INT_MIN for
+**	anything out of range, which is right for large negative values and
+**	is flipped to INT_MAX for large positive ones. Doubles are clamped
+**	before the conversion instead, both limits being exact.
+*/
+
+static inline __m128i
+sse2_f_to_i_sat (__m128 x)
+{	return _mm_xor_si128 (_mm_cvtps_epi32 (x), _mm_castps_si128 (_mm_cmpge_ps (x, _mm_set1_ps (2147483648.0f)))) ;
+} /* sse2_f_to_i_sat */
+
+static inline __m128i
+sse2_d_to_i_sat (__m128d a, __m128d b)
+{	const __m128d upper = _mm_set1_pd (1.0 * 0x7FFFFFFF), lower = _mm_set1_pd (-8.0 * 0x10000000) ;
+
+	a = _mm_min_pd (_mm_max_pd (a, lower), upper) ;
+	b = _mm_min_pd (_mm_max_pd (b, lower), upper) ;
+	return _mm_unpacklo_epi64 (_mm_cvtpd_epi32 (a), _mm_cvtpd_epi32 (b)) ;
+} /* sse2_d_to_i_sat */
+
+static int
+sse2_f_to_s_clip (const float *src, short *dest, int count, float normfact, int shift, int swap)
+{	__m128 fnorm, a, b ;
+	__m128i sh, v ;
+	int k ;
+
+	fnorm = _mm_set1_ps (normfact) ;
+	sh = _mm_cvtsi32_si128 (shift) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = _mm_mul_ps (_mm_loadu_ps (src + k), fnorm) ;
+		b = _mm_mul_ps (_mm_loadu_ps (src + k + 4), fnorm) ;
+		if (_mm_movemask_ps (_mm_cmpunord_ps (a, b)) != 0)
+			break ;
+		v = _mm_packs_epi32 (_mm_sra_epi32 (sse2_f_to_i_sat (a), sh), _mm_sra_epi32 (sse2_f_to_i_sat (b), sh)) ;
+		if (swap)
+			v = sse2_bswap16 (v) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* sse2_f_to_s_clip */
+
+static int
+sse2_f_to_i_clip (const float *src, int *dest, int count, float normfact, int swap)
+{	__m128 fnorm, x ;
+	__m128i v ;
+	int k ;
+
+	fnorm = _mm_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	x = _mm_mul_ps (_mm_loadu_ps (src + k), fnorm) ;
+		if (_mm_movemask_ps (_mm_cmpunord_ps (x, x)) != 0)
+			break ;
+		v = sse2_f_to_i_sat (x) ;
+		if (swap)
+			v = sse2_bswap32 (v) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* sse2_f_to_i_clip */
+
+static int
+sse2_d_to_s_clip (const double *src, short *dest, int count, double normfact, int shift, int swap)
+{	__m128d dnorm, a, b, c, d ;
+	__m128i sh, v ;
+	int k ;
+
+	dnorm = _mm_set1_pd (normfact) ;
+	sh = _mm_cvtsi32_si128 (shift) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = _mm_mul_pd (_mm_loadu_pd (src + k), dnorm) ;
+		b = _mm_mul_pd (_mm_loadu_pd (src + k + 2), dnorm) ;
+		c = _mm_mul_pd (_mm_loadu_pd (src + k + 4), dnorm) ;
+		d = _mm_mul_pd (_mm_loadu_pd (src + k + 6), dnorm) ;
+		if (_mm_movemask_pd (_mm_or_pd (_mm_cmpunord_pd (a, b), _mm_cmpunord_pd (c, d))) != 0)
+			break ;
+		v = _mm_packs_epi32 (_mm_sra_epi32 (sse2_d_to_i_sat (a, b), sh), _mm_sra_epi32 (sse2_d_to_i_sat (c, d), sh)) ;
+		if (swap)
+			v = sse2_bswap16 (v) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* sse2_d_to_s_clip */
+
+static int
+sse2_d_to_i_clip (const double *src, int *dest, int count, double normfact, int swap)
+{	__m128d dnorm, a, b ;
+	__m128i v ;
+	int k ;
+
+	dnorm = _mm_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	a = _mm_mul_pd (_mm_loadu_pd (src + k), dnorm) ;
+		b = _mm_mul_pd (_mm_loadu_pd (src + k + 2), dnorm) ;
+		if (_mm_movemask_pd (_mm_cmpunord_pd (a, b)) != 0)
+			break ;
+		v = sse2_d_to_i_sat (a, b) ;
+		if (swap)
+			v = sse2_bswap32 (v) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* sse2_d_to_i_clip */
+
+/*
+**	G.711 encoding is done in 16 bit lanes with the same arithmetic as the
+**	tables in ulaw.c and alaw.c. The segment shifts differ from lane to
+**	lane, which SSE2 can't do directly, so they are built from conditional
+**	shifts by 1, 2 and 4 bits.
+*/
+
+static inline __m128i
+sse2_select (__m128i mask, __m128i a, __m128i b)
+{	return _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b)) ;
+} /* sse2_select */
+
+/* All ones in the lanes of v which have all of bits set. */
+static inline __m128i
+sse2_test16 (__m128i v, int bits)
+{	const __m128i b = _mm_set1_epi16 (bits) ;
+
+	return _mm_cmpeq_epi16 (_mm_and_si128 (v, b), b) ;
+} /* sse2_test16 */
+
+/* Shift each lane of v right by the count (0 - 7) in the same lane of shift. */
+static inline __m128i
+sse2_srlv16 (__m128i v, __m128i shift)
+{	v = sse2_select (sse2_test16 (shift, 1), _mm_srli_epi16 (v, 1), v) ;
+	v = sse2_select (sse2_test16 (shift, 2), _mm_srli_epi16 (v, 2), v) ;
+	return sse2_select (sse2_test16 (shift, 4), _mm_srli_epi16 (v, 4), v) ;
+} /* sse2_srlv16 */
+
+/*
+**	Encode from the table index m and a sign mask, giving the code in the
+**	low half of each lane. Each segment threshold passed adds one to e.
+*/
+static inline __m128i
+sse2_g711_encode (__m128i m, __m128i sign, int law)
+{	__m128i b, e, mant ;
+	int k ;
+
+	e = _mm_setzero_si128 () ;
+
+	if (law == PSF_G711_ALAW)
+	{	b = _mm_min_epi16 (m, _mm_set1_epi16 (0x7FF)) ;
+		for (k = 0xF ; k < 0x7FF ; k = 2 * k + 1)
+			e = _mm_sub_epi16 (e, _mm_cmpgt_epi16 (b, _mm_set1_epi16 (k))) ;
+		/* Segments above 0 drop the leading one and shift by e - 1. */
+		mant = sse2_srlv16 (b, _mm_add_epi16 (e, _mm_cmpgt_epi16 (b, _mm_set1_epi16 (0xF)))) ;
+		}
+	else
+	{	b = _mm_min_epi16 (_mm_add_epi16 (m, _mm_set1_epi16 (33)), _mm_set1_epi16 (0x1FFF)) ;
+		for (k = 0x3F ; k < 0x1FFF ; k = 2 * k + 1)
+			e = _mm_sub_epi16 (e, _mm_cmpgt_epi16 (b, _mm_set1_epi16 (k))) ;
+		mant = sse2_srlv16 (_mm_srli_epi16 (b, 1), e) ;
+		} ;
+
+	mant = _mm_or_si128 (_mm_slli_epi16 (e, 4), _mm_and_si128 (mant, _mm_set1_epi16 (0xF))) ;
+	sign = _mm_and_si128 (sign, _mm_set1_epi16 (0x80)) ;
+
+	return _mm_xor_si128 (mant, _mm_xor_si128 (sign, _mm_set1_epi16 (law == PSF_G711_ALAW ? 0xD5 : 0xFF))) ;
+} /* sse2_g711_encode */
+
+/* Encode from four lots of 32 bit table indices and sign masks. */
+static inline __m128i
+sse2_g711_encode_s32 (const __m128i *m, const __m128i *sign, int law)
+{	return _mm_packus_epi16 (
+				sse2_g711_encode (_mm_packs_epi32 (m [0], m [1]), _mm_packs_epi32 (sign [0], sign [1]), law),
+				sse2_g711_encode (_mm_packs_epi32 (m [2], m [3]), _mm_packs_epi32 (sign [2], sign [3]), law)) ;
+} /* sse2_g711_encode_s32 */
+
+static inline __m128i
+sse2_abs32 (__m128i v)
+{	__m128i sign = _mm_srai_epi32 (v, 31) ;
+
+	return _mm_sub_epi32 (_mm_xor_si128 (v, sign), sign) ;
+} /* sse2_abs32 */
+
+static int
+sse2_s_to_g711 (const short *src, unsigned char *dest, int count, int law)
+{	__m128i a, b, sa, sb ;
+	int k, shift ;
+
+	shift = law == PSF_G711_ALAW ? 4 : 2 ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	a = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		b = _mm_loadu_si128 ((const __m128i *) (src + k + 8)) ;
+		sa = _mm_srai_epi16 (a, 15) ;
+		sb = _mm_srai_epi16 (b, 15) ;
+		/* The magnitude of -32768 is 0x8000 as an unsigned value. */
+		a = _mm_srli_epi16 (_mm_sub_epi16 (_mm_xor_si128 (a, sa), sa), shift) ;
+		b = _mm_srli_epi16 (_mm_sub_epi16 (_mm_xor_si128 (b, sb), sb), shift) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), _mm_packus_epi16 (sse2_g711_encode (a, sa, law), sse2_g711_encode (b, sb, law))) ;
+		} ;
+
+	return k ;
+} /* sse2_s_to_g711 */
+
+static int
+sse2_i_to_g711 (const int *src, unsigned char *dest, int count, int law)
+{	const __m128i int_min = _mm_set1_epi32 (-0x7FFFFFFF - 1) ;
+	__m128i v, m [4], sign [4] ;
+	int k, j, shift ;
+
+	shift = 16 + (law == PSF_G711_ALAW ? 4 : 2) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	for (j = 0 ; j < 4 ; j++)
+		{	v = _mm_loadu_si128 ((const __m128i *) (src + k + 4 * j)) ;
+			/* Like the scalar code, INT_MIN is encoded as a positive value. */
+			sign [j] = _mm_andnot_si128 (_mm_cmpeq_epi32 (v, int_min), _mm_srai_epi32 (v, 31)) ;
+			m [j] = _mm_srli_epi32 (sse2_abs32 (v), shift) ;
+			} ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), sse2_g711_encode_s32 (m, sign, law)) ;
+		} ;
+
+	return k ;
+} /* sse2_i_to_g711 */
+
+static int
+sse2_f_to_g711 (const float *src, unsigned char *dest, int count, int law, float normfact)
+{	const __m128 zero = _mm_setzero_ps (), abs_mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7FFFFFFF)) ;
+	__m128 fnorm, limit, x, scaled ;
+	__m128i m [4], sign [4] ;
+	int k, j, out_of_range ;
+
+	fnorm = _mm_set1_ps (normfact) ;
+	limit = _mm_set1_ps (g711_max_index (law)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	out_of_range = 0 ;
+		for (j = 0 ; j < 4 ; j++)
+		{	x = _mm_loadu_ps (src + k + 4 * j) ;
+			scaled = _mm_mul_ps (x, fnorm) ;
+			out_of_range |= _mm_movemask_ps (_mm_cmpnle_ps (_mm_and_ps (scaled, abs_mask), limit)) ;
+			sign [j] = _mm_castps_si128 (_mm_cmplt_ps (x, zero)) ;
+			m [j] = sse2_abs32 (_mm_cvtps_epi32 (scaled)) ;
+			} ;
+		if (out_of_range)
+			break ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), sse2_g711_encode_s32 (m, sign, law)) ;
+		} ;
+
+	return k ;
+} /* sse2_f_to_g711 */
+
+/* Four doubles to two 32 bit values in each of the low halves. */
+static inline __m128i
+sse2_pack_pd_mask (__m128d a, __m128d b)
+{	return _mm_unpacklo_epi64 (_mm_shuffle_epi32 (_mm_castpd_si128 (a), _MM_SHUFFLE (3, 3, 2, 0)),
+				_mm_shuffle_epi32 (_mm_castpd_si128 (b), _MM_SHUFFLE (3, 3, 2, 0))) ;
+} /* sse2_pack_pd_mask */
+
+static int
+sse2_d_to_g711 (const double *src, unsigned char *dest, int count, int law, double normfact)
+{	const __m128d zero = _mm_setzero_pd (), abs_mask = _mm_castsi128_pd (_mm_set1_epi64x (0x7FFFFFFFFFFFFFFFLL)) ;
+	__m128d dnorm, limit, a, b, sa, sb ;
+	__m128i m [4], sign [4] ;
+	int k, j, out_of_range ;
+
+	dnorm = _mm_set1_pd (normfact) ;
+	limit = _mm_set1_pd (g711_max_index (law)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	out_of_range = 0 ;
+		for (j = 0 ; j < 4 ; j++)
+		{	a = _mm_loadu_pd (src + k + 4 * j) ;
+			b = _mm_loadu_pd (src + k + 4 * j + 2) ;
+			sa = _mm_mul_pd (a, dnorm) ;
+			sb = _mm_mul_pd (b, dnorm) ;
+			out_of_range |= _mm_movemask_pd (_mm_or_pd (_mm_cmpnle_pd (_mm_and_pd (sa, abs_mask), limit),
+								_mm_cmpnle_pd (_mm_and_pd (sb, abs_mask), limit))) ;
+			sign [j] = sse2_pack_pd_mask (_mm_cmplt_pd (a, zero), _mm_cmplt_pd (b, zero)) ;
+			m [j] = sse2_abs32 (_mm_unpacklo_epi64 (_mm_cvtpd_epi32 (sa), _mm_cvtpd_epi32 (sb))) ;
+			} ;
+		if (out_of_range)
+			break ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), sse2_g711_encode_s32 (m, sign, law)) ;
+		} ;
+
+	return k ;
+} /* sse2_d_to_g711 */
+
+/* The low 32 bits of a * b, which SSE2 can only do for two lanes at a time. */
+static inline __m128i
+sse2_mullo32 (__m128i a, __m128i b)
+{	__m128i even, odd ;
+
+	even = _mm_mul_epu32 (a, b) ;
+	odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32)) ;
+	return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)), _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0))) ;
+} /* sse2_mullo32 */
+
+static int
+sse2_alac_unmix (const int *u, const int *v, int *out, int count, int mixbits, int mixres, int shift)
+{	__m128i mix, mshift, lshift, l, r ;
+	int k ;
+
+	if (mixbits < 0 || mixbits > 31 || shift < 0 || shift > 31)
+		return 0 ;
+
+	mix = _mm_set1_epi32 (mixres) ;
+	mshift = _mm_cvtsi32_si128 (mixbits) ;
+	lshift = _mm_cvtsi32_si128 (shift) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	l = _mm_loadu_si128 ((const __m128i *) (u + k)) ;
+		r = _mm_loadu_si128 ((const __m128i *) (v + k)) ;
+		if (mixres != 0)
+		{	l = _mm_sub_epi32 (_mm_add_epi32 (l, r), _mm_sra_epi32 (sse2_mullo32 (mix, r), mshift)) ;
+			r = _mm_sub_epi32 (l, r) ;
+			} ;
+		l = _mm_sll_epi32 (l, lshift) ;
+		r = _mm_sll_epi32 (r, lshift) ;
+		_mm_storeu_si128 ((__m128i *) (out + 2 * k), _mm_unpacklo_epi32 (l, r)) ;
+		_mm_storeu_si128 ((__m128i *) (out + 2 * k + 4), _mm_unpackhi_epi32 (l, r)) ;
+		} ;
+
+	return k ;
+} /* sse2_alac_unmix */
+
+/*
+**	Load the next eight interleaved samples of one or two channels, which
+**	is eight mono frames or four stereo ones.
+*/
+static inline void
+sse2_planar_load8 (const int * const *src, int channels, int k, __m128i *a, __m128i *b)
+{	__m128i l, r ;
+
+	l = _mm_loadu_si128 ((const __m128i *) (src [0] + k)) ;
+	if (channels == 1)
+	{	*a = l ;
+		*b = _mm_loadu_si128 ((const __m128i *) (src [0] + k + 4)) ;
+		return ;
+		} ;
+
+	r = _mm_loadu_si128 ((const __m128i *) (src [1] + k)) ;
+	*a = _mm_unpacklo_epi32 (l, r) ;
+	*b = _mm_unpackhi_epi32 (l, r) ;
+} /* sse2_planar_load8 */
+
+static int
+sse2_planar_to_s (const int * const *src, int channels, short *dest, int count, int shift)
+{	__m128i lshift, rshift, a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2 || shift < -31 || shift > 31)
+		return 0 ;
+
+	lshift = _mm_cvtsi32_si128 (shift > 0 ? shift : 0) ;
+	rshift = _mm_cvtsi32_si128 (shift < 0 ? -shift : 0) ;
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	sse2_planar_load8 (src, channels, k, &a, &b) ;
+		a = _mm_sra_epi32 (_mm_sll_epi32 (a, lshift), rshift) ;
+		b = _mm_sra_epi32 (_mm_sll_epi32 (b, lshift), rshift) ;
+		/* Sign extend the low 16 bits so the saturating pack truncates. */
+		a = _mm_srai_epi32 (_mm_slli_epi32 (a, 16), 16) ;
+		b = _mm_srai_epi32 (_mm_slli_epi32 (b, 16), 16) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k * channels), _mm_packs_epi32 (a, b)) ;
+		} ;
+
+	return k ;
+} /* sse2_planar_to_s */
+
+static int
+sse2_planar_to_i (const int * const *src, int channels, int *dest, int count, int shift)
+{	__m128i lshift, a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2 || shift < 0 || shift > 31)
+		return 0 ;
+
+	lshift = _mm_cvtsi32_si128 (shift) ;
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	sse2_planar_load8 (src, channels, k, &a, &b) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k * channels), _mm_sll_epi32 (a, lshift)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k * channels + 4), _mm_sll_epi32 (b, lshift)) ;
+		} ;
+
+	return k ;
+} /* sse2_planar_to_i */
+
+static int
+sse2_planar_to_f (const int * const *src, int channels, float *dest, int count, float normfact)
+{	__m128 norm ;
+	__m128i a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	norm = _mm_set1_ps (normfact) ;
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	sse2_planar_load8 (src, channels, k, &a, &b) ;
+		_mm_storeu_ps (dest + k * channels, _mm_mul_ps (_mm_cvtepi32_ps (a), norm)) ;
+		_mm_storeu_ps (dest + k * channels + 4, _mm_mul_ps (_mm_cvtepi32_ps (b), norm)) ;
+		} ;
+
+	return k ;
+} /* sse2_planar_to_f */
+
+static int
+sse2_planar_to_d (const int * const *src, int channels, double *dest, int count, double normfact)
+{	__m128d norm ;
+	__m128i a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	norm = _mm_set1_pd (normfact) ;
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	sse2_planar_load8 (src, channels, k, &a, &b) ;
+		sse2_store_s32_as_d (dest + k * channels, a, norm) ;
+		sse2_store_s32_as_d (dest + k * channels + 4, b, norm) ;
+		} ;
+
+	return k ;
+} /* sse2_planar_to_d */
+
+/*
+**	GSM_MULT_R () in each lane: twice the high half of the product plus the
+**	rounded top two bits of the low half. Like the SSSE3 instruction, it
+**	gives -32768 for -32768 squared.
+*/
+static inline __m128i
+sse2_gsm_mult_r (__m128i a, __m128i b)
+{	__m128i lo, hi ;
+
+	lo = _mm_mullo_epi16 (a, b) ;
+	hi = _mm_mulhi_epi16 (a, b) ;
+	return _mm_add_epi16 (_mm_slli_epi16 (hi, 1), _mm_avg_epu16 (_mm_srli_epi16 (lo, 14), _mm_setzero_si128 ())) ;
+} /* sse2_gsm_mult_r */
+
+/*
+**	Each stage of the lattice needs the output of the one before it for the
+**	same sample, so lane i runs stage i on sample t - i, one step behind the
+**	lane below it. Lanes outside the samples compute rubbish which is never
+**	used and must not change the state.
+*/
+static int
+sse2_gsm_st_analysis (short *u, const short *rp, short *s, int count)
+{	__m128i lanes, vrp, vu, din, sin, dout, sout, active ;
+	int t ;
+
+	lanes = _mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7) ;
+	vrp = _mm_loadu_si128 ((const __m128i *) rp) ;
+	vu = _mm_loadu_si128 ((const __m128i *) u) ;
+	dout = sout = _mm_setzero_si128 () ;
+
+	for (t = 0 ; t < count + 7 ; t++)
+	{	din = _mm_slli_si128 (dout, 2) ;
+		sin = _mm_slli_si128 (sout, 2) ;
+		if (t < count)
+		{	din = _mm_insert_epi16 (din, s [t], 0) ;
+			sin = _mm_insert_epi16 (sin, s [t], 0) ;
+			} ;
+
+		sout = _mm_adds_epi16 (vu, sse2_gsm_mult_r (vrp, din)) ;
+		dout = _mm_adds_epi16 (din, sse2_gsm_mult_r (vrp, vu)) ;
+
+		active = _mm_and_si128 (_mm_cmplt_epi16 (lanes, _mm_set1_epi16 (t + 1)), _mm_cmpgt_epi16 (lanes, _mm_set1_epi16 (t - count))) ;
+		vu = _mm_or_si128 (_mm_and_si128 (active, sin), _mm_andnot_si128 (active, vu)) ;
+
+		if (t >= 7)
+			s [t - 7] = _mm_extract_epi16 (dout, 7) ;
+		} ;
+
+	_mm_storeu_si128 ((__m128i *) u, vu) ;
+
+	return count ;
+} /* sse2_gsm_st_analysis */
+
+/*
+**	Here stage i needs sri from stage i + 1 for the same sample and v [i]
+**	from stage i - 1 for the previous one, so lane i runs stage i on sample
+**	n at step 2 * n + 7 - i and only half the lanes work at each step.
+*/
+static int
+sse2_gsm_st_synthesis (short *v, const short *rrp, const short *wt, short *sr, int count)
+{	__m128i lanes, lane0, vrrp, vv, sri, vnext, pos, active ;
+	int t, v8 ;
+
+	lanes = _mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7) ;
+	lane0 = _mm_setr_epi16 (-1, 0, 0, 0, 0, 0, 0, 0) ;
+	vrrp = _mm_loadu_si128 ((const __m128i *) rrp) ;
+	vv = _mm_loadu_si128 ((const __m128i *) v) ;
+	v8 = v [8] ;
+	sri = _mm_setzero_si128 () ;
+
+	for (t = 0 ; t < 2 * count + 6 ; t++)
+	{	sri = _mm_srli_si128 (sri, 2) ;
+		if ((t & 1) == 0 && t < 2 * count)
+			sri = _mm_insert_epi16 (sri, wt [t / 2], 7) ;
+
+		sri = _mm_subs_epi16 (sri, sse2_gsm_mult_r (vrrp, vv)) ;
+		vnext = _mm_adds_epi16 (vv, sse2_gsm_mult_r (vrrp, sri)) ;
+
+		/* Twice the sample number each lane is working on. */
+		pos = _mm_add_epi16 (lanes, _mm_set1_epi16 (t - 7)) ;
+		active = _mm_cmpeq_epi16 (_mm_and_si128 (pos, _mm_set1_epi16 (1)), _mm_setzero_si128 ()) ;
+		active = _mm_and_si128 (active, _mm_cmpgt_epi16 (pos, _mm_set1_epi16 (-1))) ;
+		active = _mm_and_si128 (active, _mm_cmplt_epi16 (pos, _mm_set1_epi16 (2 * count - 1))) ;
+
+		if ((t & 1) == 0 && t < 2 * count)
+			v8 = (short) _mm_extract_epi16 (vnext, 7) ;
+
+		/* Stage i sets v [i + 1], and stage 0 sets v [0] to its output. */
+		vnext = _mm_insert_epi16 (_mm_slli_si128 (vnext, 2), _mm_extract_epi16 (sri, 0), 0) ;
+		active = _mm_or_si128 (_mm_slli_si128 (active, 2), _mm_and_si128 (active, lane0)) ;
+		vv = _mm_or_si128 (_mm_and_si128 (active, vnext), _mm_andnot_si128 (active, vv)) ;
+
+		if ((t & 1) != 0 && t >= 7)
+			sr [(t - 7) / 2] = _mm_extract_epi16 (sri, 0) ;
+		} ;
+
+	_mm_storeu_si128 ((__m128i *) v, vv) ;
+	v [8] = v8 ;
+
+	return count ;
+} /* sse2_gsm_st_synthesis */
+
+static inline int
+sse2_hsum_epi32 (__m128i v)
+{	v = _mm_add_epi32 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (1, 0, 3, 2))) ;
+	v = _mm_add_epi32 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (2, 3, 0, 1))) ;
+	return _mm_cvtsi128_si32 (v) ;
+} /* sse2_hsum_epi32 */
+
+static int
+sse2_gsm_acf (const float *s, int *acf)
+{	float pad [8 + 160] ;
+	__m128i sum [9] ;
+	__m128 x ;
+	int i, k ;
+
+	/* The zeros in front stand in for the missing products of the first lags. */
+	for (i = 0 ; i < 8 ; i++)
+		pad [i] = 0.0f ;
+	for (i = 0 ; i < 160 ; i++)
+		pad [i + 8] = s [i] ;
+	for (k = 0 ; k < 9 ; k++)
+		sum [k] = _mm_setzero_si128 () ;
+
+	for (i = 8 ; i < 8 + 160 ; i += 4)
+	{	x = _mm_loadu_ps (pad + i) ;
+		for (k = 0 ; k < 9 ; k++)
+			sum [k] = _mm_add_epi32 (sum [k], _mm_cvttps_epi32 (_mm_mul_ps (x, _mm_loadu_ps (pad + i - k)))) ;
+		} ;
+
+	for (k = 0 ; k < 9 ; k++)
+		acf [k] = sse2_hsum_epi32 (sum [k]) ;
+
+	return 9 ;
+} /* sse2_gsm_acf */
+
+#if HAVE_GSM_LTP_KERNELS
+
+/* Lag 40, which is left over from the vectors. */
+static inline float
+gsm_ltp_xcorr40 (const float *wt, const float *dp)
+{	float sum = 0.0f, product ;
+	int k ;
+
+	for (k = 0 ; k < 40 ; k++)
+	{	product = wt [k] * dp [k - 40] ;
+		sum += product ;
+		} ;
+
+	return sum ;
+} /* gsm_ltp_xcorr40 */
+
+/*
+**	Each vector holds four lags, highest first so the samples they need are
+**	in order in dp, and the vectors for lags 41 to 120 all work together.
+*/
+static int
+sse2_gsm_ltp_xcorr (const float *wt, const float *dp, float *xcorr)
+{	__m128 sum [20], w ;
+	int j, k ;
+
+	for (j = 0 ; j < 20 ; j++)
+		sum [j] = _mm_setzero_ps () ;
+
+	for (k = 0 ; k < 40 ; k++)
+	{	w = _mm_set1_ps (wt [k]) ;
+		for (j = 0 ; j < 20 ; j++)
+			sum [j] = _mm_add_ps (sum [j], _mm_mul_ps (w, _mm_loadu_ps (dp + k - 120 + 4 * j))) ;
+		} ;
+
+	for (j = 0 ; j < 20 ; j++)
+		_mm_storeu_ps (xcorr + 77 - 4 * j, _mm_shuffle_ps (sum [j], sum [j], _MM_SHUFFLE (0, 1, 2, 3))) ;
+	xcorr [0] = gsm_ltp_xcorr40 (wt, dp) ;
+
+	return 81 ;
+} /* sse2_gsm_ltp_xcorr */
+
+#endif
+
+/*
+**	Each lane keeps the peak of one channel (two lanes for mono). maxpd
+**	returns its second operand when either is a NaN, so putting the running
+**	peak second ignores NaNs in the data like the scalar comparison does.
+*/
+static int
+sse2_peak_d (const double *src, int count, int channels, double *peaks)
+{	__m128d sign, max0, max1 ;
+	int k ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	sign = _mm_set1_pd (-0.0) ;
+	max0 = channels == 1 ? _mm_set1_pd (peaks [0]) : _mm_loadu_pd (peaks) ;
+	max1 = max0 ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	max0 = _mm_max_pd (_mm_andnot_pd (sign, _mm_loadu_pd (src + k)), max0) ;
+		max1 = _mm_max_pd (_mm_andnot_pd (sign, _mm_loadu_pd (src + k + 2)), max1) ;
+		} ;
+
+	max0 = _mm_max_pd (max0, max1) ;
+	if (channels == 1)
+		_mm_store_sd (peaks, _mm_max_sd (max0, _mm_unpackhi_pd (max0, max0))) ;
+	else
+		_mm_storeu_pd (peaks, max0) ;
+
+	return k ;
+} /* sse2_peak_d */
+
+static const PSF_SIMD sse2_kernels =
+{	PSF_SIMD_SSE2, "sse2",
+	sse2_swap16, sse2_swap32,
+	sse2_pcm8_to_s, sse2_pcm8_to_i, sse2_pcm8_to_f, sse2_pcm8_to_d,
+	sse2_pcm16_to_i, sse2_pcm16_to_f, sse2_pcm16_to_d,
+	sse2_pcm32_to_s, sse2_pcm32_to_f, sse2_pcm32_to_d,
+	sse2_s_to_pcm8, sse2_i_to_pcm8, sse2_i_to_pcm16, sse2_s_to_pcm32,
+	/* Packed 24 bit data needs byte shuffles, which SSE2 doesn't have. */
+	none_pcm24_to_i, none_pcm24_to_f, none_pcm24_to_d,
+	none_i_to_pcm24, none_f_to_pcm24, none_d_to_pcm24,
+	sse2_f_to_s_clip, sse2_f_to_i_clip, sse2_d_to_s_clip, sse2_d_to_i_clip,
+	/* Decoding G.711 with SSE2 is no faster than the table lookup. */
+	none_g711_to_s, none_g711_to_i, none_g711_to_f, none_g711_to_d,
+	sse2_s_to_g711, sse2_i_to_g711, sse2_f_to_g711, sse2_d_to_g711,
+	/* The predictor needs the SSSE3 sign and SSE4.1 multiply instructions. */
+	none_alac_unpc, sse2_alac_unmix,
+	sse2_planar_to_s, sse2_planar_to_i, sse2_planar_to_f, sse2_planar_to_d,
+#if HAVE_GSM_LTP_KERNELS
+	sse2_gsm_st_analysis, sse2_gsm_st_synthesis, sse2_gsm_acf, sse2_gsm_ltp_xcorr,
+#else
+	sse2_gsm_st_analysis, sse2_gsm_st_synthesis, sse2_gsm_acf, none_gsm_ltp_xcorr,
+#endif
+	sse2_peak_d
+} ;
+
+#if HAVE_AVX2_KERNELS
+/*==============================================================================
+**	AVX2 kernels for the most heavily used conversions. The others are
+**	memory bound anyway and use the SSE2 versions.
+*/
+
+#define	AVX2_BSWAP16_MASK	14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1
+#define	AVX2_BSWAP32_MASK	12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+
+static AVX2_FUNC int
+avx2_swap16 (const short *src, short *dest, int count)
+{	__m256i mask ;
+	int k ;
+
+	mask = _mm256_set_epi8 (AVX2_BSWAP16_MASK, AVX2_BSWAP16_MASK) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+		_mm256_storeu_si256 ((__m256i *) (dest + k), _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *) (src + k)), mask)) ;
+
+	return k ;
+} /* avx2_swap16 */
+
+static AVX2_FUNC int
+avx2_swap32 (const int *src, int *dest, int count)
+{	__m256i mask ;
+	int k ;
+
+	mask = _mm256_set_epi8 (AVX2_BSWAP32_MASK, AVX2_BSWAP32_MASK) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+		_mm256_storeu_si256 ((__m256i *) (dest + k), _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *) (src + k)), mask)) ;
+
+	return k ;
+} /* avx2_swap32 */
+
+static AVX2_FUNC int
+avx2_pcm8_to_f (const unsigned char *src, float *dest, int count, int is_unsigned, float normfact)
+{	__m128i bias, v ;
+	__m256 fnorm ;
+	int k ;
+
+	bias = _mm_set1_epi8 (is_unsigned ? (char) 0x80 : 0) ;
+	fnorm = _mm256_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (src + k)), bias) ;
+		_mm256_storeu_ps (dest + k, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepi8_epi32 (v)), fnorm)) ;
+		v = _mm_srli_si128 (v, 8) ;
+		_mm256_storeu_ps (dest + k + 8, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepi8_epi32 (v)), fnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm8_to_f */
+
+static AVX2_FUNC int
+avx2_pcm16_to_i (const short *src, int *dest, int count, int swap)
+{	__m128i mask, v ;
+	int k ;
+
+	mask = _mm_set_epi8 (AVX2_BSWAP16_MASK) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = _mm_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k), _mm256_slli_epi32 (_mm256_cvtepi16_epi32 (v), 16)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm16_to_i */
+
+static AVX2_FUNC int
+avx2_pcm16_to_f (const short *src, float *dest, int count, int swap, float normfact)
+{	__m128i mask, v ;
+	__m256 fnorm ;
+	int k ;
+
+	mask = _mm_set_epi8 (AVX2_BSWAP16_MASK) ;
+	fnorm = _mm256_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = _mm_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_ps (dest + k, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (v)), fnorm)) ;
+
+		v = _mm_loadu_si128 ((const __m128i *) (src + k + 8)) ;
+		if (swap)
+			v = _mm_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_ps (dest + k + 8, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (v)), fnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm16_to_f */
+
+static AVX2_FUNC int
+avx2_pcm16_to_d (const short *src, double *dest, int count, int swap, double normfact)
+{	__m128i mask, v ;
+	__m256d dnorm ;
+	int k ;
+
+	mask = _mm_set_epi8 (AVX2_BSWAP16_MASK) ;
+	dnorm = _mm256_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = _mm_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_pd (dest + k, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm_cvtepi16_epi32 (v)), dnorm)) ;
+		v = _mm_srli_si128 (v, 8) ;
+		_mm256_storeu_pd (dest + k + 4, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm_cvtepi16_epi32 (v)), dnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm16_to_d */
+
+static AVX2_FUNC int
+avx2_pcm32_to_f (const int *src, float *dest, int count, int swap, float normfact)
+{	__m256i mask, v ;
+	__m256 fnorm ;
+	int k ;
+
+	mask = _mm256_set_epi8 (AVX2_BSWAP32_MASK, AVX2_BSWAP32_MASK) ;
+	fnorm = _mm256_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = _mm256_loadu_si256 ((const __m256i *) (src + k)) ;
+		if (swap)
+			v = _mm256_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_ps (dest + k, _mm256_mul_ps (_mm256_cvtepi32_ps (v), fnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm32_to_f */
+
+static AVX2_FUNC int
+avx2_pcm32_to_d (const int *src, double *dest, int count, int swap, double normfact)
+{	__m128i mask, v ;
+	__m256d dnorm ;
+	int k ;
+
+	mask = _mm_set_epi8 (AVX2_BSWAP32_MASK) ;
+	dnorm = _mm256_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	v = _mm_loadu_si128 ((const __m128i *) (src + k)) ;
+		if (swap)
+			v = _mm_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_pd (dest + k, _mm256_mul_pd (_mm256_cvtepi32_pd (v), dnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm32_to_d */
+
+/*
+**	Packed 24 bit data. Eight samples are 24 bytes, which are loaded as two
+**	overlapping 16 byte halves (bytes 0-15 and 8-23) so the loads never go
+**	past the end of the data. Packing compacts each half to 12 bytes and
+**	then moves the two halves together.
+*/
+
+#define	AVX2_LET_UNPACK_MASK	\
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,			\
+			-1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15
+#define	AVX2_BET_UNPACK_MASK	\
+			-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,			\
+			-1, 6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13
+#define	AVX2_LET_PACK_MASK		1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1
+#define	AVX2_BET_PACK_MASK		3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1
+
+static inline AVX2_FUNC __m256i
+avx2_unpack_mask (int big_endian)
+{	return big_endian ? _mm256_setr_epi8 (AVX2_BET_UNPACK_MASK) : _mm256_setr_epi8 (AVX2_LET_UNPACK_MASK) ;
+} /* avx2_unpack_mask */
+
+static inline AVX2_FUNC __m256i
+avx2_pack_mask (int big_endian)
+{	return big_endian ? _mm256_setr_epi8 (AVX2_BET_PACK_MASK, AVX2_BET_PACK_MASK)
+					: _mm256_setr_epi8 (AVX2_LET_PACK_MASK, AVX2_LET_PACK_MASK) ;
+} /* avx2_pack_mask */
+
+/* Eight samples to ints with the sample in the top three bytes. */
+static inline AVX2_FUNC __m256i
+avx2_load_pcm24 (const unsigned char *src, __m256i mask)
+{	__m256i v ;
+
+	v = _mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) src)) ;
+	v = _mm256_inserti128_si256 (v, _mm_loadu_si128 ((const __m128i *) (src + 8)), 1) ;
+	return _mm256_shuffle_epi8 (v, mask) ;
+} /* avx2_load_pcm24 */
+
+/* The top three bytes of eight ints to 24 bytes of packed data. */
+static inline AVX2_FUNC void
+avx2_store_pcm24 (unsigned char *dest, __m256i v, __m256i mask)
+{
+	v = _mm256_shuffle_epi8 (v, mask) ;
+	v = _mm256_permutevar8x32_epi32 (v, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7)) ;
+	_mm_storeu_si128 ((__m128i *) dest, _mm256_castsi256_si128 (v)) ;
+	_mm_storel_epi64 ((__m128i *) (dest + 16), _mm256_extracti128_si256 (v, 1)) ;
+} /* avx2_store_pcm24 */
+
+static AVX2_FUNC int
+avx2_pcm24_to_i (const unsigned char *src, int *dest, int count, int big_endian)
+{	__m256i mask ;
+	int k ;
+
+	mask = avx2_unpack_mask (big_endian) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+		_mm256_storeu_si256 ((__m256i *) (dest + k), avx2_load_pcm24 (src + 3 * k, mask)) ;
+
+	return k ;
+} /* avx2_pcm24_to_i */
+
+static AVX2_FUNC int
+avx2_pcm24_to_f (const unsigned char *src, float *dest, int count, int big_endian, float normfact)
+{	__m256i mask ;
+	__m256 fnorm ;
+	int k ;
+
+	mask = avx2_unpack_mask (big_endian) ;
+	fnorm = _mm256_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+		_mm256_storeu_ps (dest + k, _mm256_mul_ps (_mm256_cvtepi32_ps (avx2_load_pcm24 (src + 3 * k, mask)), fnorm)) ;
+
+	return k ;
+} /* avx2_pcm24_to_f */
+
+static AVX2_FUNC int
+avx2_pcm24_to_d (const unsigned char *src, double *dest, int count, int big_endian, double normfact)
+{	__m256i mask, v ;
+	__m256d dnorm ;
+	int k ;
+
+	mask = avx2_unpack_mask (big_endian) ;
+	dnorm = _mm256_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = avx2_load_pcm24 (src + 3 * k, mask) ;
+		_mm256_storeu_pd (dest + k, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_castsi256_si128 (v)), dnorm)) ;
+		_mm256_storeu_pd (dest + k + 4, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_extracti128_si256 (v, 1)), dnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_pcm24_to_d */
+
+static AVX2_FUNC int
+avx2_i_to_pcm24 (const int *src, unsigned char *dest, int count, int big_endian)
+{	__m256i mask ;
+	int k ;
+
+	mask = avx2_pack_mask (big_endian) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+		avx2_store_pcm24 (dest + 3 * k, _mm256_loadu_si256 ((const __m256i *) (src + k)), mask) ;
+
+	return k ;
+} /* avx2_i_to_pcm24 */
+
+static AVX2_FUNC int
+avx2_f_to_pcm24 (const float *src, unsigned char *dest, int count, int big_endian, float normfact, int clip)
+{	__m256i mask, v ;
+	__m256 fnorm, upper, lower, x ;
+	int k ;
+
+	mask = avx2_pack_mask (big_endian) ;
+	fnorm = _mm256_set1_ps (normfact) ;
+	upper = _mm256_set1_ps (2147483648.0f) ;
+	lower = _mm256_set1_ps (-2147483648.0f) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	x = _mm256_mul_ps (_mm256_loadu_ps (src + k), fnorm) ;
+		if (clip)
+		{	/* The conversion already gives INT_MIN for large negative values. */
+			if (_mm256_movemask_ps (_mm256_cmp_ps (x, x, _CMP_UNORD_Q)) != 0)
+				break ;
+			v = _mm256_cvtps_epi32 (x) ;
+			v = _mm256_blendv_epi8 (v, _mm256_set1_epi32 (0x7FFFFFFF), _mm256_castps_si256 (_mm256_cmp_ps (x, upper, _CMP_GE_OQ))) ;
+			}
+		else
+		{	if (_mm256_movemask_ps (_mm256_and_ps (_mm256_cmp_ps (x, upper, _CMP_LT_OQ), _mm256_cmp_ps (x, lower, _CMP_GE_OQ))) != 0xFF)
+				break ;
+			v = _mm256_slli_epi32 (_mm256_cvtps_epi32 (x), 8) ;
+			} ;
+		avx2_store_pcm24 (dest + 3 * k, v, mask) ;
+		} ;
+
+	return k ;
+} /* avx2_f_to_pcm24 */
+
+/* True if lower <= x < upper for all four values. */
+static inline AVX2_FUNC int
+avx2_in_int_range_pd (__m256d x, __m256d upper, __m256d lower)
+{	return _mm256_movemask_pd (_mm256_and_pd (_mm256_cmp_pd (x, upper, _CMP_LT_OQ), _mm256_cmp_pd (x, lower, _CMP_GE_OQ))) == 0xF ;
+} /* avx2_in_int_range_pd */
+
+static AVX2_FUNC int
+avx2_d_to_pcm24 (const double *src, unsigned char *dest, int count, int big_endian, double normfact, int clip)
+{	__m256i mask, v ;
+	__m256d dnorm, upper, lower, x0, x1 ;
+	int k ;
+
+	mask = avx2_pack_mask (big_endian) ;
+	dnorm = _mm256_set1_pd (normfact) ;
+	upper = _mm256_set1_pd (1.0 * 0x7FFFFFFF) ;
+	lower = _mm256_set1_pd (-8.0 * 0x10000000) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	x0 = _mm256_mul_pd (_mm256_loadu_pd (src + k), dnorm) ;
+		x1 = _mm256_mul_pd (_mm256_loadu_pd (src + k + 4), dnorm) ;
+		if (clip)
+		{	/* Unordered if either value is a NaN. */
+			if (_mm256_movemask_pd (_mm256_cmp_pd (x0, x1, _CMP_UNORD_Q)) != 0)
+				break ;
+			/* The upper limit is exact in a double, the conversion gives INT_MIN for large negative values. */
+			x0 = _mm256_min_pd (x0, upper) ;
+			x1 = _mm256_min_pd (x1, upper) ;
+			}
+		else if (! avx2_in_int_range_pd (x0, upper, lower) || ! avx2_in_int_range_pd (x1, upper, lower))
+			break ;
+
+		v = _mm256_castsi128_si256 (_mm256_cvtpd_epi32 (x0)) ;
+		v = _mm256_inserti128_si256 (v, _mm256_cvtpd_epi32 (x1), 1) ;
+		if (clip == 0)
+			v = _mm256_slli_epi32 (v, 8) ;
+		avx2_store_pcm24 (dest + 3 * k, v, mask) ;
+		} ;
+
+	return k ;
+} /* avx2_d_to_pcm24 */
+
+/* See sse2_f_to_i_sat () and sse2_d_to_i_sat (). */
+static inline AVX2_FUNC __m256i
+avx2_f_to_i_sat (__m256 x)
+{	return _mm256_xor_si256 (_mm256_cvtps_epi32 (x), _mm256_castps_si256 (_mm256_cmp_ps (x, _mm256_set1_ps (2147483648.0f), _CMP_GE_OQ))) ;
+} /* avx2_f_to_i_sat */
+
+static inline AVX2_FUNC __m256i
+avx2_d_to_i_sat (__m256d a, __m256d b)
+{	const __m256d upper = _mm256_set1_pd (1.0 * 0x7FFFFFFF), lower = _mm256_set1_pd (-8.0 * 0x10000000) ;
+	__m256i v ;
+
+	a = _mm256_min_pd (_mm256_max_pd (a, lower), upper) ;
+	b = _mm256_min_pd (_mm256_max_pd (b, lower), upper) ;
+	v = _mm256_castsi128_si256 (_mm256_cvtpd_epi32 (a)) ;
+	return _mm256_inserti128_si256 (v, _mm256_cvtpd_epi32 (b), 1) ;
+} /* avx2_d_to_i_sat */
+
+static AVX2_FUNC int
+avx2_f_to_s_clip (const float *src, short *dest, int count, float normfact, int shift, int swap)
+{	__m256 fnorm, a, b ;
+	__m256i mask, v ;
+	__m128i sh ;
+	int k ;
+
+	fnorm = _mm256_set1_ps (normfact) ;
+	mask = _mm256_set_epi8 (AVX2_BSWAP16_MASK, AVX2_BSWAP16_MASK) ;
+	sh = _mm_cvtsi32_si128 (shift) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	a = _mm256_mul_ps (_mm256_loadu_ps (src + k), fnorm) ;
+		b = _mm256_mul_ps (_mm256_loadu_ps (src + k + 8), fnorm) ;
+		if (_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_UNORD_Q)) != 0)
+			break ;
+		/* The pack works within each half, so put the quarters back in order. */
+		v = _mm256_packs_epi32 (_mm256_sra_epi32 (avx2_f_to_i_sat (a), sh), _mm256_sra_epi32 (avx2_f_to_i_sat (b), sh)) ;
+		v = _mm256_permute4x64_epi64 (v, _MM_SHUFFLE (3, 1, 2, 0)) ;
+		if (swap)
+			v = _mm256_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* avx2_f_to_s_clip */
+
+static AVX2_FUNC int
+avx2_f_to_i_clip (const float *src, int *dest, int count, float normfact, int swap)
+{	__m256 fnorm, x ;
+	__m256i mask, v ;
+	int k ;
+
+	fnorm = _mm256_set1_ps (normfact) ;
+	mask = _mm256_set_epi8 (AVX2_BSWAP32_MASK, AVX2_BSWAP32_MASK) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	x = _mm256_mul_ps (_mm256_loadu_ps (src + k), fnorm) ;
+		if (_mm256_movemask_ps (_mm256_cmp_ps (x, x, _CMP_UNORD_Q)) != 0)
+			break ;
+		v = avx2_f_to_i_sat (x) ;
+		if (swap)
+			v = _mm256_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* avx2_f_to_i_clip */
+
+static AVX2_FUNC int
+avx2_d_to_s_clip (const double *src, short *dest, int count, double normfact, int shift, int swap)
+{	__m256d dnorm, a, b ;
+	__m128i mask, sh, v ;
+	__m256i i ;
+	int k ;
+
+	dnorm = _mm256_set1_pd (normfact) ;
+	mask = _mm_set_epi8 (AVX2_BSWAP16_MASK) ;
+	sh = _mm_cvtsi32_si128 (shift) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = _mm256_mul_pd (_mm256_loadu_pd (src + k), dnorm) ;
+		b = _mm256_mul_pd (_mm256_loadu_pd (src + k + 4), dnorm) ;
+		if (_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_UNORD_Q)) != 0)
+			break ;
+		i = _mm256_sra_epi32 (avx2_d_to_i_sat (a, b), sh) ;
+		v = _mm_packs_epi32 (_mm256_castsi256_si128 (i), _mm256_extracti128_si256 (i, 1)) ;
+		if (swap)
+			v = _mm_shuffle_epi8 (v, mask) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* avx2_d_to_s_clip */
+
+static AVX2_FUNC int
+avx2_d_to_i_clip (const double *src, int *dest, int count, double normfact, int swap)
+{	__m256d dnorm, a, b ;
+	__m256i mask, v ;
+	int k ;
+
+	dnorm = _mm256_set1_pd (normfact) ;
+	mask = _mm256_set_epi8 (AVX2_BSWAP32_MASK, AVX2_BSWAP32_MASK) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = _mm256_mul_pd (_mm256_loadu_pd (src + k), dnorm) ;
+		b = _mm256_mul_pd (_mm256_loadu_pd (src + k + 4), dnorm) ;
+		if (_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_UNORD_Q)) != 0)
+			break ;
+		v = avx2_d_to_i_sat (a, b) ;
+		if (swap)
+			v = _mm256_shuffle_epi8 (v, mask) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k), v) ;
+		} ;
+
+	return k ;
+} /* avx2_d_to_i_clip */
+
+/*
+**	G.711 works like the SSE2 encoder with twice the lanes. Decoding uses
+**	the same conditional shifts, which is where the wider vectors start to
+**	beat the table lookup.
+*/
+
+static inline AVX2_FUNC __m256i
+avx2_test16 (__m256i v, int bits)
+{	const __m256i b = _mm256_set1_epi16 (bits) ;
+
+	return _mm256_cmpeq_epi16 (_mm256_and_si256 (v, b), b) ;
+} /* avx2_test16 */
+
+static inline AVX2_FUNC __m256i
+avx2_sllv16 (__m256i v, __m256i shift)
+{	v = _mm256_blendv_epi8 (v, _mm256_slli_epi16 (v, 1), avx2_test16 (shift, 1)) ;
+	v = _mm256_blendv_epi8 (v, _mm256_slli_epi16 (v, 2), avx2_test16 (shift, 2)) ;
+	return _mm256_blendv_epi8 (v, _mm256_slli_epi16 (v, 4), avx2_test16 (shift, 4)) ;
+} /* avx2_sllv16 */
+
+static inline AVX2_FUNC __m256i
+avx2_srlv16 (__m256i v, __m256i shift)
+{	v = _mm256_blendv_epi8 (v, _mm256_srli_epi16 (v, 1), avx2_test16 (shift, 1)) ;
+	v = _mm256_blendv_epi8 (v, _mm256_srli_epi16 (v, 2), avx2_test16 (shift, 2)) ;
+	return _mm256_blendv_epi8 (v, _mm256_srli_epi16 (v, 4), avx2_test16 (shift, 4)) ;
+} /* avx2_srlv16 */
+
+/* Decode 16 G.711 bytes to shorts. */
+static inline AVX2_FUNC __m256i
+avx2_g711_decode (__m128i bytes, int law)
+{	const __m256i zero = _mm256_setzero_si256 () ;
+	__m256i x, e, t, sign ;
+
+	x = _mm256_cvtepu8_epi16 (bytes) ;
+
+	if (law == PSF_G711_ALAW)
+	{	x = _mm256_xor_si256 (x, _mm256_set1_epi16 (0x55)) ;
+		e = _mm256_and_si256 (_mm256_srli_epi16 (x, 4), _mm256_set1_epi16 (7)) ;
+		t = _mm256_slli_epi16 (_mm256_and_si256 (x, _mm256_set1_epi16 (0xF)), 4) ;
+		t = _mm256_blendv_epi8 (_mm256_srli_epi16 (avx2_sllv16 (_mm256_add_epi16 (t, _mm256_set1_epi16 (0x108)), e), 1),
+					_mm256_add_epi16 (t, _mm256_set1_epi16 (8)), _mm256_cmpeq_epi16 (e, zero)) ;
+		sign = _mm256_cmpeq_epi16 (_mm256_and_si256 (x, _mm256_set1_epi16 (0x80)), zero) ;
+		}
+	else
+	{	x = _mm256_xor_si256 (x, _mm256_set1_epi16 (0xFF)) ;
+		e = _mm256_and_si256 (_mm256_srli_epi16 (x, 4), _mm256_set1_epi16 (7)) ;
+		t = _mm256_add_epi16 (_mm256_slli_epi16 (_mm256_and_si256 (x, _mm256_set1_epi16 (0xF)), 3), _mm256_set1_epi16 (0x84)) ;
+		t = _mm256_sub_epi16 (avx2_sllv16 (t, e), _mm256_set1_epi16 (0x84)) ;
+		sign = avx2_test16 (x, 0x80) ;
+		} ;
+
+	return _mm256_sub_epi16 (_mm256_xor_si256 (t, sign), sign) ;
+} /* avx2_g711_decode */
+
+/* Encode 16 table indices and sign masks to 16 bytes. */
+static inline AVX2_FUNC __m128i
+avx2_g711_encode (__m256i m, __m256i sign, int law)
+{	__m256i b, e, mant ;
+	int k ;
+
+	e = _mm256_setzero_si256 () ;
+
+	if (law == PSF_G711_ALAW)
+	{	b = _mm256_min_epi16 (m, _mm256_set1_epi16 (0x7FF)) ;
+		for (k = 0xF ; k < 0x7FF ; k = 2 * k + 1)
+			e = _mm256_sub_epi16 (e, _mm256_cmpgt_epi16 (b, _mm256_set1_epi16 (k))) ;
+		mant = avx2_srlv16 (b, _mm256_add_epi16 (e, _mm256_cmpgt_epi16 (b, _mm256_set1_epi16 (0xF)))) ;
+		}
+	else
+	{	b = _mm256_min_epi16 (_mm256_add_epi16 (m, _mm256_set1_epi16 (33)), _mm256_set1_epi16 (0x1FFF)) ;
+		for (k = 0x3F ; k < 0x1FFF ; k = 2 * k + 1)
+			e = _mm256_sub_epi16 (e, _mm256_cmpgt_epi16 (b, _mm256_set1_epi16 (k))) ;
+		mant = avx2_srlv16 (_mm256_srli_epi16 (b, 1), e) ;
+		} ;
+
+	mant = _mm256_or_si256 (_mm256_slli_epi16 (e, 4), _mm256_and_si256 (mant, _mm256_set1_epi16 (0xF))) ;
+	sign = _mm256_and_si256 (sign, _mm256_set1_epi16 (0x80)) ;
+	mant = _mm256_xor_si256 (mant, _mm256_xor_si256 (sign, _mm256_set1_epi16 (law == PSF_G711_ALAW ? 0xD5 : 0xFF))) ;
+
+	/* The pack works within each half, so put the quarters back in order. */
+	mant = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (mant, mant), _MM_SHUFFLE (3, 1, 2, 0)) ;
+	return _mm256_castsi256_si128 (mant) ;
+} /* avx2_g711_encode */
+
+/* Encode from two lots of eight 32 bit table indices and sign masks. */
+static inline AVX2_FUNC __m128i
+avx2_g711_encode_s32 (__m256i m0, __m256i m1, __m256i sign0, __m256i sign1, int law)
+{	return avx2_g711_encode (_mm256_permute4x64_epi64 (_mm256_packs_epi32 (m0, m1), _MM_SHUFFLE (3, 1, 2, 0)),
+				_mm256_permute4x64_epi64 (_mm256_packs_epi32 (sign0, sign1), _MM_SHUFFLE (3, 1, 2, 0)), law) ;
+} /* avx2_g711_encode_s32 */
+
+static AVX2_FUNC int
+avx2_g711_to_s (const unsigned char *src, short *dest, int count, int law)
+{	int k ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+		_mm256_storeu_si256 ((__m256i *) (dest + k), avx2_g711_decode (_mm_loadu_si128 ((const __m128i *) (src + k)), law)) ;
+
+	return k ;
+} /* avx2_g711_to_s */
+
+static AVX2_FUNC int
+avx2_g711_to_i (const unsigned char *src, int *dest, int count, int law)
+{	__m256i v ;
+	int k ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = avx2_g711_decode (_mm_loadu_si128 ((const __m128i *) (src + k)), law) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k), _mm256_slli_epi32 (_mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (v)), 16)) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k + 8), _mm256_slli_epi32 (_mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (v, 1)), 16)) ;
+		} ;
+
+	return k ;
+} /* avx2_g711_to_i */
+
+static AVX2_FUNC int
+avx2_g711_to_f (const unsigned char *src, float *dest, int count, int law, float normfact)
+{	__m256i v ;
+	__m256 fnorm ;
+	int k ;
+
+	fnorm = _mm256_set1_ps (normfact) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = avx2_g711_decode (_mm_loadu_si128 ((const __m128i *) (src + k)), law) ;
+		_mm256_storeu_ps (dest + k, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm256_castsi256_si128 (v))), fnorm)) ;
+		_mm256_storeu_ps (dest + k + 8, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm256_extracti128_si256 (v, 1))), fnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_g711_to_f */
+
+static AVX2_FUNC int
+avx2_g711_to_d (const unsigned char *src, double *dest, int count, int law, double normfact)
+{	__m256i v, lo, hi ;
+	__m256d dnorm ;
+	int k ;
+
+	dnorm = _mm256_set1_pd (normfact) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = avx2_g711_decode (_mm_loadu_si128 ((const __m128i *) (src + k)), law) ;
+		lo = _mm256_cvtepi16_epi32 (_mm256_castsi256_si128 (v)) ;
+		hi = _mm256_cvtepi16_epi32 (_mm256_extracti128_si256 (v, 1)) ;
+		_mm256_storeu_pd (dest + k, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_castsi256_si128 (lo)), dnorm)) ;
+		_mm256_storeu_pd (dest + k + 4, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_extracti128_si256 (lo, 1)), dnorm)) ;
+		_mm256_storeu_pd (dest + k + 8, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_castsi256_si128 (hi)), dnorm)) ;
+		_mm256_storeu_pd (dest + k + 12, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_extracti128_si256 (hi, 1)), dnorm)) ;
+		} ;
+
+	return k ;
+} /* avx2_g711_to_d */
+
+static AVX2_FUNC int
+avx2_s_to_g711 (const short *src, unsigned char *dest, int count, int law)
+{	__m256i v, sign ;
+	int k, shift ;
+
+	shift = law == PSF_G711_ALAW ? 4 : 2 ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = _mm256_loadu_si256 ((const __m256i *) (src + k)) ;
+		sign = _mm256_srai_epi16 (v, 15) ;
+		v = _mm256_srli_epi16 (_mm256_abs_epi16 (v), shift) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), avx2_g711_encode (v, sign, law)) ;
+		} ;
+
+	return k ;
+} /* avx2_s_to_g711 */
+
+static AVX2_FUNC int
+avx2_i_to_g711 (const int *src, unsigned char *dest, int count, int law)
+{	const __m256i int_min = _mm256_set1_epi32 (-0x7FFFFFFF - 1) ;
+	__m256i a, b, sa, sb ;
+	int k, shift ;
+
+	shift = 16 + (law == PSF_G711_ALAW ? 4 : 2) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	a = _mm256_loadu_si256 ((const __m256i *) (src + k)) ;
+		b = _mm256_loadu_si256 ((const __m256i *) (src + k + 8)) ;
+		sa = _mm256_andnot_si256 (_mm256_cmpeq_epi32 (a, int_min), _mm256_srai_epi32 (a, 31)) ;
+		sb = _mm256_andnot_si256 (_mm256_cmpeq_epi32 (b, int_min), _mm256_srai_epi32 (b, 31)) ;
+		a = _mm256_srli_epi32 (_mm256_abs_epi32 (a), shift) ;
+		b = _mm256_srli_epi32 (_mm256_abs_epi32 (b), shift) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), avx2_g711_encode_s32 (a, b, sa, sb, law)) ;
+		} ;
+
+	return k ;
+} /* avx2_i_to_g711 */
+
+static AVX2_FUNC int
+avx2_f_to_g711 (const float *src, unsigned char *dest, int count, int law, float normfact)
+{	const __m256 zero = _mm256_setzero_ps (), abs_mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7FFFFFFF)) ;
+	__m256 fnorm, limit, a, b, xa, xb ;
+	__m256i sa, sb ;
+	int k ;
+
+	fnorm = _mm256_set1_ps (normfact) ;
+	limit = _mm256_set1_ps (g711_max_index (law)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	xa = _mm256_loadu_ps (src + k) ;
+		xb = _mm256_loadu_ps (src + k + 8) ;
+		a = _mm256_mul_ps (xa, fnorm) ;
+		b = _mm256_mul_ps (xb, fnorm) ;
+		if (_mm256_movemask_ps (_mm256_or_ps (_mm256_cmp_ps (_mm256_and_ps (a, abs_mask), limit, _CMP_NLE_UQ),
+					_mm256_cmp_ps (_mm256_and_ps (b, abs_mask), limit, _CMP_NLE_UQ))) != 0)
+			break ;
+		sa = _mm256_castps_si256 (_mm256_cmp_ps (xa, zero, _CMP_LT_OQ)) ;
+		sb = _mm256_castps_si256 (_mm256_cmp_ps (xb, zero, _CMP_LT_OQ)) ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), avx2_g711_encode_s32 (_mm256_abs_epi32 (_mm256_cvtps_epi32 (a)),
+							_mm256_abs_epi32 (_mm256_cvtps_epi32 (b)), sa, sb, law)) ;
+		} ;
+
+	return k ;
+} /* avx2_f_to_g711 */
+
+static AVX2_FUNC int
+avx2_d_to_g711 (const double *src, unsigned char *dest, int count, int law, double normfact)
+{	const __m256d zero = _mm256_setzero_pd (), abs_mask = _mm256_castsi256_pd (_mm256_set1_epi64x (0x7FFFFFFFFFFFFFFFLL)) ;
+	const __m256i even = _mm256_setr_epi32 (0, 2, 4, 6, 0, 2, 4, 6) ;
+	__m256d dnorm, limit, x, scaled ;
+	__m128i m [4], sign [4] ;
+	int k, j, out_of_range ;
+
+	dnorm = _mm256_set1_pd (normfact) ;
+	limit = _mm256_set1_pd (g711_max_index (law)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	out_of_range = 0 ;
+		for (j = 0 ; j < 4 ; j++)
+		{	x = _mm256_loadu_pd (src + k + 4 * j) ;
+			scaled = _mm256_mul_pd (x, dnorm) ;
+			out_of_range |= _mm256_movemask_pd (_mm256_cmp_pd (_mm256_and_pd (scaled, abs_mask), limit, _CMP_NLE_UQ)) ;
+			/* The low 32 bits of each 64 bit compare result. */
+			sign [j] = _mm256_castsi256_si128 (_mm256_permutevar8x32_epi32 (_mm256_castpd_si256 (_mm256_cmp_pd (x, zero, _CMP_LT_OQ)), even)) ;
+			m [j] = _mm_abs_epi32 (_mm256_cvtpd_epi32 (scaled)) ;
+			} ;
+		if (out_of_range)
+			break ;
+		_mm_storeu_si128 ((__m128i *) (dest + k), avx2_g711_encode_s32 (
+							_mm256_inserti128_si256 (_mm256_castsi128_si256 (m [0]), m [1], 1),
+							_mm256_inserti128_si256 (_mm256_castsi128_si256 (m [2]), m [3], 1),
+							_mm256_inserti128_si256 (_mm256_castsi128_si256 (sign [0]), sign [1], 1),
+							_mm256_inserti128_si256 (_mm256_castsi128_si256 (sign [2]), sign [3], 1), law)) ;
+		} ;
+
+	return k ;
+} /* avx2_d_to_g711 */
+
+/*
+**	The ALAC predictor is a recursion over the samples so it can't be done
+**	several samples at a time. Instead the taps go across the vector, which
+**	turns the dot product and the sign-sign coefficient update (the part the
+**	scalar code spends most of its time mispredicting branches in) into a
+**	fixed sequence of instructions. The update walks the taps from the oldest
+**	and stops at the first one where del0 changes sign, so a prefix sum of
+**	the steps finds where it stops. Lane i holds the tap numactive - 1 - i,
+**	the coefficients are kept as ints but wrapped like the int16_t ones.
+*/
+
+/* The index of the lowest set bit, x must not be zero. */
+static inline int
+avx2_lowest_bit (unsigned x)
+{
+#if COMPILER_IS_GCC
+	return __builtin_ctz (x) ;
+#else
+	unsigned long k ;
+
+	_BitScanForward (&k, x) ;
+	return (int) k ;
+#endif
+} /* avx2_lowest_bit */
+
+static AVX2_FUNC int
+avx2_alac_unpc4 (const int *pc, int *out, int num, short *coefs, int chanshift, int denshift)
+{	const __m128i lane = _mm_setr_epi32 (0, 1, 2, 3) ;
+	/* (x << wa) + (x << wb) gives x times the tap weights 1 to 4. */
+	const __m128i wa = _mm_setr_epi32 (0, 1, 1, 2) ;
+	const __m128i wb = _mm_setr_epi32 (32, 32, 0, 32) ;
+	const __m128i cshift = _mm_cvtsi32_si128 (chanshift), dshift = _mm_cvtsi32_si128 (denshift) ;
+	const __m128i denhalf = _mm_set1_epi32 (1 << (denshift - 1)) ;
+	__m128i coef, win, top, b, del, x, sum, step, upd ;
+	int j, stop, last ;
+
+	coef = _mm_shuffle_epi32 (_mm_cvtepi16_epi32 (_mm_loadl_epi64 ((const __m128i *) coefs)), _MM_SHUFFLE (0, 1, 2, 3)) ;
+	win = _mm_loadu_si128 ((const __m128i *) (out + 1)) ;
+
+	for (j = 5 ; j < num ; j++)
+	{	top = _mm_set1_epi32 (out [j - 5]) ;
+		b = _mm_sub_epi32 (top, win) ;
+		sum = _mm_mullo_epi32 (coef, b) ;
+		sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (1, 0, 3, 2))) ;
+		sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (2, 3, 0, 1))) ;
+		sum = _mm_sra_epi32 (_mm_sub_epi32 (denhalf, sum), dshift) ;
+		sum = _mm_add_epi32 (_mm_add_epi32 (sum, top), _mm_cvtsi32_si128 (pc [j])) ;
+		last = _mm_cvtsi128_si32 (_mm_sra_epi32 (_mm_sll_epi32 (sum, cshift), cshift)) ;
+		out [j] = last ;
+
+		del = _mm_set1_epi32 (pc [j]) ;
+		x = _mm_sra_epi32 (_mm_sign_epi32 (_mm_abs_epi32 (b), del), dshift) ;
+		step = _mm_add_epi32 (_mm_sllv_epi32 (x, wa), _mm_sllv_epi32 (x, wb)) ;
+		step = _mm_add_epi32 (step, _mm_slli_si128 (step, 4)) ;
+		step = _mm_add_epi32 (step, _mm_slli_si128 (step, 8)) ;
+		step = _mm_sign_epi32 (_mm_sub_epi32 (del, step), del) ;
+		stop = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (step, _mm_setzero_si128 ()))) ;
+		stop = avx2_lowest_bit ((~stop & 0x7) | 0x8) ;
+
+		upd = _mm_sign_epi32 (_mm_sign_epi32 (_mm_set1_epi32 (1), b), del) ;
+		upd = _mm_and_si128 (upd, _mm_cmpgt_epi32 (_mm_set1_epi32 (stop + 1), lane)) ;
+		coef = _mm_sub_epi32 (coef, upd) ;
+		coef = _mm_srai_epi32 (_mm_slli_epi32 (coef, 16), 16) ;
+
+		win = _mm_alignr_epi8 (_mm_set1_epi32 (last), win, 4) ;
+		} ;
+
+	coef = _mm_shuffle_epi32 (coef, _MM_SHUFFLE (0, 1, 2, 3)) ;
+	_mm_storel_epi64 ((__m128i *) coefs, _mm_packs_epi32 (coef, coef)) ;
+
+	return num - 5 ;
+} /* avx2_alac_unpc4 */
+
+static AVX2_FUNC int
+avx2_alac_unpc8 (const int *pc, int *out, int num, short *coefs, int chanshift, int denshift)
+{	const __m256i lane = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7) ;
+	const __m256i reverse = _mm256_setr_epi32 (7, 6, 5, 4, 3, 2, 1, 0) ;
+	const __m256i rotate = _mm256_setr_epi32 (1, 2, 3, 4, 5, 6, 7, 7) ;
+	/* The tap weights 1 to 8, with 7 as 8 - 1. */
+	const __m256i wa = _mm256_setr_epi32 (0, 1, 1, 2, 2, 2, 3, 3) ;
+	const __m256i wb = _mm256_setr_epi32 (32, 32, 0, 32, 0, 1, 0, 32) ;
+	const __m256i wsign = _mm256_setr_epi32 (1, 1, 1, 1, 1, 1, -1, 1) ;
+	const __m128i cshift = _mm_cvtsi32_si128 (chanshift), dshift = _mm_cvtsi32_si128 (denshift) ;
+	const __m128i denhalf = _mm_set1_epi32 (1 << (denshift - 1)) ;
+	__m256i coef, win, top, b, del, x, step, upd ;
+	__m128i sum ;
+	int j, stop, last ;
+
+	coef = _mm256_permutevar8x32_epi32 (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) coefs)), reverse) ;
+	win = _mm256_loadu_si256 ((const __m256i *) (out + 1)) ;
+
+	for (j = 9 ; j < num ; j++)
+	{	top = _mm256_set1_epi32 (out [j - 9]) ;
+		b = _mm256_sub_epi32 (top, win) ;
+		step = _mm256_mullo_epi32 (coef, b) ;
+		sum = _mm_add_epi32 (_mm256_castsi256_si128 (step), _mm256_extracti128_si256 (step, 1)) ;
+		sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (1, 0, 3, 2))) ;
+		sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (2, 3, 0, 1))) ;
+		sum = _mm_sra_epi32 (_mm_sub_epi32 (denhalf, sum), dshift) ;
+		sum = _mm_add_epi32 (_mm_add_epi32 (sum, _mm256_castsi256_si128 (top)), _mm_cvtsi32_si128 (pc [j])) ;
+		last = _mm_cvtsi128_si32 (_mm_sra_epi32 (_mm_sll_epi32 (sum, cshift), cshift)) ;
+		out [j] = last ;
+
+		del = _mm256_set1_epi32 (pc [j]) ;
+		x = _mm256_sra_epi32 (_mm256_sign_epi32 (_mm256_abs_epi32 (b), del), dshift) ;
+		step = _mm256_add_epi32 (_mm256_sllv_epi32 (x, wa), _mm256_sign_epi32 (_mm256_sllv_epi32 (x, wb), wsign)) ;
+		step = _mm256_add_epi32 (step, _mm256_slli_si256 (step, 4)) ;
+		step = _mm256_add_epi32 (step, _mm256_slli_si256 (step, 8)) ;
+		/* Carry the sum of the low half into the high half. */
+		step = _mm256_add_epi32 (step, _mm256_shuffle_epi32 (_mm256_permute2x128_si256 (step, step, 0x08), 0xFF)) ;
+		step = _mm256_sign_epi32 (_mm256_sub_epi32 (del, step), del) ;
+		stop = _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpgt_epi32 (step, _mm256_setzero_si256 ()))) ;
+		stop = avx2_lowest_bit ((~stop & 0x7F) | 0x80) ;
+
+		upd = _mm256_sign_epi32 (_mm256_sign_epi32 (_mm256_set1_epi32 (1), b), del) ;
+		upd = _mm256_and_si256 (upd, _mm256_cmpgt_epi32 (_mm256_set1_epi32 (stop + 1), lane)) ;
+		coef = _mm256_sub_epi32 (coef, upd) ;
+		coef = _mm256_srai_epi32 (_mm256_slli_epi32 (coef, 16), 16) ;
+
+		win = _mm256_blend_epi32 (_mm256_permutevar8x32_epi32 (win, rotate), _mm256_set1_epi32 (last), 0x80) ;
+		} ;
+
+	coef = _mm256_permutevar8x32_epi32 (coef, reverse) ;
+	_mm_storeu_si128 ((__m128i *) coefs, _mm_packs_epi32 (_mm256_castsi256_si128 (coef), _mm256_extracti128_si256 (coef, 1))) ;
+
+	return num - 9 ;
+} /* avx2_alac_unpc8 */
+
+static AVX2_FUNC int
+avx2_alac_unpc (const int *pc, int *out, int num, short *coefs, int numactive, int chanshift, int denshift)
+{
+	if (num <= numactive + 1 || chanshift < 0 || chanshift > 31 || denshift < 1 || denshift > 31)
+		return 0 ;
+
+	/* The encoder only uses 4 or 8 taps. */
+	switch (numactive)
+	{	case 4 :
+			return avx2_alac_unpc4 (pc, out, num, coefs, chanshift, denshift) ;
+		case 8 :
+			return avx2_alac_unpc8 (pc, out, num, coefs, chanshift, denshift) ;
+		default :
+			break ;
+		} ;
+
+	return 0 ;
+} /* avx2_alac_unpc */
+
+static AVX2_FUNC int
+avx2_alac_unmix (const int *u, const int *v, int *out, int count, int mixbits, int mixres, int shift)
+{	__m256i mix, l, r, lo, hi ;
+	__m128i mshift, lshift ;
+	int k ;
+
+	if (mixbits < 0 || mixbits > 31 || shift < 0 || shift > 31)
+		return 0 ;
+
+	mix = _mm256_set1_epi32 (mixres) ;
+	mshift = _mm_cvtsi32_si128 (mixbits) ;
+	lshift = _mm_cvtsi32_si128 (shift) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	l = _mm256_loadu_si256 ((const __m256i *) (u + k)) ;
+		r = _mm256_loadu_si256 ((const __m256i *) (v + k)) ;
+		if (mixres != 0)
+		{	l = _mm256_sub_epi32 (_mm256_add_epi32 (l, r), _mm256_sra_epi32 (_mm256_mullo_epi32 (mix, r), mshift)) ;
+			r = _mm256_sub_epi32 (l, r) ;
+			} ;
+		l = _mm256_sll_epi32 (l, lshift) ;
+		r = _mm256_sll_epi32 (r, lshift) ;
+		lo = _mm256_unpacklo_epi32 (l, r) ;
+		hi = _mm256_unpackhi_epi32 (l, r) ;
+		_mm256_storeu_si256 ((__m256i *) (out + 2 * k), _mm256_permute2x128_si256 (lo, hi, 0x20)) ;
+		_mm256_storeu_si256 ((__m256i *) (out + 2 * k + 8), _mm256_permute2x128_si256 (lo, hi, 0x31)) ;
+		} ;
+
+	return k ;
+} /* avx2_alac_unmix */
+
+/* Like sse2_planar_load8 () with sixteen samples. */
+static inline AVX2_FUNC void
+avx2_planar_load16 (const int * const *src, int channels, int k, __m256i *a, __m256i *b)
+{	__m256i l, r, lo, hi ;
+
+	l = _mm256_loadu_si256 ((const __m256i *) (src [0] + k)) ;
+	if (channels == 1)
+	{	*a = l ;
+		*b = _mm256_loadu_si256 ((const __m256i *) (src [0] + k + 8)) ;
+		return ;
+		} ;
+
+	/* The unpacks work within each 128 bit lane, so swap the middle quarters back. */
+	r = _mm256_loadu_si256 ((const __m256i *) (src [1] + k)) ;
+	lo = _mm256_unpacklo_epi32 (l, r) ;
+	hi = _mm256_unpackhi_epi32 (l, r) ;
+	*a = _mm256_permute2x128_si256 (lo, hi, 0x20) ;
+	*b = _mm256_permute2x128_si256 (lo, hi, 0x31) ;
+} /* avx2_planar_load16 */
+
+static AVX2_FUNC int
+avx2_planar_to_s (const int * const *src, int channels, short *dest, int count, int shift)
+{	__m128i lshift, rshift ;
+	__m256i a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2 || shift < -31 || shift > 31)
+		return 0 ;
+
+	lshift = _mm_cvtsi32_si128 (shift > 0 ? shift : 0) ;
+	rshift = _mm_cvtsi32_si128 (shift < 0 ? -shift : 0) ;
+	step = 16 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	avx2_planar_load16 (src, channels, k, &a, &b) ;
+		a = _mm256_sra_epi32 (_mm256_sll_epi32 (a, lshift), rshift) ;
+		b = _mm256_sra_epi32 (_mm256_sll_epi32 (b, lshift), rshift) ;
+		a = _mm256_srai_epi32 (_mm256_slli_epi32 (a, 16), 16) ;
+		b = _mm256_srai_epi32 (_mm256_slli_epi32 (b, 16), 16) ;
+		/* The pack also works within lanes, giving a0 b0 a1 b1 in 64 bit pieces. */
+		a = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (a, b), _MM_SHUFFLE (3, 1, 2, 0)) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k * channels), a) ;
+		} ;
+
+	return k ;
+} /* avx2_planar_to_s */
+
+static AVX2_FUNC int
+avx2_planar_to_i (const int * const *src, int channels, int *dest, int count, int shift)
+{	__m128i lshift ;
+	__m256i a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2 || shift < 0 || shift > 31)
+		return 0 ;
+
+	lshift = _mm_cvtsi32_si128 (shift) ;
+	step = 16 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	avx2_planar_load16 (src, channels, k, &a, &b) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k * channels), _mm256_sll_epi32 (a, lshift)) ;
+		_mm256_storeu_si256 ((__m256i *) (dest + k * channels + 8), _mm256_sll_epi32 (b, lshift)) ;
+		} ;
+
+	return k ;
+} /* avx2_planar_to_i */
+
+static AVX2_FUNC int
+avx2_planar_to_f (const int * const *src, int channels, float *dest, int count, float normfact)
+{	__m256 norm ;
+	__m256i a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	norm = _mm256_set1_ps (normfact) ;
+	step = 16 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	avx2_planar_load16 (src, channels, k, &a, &b) ;
+		_mm256_storeu_ps (dest + k * channels, _mm256_mul_ps (_mm256_cvtepi32_ps (a), norm)) ;
+		_mm256_storeu_ps (dest + k * channels + 8, _mm256_mul_ps (_mm256_cvtepi32_ps (b), norm)) ;
+		} ;
+
+	return k ;
+} /* avx2_planar_to_f */
+
+static AVX2_FUNC int
+avx2_planar_to_d (const int * const *src, int channels, double *dest, int count, double normfact)
+{	__m256d norm ;
+	__m256i a, b ;
+	double *out ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	norm = _mm256_set1_pd (normfact) ;
+	step = 16 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	avx2_planar_load16 (src, channels, k, &a, &b) ;
+		out = dest + k * channels ;
+		_mm256_storeu_pd (out, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_castsi256_si128 (a)), norm)) ;
+		_mm256_storeu_pd (out + 4, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_extracti128_si256 (a, 1)), norm)) ;
+		_mm256_storeu_pd (out + 8, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_castsi256_si128 (b)), norm)) ;
+		_mm256_storeu_pd (out + 12, _mm256_mul_pd (_mm256_cvtepi32_pd (_mm256_extracti128_si256 (b, 1)), norm)) ;
+		} ;
+
+	return k ;
+} /* avx2_planar_to_d */
+
+/*
+**	The short term filters only fill eight lanes, but with SSSE3 GSM_MULT_R
+**	is a single instruction, which shortens the chain from one step to the
+**	next.
+*/
+static AVX2_FUNC int
+avx2_gsm_st_analysis (short *u, const short *rp, short *s, int count)
+{	__m128i lanes, vrp, vu, din, sin, dout, sout, active ;
+	int t ;
+
+	lanes = _mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7) ;
+	vrp = _mm_loadu_si128 ((const __m128i *) rp) ;
+	vu = _mm_loadu_si128 ((const __m128i *) u) ;
+	dout = sout = _mm_setzero_si128 () ;
+
+	for (t = 0 ; t < count + 7 ; t++)
+	{	din = _mm_slli_si128 (dout, 2) ;
+		sin = _mm_slli_si128 (sout, 2) ;
+		if (t < count)
+		{	din = _mm_insert_epi16 (din, s [t], 0) ;
+			sin = _mm_insert_epi16 (sin, s [t], 0) ;
+			} ;
+
+		sout = _mm_adds_epi16 (vu, _mm_mulhrs_epi16 (vrp, din)) ;
+		dout = _mm_adds_epi16 (din, _mm_mulhrs_epi16 (vrp, vu)) ;
+
+		active = _mm_and_si128 (_mm_cmplt_epi16 (lanes, _mm_set1_epi16 (t + 1)), _mm_cmpgt_epi16 (lanes, _mm_set1_epi16 (t - count))) ;
+		vu = _mm_blendv_epi8 (vu, sin, active) ;
+
+		if (t >= 7)
+			s [t - 7] = _mm_extract_epi16 (dout, 7) ;
+		} ;
+
+	_mm_storeu_si128 ((__m128i *) u, vu) ;
+
+	return count ;
+} /* avx2_gsm_st_analysis */
+
+static AVX2_FUNC int
+avx2_gsm_st_synthesis (short *v, const short *rrp, const short *wt, short *sr, int count)
+{	__m128i lanes, lane0, vrrp, vv, sri, vnext, pos, active ;
+	int t, v8 ;
+
+	lanes = _mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7) ;
+	lane0 = _mm_setr_epi16 (-1, 0, 0, 0, 0, 0, 0, 0) ;
+	vrrp = _mm_loadu_si128 ((const __m128i *) rrp) ;
+	vv = _mm_loadu_si128 ((const __m128i *) v) ;
+	v8 = v [8] ;
+	sri = _mm_setzero_si128 () ;
+
+	for (t = 0 ; t < 2 * count + 6 ; t++)
+	{	sri = _mm_srli_si128 (sri, 2) ;
+		if ((t & 1) == 0 && t < 2 * count)
+			sri = _mm_insert_epi16 (sri, wt [t / 2], 7) ;
+
+		sri = _mm_subs_epi16 (sri, _mm_mulhrs_epi16 (vrrp, vv)) ;
+		vnext = _mm_adds_epi16 (vv, _mm_mulhrs_epi16 (vrrp, sri)) ;
+
+		pos = _mm_add_epi16 (lanes, _mm_set1_epi16 (t - 7)) ;
+		active = _mm_cmpeq_epi16 (_mm_and_si128 (pos, _mm_set1_epi16 (1)), _mm_setzero_si128 ()) ;
+		active = _mm_and_si128 (active, _mm_cmpgt_epi16 (pos, _mm_set1_epi16 (-1))) ;
+		active = _mm_and_si128 (active, _mm_cmplt_epi16 (pos, _mm_set1_epi16 (2 * count - 1))) ;
+
+		if ((t & 1) == 0 && t < 2 * count)
+			v8 = (short) _mm_extract_epi16 (vnext, 7) ;
+
+		vnext = _mm_blendv_epi8 (_mm_slli_si128 (vnext, 2), sri, lane0) ;
+		active = _mm_or_si128 (_mm_slli_si128 (active, 2), _mm_and_si128 (active, lane0)) ;
+		vv = _mm_blendv_epi8 (vv, vnext, active) ;
+
+		if ((t & 1) != 0 && t >= 7)
+			sr [(t - 7) / 2] = _mm_extract_epi16 (sri, 0) ;
+		} ;
+
+	_mm_storeu_si128 ((__m128i *) v, vv) ;
+	v [8] = v8 ;
+
+	return count ;
+} /* avx2_gsm_st_synthesis */
+
+static AVX2_FUNC int
+avx2_gsm_acf (const float *s, int *acf)
+{	float pad [8 + 160] ;
+	__m256i sum [9] ;
+	__m256 x ;
+	int i, k ;
+
+	for (i = 0 ; i < 8 ; i++)
+		pad [i] = 0.0f ;
+	for (i = 0 ; i < 160 ; i++)
+		pad [i + 8] = s [i] ;
+	for (k = 0 ; k < 9 ; k++)
+		sum [k] = _mm256_setzero_si256 () ;
+
+	for (i = 8 ; i < 8 + 160 ; i += 8)
+	{	x = _mm256_loadu_ps (pad + i) ;
+		for (k = 0 ; k < 9 ; k++)
+			sum [k] = _mm256_add_epi32 (sum [k], _mm256_cvttps_epi32 (_mm256_mul_ps (x, _mm256_loadu_ps (pad + i - k)))) ;
+		} ;
+
+	for (k = 0 ; k < 9 ; k++)
+		acf [k] = sse2_hsum_epi32 (_mm_add_epi32 (_mm256_castsi256_si128 (sum [k]), _mm256_extracti128_si256 (sum [k], 1))) ;
+
+	return 9 ;
+} /* avx2_gsm_acf */
+
+#if HAVE_GSM_LTP_KERNELS
+
+/* As sse2_gsm_ltp_xcorr () with eight lags to a vector, multiplying and adding separately. */
+static AVX2_FUNC int
+avx2_gsm_ltp_xcorr (const float *wt, const float *dp, float *xcorr)
+{	__m256 sum [10], w ;
+	__m256i reverse ;
+	int j, k ;
+
+	for (j = 0 ; j < 10 ; j++)
+		sum [j] = _mm256_setzero_ps () ;
+
+	for (k = 0 ; k < 40 ; k++)
+	{	w = _mm256_set1_ps (wt [k]) ;
+		for (j = 0 ; j < 10 ; j++)
+			sum [j] = _mm256_add_ps (sum [j], _mm256_mul_ps (w, _mm256_loadu_ps (dp + k - 120 + 8 * j))) ;
+		} ;
+
+	reverse = _mm256_setr_epi32 (7, 6, 5, 4, 3, 2, 1, 0) ;
+	for (j = 0 ; j < 10 ; j++)
+		_mm256_storeu_ps (xcorr + 73 - 8 * j, _mm256_permutevar8x32_ps (sum [j], reverse)) ;
+	xcorr [0] = gsm_ltp_xcorr40 (wt, dp) ;
+
+	return 81 ;
+} /* avx2_gsm_ltp_xcorr */
+
+#endif
+
+/* As sse2_peak_d () with four lanes, which is two or four frames. */
+static AVX2_FUNC int
+avx2_peak_d (const double *src, int count, int channels, double *peaks)
+{	__m256d sign, max0, max1 ;
+	__m128d max ;
+	int k ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	sign = _mm256_set1_pd (-0.0) ;
+	max0 = channels == 1 ? _mm256_set1_pd (peaks [0]) : _mm256_setr_pd (peaks [0], peaks [1], peaks [0], peaks [1]) ;
+	max1 = max0 ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	max0 = _mm256_max_pd (_mm256_andnot_pd (sign, _mm256_loadu_pd (src + k)), max0) ;
+		max1 = _mm256_max_pd (_mm256_andnot_pd (sign, _mm256_loadu_pd (src + k + 4)), max1) ;
+		} ;
+
+	max0 = _mm256_max_pd (max0, max1) ;
+	max = _mm_max_pd (_mm256_castpd256_pd128 (max0), _mm256_extractf128_pd (max0, 1)) ;
+	if (channels == 1)
+		_mm_store_sd (peaks, _mm_max_sd (max, _mm_unpackhi_pd (max, max))) ;
+	else
+		_mm_storeu_pd (peaks, max) ;
+
+	return k ;
+} /* avx2_peak_d */
+
+static const PSF_SIMD avx2_kernels =
+{	PSF_SIMD_AVX2, "avx2",
+	avx2_swap16, avx2_swap32,
+	sse2_pcm8_to_s, sse2_pcm8_to_i, avx2_pcm8_to_f, sse2_pcm8_to_d,
+	avx2_pcm16_to_i, avx2_pcm16_to_f, avx2_pcm16_to_d,
+	sse2_pcm32_to_s, avx2_pcm32_to_f, avx2_pcm32_to_d,
+	sse2_s_to_pcm8, sse2_i_to_pcm8, sse2_i_to_pcm16, sse2_s_to_pcm32,
+	avx2_pcm24_to_i, avx2_pcm24_to_f, avx2_pcm24_to_d,
+	avx2_i_to_pcm24, avx2_f_to_pcm24, avx2_d_to_pcm24,
+	avx2_f_to_s_clip, avx2_f_to_i_clip, avx2_d_to_s_clip, avx2_d_to_i_clip,
+	avx2_g711_to_s, avx2_g711_to_i, avx2_g711_to_f, avx2_g711_to_d,
+	avx2_s_to_g711, avx2_i_to_g711, avx2_f_to_g711, avx2_d_to_g711,
+	avx2_alac_unpc, avx2_alac_unmix,
+	avx2_planar_to_s, avx2_planar_to_i, avx2_planar_to_f, avx2_planar_to_d,
+#if HAVE_GSM_LTP_KERNELS
+	avx2_gsm_st_analysis, avx2_gsm_st_synthesis, avx2_gsm_acf, avx2_gsm_ltp_xcorr,
+#else
+	avx2_gsm_st_analysis, avx2_gsm_st_synthesis, avx2_gsm_acf, none_gsm_ltp_xcorr,
+#endif
+	avx2_peak_d
+} ;
+
+static int
+cpu_has_avx2 (void)
+{
+#if COMPILER_IS_GCC
+	__builtin_cpu_init () ;
+	return __builtin_cpu_supports ("avx2") ? 1 : 0 ;
+#else
+	int info [4] ;
+
+	__cpuid (info, 0) ;
+	if (info [0] < 7)
+		return 0 ;
+
+	/* The CPU must have AVX and the OS must save the YMM registers. */
+	__cpuid (info, 1) ;
+	if ((info [2] & (3 << 27)) != (3 << 27) || (_xgetbv (0) & 6) != 6)
+		return 0 ;
+
+	__cpuidex (info, 7, 0) ;
+	return (info [1] & (1 << 5)) ? 1 : 0 ;
+#endif
+} /* cpu_has_avx2 */
+
+#endif /* HAVE_AVX2_KERNELS */
+
+#elif CPU_IS_AARCH64
+/*==============================================================================
+**	NEON kernels.
+*/
+
+static inline int16x8_t
+neon_bswap16 (int16x8_t v)
+{	return vreinterpretq_s16_u8 (vrev16q_u8 (vreinterpretq_u8_s16 (v))) ;
+} /* neon_bswap16 */
+
+static inline int32x4_t
+neon_bswap32 (int32x4_t v)
+{	return vreinterpretq_s32_u8 (vrev32q_u8 (vreinterpretq_u8_s32 (v))) ;
+} /* neon_bswap32 */
+
+static inline void
+neon_store_s32_as_d (double *dest, int32x4_t v, double normfact)
+{	vst1q_f64 (dest, vmulq_n_f64 (vcvtq_f64_s64 (vmovl_s32 (vget_low_s32 (v))), normfact)) ;
+	vst1q_f64 (dest + 2, vmulq_n_f64 (vcvtq_f64_s64 (vmovl_s32 (vget_high_s32 (v))), normfact)) ;
+} /* neon_store_s32_as_d */
+
+static int
+neon_swap16 (const short *src, short *dest, int count)
+{	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+		vst1q_s16 (dest + k, neon_bswap16 (vld1q_s16 (src + k))) ;
+
+	return k ;
+} /* neon_swap16 */
+
+static int
+neon_swap32 (const int *src, int *dest, int count)
+{	int k ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+		vst1q_s32 (dest + k, neon_bswap32 (vld1q_s32 (src + k))) ;
+
+	return k ;
+} /* neon_swap32 */
+
+static int
+neon_pcm8_to_s (const unsigned char *src, short *dest, int count, int is_unsigned)
+{	uint8x16_t bias, v ;
+	int k ;
+
+	bias = vdupq_n_u8 (is_unsigned ? 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = veorq_u8 (vld1q_u8 (src + k), bias) ;
+		vst1q_s16 (dest + k, vreinterpretq_s16_u16 (vshll_n_u8 (vget_low_u8 (v), 8))) ;
+		vst1q_s16 (dest + k + 8, vreinterpretq_s16_u16 (vshll_n_u8 (vget_high_u8 (v), 8))) ;
+		} ;
+
+	return k ;
+} /* neon_pcm8_to_s */
+
+static int
+neon_pcm8_to_i (const unsigned char *src, int *dest, int count, int is_unsigned)
+{	uint8x16_t bias, v ;
+	uint16x8_t lo, hi ;
+	int k ;
+
+	bias = vdupq_n_u8 (is_unsigned ? 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = veorq_u8 (vld1q_u8 (src + k), bias) ;
+		lo = vshll_n_u8 (vget_low_u8 (v), 8) ;
+		hi = vshll_n_u8 (vget_high_u8 (v), 8) ;
+		vst1q_s32 (dest + k, vreinterpretq_s32_u32 (vshll_n_u16 (vget_low_u16 (lo), 16))) ;
+		vst1q_s32 (dest + k + 4, vreinterpretq_s32_u32 (vshll_n_u16 (vget_high_u16 (lo), 16))) ;
+		vst1q_s32 (dest + k + 8, vreinterpretq_s32_u32 (vshll_n_u16 (vget_low_u16 (hi), 16))) ;
+		vst1q_s32 (dest + k + 12, vreinterpretq_s32_u32 (vshll_n_u16 (vget_high_u16 (hi), 16))) ;
+		} ;
+
+	return k ;
+} /* neon_pcm8_to_i */
+
+static int
+neon_pcm8_to_f (const unsigned char *src, float *dest, int count, int is_unsigned, float normfact)
+{	uint8x16_t bias ;
+	int8x16_t v ;
+	int16x8_t lo, hi ;
+	int k ;
+
+	bias = vdupq_n_u8 (is_unsigned ? 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vreinterpretq_s8_u8 (veorq_u8 (vld1q_u8 (src + k), bias)) ;
+		lo = vmovl_s8 (vget_low_s8 (v)) ;
+		hi = vmovl_s8 (vget_high_s8 (v)) ;
+		vst1q_f32 (dest + k, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (lo))), normfact)) ;
+		vst1q_f32 (dest + k + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (lo))), normfact)) ;
+		vst1q_f32 (dest + k + 8, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (hi))), normfact)) ;
+		vst1q_f32 (dest + k + 12, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (hi))), normfact)) ;
+		} ;
+
+	return k ;
+} /* neon_pcm8_to_f */
+
+static int
+neon_pcm8_to_d (const unsigned char *src, double *dest, int count, int is_unsigned, double normfact)
+{	uint8x16_t bias ;
+	int8x16_t v ;
+	int16x8_t lo, hi ;
+	int k ;
+
+	bias = vdupq_n_u8 (is_unsigned ? 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vreinterpretq_s8_u8 (veorq_u8 (vld1q_u8 (src + k), bias)) ;
+		lo = vmovl_s8 (vget_low_s8 (v)) ;
+		hi = vmovl_s8 (vget_high_s8 (v)) ;
+		neon_store_s32_as_d (dest + k, vmovl_s16 (vget_low_s16 (lo)), normfact) ;
+		neon_store_s32_as_d (dest + k + 4, vmovl_s16 (vget_high_s16 (lo)), normfact) ;
+		neon_store_s32_as_d (dest + k + 8, vmovl_s16 (vget_low_s16 (hi)), normfact) ;
+		neon_store_s32_as_d (dest + k + 12, vmovl_s16 (vget_high_s16 (hi)), normfact) ;
+		} ;
+
+	return k ;
+} /* neon_pcm8_to_d */
+
+static int
+neon_pcm16_to_i (const short *src, int *dest, int count, int swap)
+{	int16x8_t v ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = vld1q_s16 (src + k) ;
+		if (swap)
+			v = neon_bswap16 (v) ;
+		vst1q_s32 (dest + k, vshll_n_s16 (vget_low_s16 (v), 16)) ;
+		vst1q_s32 (dest + k + 4, vshll_n_s16 (vget_high_s16 (v), 16)) ;
+		} ;
+
+	return k ;
+} /* neon_pcm16_to_i */
+
+static int
+neon_pcm16_to_f (const short *src, float *dest, int count, int swap, float normfact)
+{	int16x8_t v ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = vld1q_s16 (src + k) ;
+		if (swap)
+			v = neon_bswap16 (v) ;
+		vst1q_f32 (dest + k, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (v))), normfact)) ;
+		vst1q_f32 (dest + k + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (v))), normfact)) ;
+		} ;
+
+	return k ;
+} /* neon_pcm16_to_f */
+
+static int
+neon_pcm16_to_d (const short *src, double *dest, int count, int swap, double normfact)
+{	int16x8_t v ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = vld1q_s16 (src + k) ;
+		if (swap)
+			v = neon_bswap16 (v) ;
+		neon_store_s32_as_d (dest + k, vmovl_s16 (vget_low_s16 (v)), normfact) ;
+		neon_store_s32_as_d (dest + k + 4, vmovl_s16 (vget_high_s16 (v)), normfact) ;
+		} ;
+
+	return k ;
+} /* neon_pcm16_to_d */
+
+static int
+neon_pcm32_to_s (const int *src, short *dest, int count, int swap)
+{	int32x4_t a, b ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = vld1q_s32 (src + k) ;
+		b = vld1q_s32 (src + k + 4) ;
+		if (swap)
+		{	a = neon_bswap32 (a) ;
+			b = neon_bswap32 (b) ;
+			} ;
+		vst1q_s16 (dest + k, vcombine_s16 (vshrn_n_s32 (a, 16), vshrn_n_s32 (b, 16))) ;
+		} ;
+
+	return k ;
+} /* neon_pcm32_to_s */
+
+static int
+neon_pcm32_to_f (const int *src, float *dest, int count, int swap, float normfact)
+{	int32x4_t v ;
+	int k ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	v = vld1q_s32 (src + k) ;
+		if (swap)
+			v = neon_bswap32 (v) ;
+		vst1q_f32 (dest + k, vmulq_n_f32 (vcvtq_f32_s32 (v), normfact)) ;
+		} ;
+
+	return k ;
+} /* neon_pcm32_to_f */
+
+static int
+neon_pcm32_to_d (const int *src, double *dest, int count, int swap, double normfact)
+{	int32x4_t v ;
+	int k ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	v = vld1q_s32 (src + k) ;
+		if (swap)
+			v = neon_bswap32 (v) ;
+		neon_store_s32_as_d (dest + k, v, normfact) ;
+		} ;
+
+	return k ;
+} /* neon_pcm32_to_d */
+
+static int
+neon_s_to_pcm8 (const short *src, unsigned char *dest, int count, int is_unsigned)
+{	uint8x16_t bias ;
+	int8x16_t v ;
+	int k ;
+
+	bias = vdupq_n_u8 (is_unsigned ? 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vcombine_s8 (vshrn_n_s16 (vld1q_s16 (src + k), 8), vshrn_n_s16 (vld1q_s16 (src + k + 8), 8)) ;
+		vst1q_u8 (dest + k, veorq_u8 (vreinterpretq_u8_s8 (v), bias)) ;
+		} ;
+
+	return k ;
+} /* neon_s_to_pcm8 */
+
+static int
+neon_i_to_pcm8 (const int *src, unsigned char *dest, int count, int is_unsigned)
+{	uint8x16_t bias ;
+	int16x8_t lo, hi ;
+	int8x16_t v ;
+	int k ;
+
+	bias = vdupq_n_u8 (is_unsigned ? 0x80 : 0) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	lo = vcombine_s16 (vshrn_n_s32 (vld1q_s32 (src + k), 16), vshrn_n_s32 (vld1q_s32 (src + k + 4), 16)) ;
+		hi = vcombine_s16 (vshrn_n_s32 (vld1q_s32 (src + k + 8), 16), vshrn_n_s32 (vld1q_s32 (src + k + 12), 16)) ;
+		v = vcombine_s8 (vshrn_n_s16 (lo, 8), vshrn_n_s16 (hi, 8)) ;
+		vst1q_u8 (dest + k, veorq_u8 (vreinterpretq_u8_s8 (v), bias)) ;
+		} ;
+
+	return k ;
+} /* neon_i_to_pcm8 */
+
+static int
+neon_i_to_pcm16 (const int *src, short *dest, int count, int swap)
+{	int16x8_t v ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = vcombine_s16 (vshrn_n_s32 (vld1q_s32 (src + k), 16), vshrn_n_s32 (vld1q_s32 (src + k + 4), 16)) ;
+		if (swap)
+			v = neon_bswap16 (v) ;
+		vst1q_s16 (dest + k, v) ;
+		} ;
+
+	return k ;
+} /* neon_i_to_pcm16 */
+
+static int
+neon_s_to_pcm32 (const short *src, int *dest, int count, int swap)
+{	int16x8_t v ;
+	int32x4_t lo, hi ;
+	int k ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	v = vld1q_s16 (src + k) ;
+		lo = vshll_n_s16 (vget_low_s16 (v), 16) ;
+		hi = vshll_n_s16 (vget_high_s16 (v), 16) ;
+		if (swap)
+		{	lo = neon_bswap32 (lo) ;
+			hi = neon_bswap32 (hi) ;
+			} ;
+		vst1q_s32 (dest + k, lo) ;
+		vst1q_s32 (dest + k + 4, hi) ;
+		} ;
+
+	return k ;
+} /* neon_s_to_pcm32 */
+
+/*
+**	Packed 24 bit data, sixteen samples at a time. The structure loads and
+**	stores split the three bytes of each sample into separate registers.
+*/
+
+static inline void
+neon_load_pcm24 (const unsigned char *src, int big_endian, int32x4_t *v)
+{	uint8x16x3_t	t ;
+	uint8x16x2_t	a, b ;
+	uint16x8x2_t	c, d ;
+
+	t = vld3q_u8 (src) ;
+
+	/* Zip the bytes together lowest first, with a zero below them. */
+	a = vzipq_u8 (vdupq_n_u8 (0), big_endian ? t.val [2] : t.val [0]) ;
+	b = vzipq_u8 (t.val [1], big_endian ? t.val [0] : t.val [2]) ;
+	c = vzipq_u16 (vreinterpretq_u16_u8 (a.val [0]), vreinterpretq_u16_u8 (b.val [0])) ;
+	d = vzipq_u16 (vreinterpretq_u16_u8 (a.val [1]), vreinterpretq_u16_u8 (b.val [1])) ;
+
+	v [0] = vreinterpretq_s32_u16 (c.val [0]) ;
+	v [1] = vreinterpretq_s32_u16 (c.val [1]) ;
+	v [2] = vreinterpretq_s32_u16 (d.val [0]) ;
+	v [3] = vreinterpretq_s32_u16 (d.val [1]) ;
+} /* neon_load_pcm24 */
+
+static inline void
+neon_store_pcm24 (unsigned char *dest, int big_endian, const int32x4_t *v)
+{	uint8x16x3_t	t ;
+	uint8x16x2_t	a, b, even, odd ;
+
+	/* Separate the bytes of the ints, byte 0 is discarded. */
+	a = vuzpq_u8 (vreinterpretq_u8_s32 (v [0]), vreinterpretq_u8_s32 (v [1])) ;
+	b = vuzpq_u8 (vreinterpretq_u8_s32 (v [2]), vreinterpretq_u8_s32 (v [3])) ;
+	even = vuzpq_u8 (a.val [0], b.val [0]) ;
+	odd = vuzpq_u8 (a.val [1], b.val [1]) ;
+
+	t.val [0] = big_endian ? odd.val [1] : odd.val [0] ;
+	t.val [1] = even.val [1] ;
+	t.val [2] = big_endian ? odd.val [0] : odd.val [1] ;
+	vst3q_u8 (dest, t) ;
+} /* neon_store_pcm24 */
+
+/* True if no lane is a NaN. */
+static inline int
+neon_all_ordered_f32 (float32x4_t x)
+{	return vminvq_u32 (vceqq_f32 (x, x)) != 0 ;
+} /* neon_all_ordered_f32 */
+
+static int
+neon_pcm24_to_i (const unsigned char *src, int *dest, int count, int big_endian)
+{	int32x4_t v [4] ;
+	int k, j ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	neon_load_pcm24 (src + 3 * k, big_endian, v) ;
+		for (j = 0 ; j < 4 ; j++)
+			vst1q_s32 (dest + k + 4 * j, v [j]) ;
+		} ;
+
+	return k ;
+} /* neon_pcm24_to_i */
+
+static int
+neon_pcm24_to_f (const unsigned char *src, float *dest, int count, int big_endian, float normfact)
+{	int32x4_t v [4] ;
+	int k, j ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	neon_load_pcm24 (src + 3 * k, big_endian, v) ;
+		for (j = 0 ; j < 4 ; j++)
+			vst1q_f32 (dest + k + 4 * j, vmulq_n_f32 (vcvtq_f32_s32 (v [j]), normfact)) ;
+		} ;
+
+	return k ;
+} /* neon_pcm24_to_f */
+
+static int
+neon_pcm24_to_d (const unsigned char *src, double *dest, int count, int big_endian, double normfact)
+{	int32x4_t v [4] ;
+	int k, j ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	neon_load_pcm24 (src + 3 * k, big_endian, v) ;
+		for (j = 0 ; j < 4 ; j++)
+			neon_store_s32_as_d (dest + k + 4 * j, v [j], normfact) ;
+		} ;
+
+	return k ;
+} /* neon_pcm24_to_d */
+
+static int
+neon_i_to_pcm24 (const int *src, unsigned char *dest, int count, int big_endian)
+{	int32x4_t v [4] ;
+	int k, j ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	for (j = 0 ; j < 4 ; j++)
+			v [j] = vld1q_s32 (src + k + 4 * j) ;
+		neon_store_pcm24 (dest + 3 * k, big_endian, v) ;
+		} ;
+
+	return k ;
+} /* neon_i_to_pcm24 */
+
+static int
+neon_f_to_pcm24 (const float *src, unsigned char *dest, int count, int big_endian, float normfact, int clip)
+{	int32x4_t v [4] ;
+	float32x4_t x ;
+	int k, j ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	for (j = 0 ; j < 4 ; j++)
+		{	x = vmulq_n_f32 (vld1q_f32 (src + k + 4 * j), normfact) ;
+			if (clip)
+			{	/* The conversion saturates just like the clipping code. */
+				if (! neon_all_ordered_f32 (x))
+					return k ;
+				v [j] = vcvtnq_s32_f32 (x) ;
+				}
+			else
+			{	if (vminvq_u32 (vandq_u32 (vcltq_f32 (x, vdupq_n_f32 (2147483648.0f)), vcgeq_f32 (x, vdupq_n_f32 (-2147483648.0f)))) == 0)
+					return k ;
+				v [j] = vshlq_n_s32 (vcvtnq_s32_f32 (x), 8) ;
+				} ;
+			} ;
+		neon_store_pcm24 (dest + 3 * k, big_endian, v) ;
+		} ;
+
+	return k ;
+} /* neon_f_to_pcm24 */
+
+static int
+neon_d_to_pcm24 (const double *src, unsigned char *dest, int count, int big_endian, double normfact, int clip)
+{	int32x4_t v [4] ;
+	float64x2_t x0, x1 ;
+	uint64x2_t ok ;
+	int k, j ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	for (j = 0 ; j < 4 ; j++)
+		{	x0 = vmulq_n_f64 (vld1q_f64 (src + k + 4 * j), normfact) ;
+			x1 = vmulq_n_f64 (vld1q_f64 (src + k + 4 * j + 2), normfact) ;
+			if (clip)
+				ok = vandq_u64 (vceqq_f64 (x0, x0), vceqq_f64 (x1, x1)) ;
+			else
+			{	ok = vandq_u64 (vcltq_f64 (x0, vdupq_n_f64 (1.0 * 0x7FFFFFFF)), vcgeq_f64 (x0, vdupq_n_f64 (-8.0 * 0x10000000))) ;
+				ok = vandq_u64 (ok, vandq_u64 (vcltq_f64 (x1, vdupq_n_f64 (1.0 * 0x7FFFFFFF)), vcgeq_f64 (x1, vdupq_n_f64 (-8.0 * 0x10000000)))) ;
+				} ;
+			if (vminvq_u32 (vreinterpretq_u32_u64 (ok)) == 0)
+				return k ;
+
+			/* Saturating narrow, which does the clipping. */
+			v [j] = vcombine_s32 (vqmovn_s64 (vcvtnq_s64_f64 (x0)), vqmovn_s64 (vcvtnq_s64_f64 (x1))) ;
+			if (clip == 0)
+				v [j] = vshlq_n_s32 (v [j], 8) ;
+			} ;
+		neon_store_pcm24 (dest + 3 * k, big_endian, v) ;
+		} ;
+
+	return k ;
+} /* neon_d_to_pcm24 */
+
+/*
+**	The NEON conversions round to nearest and saturate, and the narrowing
+**	moves saturate too, so clipping comes for free.
+*/
+
+static inline int32x4_t
+neon_d_to_i_sat (float64x2_t a, float64x2_t b)
+{	return vcombine_s32 (vqmovn_s64 (vcvtnq_s64_f64 (a)), vqmovn_s64 (vcvtnq_s64_f64 (b))) ;
+} /* neon_d_to_i_sat */
+
+/* True if no lane is a NaN. */
+static inline int
+neon_all_ordered_f64 (float64x2_t a, float64x2_t b)
+{	return vminvq_u32 (vreinterpretq_u32_u64 (vandq_u64 (vceqq_f64 (a, a), vceqq_f64 (b, b)))) != 0 ;
+} /* neon_all_ordered_f64 */
+
+static int
+neon_f_to_s_clip (const float *src, short *dest, int count, float normfact, int shift, int swap)
+{	float32x4_t a, b ;
+	int32x4_t sh ;
+	int16x8_t v ;
+	int k ;
+
+	/* A negative count shifts right. */
+	sh = vdupq_n_s32 (-shift) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = vmulq_n_f32 (vld1q_f32 (src + k), normfact) ;
+		b = vmulq_n_f32 (vld1q_f32 (src + k + 4), normfact) ;
+		if (! neon_all_ordered_f32 (a) || ! neon_all_ordered_f32 (b))
+			break ;
+		v = vcombine_s16 (vqmovn_s32 (vshlq_s32 (vcvtnq_s32_f32 (a), sh)), vqmovn_s32 (vshlq_s32 (vcvtnq_s32_f32 (b), sh))) ;
+		if (swap)
+			v = neon_bswap16 (v) ;
+		vst1q_s16 (dest + k, v) ;
+		} ;
+
+	return k ;
+} /* neon_f_to_s_clip */
+
+static int
+neon_f_to_i_clip (const float *src, int *dest, int count, float normfact, int swap)
+{	float32x4_t x ;
+	int32x4_t v ;
+	int k ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	x = vmulq_n_f32 (vld1q_f32 (src + k), normfact) ;
+		if (! neon_all_ordered_f32 (x))
+			break ;
+		v = vcvtnq_s32_f32 (x) ;
+		if (swap)
+			v = neon_bswap32 (v) ;
+		vst1q_s32 (dest + k, v) ;
+		} ;
+
+	return k ;
+} /* neon_f_to_i_clip */
+
+static int
+neon_d_to_s_clip (const double *src, short *dest, int count, double normfact, int shift, int swap)
+{	float64x2_t a, b, c, d ;
+	int32x4_t sh ;
+	int16x8_t v ;
+	int k ;
+
+	sh = vdupq_n_s32 (-shift) ;
+
+	for (k = 0 ; k + 8 <= count ; k += 8)
+	{	a = vmulq_n_f64 (vld1q_f64 (src + k), normfact) ;
+		b = vmulq_n_f64 (vld1q_f64 (src + k + 2), normfact) ;
+		c = vmulq_n_f64 (vld1q_f64 (src + k + 4), normfact) ;
+		d = vmulq_n_f64 (vld1q_f64 (src + k + 6), normfact) ;
+		if (! neon_all_ordered_f64 (a, b) || ! neon_all_ordered_f64 (c, d))
+			break ;
+		v = vcombine_s16 (vqmovn_s32 (vshlq_s32 (neon_d_to_i_sat (a, b), sh)), vqmovn_s32 (vshlq_s32 (neon_d_to_i_sat (c, d), sh))) ;
+		if (swap)
+			v = neon_bswap16 (v) ;
+		vst1q_s16 (dest + k, v) ;
+		} ;
+
+	return k ;
+} /* neon_d_to_s_clip */
+
+static int
+neon_d_to_i_clip (const double *src, int *dest, int count, double normfact, int swap)
+{	float64x2_t a, b ;
+	int32x4_t v ;
+	int k ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	a = vmulq_n_f64 (vld1q_f64 (src + k), normfact) ;
+		b = vmulq_n_f64 (vld1q_f64 (src + k + 2), normfact) ;
+		if (! neon_all_ordered_f64 (a, b))
+			break ;
+		v = neon_d_to_i_sat (a, b) ;
+		if (swap)
+			v = neon_bswap32 (v) ;
+		vst1q_s32 (dest + k, v) ;
+		} ;
+
+	return k ;
+} /* neon_d_to_i_clip */
+
+/*
+**	G.711 in 16 bit lanes, using the per lane shifts and the leading zero
+**	count to find the segments.
+*/
+
+static inline int16x8_t
+neon_g711_decode (uint8x8_t bytes, int law)
+{	uint16x8_t x, e, t, sign ;
+
+	x = vmovl_u8 (bytes) ;
+
+	if (law == PSF_G711_ALAW)
+	{	x = veorq_u16 (x, vdupq_n_u16 (0x55)) ;
+		e = vandq_u16 (vshrq_n_u16 (x, 4), vdupq_n_u16 (7)) ;
+		t = vshlq_n_u16 (vandq_u16 (x, vdupq_n_u16 (0xF)), 4) ;
+		/* Segment 0 has no leading one and no shift. */
+		t = vbslq_u16 (vceqq_u16 (e, vdupq_n_u16 (0)), vaddq_u16 (t, vdupq_n_u16 (8)),
+					vshlq_u16 (vaddq_u16 (t, vdupq_n_u16 (0x108)), vreinterpretq_s16_u16 (vsubq_u16 (e, vdupq_n_u16 (1))))) ;
+		sign = vceqq_u16 (vandq_u16 (x, vdupq_n_u16 (0x80)), vdupq_n_u16 (0)) ;
+		}
+	else
+	{	x = veorq_u16 (x, vdupq_n_u16 (0xFF)) ;
+		e = vandq_u16 (vshrq_n_u16 (x, 4), vdupq_n_u16 (7)) ;
+		t = vaddq_u16 (vshlq_n_u16 (vandq_u16 (x, vdupq_n_u16 (0xF)), 3), vdupq_n_u16 (0x84)) ;
+		t = vsubq_u16 (vshlq_u16 (t, vreinterpretq_s16_u16 (e)), vdupq_n_u16 (0x84)) ;
+		sign = vtstq_u16 (x, vdupq_n_u16 (0x80)) ;
+		} ;
+
+	return vreinterpretq_s16_u16 (vsubq_u16 (veorq_u16 (t, sign), sign)) ;
+} /* neon_g711_decode */
+
+/* Encode from the table index m and a sign mask. */
+static inline uint8x8_t
+neon_g711_encode (uint16x8_t m, uint16x8_t sign, int law)
+{	uint16x8_t b, e, mant ;
+
+	if (law == PSF_G711_ALAW)
+	{	b = vminq_u16 (m, vdupq_n_u16 (0x7FF)) ;
+		e = vqsubq_u16 (vdupq_n_u16 (12), vclzq_u16 (b)) ;
+		/* Segments above 0 drop the leading one and shift by e - 1. */
+		mant = vshlq_u16 (b, vnegq_s16 (vreinterpretq_s16_u16 (vqsubq_u16 (e, vdupq_n_u16 (1))))) ;
+		}
+	else
+	{	b = vminq_u16 (vaddq_u16 (m, vdupq_n_u16 (33)), vdupq_n_u16 (0x1FFF)) ;
+		e = vsubq_u16 (vdupq_n_u16 (10), vclzq_u16 (b)) ;
+		mant = vshlq_u16 (b, vnegq_s16 (vreinterpretq_s16_u16 (vaddq_u16 (e, vdupq_n_u16 (1))))) ;
+		} ;
+
+	mant = vorrq_u16 (vshlq_n_u16 (e, 4), vandq_u16 (mant, vdupq_n_u16 (0xF))) ;
+	sign = vandq_u16 (sign, vdupq_n_u16 (0x80)) ;
+
+	return vmovn_u16 (veorq_u16 (mant, veorq_u16 (sign, vdupq_n_u16 (law == PSF_G711_ALAW ? 0xD5 : 0xFF)))) ;
+} /* neon_g711_encode */
+
+/* Encode from four lots of 32 bit table indices and sign masks. */
+static inline uint8x16_t
+neon_g711_encode_u32 (const uint32x4_t *m, const uint32x4_t *sign, int law)
+{	return vcombine_u8 (
+				neon_g711_encode (vcombine_u16 (vmovn_u32 (m [0]), vmovn_u32 (m [1])), vcombine_u16 (vmovn_u32 (sign [0]), vmovn_u32 (sign [1])), law),
+				neon_g711_encode (vcombine_u16 (vmovn_u32 (m [2]), vmovn_u32 (m [3])), vcombine_u16 (vmovn_u32 (sign [2]), vmovn_u32 (sign [3])), law)) ;
+} /* neon_g711_encode_u32 */
+
+static int
+neon_g711_to_s (const unsigned char *src, short *dest, int count, int law)
+{	uint8x16_t v ;
+	int k ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vld1q_u8 (src + k) ;
+		vst1q_s16 (dest + k, neon_g711_decode (vget_low_u8 (v), law)) ;
+		vst1q_s16 (dest + k + 8, neon_g711_decode (vget_high_u8 (v), law)) ;
+		} ;
+
+	return k ;
+} /* neon_g711_to_s */
+
+static int
+neon_g711_to_i (const unsigned char *src, int *dest, int count, int law)
+{	uint8x16_t v ;
+	int16x8_t lo, hi ;
+	int k ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vld1q_u8 (src + k) ;
+		lo = neon_g711_decode (vget_low_u8 (v), law) ;
+		hi = neon_g711_decode (vget_high_u8 (v), law) ;
+		vst1q_s32 (dest + k, vshll_n_s16 (vget_low_s16 (lo), 16)) ;
+		vst1q_s32 (dest + k + 4, vshll_n_s16 (vget_high_s16 (lo), 16)) ;
+		vst1q_s32 (dest + k + 8, vshll_n_s16 (vget_low_s16 (hi), 16)) ;
+		vst1q_s32 (dest + k + 12, vshll_n_s16 (vget_high_s16 (hi), 16)) ;
+		} ;
+
+	return k ;
+} /* neon_g711_to_i */
+
+static int
+neon_g711_to_f (const unsigned char *src, float *dest, int count, int law, float normfact)
+{	uint8x16_t v ;
+	int16x8_t lo, hi ;
+	int k ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vld1q_u8 (src + k) ;
+		lo = neon_g711_decode (vget_low_u8 (v), law) ;
+		hi = neon_g711_decode (vget_high_u8 (v), law) ;
+		vst1q_f32 (dest + k, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (lo))), normfact)) ;
+		vst1q_f32 (dest + k + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (lo))), normfact)) ;
+		vst1q_f32 (dest + k + 8, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (hi))), normfact)) ;
+		vst1q_f32 (dest + k + 12, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (hi))), normfact)) ;
+		} ;
+
+	return k ;
+} /* neon_g711_to_f */
+
+static int
+neon_g711_to_d (const unsigned char *src, double *dest, int count, int law, double normfact)
+{	uint8x16_t v ;
+	int16x8_t lo, hi ;
+	int k ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	v = vld1q_u8 (src + k) ;
+		lo = neon_g711_decode (vget_low_u8 (v), law) ;
+		hi = neon_g711_decode (vget_high_u8 (v), law) ;
+		neon_store_s32_as_d (dest + k, vmovl_s16 (vget_low_s16 (lo)), normfact) ;
+		neon_store_s32_as_d (dest + k + 4, vmovl_s16 (vget_high_s16 (lo)), normfact) ;
+		neon_store_s32_as_d (dest + k + 8, vmovl_s16 (vget_low_s16 (hi)), normfact) ;
+		neon_store_s32_as_d (dest + k + 12, vmovl_s16 (vget_high_s16 (hi)), normfact) ;
+		} ;
+
+	return k ;
+} /* neon_g711_to_d */
+
+static int
+neon_s_to_g711 (const short *src, unsigned char *dest, int count, int law)
+{	int16x8_t a, b, shift ;
+	int k ;
+
+	/* A negative count shifts right. */
+	shift = vdupq_n_s16 (law == PSF_G711_ALAW ? -4 : -2) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	a = vld1q_s16 (src + k) ;
+		b = vld1q_s16 (src + k + 8) ;
+		/* The magnitude of -32768 is 0x8000 as an unsigned value. */
+		vst1q_u8 (dest + k, vcombine_u8 (
+				neon_g711_encode (vshlq_u16 (vreinterpretq_u16_s16 (vabsq_s16 (a)), shift), vcltq_s16 (a, vdupq_n_s16 (0)), law),
+				neon_g711_encode (vshlq_u16 (vreinterpretq_u16_s16 (vabsq_s16 (b)), shift), vcltq_s16 (b, vdupq_n_s16 (0)), law))) ;
+		} ;
+
+	return k ;
+} /* neon_s_to_g711 */
+
+static int
+neon_i_to_g711 (const int *src, unsigned char *dest, int count, int law)
+{	uint32x4_t m [4], sign [4] ;
+	int32x4_t v, shift ;
+	int k, j ;
+
+	shift = vdupq_n_s32 (-16 - (law == PSF_G711_ALAW ? 4 : 2)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	for (j = 0 ; j < 4 ; j++)
+		{	v = vld1q_s32 (src + k + 4 * j) ;
+			/* Like the scalar code, INT_MIN is encoded as a positive value. */
+			sign [j] = vbicq_u32 (vcltq_s32 (v, vdupq_n_s32 (0)), vceqq_s32 (v, vdupq_n_s32 (-0x7FFFFFFF - 1))) ;
+			m [j] = vshlq_u32 (vreinterpretq_u32_s32 (vabsq_s32 (v)), shift) ;
+			} ;
+		vst1q_u8 (dest + k, neon_g711_encode_u32 (m, sign, law)) ;
+		} ;
+
+	return k ;
+} /* neon_i_to_g711 */
+
+static int
+neon_f_to_g711 (const float *src, unsigned char *dest, int count, int law, float normfact)
+{	uint32x4_t m [4], sign [4], in_range ;
+	float32x4_t limit, x, scaled ;
+	int k, j ;
+
+	limit = vdupq_n_f32 (g711_max_index (law)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	in_range = vdupq_n_u32 (~0u) ;
+		for (j = 0 ; j < 4 ; j++)
+		{	x = vld1q_f32 (src + k + 4 * j) ;
+			scaled = vmulq_n_f32 (x, normfact) ;
+			in_range = vandq_u32 (in_range, vcaleq_f32 (scaled, limit)) ;
+			sign [j] = vcltq_f32 (x, vdupq_n_f32 (0.0f)) ;
+			m [j] = vreinterpretq_u32_s32 (vabsq_s32 (vcvtnq_s32_f32 (scaled))) ;
+			} ;
+		if (vminvq_u32 (in_range) == 0)
+			break ;
+		vst1q_u8 (dest + k, neon_g711_encode_u32 (m, sign, law)) ;
+		} ;
+
+	return k ;
+} /* neon_f_to_g711 */
+
+static int
+neon_d_to_g711 (const double *src, unsigned char *dest, int count, int law, double normfact)
+{	uint32x4_t m [4], sign [4] ;
+	uint64x2_t in_range, lt [2] ;
+	float64x2_t limit, x [2], scaled [2] ;
+	int64x2_t r [2] ;
+	int k, j, h ;
+
+	limit = vdupq_n_f64 (g711_max_index (law)) ;
+
+	for (k = 0 ; k + 16 <= count ; k += 16)
+	{	in_range = vdupq_n_u64 (~0ull) ;
+		for (j = 0 ; j < 4 ; j++)
+		{	for (h = 0 ; h < 2 ; h++)
+			{	x [h] = vld1q_f64 (src + k + 4 * j + 2 * h) ;
+				scaled [h] = vmulq_n_f64 (x [h], normfact) ;
+				in_range = vandq_u64 (in_range, vcaleq_f64 (scaled [h], limit)) ;
+				lt [h] = vcltq_f64 (x [h], vdupq_n_f64 (0.0)) ;
+				r [h] = vabsq_s64 (vcvtnq_s64_f64 (scaled [h])) ;
+				} ;
+			sign [j] = vcombine_u32 (vmovn_u64 (lt [0]), vmovn_u64 (lt [1])) ;
+			m [j] = vcombine_u32 (vmovn_u64 (vreinterpretq_u64_s64 (r [0])), vmovn_u64 (vreinterpretq_u64_s64 (r [1]))) ;
+			} ;
+		if (vminvq_u32 (vreinterpretq_u32_u64 (in_range)) == 0)
+			break ;
+		vst1q_u8 (dest + k, neon_g711_encode_u32 (m, sign, law)) ;
+		} ;
+
+	return k ;
+} /* neon_d_to_g711 */
+
+static int
+neon_alac_unmix (const int *u, const int *v, int *out, int count, int mixbits, int mixres, int shift)
+{	int32x4x2_t lr ;
+	int32x4_t mshift, lshift ;
+	int k ;
+
+	if (mixbits < 0 || mixbits > 31 || shift < 0 || shift > 31)
+		return 0 ;
+
+	/* NEON shifts right by shifting left by a negative count. */
+	mshift = vdupq_n_s32 (-mixbits) ;
+	lshift = vdupq_n_s32 (shift) ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	lr.val [0] = vld1q_s32 (u + k) ;
+		lr.val [1] = vld1q_s32 (v + k) ;
+		if (mixres != 0)
+		{	lr.val [0] = vsubq_s32 (vaddq_s32 (lr.val [0], lr.val [1]), vshlq_s32 (vmulq_n_s32 (lr.val [1], mixres), mshift)) ;
+			lr.val [1] = vsubq_s32 (lr.val [0], lr.val [1]) ;
+			} ;
+		lr.val [0] = vshlq_s32 (lr.val [0], lshift) ;
+		lr.val [1] = vshlq_s32 (lr.val [1], lshift) ;
+		vst2q_s32 (out + 2 * k, lr) ;
+		} ;
+
+	return k ;
+} /* neon_alac_unmix */
+
+/* Like sse2_planar_load8 (), vzipq interleaves the two channels. */
+static inline void
+neon_planar_load8 (const int * const *src, int channels, int k, int32x4_t *a, int32x4_t *b)
+{	int32x4x2_t lr ;
+
+	if (channels == 1)
+	{	*a = vld1q_s32 (src [0] + k) ;
+		*b = vld1q_s32 (src [0] + k + 4) ;
+		return ;
+		} ;
+
+	lr = vzipq_s32 (vld1q_s32 (src [0] + k), vld1q_s32 (src [1] + k)) ;
+	*a = lr.val [0] ;
+	*b = lr.val [1] ;
+} /* neon_planar_load8 */
+
+static int
+neon_planar_to_s (const int * const *src, int channels, short *dest, int count, int shift)
+{	int32x4_t a, b, vshift ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2 || shift < -31 || shift > 31)
+		return 0 ;
+
+	/* A negative count shifts right, and vmovn keeps the low 16 bits. */
+	vshift = vdupq_n_s32 (shift) ;
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	neon_planar_load8 (src, channels, k, &a, &b) ;
+		vst1q_s16 (dest + k * channels, vcombine_s16 (vmovn_s32 (vshlq_s32 (a, vshift)), vmovn_s32 (vshlq_s32 (b, vshift)))) ;
+		} ;
+
+	return k ;
+} /* neon_planar_to_s */
+
+static int
+neon_planar_to_i (const int * const *src, int channels, int *dest, int count, int shift)
+{	int32x4_t a, b, vshift ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2 || shift < 0 || shift > 31)
+		return 0 ;
+
+	vshift = vdupq_n_s32 (shift) ;
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	neon_planar_load8 (src, channels, k, &a, &b) ;
+		vst1q_s32 (dest + k * channels, vshlq_s32 (a, vshift)) ;
+		vst1q_s32 (dest + k * channels + 4, vshlq_s32 (b, vshift)) ;
+		} ;
+
+	return k ;
+} /* neon_planar_to_i */
+
+static int
+neon_planar_to_f (const int * const *src, int channels, float *dest, int count, float normfact)
+{	int32x4_t a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	neon_planar_load8 (src, channels, k, &a, &b) ;
+		vst1q_f32 (dest + k * channels, vmulq_n_f32 (vcvtq_f32_s32 (a), normfact)) ;
+		vst1q_f32 (dest + k * channels + 4, vmulq_n_f32 (vcvtq_f32_s32 (b), normfact)) ;
+		} ;
+
+	return k ;
+} /* neon_planar_to_f */
+
+static int
+neon_planar_to_d (const int * const *src, int channels, double *dest, int count, double normfact)
+{	int32x4_t a, b ;
+	int k, step ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	step = 8 / channels ;
+
+	for (k = 0 ; k + step <= count ; k += step)
+	{	neon_planar_load8 (src, channels, k, &a, &b) ;
+		neon_store_s32_as_d (dest + k * channels, a, normfact) ;
+		neon_store_s32_as_d (dest + k * channels + 4, b, normfact) ;
+		} ;
+
+	return k ;
+} /* neon_planar_to_d */
+
+/*
+**	The GSM short term filters work like the SSE2 versions, and vqrdmulh
+**	is exactly GSM_MULT_R (), saturating -32768 squared to 32767.
+*/
+static int
+neon_gsm_st_analysis (short *u, const short *rp, short *s, int count)
+{	static const int16_t lane_index [8] = { 0, 1, 2, 3, 4, 5, 6, 7 } ;
+	int16x8_t lanes, zero, vrp, vu, din, sin, dout, sout ;
+	uint16x8_t active ;
+	int t ;
+
+	lanes = vld1q_s16 (lane_index) ;
+	zero = vdupq_n_s16 (0) ;
+	vrp = vld1q_s16 (rp) ;
+	vu = vld1q_s16 (u) ;
+	dout = sout = zero ;
+
+	for (t = 0 ; t < count + 7 ; t++)
+	{	din = vextq_s16 (zero, dout, 7) ;
+		sin = vextq_s16 (zero, sout, 7) ;
+		if (t < count)
+		{	din = vsetq_lane_s16 (s [t], din, 0) ;
+			sin = vsetq_lane_s16 (s [t], sin, 0) ;
+			} ;
+
+		sout = vqaddq_s16 (vu, vqrdmulhq_s16 (vrp, din)) ;
+		dout = vqaddq_s16 (din, vqrdmulhq_s16 (vrp, vu)) ;
+
+		active = vandq_u16 (vcltq_s16 (lanes, vdupq_n_s16 (t + 1)), vcgtq_s16 (lanes, vdupq_n_s16 (t - count))) ;
+		vu = vbslq_s16 (active, sin, vu) ;
+
+		if (t >= 7)
+			s [t - 7] = vgetq_lane_s16 (dout, 7) ;
+		} ;
+
+	vst1q_s16 (u, vu) ;
+
+	return count ;
+} /* neon_gsm_st_analysis */
+
+static int
+neon_gsm_st_synthesis (short *v, const short *rrp, const short *wt, short *sr, int count)
+{	static const int16_t lane_index [8] = { 0, 1, 2, 3, 4, 5, 6, 7 } ;
+	static const uint16_t lane0_mask [8] = { 0xffff, 0, 0, 0, 0, 0, 0, 0 } ;
+	int16x8_t lanes, zero, vrrp, vv, sri, vnext, pos ;
+	uint16x8_t lane0, active ;
+	int t, v8 ;
+
+	lanes = vld1q_s16 (lane_index) ;
+	lane0 = vld1q_u16 (lane0_mask) ;
+	zero = vdupq_n_s16 (0) ;
+	vrrp = vld1q_s16 (rrp) ;
+	vv = vld1q_s16 (v) ;
+	v8 = v [8] ;
+	sri = zero ;
+
+	for (t = 0 ; t < 2 * count + 6 ; t++)
+	{	sri = vextq_s16 (sri, zero, 1) ;
+		if ((t & 1) == 0 && t < 2 * count)
+			sri = vsetq_lane_s16 (wt [t / 2], sri, 7) ;
+
+		sri = vqsubq_s16 (sri, vqrdmulhq_s16 (vrrp, vv)) ;
+		vnext = vqaddq_s16 (vv, vqrdmulhq_s16 (vrrp, sri)) ;
+
+		pos = vaddq_s16 (lanes, vdupq_n_s16 (t - 7)) ;
+		active = vceqq_s16 (vandq_s16 (pos, vdupq_n_s16 (1)), zero) ;
+		active = vandq_u16 (active, vcgtq_s16 (pos, vdupq_n_s16 (-1))) ;
+		active = vandq_u16 (active, vcltq_s16 (pos, vdupq_n_s16 (2 * count - 1))) ;
+
+		if ((t & 1) == 0 && t < 2 * count)
+			v8 = vgetq_lane_s16 (vnext, 7) ;
+
+		vnext = vsetq_lane_s16 (vgetq_lane_s16 (sri, 0), vextq_s16 (zero, vnext, 7), 0) ;
+		active = vorrq_u16 (vextq_u16 (vdupq_n_u16 (0), active, 7), vandq_u16 (active, lane0)) ;
+		vv = vbslq_s16 (active, vnext, vv) ;
+
+		if ((t & 1) != 0 && t >= 7)
+			sr [(t - 7) / 2] = vgetq_lane_s16 (sri, 0) ;
+		} ;
+
+	vst1q_s16 (v, vv) ;
+	v [8] = v8 ;
+
+	return count ;
+} /* neon_gsm_st_synthesis */
+
+static int
+neon_gsm_acf (const float *s, int *acf)
+{	float pad [8 + 160] ;
+	int32x4_t sum [9] ;
+	float32x4_t x ;
+	int i, k ;
+
+	for (i = 0 ; i < 8 ; i++)
+		pad [i] = 0.0f ;
+	for (i = 0 ; i < 160 ; i++)
+		pad [i + 8] = s [i] ;
+	for (k = 0 ; k < 9 ; k++)
+		sum [k] = vdupq_n_s32 (0) ;
+
+	for (i = 8 ; i < 8 + 160 ; i += 4)
+	{	x = vld1q_f32 (pad + i) ;
+		for (k = 0 ; k < 9 ; k++)
+			sum [k] = vaddq_s32 (sum [k], vcvtq_s32_f32 (vmulq_f32 (x, vld1q_f32 (pad + i - k)))) ;
+		} ;
+
+	for (k = 0 ; k < 9 ; k++)
+		acf [k] = vaddvq_s32 (sum [k]) ;
+
+	return 9 ;
+} /* neon_gsm_acf */
+
+/* As sse2_peak_d (). FMAXNM returns the other operand when one is a NaN. */
+static int
+neon_peak_d (const double *src, int count, int channels, double *peaks)
+{	float64x2_t max0, max1 ;
+	int k ;
+
+	if (channels < 1 || channels > 2)
+		return 0 ;
+
+	max0 = channels == 1 ? vdupq_n_f64 (peaks [0]) : vld1q_f64 (peaks) ;
+	max1 = max0 ;
+
+	for (k = 0 ; k + 4 <= count ; k += 4)
+	{	max0 = vmaxnmq_f64 (max0, vabsq_f64 (vld1q_f64 (src + k))) ;
+		max1 = vmaxnmq_f64 (max1, vabsq_f64 (vld1q_f64 (src + k + 2))) ;
+		} ;
+
+	max0 = vmaxq_f64 (max0, max1) ;
+	if (channels == 1)
+		peaks [0] = vmaxvq_f64 (max0) ;
+	else
+		vst1q_f64 (peaks, max0) ;
+
+	return k ;
+} /* neon_peak_d */
+
+static const PSF_SIMD neon_kernels =
+{	PSF_SIMD_NEON, "neon",
+	neon_swap16, neon_swap32,
+	neon_pcm8_to_s, neon_pcm8_to_i, neon_pcm8_to_f, neon_pcm8_to_d,
+	neon_pcm16_to_i, neon_pcm16_to_f, neon_pcm16_to_d,
+	neon_pcm32_to_s, neon_pcm32_to_f, neon_pcm32_to_d,
+	neon_s_to_pcm8, neon_i_to_pcm8, neon_i_to_pcm16, neon_s_to_pcm32,
+	neon_pcm24_to_i, neon_pcm24_to_f, neon_pcm24_to_d,
+	neon_i_to_pcm24, neon_f_to_pcm24, neon_d_to_pcm24,
+	neon_f_to_s_clip, neon_f_to_i_clip, neon_d_to_s_clip, neon_d_to_i_clip,
+	neon_g711_to_s, neon_g711_to_i, neon_g711_to_f, neon_g711_to_d,
+	neon_s_to_g711, neon_i_to_g711, neon_f_to_g711, neon_d_to_g711,
+	/* The ALAC predictor has only been vectorised for AVX2 so far. */
+	none_alac_unpc, neon_alac_unmix,
+	neon_planar_to_s, neon_planar_to_i, neon_planar_to_f, neon_planar_to_d,
+	/* See HAVE_GSM_LTP_KERNELS. */
+	neon_gsm_st_analysis, neon_gsm_st_synthesis, neon_gsm_acf, none_gsm_ltp_xcorr,
+	neon_peak_d
+} ;
+
+#endif
+
+/*==============================================================================
+*/
+
+const PSF_SIMD *
+psf_simd_get (int level)
+{
+	switch (level)
+	{	case PSF_SIMD_NONE :
+			return &none_kernels ;
+
+#if CPU_IS_X86_64
+		case PSF_SIMD_SSE2 :
+			return &sse2_kernels ;
+
+#if HAVE_AVX2_KERNELS
+		case PSF_SIMD_AVX2 :
+			return cpu_has_avx2 () ? &avx2_kernels : NULL ;
+#endif
+#elif CPU_IS_AARCH64
+		case PSF_SIMD_NEON :
+			return &neon_kernels ;
+#endif
+
+		default :
+			break ;
+		} ;
+
+	return NULL ;
+} /* psf_simd_get */
+
+/*
+**	The choice is made once for the whole process. Applications may call in
+**	from several threads at once, each with its own SNDFILE, so the first
+**	caller makes it and the others wait for it or see its result.
+*/
+static const PSF_SIMD *simd_best = NULL ;
+
+static void
+psf_simd_choose (void)
+{	static const int levels [] = { PSF_SIMD_AVX2, PSF_SIMD_SSE2, PSF_SIMD_NEON } ;
+	const PSF_SIMD *kernels = NULL ;
+	unsigned k ;
+
+	for (k = 0 ; k < sizeof (levels) / sizeof (levels [0]) ; k++)
+		if ((kernels = psf_simd_get (levels [k])) != NULL)
+			break ;
+
+	kernels = (kernels != NULL) ? kernels : &none_kernels ;
+
+#if HAVE_PTHREAD
+	simd_best = kernels ;
+#elif OS_IS_WIN32
+	InterlockedCompareExchangePointer ((PVOID volatile *) &simd_best, (PVOID) kernels, NULL) ;
+#else
+	simd_best = kernels ;
+#endif
+} /* psf_simd_choose */
+
+const PSF_SIMD *
+psf_simd (void)
+{
+#if HAVE_PTHREAD
+	static pthread_once_t once = PTHREAD_ONCE_INIT ;
+
+	pthread_once (&once, psf_simd_choose) ;
+	return simd_best ;
+#elif OS_IS_WIN32
+	/* The CPU checks here are plain cpuid, so threads may race to make them. */
+	const PSF_SIMD *kernels ;
+
+	if ((kernels = InterlockedCompareExchangePointer ((PVOID volatile *) &simd_best, NULL, NULL)) == NULL)
+	{	psf_simd_choose () ;
+		kernels = InterlockedCompareExchangePointer ((PVOID volatile *) &simd_best, NULL, NULL) ;
+		} ;
+	return kernels ;
+#else
+	/* No threads in this build. */
+	if (simd_best == NULL)
+		psf_simd_choose () ;
+	return simd_best ;
+#endif
+} /* psf_simd */
@@ -0,0 +1,181 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef SNDFILE_SIMD_H
+#define SNDFILE_SIMD_H
+
+/*
+**	Vectorised sample conversion kernels, selected at run time from the
+**	instruction sets the CPU supports.
+**
+**	Every kernel converts the first part of the array that it can handle
+**	(some multiple of the vector length) and returns the number of items
+**	converted. The caller finishes the rest with the scalar code, which is
+**	also the reference for the results; kernels must give identical output.
+**	Source and destination must not overlap, except for the swap kernels
+**	which may work in place.
+**
+**	Read kernels (pcmN_to_*) byte swap the file data before converting it
+**	when swap is non-zero, write kernels (*_to_pcmN) byte swap their output.
+**	For 8 bit data is_unsigned selects unsigned (offset by 0x80) samples.
+**
+**	The 24 bit kernels work on packed three byte samples, big_endian selects
+**	the byte order of the file data. Unpacking gives the sample in the top
+**	three bytes of an int, like psf_get_le24 (). When packing floats with
+**	clip set, normfact scales to the full int range and the result is
+**	clipped and truncated to 24 bits, otherwise it scales to the 24 bit
+**	range directly. Either way the kernel stops early at values the scalar
+**	code would treat differently (NaNs, or overflow when not clipping).
+**
+**	The clip kernels round src * normfact to the nearest int and saturate
+**	to the int range, which is what all the clipping converters do. The
+**	short versions then shift the int right by shift bits (16 to take the
+**	top half like pcm.c does, 0 to round directly to short) and saturate
+**	again to the short range. Both can byte swap the output and stop before
+**	a NaN.
+**
+**	The G.711 kernels take law (PSF_G711_ULAW or PSF_G711_ALAW) to pick the
+**	encoding. Decoding gives the same 16 bit values as the tables in ulaw.c
+**	and alaw.c. Encoding works from the same table index as the scalar
+**	code: the magnitude divided by 4 (u-law) or 16 (A-law), so for floats
+**	normfact must include that divide. The float kernels stop before a
+**	value that would index outside the table, including NaNs and infinities.
+**
+**	The ALAC kernels work on the decoder's predictor buffers. alac_unpc runs
+**	the adaptive predictor of unpc_block () with numactive taps on the
+**	residuals in pc, starting after the numactive + 1 warm up samples which
+**	must already be in out, and updates coefs as it goes. It returns the
+**	number of samples it predicted, and the scalar code carries on from
+**	there with the updated coefs. chanshift is 32 minus the channel width.
+**	alac_unmix undoes the stereo matrixing (none when mixres is zero) of
+**	count sample pairs from u and v, shifts them left by shift bits and
+**	interleaves them into out.
+**
+**	The planar kernels interleave count frames from separate channel buffers
+**	(src [0] to src [channels - 1], as libFLAC decodes them) into dest,
+**	converting each sample like flac_buffer_copy () does. They handle one or
+**	two channels and return zero for more. The short version shifts left by
+**	shift bits, or right for a negative shift, and keeps the low 16 bits;
+**	the int version shifts left by shift.
+**
+**	The GSM 06.10 kernels are the hot loops of the codec in GSM610/. The
+**	short term filters run the eight stage lattices of short_term.c over
+**	count samples with the reflection coefficients in rp (or rrp), which
+**	must be greater than -32768 as LARp_to_rp () makes them. The analysis
+**	filter works on s in place and updates u [0..7], the synthesis filter
+**	reads wt, writes sr and updates v [0..8]. gsm_acf computes the nine
+**	sums of Autocorrelation () in lpc.c from the 160 samples in s, before
+**	they are doubled, and returns 9. gsm_ltp_xcorr computes the cross
+**	correlations of the 40 samples in wt with dp [-120..-1] for the lags
+**	40 to 120 of Calculation_of_the_LTP_parameters () in long_term.c,
+**	adding the products in the same order, and returns 81. These last two
+**	do all or nothing.
+**
+**	peak_d raises peaks [0..channels - 1] to the largest magnitude of each
+**	channel in the count interleaved samples of src, passing over NaNs like
+**	the scalar code in command.c. It handles one or two channels, returns
+**	zero for more and otherwise a whole number of frames.
+*/
+
+enum
+{	PSF_G711_ULAW = 0,
+	PSF_G711_ALAW
+} ;
+
+enum
+{	PSF_SIMD_NONE = 0,
+	PSF_SIMD_SSE2,
+	PSF_SIMD_AVX2,
+	PSF_SIMD_NEON
+} ;
+
+typedef struct
+{	int			level ;
+	const char	*name ;
+
+	int	(*swap16)		(const short *src, short *dest, int count) ;
+	int	(*swap32)		(const int *src, int *dest, int count) ;
+
+	int	(*pcm8_to_s)	(const unsigned char *src, short *dest, int count, int is_unsigned) ;
+	int	(*pcm8_to_i)	(const unsigned char *src, int *dest, int count, int is_unsigned) ;
+	int	(*pcm8_to_f)	(const unsigned char *src, float *dest, int count, int is_unsigned, float normfact) ;
+	int	(*pcm8_to_d)	(const unsigned char *src, double *dest, int count, int is_unsigned, double normfact) ;
+
+	int	(*pcm16_to_i)	(const short *src, int *dest, int count, int swap) ;
+	int	(*pcm16_to_f)	(const short *src, float *dest, int count, int swap, float normfact) ;
+	int	(*pcm16_to_d)	(const short *src, double *dest, int count, int swap, double normfact) ;
+
+	int	(*pcm32_to_s)	(const int *src, short *dest, int count, int swap) ;
+	int	(*pcm32_to_f)	(const int *src, float *dest, int count, int swap, float normfact) ;
+	int	(*pcm32_to_d)	(const int *src, double *dest, int count, int swap, double normfact) ;
+
+	int	(*s_to_pcm8)	(const short *src, unsigned char *dest, int count, int is_unsigned) ;
+	int	(*i_to_pcm8)	(const int *src, unsigned char *dest, int count, int is_unsigned) ;
+	int	(*i_to_pcm16)	(const int *src, short *dest, int count, int swap) ;
+	int	(*s_to_pcm32)	(const short *src, int *dest, int count, int swap) ;
+
+	int	(*pcm24_to_i)	(const unsigned char *src, int *dest, int count, int big_endian) ;
+	int	(*pcm24_to_f)	(const unsigned char *src, float *dest, int count, int big_endian, float normfact) ;
+	int	(*pcm24_to_d)	(const unsigned char *src, double *dest, int count, int big_endian, double normfact) ;
+
+	int	(*i_to_pcm24)	(const int *src, unsigned char *dest, int count, int big_endian) ;
+	int	(*f_to_pcm24)	(const float *src, unsigned char *dest, int count, int big_endian, float normfact, int clip) ;
+	int	(*d_to_pcm24)	(const double *src, unsigned char *dest, int count, int big_endian, double normfact, int clip) ;
+
+	int	(*f_to_s_clip)	(const float *src, short *dest, int count, float normfact, int shift, int swap) ;
+	int	(*f_to_i_clip)	(const float *src, int *dest, int count, float normfact, int swap) ;
+	int	(*d_to_s_clip)	(const double *src, short *dest, int count, double normfact, int shift, int swap) ;
+	int	(*d_to_i_clip)	(const double *src, int *dest, int count, double normfact, int swap) ;
+
+	int	(*g711_to_s)	(const unsigned char *src, short *dest, int count, int law) ;
+	int	(*g711_to_i)	(const unsigned char *src, int *dest, int count, int law) ;
+	int	(*g711_to_f)	(const unsigned char *src, float *dest, int count, int law, float normfact) ;
+	int	(*g711_to_d)	(const unsigned char *src, double *dest, int count, int law, double normfact) ;
+
+	int	(*s_to_g711)	(const short *src, unsigned char *dest, int count, int law) ;
+	int	(*i_to_g711)	(const int *src, unsigned char *dest, int count, int law) ;
+	int	(*f_to_g711)	(const float *src, unsigned char *dest, int count, int law, float normfact) ;
+	int	(*d_to_g711)	(const double *src, unsigned char *dest, int count, int law, double normfact) ;
+
+	int	(*alac_unpc)	(const int *pc, int *out, int num, short *coefs, int numactive, int chanshift, int denshift) ;
+	int	(*alac_unmix)	(const int *u, const int *v, int *out, int count, int mixbits, int mixres, int shift) ;
+
+	int	(*planar_to_s)	(const int * const *src, int channels, short *dest, int count, int shift) ;
+	int	(*planar_to_i)	(const int * const *src, int channels, int *dest, int count, int shift) ;
+	int	(*planar_to_f)	(const int * const *src, int channels, float *dest, int count, float normfact) ;
+	int	(*planar_to_d)	(const int * const *src, int channels, double *dest, int count, double normfact) ;
+
+	int	(*gsm_st_analysis)	(short *u, const short *rp, short *s, int count) ;
+	int	(*gsm_st_synthesis)	(short *v, const short *rrp, const short *wt, short *sr, int count) ;
+	int	(*gsm_acf)			(const float *s, int *acf) ;
+	int	(*gsm_ltp_xcorr)	(const float *wt, const float *dp, float *xcorr) ;
+
+	int	(*peak_d)		(const double *src, int count, int channels, double *peaks) ;
+} PSF_SIMD ;
+
+/* The best kernels for this CPU. */
+const PSF_SIMD *psf_simd (void) ;
+
+/*
+**	The kernels for a given PSF_SIMD_* level or NULL if the CPU (or the
+**	build) doesn't support it. PSF_SIMD_NONE always succeeds and returns
+**	kernels which convert nothing. Used for testing.
+*/
+const PSF_SIMD *psf_simd_get (int level) ;
+
+#endif /* SNDFILE_SIMD_H */
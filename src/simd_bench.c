@@ -0,0 +1,258 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+**	Micro benchmark for the packed 24 bit and clipping conversion kernels. Each
+**	conversion is run the way pcm.c runs it (kernel first, scalar code for
+**	the rest) with every kernel set the CPU supports. The "none" set does
+**	everything in the scalar code, which is what pcm.c did before the
+**	kernels were added.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "common.h"
+#include "sfendian.h"
+#include "simd.h"
+
+#define	BENCH_LEN		(SF_BUFFER_LEN / 4)
+#define	BENCH_SECONDS	0.5
+
+static unsigned char	pcm24 [3 * BENCH_LEN] ;
+static short			sbuf [BENCH_LEN] ;
+static int				ibuf [BENCH_LEN] ;
+static float			fbuf [BENCH_LEN] ;
+static double			dbuf [BENCH_LEN] ;
+
+static void
+let2i (const PSF_SIMD *simd)
+{	int count = BENCH_LEN, done ;
+
+	done = simd->pcm24_to_i (pcm24, ibuf, count, SF_FALSE) ;
+	while (--count >= done)
+		ibuf [count] = psf_get_le24 (pcm24, 3 * count) ;
+} /* let2i */
+
+static void
+bet2f (const PSF_SIMD *simd)
+{	const float normfact = 1.0 / ((float) 0x80000000) ;
+	int count = BENCH_LEN, done ;
+
+	done = simd->pcm24_to_f (pcm24, fbuf, count, SF_TRUE, normfact) ;
+	while (--count >= done)
+		fbuf [count] = ((float) psf_get_be24 (pcm24, 3 * count)) * normfact ;
+} /* bet2f */
+
+static void
+let2f (const PSF_SIMD *simd)
+{	const float normfact = 1.0 / ((float) 0x80000000) ;
+	int count = BENCH_LEN, done ;
+
+	done = simd->pcm24_to_f (pcm24, fbuf, count, SF_FALSE, normfact) ;
+	while (--count >= done)
+		fbuf [count] = ((float) psf_get_le24 (pcm24, 3 * count)) * normfact ;
+} /* let2f */
+
+static void
+let2d (const PSF_SIMD *simd)
+{	const double normfact = 1.0 / ((double) 0x80000000) ;
+	int count = BENCH_LEN, done ;
+
+	done = simd->pcm24_to_d (pcm24, dbuf, count, SF_FALSE, normfact) ;
+	while (--count >= done)
+		dbuf [count] = ((double) psf_get_le24 (pcm24, 3 * count)) * normfact ;
+} /* let2d */
+
+static void
+i2let (const PSF_SIMD *simd)
+{	int count = BENCH_LEN, done, value ;
+
+	done = simd->i_to_pcm24 (ibuf, pcm24, count, SF_FALSE) ;
+	while (--count >= done)
+	{	value = ibuf [count] >> 8 ;
+		pcm24 [3 * count] = value ;
+		pcm24 [3 * count + 1] = value >> 8 ;
+		pcm24 [3 * count + 2] = value >> 16 ;
+		} ;
+} /* i2let */
+
+static void
+f2let (const PSF_SIMD *simd)
+{	const float normfact = 1.0 * 0x7FFFFF ;
+	int count = BENCH_LEN, done, value ;
+
+	done = simd->f_to_pcm24 (fbuf, pcm24, count, SF_FALSE, normfact, SF_FALSE) ;
+	while (--count >= done)
+	{	value = lrintf (fbuf [count] * normfact) ;
+		pcm24 [3 * count] = value ;
+		pcm24 [3 * count + 1] = value >> 8 ;
+		pcm24 [3 * count + 2] = value >> 16 ;
+		} ;
+} /* f2let */
+
+static void
+f2bet_clip (const PSF_SIMD *simd)
+{	const float normfact = 8.0 * 0x10000000 ;
+	float scaled_value ;
+	int count = BENCH_LEN, done, value ;
+
+	done = simd->f_to_pcm24 (fbuf, pcm24, count, SF_TRUE, normfact, SF_TRUE) ;
+	while (--count >= done)
+	{	scaled_value = fbuf [count] * normfact ;
+		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+			value = 0x7FFFFFFF ;
+		else if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+			value = -0x7FFFFFFF - 1 ;
+		else
+			value = lrintf (scaled_value) ;
+		pcm24 [3 * count] = value >> 24 ;
+		pcm24 [3 * count + 1] = value >> 16 ;
+		pcm24 [3 * count + 2] = value >> 8 ;
+		} ;
+} /* f2bet_clip */
+
+static void
+d2let_clip (const PSF_SIMD *simd)
+{	const double normfact = 8.0 * 0x10000000 ;
+	double scaled_value ;
+	int count = BENCH_LEN, done, value ;
+
+	done = simd->d_to_pcm24 (dbuf, pcm24, count, SF_FALSE, normfact, SF_TRUE) ;
+	while (--count >= done)
+	{	scaled_value = dbuf [count] * normfact ;
+		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+			value = 0x7FFFFFFF ;
+		else if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+			value = -0x7FFFFFFF - 1 ;
+		else
+			value = lrint (scaled_value) ;
+		pcm24 [3 * count] = value >> 8 ;
+		pcm24 [3 * count + 1] = value >> 16 ;
+		pcm24 [3 * count + 2] = value >> 24 ;
+		} ;
+} /* d2let_clip */
+
+static void
+f2s_clip (const PSF_SIMD *simd)
+{	const float normfact = 1.0 * 0x8000 ;
+	float scaled_value ;
+	int count = BENCH_LEN, done ;
+
+	done = simd->f_to_s_clip (fbuf, sbuf, count, normfact, 0, SF_FALSE) ;
+	while (--count >= done)
+	{	scaled_value = fbuf [count] * normfact ;
+		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFF))
+			sbuf [count] = 0x7FFF ;
+		else if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x1000))
+			sbuf [count] = -0x7FFF - 1 ;
+		else
+			sbuf [count] = lrintf (scaled_value) ;
+		} ;
+} /* f2s_clip */
+
+static void
+d2i_clip (const PSF_SIMD *simd)
+{	const double normfact = 8.0 * 0x10000000 ;
+	double scaled_value ;
+	int count = BENCH_LEN, done ;
+
+	done = simd->d_to_i_clip (dbuf, ibuf, count, normfact, SF_FALSE) ;
+	while (--count >= done)
+	{	scaled_value = dbuf [count] * normfact ;
+		if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+			ibuf [count] = 0x7FFFFFFF ;
+		else if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+			ibuf [count] = -0x7FFFFFFF - 1 ;
+		else
+			ibuf [count] = lrint (scaled_value) ;
+		} ;
+} /* d2i_clip */
+
+/* Returns millions of samples per second. */
+static double
+bench (void (*convert) (const PSF_SIMD *), const PSF_SIMD *simd)
+{	clock_t start, elapsed ;
+	long loops = 0 ;
+
+	start = clock () ;
+	do
+	{	convert (simd) ;
+		loops ++ ;
+		elapsed = clock () - start ;
+		}
+	while (elapsed < BENCH_SECONDS * CLOCKS_PER_SEC) ;
+
+	return (1e-6 * loops * BENCH_LEN) / (((double) elapsed) / CLOCKS_PER_SEC) ;
+} /* bench */
+
+int
+main (void)
+{	static const struct
+	{	const char *name ;
+		void (*convert) (const PSF_SIMD *) ;
+	} tests [] =
+	{	{ "le 24 bit -> int", let2i },
+		{ "le 24 bit -> float", let2f },
+		{ "be 24 bit -> float", bet2f },
+		{ "le 24 bit -> double", let2d },
+		{ "int -> le 24 bit", i2let },
+		{ "float -> le 24 bit", f2let },
+		{ "float -> be 24 bit (clip)", f2bet_clip },
+		{ "double -> le 24 bit (clip)", d2let_clip },
+		{ "float -> short (clip)", f2s_clip },
+		{ "double -> int (clip)", d2i_clip },
+		} ;
+	const PSF_SIMD *simd ;
+	double scalar, rate ;
+	unsigned k ;
+	int level ;
+
+	srand (0x24b17) ;
+	for (k = 0 ; k < BENCH_LEN ; k++)
+	{	fbuf [k] = (rand () - RAND_MAX / 2) * (2.2 / RAND_MAX) ;
+		dbuf [k] = fbuf [k] ;
+		ibuf [k] = rand () ;
+		} ;
+	for (k = 0 ; k < sizeof (pcm24) ; k++)
+		pcm24 [k] = rand () ;
+
+	printf ("\n    Conversions in Msamples/sec (%d samples per call).\n\n", BENCH_LEN) ;
+
+	for (k = 0 ; k < ARRAY_LEN (tests) ; k++)
+	{	scalar = bench (tests [k].convert, psf_simd_get (PSF_SIMD_NONE)) ;
+		printf ("    %-28s scalar %8.1f", tests [k].name, scalar) ;
+
+		for (level = PSF_SIMD_SSE2 ; level <= PSF_SIMD_NEON ; level++)
+		{	if ((simd = psf_simd_get (level)) == NULL)
+				continue ;
+			rate = bench (tests [k].convert, simd) ;
+			printf ("    %s %8.1f (x%.1f)", simd->name, rate, rate / scalar) ;
+			} ;
+		puts ("") ;
+		} ;
+
+	puts ("") ;
+
+	return 0 ;
+} /* main */
@@ -26,6 +26,8 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"thread_pool.h"
+#include	"checkpoint.h"
 
 #if HAVE_UNISTD_H
 #include <unistd.h>
@@ -279,6 +281,9 @@ ErrorStruct SndfileErrors [] =
 
 	{	SFE_OPUS_BAD_SAMPLERATE	, "Error : Opus only supports sample rates of 8000, 12000, 16000, 24000 and 48000." },
 
+	{	SFE_BAD_MEMORY_IO		, "Error : bad pointer or length for in memory file." },
+	{	SFE_BAD_PLANAR_ARGS		, "Error : bad channel pointers or stride for planar read/write." },
+
 	{	SFE_MAX_ERROR			, "Maximum error number." },
 	{	SFE_MAX_ERROR + 1		, NULL }
 } ;
@@ -296,6 +301,16 @@ static int	psf_close (SF_PRIVATE *psf) ;
 
 static int	try_resource_fork (SF_PRIVATE * psf) ;
 
+/* Sample types for the functions which handle all four of them. */
+enum
+{	SF_DATA_SHORT,
+	SF_DATA_INT,
+	SF_DATA_FLOAT,
+	SF_DATA_DOUBLE
+} ;
+
+static sf_count_t	read_selected (SF_PRIVATE *psf, int type, void *ptr, sf_count_t len) ;
+
 /*------------------------------------------------------------------------------
 ** Private (static) variables.
 */
@@ -431,15 +446,70 @@ sf_open_virtual	(SF_VIRTUAL_IO *sfvirtual, int mode, SF_INFO *sfinfo, void *user
 
 	psf_init_files (psf) ;
 
-	psf->virtual_io = SF_TRUE ;
-	psf->vio = *sfvirtual ;
-	psf->vio_user_data = user_data ;
+	psf_set_virtual_io (psf, sfvirtual, user_data) ;
 
 	psf->file.mode = mode ;
 
 	return psf_open_file (psf, sfinfo) ;
 } /* sf_open_virtual */
 
+SNDFILE*
+sf_open_memory	(const void *data, sf_count_t datalen, SF_INFO *sfinfo)
+{	SF_PRIVATE 	*psf ;
+
+	if (data == NULL || datalen < 0)
+	{	sf_errno = SFE_BAD_MEMORY_IO ;
+		return NULL ;
+		} ;
+
+	if ((psf = psf_allocate ()) == NULL)
+	{	sf_errno = SFE_MALLOC_FAILED ;
+		return	NULL ;
+		} ;
+
+	psf_init_files (psf) ;
+	psf_set_memory (psf, data, datalen) ;
+
+	psf->file.mode = SFM_READ ;
+
+	return psf_open_file (psf, sfinfo) ;
+} /* sf_open_memory */
+
+SNDFILE*
+sf_open_memory_write	(void **data, sf_count_t *datalen, SF_INFO *sfinfo)
+{	SF_PRIVATE 	*psf ;
+	SNDFILE		*result ;
+
+	if (data == NULL || datalen == NULL)
+	{	sf_errno = SFE_BAD_MEMORY_IO ;
+		return NULL ;
+		} ;
+
+	if ((psf = psf_allocate ()) == NULL)
+	{	sf_errno = SFE_MALLOC_FAILED ;
+		return	NULL ;
+		} ;
+
+	psf_init_files (psf) ;
+	psf_set_memory_write (psf, data, datalen) ;
+
+	psf->file.mode = SFM_WRITE ;
+
+	if ((result = psf_open_file (psf, sfinfo)) == NULL)
+	{	/* Anything written by the header code belongs to the failed open. */
+		free (*data) ;
+		*data = NULL ;
+		*datalen = 0 ;
+		} ;
+
+	return result ;
+} /* sf_open_memory_write */
+
+void
+sf_memory_free	(void *data)
+{	free (data) ;
+} /* sf_memory_free */
+
 int
 sf_close	(SNDFILE *sndfile)
 {	SF_PRIVATE	*psf ;
@@ -1154,6 +1224,7 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 					return SF_TRUE ;
 
 				psf->sf.frames = position ;
+				psf_clear_peak_cache (psf) ;
 
 				position = psf_fseek (psf, 0, SEEK_CUR) ;
 
@@ -1169,6 +1240,7 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 				return (psf->error = SFE_BAD_COMMAND_PARAM) ;
 
 			psf->dataoffset = *((sf_count_t*) data) ;
+			psf_clear_peak_cache (psf) ;
 			sf_seek (sndfile, 0, SEEK_CUR) ;
 			break ;
 
@@ -1199,6 +1271,19 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 		case SFC_GET_CLIPPING :
 			return psf->add_clipping ;
 
+		case SFC_SET_MMAP_READ :
+			return psf_use_mmap (psf, (datasize) ? SF_TRUE : SF_FALSE) ;
+
+		case SFC_SET_WRITE_BUFFER_SIZE :
+			if (data == NULL || datasize != SIGNED_SIZEOF (int) || *((int *) data) < 0)
+				return (psf->error = SFE_BAD_COMMAND_PARAM) ;
+			return psf_set_write_buffer (psf, *((int *) data)) ;
+
+		case SFC_SET_VIRTUAL_IO_BLOCK_SIZE :
+			if (data == NULL || datasize != SIGNED_SIZEOF (int) || *((int *) data) < 0)
+				return (psf->error = SFE_BAD_COMMAND_PARAM) ;
+			return psf_set_vio_block_size (psf, *((int *) data)) ;
+
 		case SFC_GET_LOOP_INFO :
 			if (datasize != sizeof (SF_LOOP_INFO) || data == NULL)
 			{	psf->error = SFE_BAD_COMMAND_PARAM ;
@@ -1383,6 +1468,76 @@ sf_command	(SNDFILE *sndfile, int command, void *data, int datasize)
 				return psf->command (psf, command, NULL, 0) ;
 			return SF_FALSE ;
 
+		case SFC_SET_READ_CHANNELS :
+			if (psf->file.mode != SFM_READ)
+			{	psf->error = SFE_NOT_READMODE ;
+				return SF_FALSE ;
+				} ;
+
+			if (data == NULL || datasize == 0)
+			{	free (psf->read_channels) ;
+				psf->read_channels = NULL ;
+				psf->read_channel_count = 0 ;
+				return SF_TRUE ;
+				} ;
+
+			if (psf->can_select_channels == SF_FALSE)
+			{	psf->error = SFE_UNIMPLEMENTED ;
+				return SF_FALSE ;
+				} ;
+
+			if (datasize < 0 || datasize % SIGNED_SIZEOF (int) != 0 || datasize > SIGNED_SIZEOF (int) * psf->sf.channels)
+			{	psf->error = SFE_BAD_COMMAND_PARAM ;
+				return SF_FALSE ;
+				} ;
+
+			{	int *iptr ;
+
+				for (iptr = data ; iptr < (int *) data + datasize / SIGNED_SIZEOF (int) ; iptr++)
+				{	if (*iptr < 0 || *iptr >= psf->sf.channels)
+					{	psf->error = SFE_BAD_COMMAND_PARAM ;
+						return SF_FALSE ;
+						} ;
+					} ;
+				} ;
+
+			free (psf->read_channels) ;
+			if ((psf->read_channels = malloc (datasize)) == NULL)
+			{	psf->read_channel_count = 0 ;
+				psf->error = SFE_MALLOC_FAILED ;
+				return SF_FALSE ;
+				} ;
+
+			memcpy (psf->read_channels, data, datasize) ;
+			psf->read_channel_count = datasize / SIGNED_SIZEOF (int) ;
+			return SF_TRUE ;
+
+		case SFC_SET_THREADS :
+			if (data == NULL || datasize != SIGNED_SIZEOF (int) || *((int *) data) < 0)
+			{	psf->error = SFE_BAD_COMMAND_PARAM ;
+				return SF_FALSE ;
+				} ;
+
+			/* Codecs pick their mode before the first write. */
+			if (psf->have_written)
+			{	psf->error = SFE_CMD_HAS_DATA ;
+				return SF_FALSE ;
+				} ;
+
+			psf->threads = *((int *) data) ;
+			if (psf->threads == 0)
+				psf->threads = psf_cpu_count () ;
+			psf->threads = SF_MIN (psf->threads, PSF_MAX_THREADS) ;
+			return psf->threads ;
+
+		case SFC_BUILD_SEEK_INDEX :
+			if (psf->checkpoints != NULL)
+				return psf_checkpoints_build (psf) ;
+			/* Otherwise the container may keep an index of its own. */
+			if (psf->command)
+				return psf->command (psf, command, data, datasize) ;
+			return SF_FALSE ;
+
 		case SFC_SET_VBR_ENCODING_QUALITY :
 			if (data == NULL || datasize != sizeof (double))
 				return SF_FALSE ;
@@ -1664,12 +1819,15 @@ sf_count_t
 sf_read_short	(SNDFILE *sndfile, short *ptr, sf_count_t len)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (len == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (len <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -1680,7 +1838,7 @@ sf_read_short	(SNDFILE *sndfile, short *ptr, sf_count_t len)
 		return 0 ;
 		} ;
 
-	if (len % psf->sf.channels)
+	if (len % channels)
 	{	psf->error = SFE_BAD_READ_ALIGN ;
 		return 0 ;
 		} ;
@@ -1699,12 +1857,15 @@ sf_read_short	(SNDFILE *sndfile, short *ptr, sf_count_t len)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_short (psf, ptr, len) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_SHORT, ptr, len) ;
+	else
+		count = psf->read_short (psf, ptr, len) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
 		extra = len - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (short)) ;
 		psf->read_current = psf->sf.frames ;
@@ -1719,12 +1880,15 @@ sf_count_t
 sf_readf_short		(SNDFILE *sndfile, short *ptr, sf_count_t frames)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (frames == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (frames <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -1736,7 +1900,7 @@ sf_readf_short		(SNDFILE *sndfile, short *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_current >= psf->sf.frames)
-	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (short)) ;
+	{	psf_memset (ptr, 0, frames * channels * sizeof (short)) ;
 		return 0 ; /* End of file. */
 		} ;
 
@@ -1749,20 +1913,23 @@ sf_readf_short		(SNDFILE *sndfile, short *ptr, sf_count_t frames)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_short (psf, ptr, frames * psf->sf.channels) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_SHORT, ptr, frames * channels) ;
+	else
+		count = psf->read_short (psf, ptr, frames * channels) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
-		extra = frames * psf->sf.channels - count ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
+		extra = frames * channels - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (short)) ;
 		psf->read_current = psf->sf.frames ;
 		} ;
 
 	psf->last_op = SFM_READ ;
 
-	return count / psf->sf.channels ;
+	return count / channels ;
 } /* sf_readf_short */
 
 /*------------------------------------------------------------------------------
@@ -1772,12 +1939,15 @@ sf_count_t
 sf_read_int		(SNDFILE *sndfile, int *ptr, sf_count_t len)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (len == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (len <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -1788,7 +1958,7 @@ sf_read_int		(SNDFILE *sndfile, int *ptr, sf_count_t len)
 		return 0 ;
 		} ;
 
-	if (len % psf->sf.channels)
+	if (len % channels)
 	{	psf->error = SFE_BAD_READ_ALIGN ;
 		return 0 ;
 		} ;
@@ -1807,12 +1977,15 @@ sf_read_int		(SNDFILE *sndfile, int *ptr, sf_count_t len)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_int (psf, ptr, len) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_INT, ptr, len) ;
+	else
+		count = psf->read_int (psf, ptr, len) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
 		extra = len - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (int)) ;
 		psf->read_current = psf->sf.frames ;
@@ -1827,12 +2000,15 @@ sf_count_t
 sf_readf_int	(SNDFILE *sndfile, int *ptr, sf_count_t frames)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (frames == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (frames <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -1844,7 +2020,7 @@ sf_readf_int	(SNDFILE *sndfile, int *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_current >= psf->sf.frames)
-	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (int)) ;
+	{	psf_memset (ptr, 0, frames * channels * sizeof (int)) ;
 		return 0 ;
 		} ;
 
@@ -1857,20 +2033,23 @@ sf_readf_int	(SNDFILE *sndfile, int *ptr, sf_count_t frames)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_int (psf, ptr, frames * psf->sf.channels) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_INT, ptr, frames * channels) ;
+	else
+		count = psf->read_int (psf, ptr, frames * channels) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
-		extra = frames * psf->sf.channels - count ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
+		extra = frames * channels - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (int)) ;
 		psf->read_current = psf->sf.frames ;
 		} ;
 
 	psf->last_op = SFM_READ ;
 
-	return count / psf->sf.channels ;
+	return count / channels ;
 } /* sf_readf_int */
 
 /*------------------------------------------------------------------------------
@@ -1880,12 +2059,15 @@ sf_count_t
 sf_read_float	(SNDFILE *sndfile, float *ptr, sf_count_t len)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (len == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (len <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -1896,7 +2078,7 @@ sf_read_float	(SNDFILE *sndfile, float *ptr, sf_count_t len)
 		return 0 ;
 		} ;
 
-	if (len % psf->sf.channels)
+	if (len % channels)
 	{	psf->error = SFE_BAD_READ_ALIGN ;
 		return 0 ;
 		} ;
@@ -1915,12 +2097,15 @@ sf_read_float	(SNDFILE *sndfile, float *ptr, sf_count_t len)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_float (psf, ptr, len) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_FLOAT, ptr, len) ;
+	else
+		count = psf->read_float (psf, ptr, len) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
 		extra = len - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (float)) ;
 		psf->read_current = psf->sf.frames ;
@@ -1935,12 +2120,15 @@ sf_count_t
 sf_readf_float	(SNDFILE *sndfile, float *ptr, sf_count_t frames)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (frames == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (frames <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -1952,7 +2140,7 @@ sf_readf_float	(SNDFILE *sndfile, float *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_current >= psf->sf.frames)
-	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (float)) ;
+	{	psf_memset (ptr, 0, frames * channels * sizeof (float)) ;
 		return 0 ;
 		} ;
 
@@ -1965,20 +2153,23 @@ sf_readf_float	(SNDFILE *sndfile, float *ptr, sf_count_t frames)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_float (psf, ptr, frames * psf->sf.channels) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_FLOAT, ptr, frames * channels) ;
+	else
+		count = psf->read_float (psf, ptr, frames * channels) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
-		extra = frames * psf->sf.channels - count ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
+		extra = frames * channels - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (float)) ;
 		psf->read_current = psf->sf.frames ;
 		} ;
 
 	psf->last_op = SFM_READ ;
 
-	return count / psf->sf.channels ;
+	return count / channels ;
 } /* sf_readf_float */
 
 /*------------------------------------------------------------------------------
@@ -1988,12 +2179,15 @@ sf_count_t
 sf_read_double	(SNDFILE *sndfile, double *ptr, sf_count_t len)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (len == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (len <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -2004,7 +2198,7 @@ sf_read_double	(SNDFILE *sndfile, double *ptr, sf_count_t len)
 		return 0 ;
 		} ;
 
-	if (len % psf->sf.channels)
+	if (len % channels)
 	{	psf->error = SFE_BAD_READ_ALIGN ;
 		return 0 ;
 		} ;
@@ -2023,12 +2217,15 @@ sf_read_double	(SNDFILE *sndfile, double *ptr, sf_count_t len)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_double (psf, ptr, len) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_DOUBLE, ptr, len) ;
+	else
+		count = psf->read_double (psf, ptr, len) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
 		extra = len - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (double)) ;
 		psf->read_current = psf->sf.frames ;
@@ -2043,12 +2240,15 @@ sf_count_t
 sf_readf_double	(SNDFILE *sndfile, double *ptr, sf_count_t frames)
 {	SF_PRIVATE 	*psf ;
 	sf_count_t	count, extra ;
+	int			channels ;
 
 	if (frames == 0)
 		return 0 ;
 
 	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
 
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
 	if (frames <= 0)
 	{	psf->error = SFE_NEGATIVE_RW_LEN ;
 		return 0 ;
@@ -2060,7 +2260,7 @@ sf_readf_double	(SNDFILE *sndfile, double *ptr, sf_count_t frames)
 		} ;
 
 	if (psf->read_current >= psf->sf.frames)
-	{	psf_memset (ptr, 0, frames * psf->sf.channels * sizeof (double)) ;
+	{	psf_memset (ptr, 0, frames * channels * sizeof (double)) ;
 		return 0 ;
 		} ;
 
@@ -2073,20 +2273,23 @@ sf_readf_double	(SNDFILE *sndfile, double *ptr, sf_count_t frames)
 		if (psf->seek (psf, SFM_READ, psf->read_current) < 0)
 			return 0 ;
 
-	count = psf->read_double (psf, ptr, frames * psf->sf.channels) ;
+	if (psf->read_channels != NULL)
+		count = read_selected (psf, SF_DATA_DOUBLE, ptr, frames * channels) ;
+	else
+		count = psf->read_double (psf, ptr, frames * channels) ;
 
-	if (psf->read_current + count / psf->sf.channels <= psf->sf.frames)
-		psf->read_current += count / psf->sf.channels ;
+	if (psf->read_current + count / channels <= psf->sf.frames)
+		psf->read_current += count / channels ;
 	else
-	{	count = (psf->sf.frames - psf->read_current) * psf->sf.channels ;
-		extra = frames * psf->sf.channels - count ;
+	{	count = (psf->sf.frames - psf->read_current) * channels ;
+		extra = frames * channels - count ;
 		psf_memset (ptr + count, 0, extra * sizeof (double)) ;
 		psf->read_current = psf->sf.frames ;
 		} ;
 
 	psf->last_op = SFM_READ ;
 
-	return count / psf->sf.channels ;
+	return count / channels ;
 } /* sf_readf_double */
 
 /*------------------------------------------------------------------------------
@@ -2130,6 +2333,7 @@ sf_write_raw	(SNDFILE *sndfile, const void *ptr, sf_count_t len)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf_fwrite (ptr, 1, len, psf) ;
 
@@ -2190,6 +2394,7 @@ sf_write_short	(SNDFILE *sndfile, const short *ptr, sf_count_t len)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_short (psf, ptr, len) ;
 
@@ -2242,6 +2447,7 @@ sf_writef_short	(SNDFILE *sndfile, const short *ptr, sf_count_t frames)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_short (psf, ptr, frames * psf->sf.channels) ;
 
@@ -2302,6 +2508,7 @@ sf_write_int	(SNDFILE *sndfile, const int *ptr, sf_count_t len)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_int (psf, ptr, len) ;
 
@@ -2354,6 +2561,7 @@ sf_writef_int	(SNDFILE *sndfile, const int *ptr, sf_count_t frames)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_int (psf, ptr, frames * psf->sf.channels) ;
 
@@ -2414,6 +2622,7 @@ sf_write_float	(SNDFILE *sndfile, const float *ptr, sf_count_t len)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_float (psf, ptr, len) ;
 
@@ -2466,6 +2675,7 @@ sf_writef_float	(SNDFILE *sndfile, const float *ptr, sf_count_t frames)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_float (psf, ptr, frames * psf->sf.channels) ;
 
@@ -2526,6 +2736,7 @@ sf_write_double	(SNDFILE *sndfile, const double *ptr, sf_count_t len)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_double (psf, ptr, len) ;
 
@@ -2578,6 +2789,7 @@ sf_writef_double	(SNDFILE *sndfile, const double *ptr, sf_count_t frames)
 			return 0 ;
 		} ;
 	psf->have_written = SF_TRUE ;
+	psf_clear_peak_cache (psf) ;
 
 	count = psf->write_double (psf, ptr, frames * psf->sf.channels) ;
 
@@ -2596,10 +2808,224 @@ sf_writef_double	(SNDFILE *sndfile, const double *ptr, sf_count_t frames)
 	return count / psf->sf.channels ;
 } /* sf_writef_double */
 
+/*------------------------------------------------------------------------------
+** Planar (one buffer per channel) reads and writes. These go through the
+** interleaved functions above a small buffer at a time, transposing each
+** buffer while it is still in cache.
+*/
+
+static int
+planar_check (SF_PRIVATE *psf, int mode, const void * const *ptrs, int channels, sf_count_t stride, sf_count_t frames)
+{	int k ;
+
+	if (frames < 0)
+	{	psf->error = SFE_NEGATIVE_RW_LEN ;
+		return 0 ;
+		} ;
+
+	if (mode == SFM_READ && psf->file.mode == SFM_WRITE)
+	{	psf->error = SFE_NOT_READMODE ;
+		return 0 ;
+		} ;
+
+	if (mode == SFM_WRITE && psf->file.mode == SFM_READ)
+	{	psf->error = SFE_NOT_WRITEMODE ;
+		return 0 ;
+		} ;
+
+	if (ptrs == NULL || stride < 1)
+	{	psf->error = SFE_BAD_PLANAR_ARGS ;
+		return 0 ;
+		} ;
+
+	for (k = 0 ; k < channels ; k++)
+		if (ptrs [k] == NULL)
+		{	psf->error = SFE_BAD_PLANAR_ARGS ;
+			return 0 ;
+			} ;
+
+	return 1 ;
+} /* planar_check */
+
+static sf_count_t
+planar_read (SNDFILE *sndfile, int type, void * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	SF_PRIVATE	*psf ;
+	BUF_UNION	ubuf ;
+	sf_count_t	total = 0, chunk, count, want ;
+	int			itemsize, channels ;
+
+	if (frames == 0)
+		return 0 ;
+
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+
+	channels = psf->read_channels != NULL ? psf->read_channel_count : psf->sf.channels ;
+
+	if (planar_check (psf, SFM_READ, (const void * const *) ptrs, channels, stride, frames) == 0)
+		return 0 ;
+
+	switch (type)
+	{	case SF_DATA_SHORT : itemsize = sizeof (short) ; break ;
+		case SF_DATA_INT : itemsize = sizeof (int) ; break ;
+		case SF_DATA_FLOAT : itemsize = sizeof (float) ; break ;
+		default : itemsize = sizeof (double) ; break ;
+		} ;
+
+	chunk = SF_BUFFER_LEN / (itemsize * channels) ;
+
+	while (total < frames)
+	{	want = SF_MIN (chunk, frames - total) ;
+
+		switch (type)
+		{	case SF_DATA_SHORT : count = sf_readf_short (sndfile, ubuf.sbuf, want) ; break ;
+			case SF_DATA_INT : count = sf_readf_int (sndfile, ubuf.ibuf, want) ; break ;
+			case SF_DATA_FLOAT : count = sf_readf_float (sndfile, ubuf.fbuf, want) ; break ;
+			default : count = sf_readf_double (sndfile, ubuf.dbuf, want) ; break ;
+			} ;
+
+		if (count <= 0)
+			break ;
+
+		psf_deinterleave (ubuf.ucbuf, ptrs, itemsize, channels, total * stride, stride, (int) count) ;
+		total += count ;
+
+		if (count < want)
+			break ;
+		} ;
+
+	/* Like the interleaved functions, zero whatever could not be read. */
+	if (total < frames)
+		psf_planar_clear (ptrs, itemsize, channels, total * stride, stride, frames - total) ;
+
+	return total ;
+} /* planar_read */
+
+static sf_count_t
+planar_write (SNDFILE *sndfile, int type, const void * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	SF_PRIVATE	*psf ;
+	BUF_UNION	ubuf ;
+	sf_count_t	total = 0, chunk, count, written ;
+	int			itemsize, channels ;
+
+	if (frames == 0)
+		return 0 ;
+
+	VALIDATE_SNDFILE_AND_ASSIGN_PSF (sndfile, psf, 1) ;
+
+	channels = psf->sf.channels ;
+
+	if (planar_check (psf, SFM_WRITE, ptrs, channels, stride, frames) == 0)
+		return 0 ;
+
+	switch (type)
+	{	case SF_DATA_SHORT : itemsize = sizeof (short) ; break ;
+		case SF_DATA_INT : itemsize = sizeof (int) ; break ;
+		case SF_DATA_FLOAT : itemsize = sizeof (float) ; break ;
+		default : itemsize = sizeof (double) ; break ;
+		} ;
+
+	chunk = SF_BUFFER_LEN / (itemsize * channels) ;
+
+	while (total < frames)
+	{	count = SF_MIN (chunk, frames - total) ;
+
+		psf_interleave (ptrs, ubuf.ucbuf, itemsize, channels, total * stride, stride, (int) count) ;
+
+		switch (type)
+		{	case SF_DATA_SHORT : written = sf_writef_short (sndfile, ubuf.sbuf, count) ; break ;
+			case SF_DATA_INT : written = sf_writef_int (sndfile, ubuf.ibuf, count) ; break ;
+			case SF_DATA_FLOAT : written = sf_writef_float (sndfile, ubuf.fbuf, count) ; break ;
+			default : written = sf_writef_double (sndfile, ubuf.dbuf, count) ; break ;
+			} ;
+
+		if (written > 0)
+			total += written ;
+		if (written < count)
+			break ;
+		} ;
+
+	return total ;
+} /* planar_write */
+
+sf_count_t
+sf_readf_short_planar (SNDFILE *sndfile, short * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_read (sndfile, SF_DATA_SHORT, (void * const *) ptrs, stride, frames) ;
+} /* sf_readf_short_planar */
+
+sf_count_t
+sf_readf_int_planar (SNDFILE *sndfile, int * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_read (sndfile, SF_DATA_INT, (void * const *) ptrs, stride, frames) ;
+} /* sf_readf_int_planar */
+
+sf_count_t
+sf_readf_float_planar (SNDFILE *sndfile, float * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_read (sndfile, SF_DATA_FLOAT, (void * const *) ptrs, stride, frames) ;
+} /* sf_readf_float_planar */
+
+sf_count_t
+sf_readf_double_planar (SNDFILE *sndfile, double * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_read (sndfile, SF_DATA_DOUBLE, (void * const *) ptrs, stride, frames) ;
+} /* sf_readf_double_planar */
+
+sf_count_t
+sf_writef_short_planar (SNDFILE *sndfile, const short * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_write (sndfile, SF_DATA_SHORT, (const void * const *) ptrs, stride, frames) ;
+} /* sf_writef_short_planar */
+
+sf_count_t
+sf_writef_int_planar (SNDFILE *sndfile, const int * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_write (sndfile, SF_DATA_INT, (const void * const *) ptrs, stride, frames) ;
+} /* sf_writef_int_planar */
+
+sf_count_t
+sf_writef_float_planar (SNDFILE *sndfile, const float * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_write (sndfile, SF_DATA_FLOAT, (const void * const *) ptrs, stride, frames) ;
+} /* sf_writef_float_planar */
+
+sf_count_t
+sf_writef_double_planar (SNDFILE *sndfile, const double * const *ptrs, sf_count_t stride, sf_count_t frames)
+{	return planar_write (sndfile, SF_DATA_DOUBLE, (const void * const *) ptrs, stride, frames) ;
+} /* sf_writef_double_planar */
+
 /*=========================================================================
 ** Private functions.
 */
 
+/*
+** Codecs read into buffers of at least this many items (SF_BUFFER_LEN bytes
+** of doubles), so handing them whole frames of the selected channels at most
+** this many items at a time means psf_fread_samples () is always asked for
+** whole frames.
+*/
+#define	SELECT_CHUNK_LEN	(SF_BUFFER_LEN / SIGNED_SIZEOF (double))
+
+static sf_count_t
+read_selected (SF_PRIVATE *psf, int type, void *ptr, sf_count_t len)
+{	sf_count_t	total = 0, chunk, count, want ;
+
+	chunk = SELECT_CHUNK_LEN - SELECT_CHUNK_LEN % psf->read_channel_count ;
+
+	while (total < len)
+	{	want = SF_MIN (chunk, len - total) ;
+
+		switch (type)
+		{	case SF_DATA_SHORT : count = psf->read_short (psf, ((short *) ptr) + total, want) ; break ;
+			case SF_DATA_INT : count = psf->read_int (psf, ((int *) ptr) + total, want) ; break ;
+			case SF_DATA_FLOAT : count = psf->read_float (psf, ((float *) ptr) + total, want) ; break ;
+			default : count = psf->read_double (psf, ((double *) ptr) + total, want) ; break ;
+			} ;
+
+		if (count <= 0)
+			break ;
+		total += count ;
+
+		if (count < want)
+			break ;
+		} ;
+
+	return total ;
+} /* read_selected */
+
 static int
 try_resource_fork (SF_PRIVATE * psf)
 {	int old_error = psf->error ;
@@ -2903,6 +3329,9 @@ psf_close (SF_PRIVATE *psf)
 	free (psf->instrument) ;
 	free (psf->cues) ;
 	free (psf->channel_map) ;
+	free (psf->read_channels) ;
+	psf_checkpoints_free (psf->checkpoints) ;
+	psf_clear_peak_cache (psf) ;
 	free (psf->format_desc) ;
 	free (psf->strings.storage) ;
 
@@ -0,0 +1,192 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "test_main.h"
+
+#include "alac.c"
+
+/*
+**	Nearly five hours of 48kHz audio at 4096 frames per packet, which is
+**	three times the length that once made the index start to thin out.
+*/
+#define	PAKT_TEST_PACKETS	200003
+#define	PAKT_TEST_SEEKS		5000
+
+static sf_count_t pakt_test_offsets [PAKT_TEST_PACKETS + 1] ;
+
+/* The 'pakt' chunk is read from memory, counting the bytes read. */
+typedef struct
+{	uint8_t		* data ;
+	sf_count_t	length, position, bytes_read ;
+} PAKT_TEST_FILE ;
+
+static sf_count_t
+pakt_test_get_filelen (void * user_data)
+{	PAKT_TEST_FILE * file = user_data ;
+
+	return file->length ;
+} /* pakt_test_get_filelen */
+
+static sf_count_t
+pakt_test_seek (sf_count_t offset, int whence, void * user_data)
+{	PAKT_TEST_FILE * file = user_data ;
+
+	switch (whence)
+	{	case SEEK_CUR :
+			offset += file->position ;
+			break ;
+		case SEEK_END :
+			offset += file->length ;
+			break ;
+		default :
+			break ;
+		} ;
+
+	if (offset < 0 || offset > file->length)
+		return -1 ;
+
+	return file->position = offset ;
+} /* pakt_test_seek */
+
+static sf_count_t
+pakt_test_read (void * ptr, sf_count_t count, void * user_data)
+{	PAKT_TEST_FILE * file = user_data ;
+
+	count = SF_MIN (count, file->length - file->position) ;
+	memcpy (ptr, file->data + file->position, count) ;
+	file->position += count ;
+	file->bytes_read += count ;
+
+	return count ;
+} /* pakt_test_read */
+
+static sf_count_t
+pakt_test_write (const void * UNUSED (ptr), sf_count_t UNUSED (count), void * UNUSED (user_data))
+{	return 0 ;
+} /* pakt_test_write */
+
+static sf_count_t
+pakt_test_tell (void * user_data)
+{	PAKT_TEST_FILE * file = user_data ;
+
+	return file->position ;
+} /* pakt_test_tell */
+
+static uint32_t
+pakt_test_size (uint32_t k)
+{	/* Mostly two byte sizes, with some one and three byte ones. */
+	if (k % 997 == 0)
+		return 1 + k % 127 ;
+	if (k % 1009 == 0)
+		return 20000 + k % 100000 ;
+	return 200 + (k * 7919u) % 12000 ;
+} /* pakt_test_size */
+
+void
+test_alac_pakt (void)
+{	SF_VIRTUAL_IO vio = { pakt_test_get_filelen, pakt_test_seek, pakt_test_read, pakt_test_write, pakt_test_tell } ;
+	PAKT_TEST_FILE file ;
+	SF_PRIVATE sf_data, *psf ;
+	PAKT_INFO *writer, *info ;
+	sf_count_t offset ;
+	uint32_t k, block, seed ;
+
+	print_test_name ("Testing ALAC packet table") ;
+
+	/* Build the 'pakt' chunk data with the writer and keep a running sum. */
+	if ((writer = calloc (1, sizeof (PAKT_INFO))) == NULL)
+	{	printf ("\n\nLine %d : calloc failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	for (k = 0 ; k < PAKT_TEST_PACKETS ; k++)
+	{	pakt_test_offsets [k + 1] = pakt_test_offsets [k] + pakt_test_size (k) ;
+		if (alac_pakt_append (writer, pakt_test_size (k)) == 0)
+		{	printf ("\n\nLine %d : alac_pakt_append failed at packet %u.\n\n", __LINE__, k) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	/* The chunk starts the file, with a 24 byte header before the sizes. */
+	memset (&file, 0, sizeof (file)) ;
+	file.length = 24 + writer->data_len ;
+	if ((file.data = calloc (1, file.length)) == NULL)
+	{	printf ("\n\nLine %d : calloc failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+	memcpy (file.data + 24, writer->data, writer->data_len) ;
+
+	memset (&sf_data, 0, sizeof (sf_data)) ;
+	psf = &sf_data ;
+	psf->file.mode = SFM_READ ;
+	psf_set_virtual_io (psf, &vio, &file) ;
+	psf->file.buf.size = 0 ;	/* No read ahead, so every byte asked for is counted. */
+
+	if (psf_store_read_chunk_u32 (&psf->rchunks, MAKE_MARKER ('p', 'a', 'k', 't'), 0, (uint32_t) file.length) != 0)
+	{	printf ("\n\nLine %d : psf_store_read_chunk_u32 failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	if ((info = alac_pakt_read_index (psf)) == NULL)
+	{	printf ("\n\nLine %d : alac_pakt_read_index failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	if (info->count != PAKT_TEST_PACKETS || info->total != pakt_test_offsets [PAKT_TEST_PACKETS])
+	{	printf ("\n\nLine %d : %u packets of %" PRId64 " bytes.\n\n", __LINE__, info->count, info->total) ;
+		exit (1) ;
+		} ;
+
+	/* Straight through. */
+	for (k = 0 ; k <= PAKT_TEST_PACKETS ; k++)
+		if ((offset = alac_pakt_block_offset (psf, info, k)) != pakt_test_offsets [k])
+		{	printf ("\n\nLine %d : block %u at %" PRId64 " (should be %" PRId64 ").\n\n", __LINE__, k, offset, pakt_test_offsets [k]) ;
+			exit (1) ;
+			} ;
+
+	/* Seeking anywhere reads no more than one window of sizes. */
+	for (k = 0, seed = 1 ; k < PAKT_TEST_SEEKS ; k++)
+	{	seed = seed * 1103515245u + 12345u ;
+		block = (seed >> 8) % PAKT_TEST_PACKETS ;
+
+		info->window_count = 0 ;
+		file.bytes_read = 0 ;
+		if ((offset = alac_pakt_block_offset (psf, info, block)) != pakt_test_offsets [block])
+		{	printf ("\n\nLine %d : block %u at %" PRId64 " (should be %" PRId64 ").\n\n", __LINE__, block, offset, pakt_test_offsets [block]) ;
+			exit (1) ;
+			} ;
+
+		if (file.bytes_read > PAKT_WINDOW * 5)
+		{	printf ("\n\nLine %d : seek to block %u read %" PRId64 " bytes.\n\n", __LINE__, block, file.bytes_read) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	alac_pakt_free (info) ;
+	alac_pakt_free (writer) ;
+	free (psf->rchunks.chunks) ;
+	free (file.data) ;
+
+	puts ("ok") ;
+} /* test_alac_pakt */
@@ -0,0 +1,87 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "checkpoint.h"
+#include "test_main.h"
+
+#define	CP_TEST_INTERVAL	100
+#define	CP_TEST_COUNT		1000
+
+void
+test_checkpoint (void)
+{	PSF_CHECKPOINTS *cp ;
+	sf_count_t frame, ahead, found ;
+	int state ;
+
+	print_test_name ("Testing decoder checkpoints") ;
+
+	/* A NULL set of checkpoints never wants a snapshot. */
+	if (psf_checkpoints_ahead (NULL, 0) != SF_COUNT_MAX || psf_checkpoints_find (NULL, 0, &state) != -1)
+	{	printf ("\n\nLine %d : NULL checkpoints not handled.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	if ((cp = psf_checkpoints_new (CP_TEST_INTERVAL, sizeof (state))) == NULL)
+	{	printf ("\n\nLine %d : psf_checkpoints_new failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	if (psf_checkpoints_find (cp, 0, &state) != -1)
+	{	printf ("\n\nLine %d : found a checkpoint before any were added.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	/* Decode in uneven steps, saving the frame number as the state. */
+	for (frame = 0 ; frame < CP_TEST_INTERVAL * CP_TEST_COUNT ; )
+	{	ahead = psf_checkpoints_ahead (cp, frame) ;
+		if (ahead == 0)
+		{	state = (int) frame ;
+			psf_checkpoints_add (cp, frame, &state) ;
+			continue ;
+			} ;
+		if (ahead < 1 || ahead > CP_TEST_INTERVAL)
+		{	printf ("\n\nLine %d : %d frames ahead at frame %d.\n\n", __LINE__, (int) ahead, (int) frame) ;
+			exit (1) ;
+			} ;
+
+		/* Snapshots out of turn are ignored. */
+		state = -1 ;
+		psf_checkpoints_add (cp, frame, &state) ;
+
+		frame += SF_MIN (ahead, (sf_count_t) (1 + frame % 37)) ;
+		} ;
+
+	for (frame = 0 ; frame < CP_TEST_INTERVAL * (CP_TEST_COUNT + 2) ; frame += 7)
+	{	found = psf_checkpoints_find (cp, frame, &state) ;
+		if (found > frame || frame - found >= (frame < CP_TEST_INTERVAL * CP_TEST_COUNT ? CP_TEST_INTERVAL : 3 * CP_TEST_INTERVAL)
+				|| found % CP_TEST_INTERVAL != 0 || state != found)
+		{	printf ("\n\nLine %d : frame %d found checkpoint %d with state %d.\n\n", __LINE__, (int) frame, (int) found, state) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	psf_checkpoints_free (cp) ;
+
+	puts ("ok") ;
+} /* test_checkpoint */
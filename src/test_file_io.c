@@ -30,6 +30,7 @@
 #include <string.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <sys/stat.h>
 
 #include "common.h"
 
@@ -40,6 +41,10 @@ static void make_data (int *data, int len, int seed) ;
 static void file_open_test (const char *filename) ;
 static void file_read_write_test (const char *filename) ;
 static void file_truncate_test (const char *filename) ;
+static void file_mmap_test (const char *filename) ;
+static void file_read_ahead_test (const char *filename) ;
+static void file_write_buffer_test (const char *filename) ;
+static int count_small_writes (SF_PRIVATE *psf, int buffer_size) ;
 
 static void test_open_or_die (SF_PRIVATE *psf, int linenum) ;
 static void test_close_or_die (SF_PRIVATE *psf, int linenum) ;
@@ -363,6 +368,320 @@ file_seek_with_offset_test (const char *filename)
 	puts ("ok") ;
 } /* file_seek_with_offset_test */
 
+static void
+file_mmap_test (const char *filename)
+{	static int data_out	[512] ;
+	static int data_in	[512] ;
+
+	SF_PRIVATE sf_data, *psf, sf_writer, *writer ;
+
+	print_test_name ("Testing mmap read") ;
+
+	memset (&sf_writer, 0, sizeof (sf_writer)) ;
+	writer = &sf_writer ;
+	snprintf (writer->file.path.c, sizeof (writer->file.path.c), "%s", filename) ;
+
+	/* Write two blocks of data. */
+	writer->file.mode = SFM_WRITE ;
+	test_open_or_die (writer, __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 1) ;
+	test_write_or_die (writer, data_out, sizeof (data_out [0]), ARRAY_LEN (data_out), sizeof (data_out), __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 2) ;
+	test_write_or_die (writer, data_out, sizeof (data_out [0]), ARRAY_LEN (data_out), 2 * sizeof (data_out), __LINE__) ;
+	test_close_or_die (writer, __LINE__) ;
+
+	memset (&sf_data, 0, sizeof (sf_data)) ;
+	psf = &sf_data ;
+	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+
+	/* Mapping is only allowed for files opened read only. */
+	psf->file.mode = SFM_RDWR ;
+	test_open_or_die (psf, __LINE__) ;
+	if (psf_use_mmap (psf, SF_TRUE) != SF_FALSE)
+	{	printf ("\n\nLine %d: psf_use_mmap() should fail in SFM_RDWR mode.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+	test_close_or_die (psf, __LINE__) ;
+
+	psf->file.mode = SFM_READ ;
+	test_open_or_die (psf, __LINE__) ;
+
+	/* Start the mapping part way into the file. */
+	test_seek_or_die (psf, SIGNED_SIZEOF (data_out), SEEK_SET, SIGNED_SIZEOF (data_out), __LINE__) ;
+
+	if (psf_use_mmap (psf, SF_TRUE) != SF_TRUE)
+	{	if (HAVE_MMAP)
+		{	printf ("\n\nLine %d: psf_use_mmap() failed.\n\n", __LINE__) ;
+			exit (1) ;
+			} ;
+		test_close_or_die (psf, __LINE__) ;
+		puts ("no mmap") ;
+		return ;
+		} ;
+
+	test_tell_or_die (psf, SIGNED_SIZEOF (data_out), __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 2) ;
+	test_read_or_die (psf, data_in, 1, sizeof (data_in), 2 * sizeof (data_in), __LINE__) ;
+	test_equal_or_die (data_out, data_in, ARRAY_LEN (data_out), __LINE__) ;
+
+	/* Reading at the end of the mapping should return nothing. */
+	if (psf_fread (data_in, 1, sizeof (data_in), psf) != 0)
+	{	printf ("\n\nLine %d: psf_fread() past end of file should return 0.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	test_seek_or_die (psf, 0, SEEK_END, 2 * SIGNED_SIZEOF (data_out), __LINE__) ;
+	test_seek_or_die (psf, -2 * SIGNED_SIZEOF (data_out), SEEK_CUR, 0, __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 1) ;
+	test_read_or_die (psf, data_in, sizeof (data_in [0]), ARRAY_LEN (data_in), sizeof (data_in), __LINE__) ;
+	test_equal_or_die (data_out, data_in, ARRAY_LEN (data_out), __LINE__) ;
+
+	/* Check that the fileoffset is respected. */
+	psf->fileoffset = sizeof (data_out) ;
+	test_tell_or_die (psf, 0, __LINE__) ;
+	test_seek_or_die (psf, 0, SEEK_SET, 0, __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 2) ;
+	test_read_or_die (psf, data_in, sizeof (data_in [0]), ARRAY_LEN (data_in), sizeof (data_in), __LINE__) ;
+	test_equal_or_die (data_out, data_in, ARRAY_LEN (data_out), __LINE__) ;
+	psf->fileoffset = 0 ;
+
+	/* Grow the file while it is mapped. Reads should fall back to read (). */
+	writer->file.mode = SFM_RDWR ;
+	test_open_or_die (writer, __LINE__) ;
+	test_seek_or_die (writer, 0, SEEK_END, 2 * SIGNED_SIZEOF (data_out), __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 3) ;
+	test_write_or_die (writer, data_out, sizeof (data_out [0]), ARRAY_LEN (data_out), 3 * sizeof (data_out), __LINE__) ;
+	test_close_or_die (writer, __LINE__) ;
+
+	test_seek_or_die (psf, SIGNED_SIZEOF (data_out) + 16, SEEK_SET, SIGNED_SIZEOF (data_out) + 16, __LINE__) ;
+	test_read_or_die (psf, data_in, 1, sizeof (data_in), 2 * sizeof (data_in) + 16, __LINE__) ;
+	test_seek_or_die (psf, 2 * SIGNED_SIZEOF (data_out), SEEK_SET, 2 * SIGNED_SIZEOF (data_out), __LINE__) ;
+	test_read_or_die (psf, data_in, 1, sizeof (data_in), 3 * sizeof (data_in), __LINE__) ;
+	test_equal_or_die (data_out, data_in, ARRAY_LEN (data_out), __LINE__) ;
+
+	test_seek_or_die (psf, 0, SEEK_END, 3 * SIGNED_SIZEOF (data_out), __LINE__) ;
+
+	test_close_or_die (psf, __LINE__) ;
+
+	/*
+	** Truncate the file while it is mapped. Copying from the pages that were
+	** cut off would raise SIGBUS, so reads should fall back to read ().
+	*/
+	psf->file.mode = SFM_READ ;
+	test_open_or_die (psf, __LINE__) ;
+	if (psf_use_mmap (psf, SF_TRUE) != SF_TRUE)
+	{	printf ("\n\nLine %d: psf_use_mmap() failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	writer->file.mode = SFM_RDWR ;
+	test_open_or_die (writer, __LINE__) ;
+	psf_ftruncate (writer, sizeof (data_out)) ;
+	test_close_or_die (writer, __LINE__) ;
+
+#if HAVE_PREAD
+	/* Positioned reads leave the mapping in place but must not use it either. */
+	if (psf_fread_at (psf, data_in, sizeof (data_in), 2 * sizeof (data_in)) != 0)
+	{	printf ("\n\nLine %d: psf_fread_at() past end of truncated file should return 0.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+	make_data (data_out, ARRAY_LEN (data_out), 1) ;
+	if (psf_fread_at (psf, data_in, sizeof (data_in), 0) != sizeof (data_in))
+	{	printf ("\n\nLine %d: psf_fread_at() failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+	test_equal_or_die (data_out, data_in, ARRAY_LEN (data_out), __LINE__) ;
+#endif
+
+	test_seek_or_die (psf, 2 * SIGNED_SIZEOF (data_out), SEEK_SET, 2 * SIGNED_SIZEOF (data_out), __LINE__) ;
+	if (psf_fread (data_in, 1, sizeof (data_in), psf) != 0)
+	{	printf ("\n\nLine %d: psf_fread() past end of truncated file should return 0.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	test_seek_or_die (psf, 0, SEEK_SET, 0, __LINE__) ;
+	make_data (data_out, ARRAY_LEN (data_out), 1) ;
+	test_read_or_die (psf, data_in, 1, sizeof (data_in), sizeof (data_in), __LINE__) ;
+	test_equal_or_die (data_out, data_in, ARRAY_LEN (data_out), __LINE__) ;
+
+	test_close_or_die (psf, __LINE__) ;
+
+	puts ("ok") ;
+} /* file_mmap_test */
+
+static void
+file_read_ahead_test (const char *filename)
+{	static char lines [] = "line one\nline two\n\nlast line" ;
+	SF_PRIVATE sf_data, *psf ;
+	char buffer [64], marker = 'X' ;
+	sf_count_t retval ;
+
+	print_test_name ("Testing read-ahead buffer") ;
+
+	memset (&sf_data, 0, sizeof (sf_data)) ;
+	psf = &sf_data ;
+	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+
+	psf->file.mode = SFM_WRITE ;
+	test_open_or_die (psf, __LINE__) ;
+	test_write_or_die (psf, lines, 1, sizeof (lines) - 1, sizeof (lines) - 1, __LINE__) ;
+	test_close_or_die (psf, __LINE__) ;
+
+	psf->file.mode = SFM_RDWR ;
+	test_open_or_die (psf, __LINE__) ;
+
+	if ((retval = psf_fgets (buffer, sizeof (buffer), psf)) != 9 || strcmp (buffer, "line one\n") != 0)
+	{	printf ("\n\nLine %d: psf_fgets() returned %" PRId64 " '%s'.\n\n", __LINE__, retval, buffer) ;
+		exit (1) ;
+		} ;
+	test_tell_or_die (psf, 9, __LINE__) ;
+
+	/* The whole file should now be in the buffer, so seeking back is free. */
+	if (psf->file.buf.len != sizeof (lines) - 1)
+	{	printf ("\n\nLine %d: read-ahead buffer holds %" PRId64 " bytes (should be %zd).\n\n", __LINE__, psf->file.buf.len, sizeof (lines) - 1) ;
+		exit (1) ;
+		} ;
+
+	test_seek_or_die (psf, -4, SEEK_CUR, 5, __LINE__) ;
+	psf_fgets (buffer, sizeof (buffer), psf) ;
+	psf_fgets (buffer, sizeof (buffer), psf) ;
+	if (strcmp (buffer, "line two\n") != 0)
+	{	printf ("\n\nLine %d: psf_fgets() returned '%s'.\n\n", __LINE__, buffer) ;
+		exit (1) ;
+		} ;
+
+	/* A write must land at the logical position, not the read-ahead position. */
+	test_write_or_die (psf, &marker, 1, 1, 19, __LINE__) ;
+	test_seek_or_die (psf, 0, SEEK_SET, 0, __LINE__) ;
+	test_read_or_die (psf, buffer, 1, sizeof (lines) - 1, sizeof (lines) - 1, __LINE__) ;
+	if (memcmp (buffer, "line one\nline two\nXlast line", sizeof (lines) - 1) != 0)
+	{	printf ("\n\nLine %d: read back data is not correct.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	/* Last line has no newline. */
+	test_seek_or_die (psf, 19, SEEK_SET, 19, __LINE__) ;
+	if ((retval = psf_fgets (buffer, sizeof (buffer), psf)) != 9 || strcmp (buffer, "last line") != 0)
+	{	printf ("\n\nLine %d: psf_fgets() returned %" PRId64 " '%s'.\n\n", __LINE__, retval, buffer) ;
+		exit (1) ;
+		} ;
+
+	test_close_or_die (psf, __LINE__) ;
+
+	puts ("ok") ;
+} /* file_read_ahead_test */
+
+static void
+file_write_buffer_test (const char *filename)
+{	static int data_out	[1024] ;
+	static int data_in	[1024] ;
+
+	SF_PRIVATE sf_data, *psf ;
+	int unbuffered, buffered, k ;
+
+	print_test_name ("Testing write buffer") ;
+
+	memset (&sf_data, 0, sizeof (sf_data)) ;
+	psf = &sf_data ;
+	snprintf (psf->file.path.c, sizeof (psf->file.path.c), "%s", filename) ;
+
+	/* Write buffering is not allowed for files opened read only. */
+	psf->file.mode = SFM_WRITE ;
+	test_open_or_die (psf, __LINE__) ;
+	test_close_or_die (psf, __LINE__) ;
+	psf->file.mode = SFM_READ ;
+	test_open_or_die (psf, __LINE__) ;
+	if (psf_set_write_buffer (psf, 4096) != SF_FALSE)
+	{	printf ("\n\nLine %d: psf_set_write_buffer() should fail in SFM_READ mode.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+	test_close_or_die (psf, __LINE__) ;
+
+	/*
+	** The number of times the file length changes is the number of write
+	** system calls, which should drop from one per write to one per 4096
+	** bytes.
+	*/
+	unbuffered = count_small_writes (psf, 0) ;
+	buffered = count_small_writes (psf, 4096) ;
+
+	if (buffered < 0)
+	{	test_close_or_die (psf, __LINE__) ;
+		puts ("no write buffer") ;
+		return ;
+		} ;
+
+	if (unbuffered != 256 || buffered != 4)
+	{	printf ("\n\nLine %d: file grew %d times unbuffered (should be 256) and %d times buffered (should be 4).\n\n", __LINE__, unbuffered, buffered) ;
+		exit (1) ;
+		} ;
+
+	/* Seeking writes out the buffer, and reads see the written data. */
+	make_data (data_out, ARRAY_LEN (data_out), 7) ;
+	test_seek_or_die (psf, 64, SEEK_SET, 64, __LINE__) ;
+	for (k = 0 ; k < 4 ; k++)
+		test_write_or_die (psf, data_out + 16 * k, sizeof (data_out [0]), 16, 64 + 64 * (k + 1), __LINE__) ;
+	test_seek_or_die (psf, 64, SEEK_SET, 64, __LINE__) ;
+	test_read_or_die (psf, data_in, sizeof (data_in [0]), 64, 64 + 256, __LINE__) ;
+	test_equal_or_die (data_out, data_in, 64, __LINE__) ;
+
+	/* Pending data past the end of file is included in the file length. */
+	test_seek_or_die (psf, 0, SEEK_END, 256 * 64, __LINE__) ;
+	test_write_or_die (psf, data_out, sizeof (data_out [0]), 16, 256 * 64 + 64, __LINE__) ;
+	if (psf_get_filelen (psf) != 256 * 64 + 64)
+	{	printf ("\n\nLine %d: psf_get_filelen() returned %" PRId64 " (should be %d).\n\n", __LINE__, psf_get_filelen (psf), 256 * 64 + 64) ;
+		exit (1) ;
+		} ;
+
+	/* Closing flushes the buffer. */
+	test_close_or_die (psf, __LINE__) ;
+	psf->file.mode = SFM_READ ;
+	test_open_or_die (psf, __LINE__) ;
+	test_seek_or_die (psf, 256 * 64, SEEK_SET, 256 * 64, __LINE__) ;
+	test_read_or_die (psf, data_in, sizeof (data_in [0]), 16, 256 * 64 + 64, __LINE__) ;
+	test_equal_or_die (data_out, data_in, 16, __LINE__) ;
+	test_close_or_die (psf, __LINE__) ;
+
+	puts ("ok") ;
+} /* file_write_buffer_test */
+
+static int
+count_small_writes (SF_PRIVATE *psf, int buffer_size)
+{	unsigned char data [64] ;
+	struct stat statbuf ;
+	off_t last_size = 0 ;
+	int k, changes = 0 ;
+
+	/* With a write buffer, the file is left open in SFM_RDWR mode. */
+	psf->file.mode = SFM_RDWR ;
+	test_open_or_die (psf, __LINE__) ;
+	psf_ftruncate (psf, 0) ;
+
+	if (buffer_size > 0 && psf_set_write_buffer (psf, buffer_size) != SF_TRUE)
+		return -1 ;
+
+	memset (data, 0x55, sizeof (data)) ;
+
+	for (k = 0 ; k < 256 ; k++)
+	{	test_write_or_die (psf, data, 1, sizeof (data), (k + 1) * SIGNED_SIZEOF (data), __LINE__) ;
+
+		if (stat (psf->file.path.c, &statbuf) != 0)
+		{	printf ("\n\nLine %d: stat failed : %s\n\n", __LINE__, strerror (errno)) ;
+			exit (1) ;
+			} ;
+
+		if (statbuf.st_size != last_size)
+		{	last_size = statbuf.st_size ;
+			changes ++ ;
+			} ;
+		} ;
+
+	if (buffer_size == 0)
+		test_close_or_die (psf, __LINE__) ;
+
+	return changes ;
+} /* count_small_writes */
+
 /*==============================================================================
 ** Testing helper functions.
 */
@@ -486,6 +805,9 @@ test_file_io (void)
 	file_read_write_test	(filename) ;
 	file_seek_with_offset_test (filename) ;
 	file_truncate_test (filename) ;
+	file_mmap_test (filename) ;
+	file_read_ahead_test (filename) ;
+	file_write_buffer_test (filename) ;
 
 	unlink (filename) ;
 } /* main */
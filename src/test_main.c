@@ -51,6 +51,7 @@ main (void)
 	test_endswap () ;
 	test_float_convert () ;
 	test_double_convert () ;
+	test_simd () ;
 
 	test_log_printf () ;
 	test_binheader_writef () ;
@@ -65,6 +66,11 @@ main (void)
 
 	test_nms_adpcm () ;
 
+	test_thread_pool () ;
+	test_checkpoint () ;
+
+	test_alac_pakt () ;
+
 	return 0 ;
 } /* main */
 
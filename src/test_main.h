@@ -42,3 +42,11 @@ void test_broadcast_var (void) ;
 void test_cart_var (void) ;
 
 void test_nms_adpcm (void) ;
+
+void test_simd (void) ;
+
+void test_thread_pool (void) ;
+
+void test_checkpoint (void) ;
+
+void test_alac_pakt (void) ;
@@ -0,0 +1,840 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "common.h"
+#include "sfendian.h"
+#include "simd.h"
+#include "test_main.h"
+
+/*
+**	Check every kernel of every instruction set the CPU supports against the
+**	scalar code in pcm.c, which is repeated here. The data starts one item
+**	into the buffers to test unaligned access and the odd length leaves a
+**	tail for the scalar code.
+*/
+
+#define	SIMD_TEST_LEN	(1000 + 13)
+
+static union
+{	unsigned char	uc [4 * SIMD_TEST_LEN + 16] ;
+	short			s [2 * SIMD_TEST_LEN + 8] ;
+	int				i [SIMD_TEST_LEN + 4] ;
+} src ;
+
+static union
+{	unsigned char	uc [8 * SIMD_TEST_LEN + 16] ;
+	short			s [4 * SIMD_TEST_LEN + 8] ;
+	int				i [2 * SIMD_TEST_LEN + 4] ;
+	float			f [2 * SIMD_TEST_LEN + 4] ;
+	double			d [SIMD_TEST_LEN + 2] ;
+} dest, ref ;
+
+static float	fsrc [SIMD_TEST_LEN + 1] ;
+static double	dsrc [SIMD_TEST_LEN + 1] ;
+
+static void
+simd_check (const PSF_SIMD *simd, const char *kernel, int done, size_t itemsize)
+{
+	if (done < 0 || done > SIMD_TEST_LEN || done < SIMD_TEST_LEN - 64)
+	{	printf ("\n\nLine %d : %s %s converted %d of %d items.\n\n", __LINE__, simd->name, kernel, done, SIMD_TEST_LEN) ;
+		exit (1) ;
+		} ;
+
+	if (memcmp (dest.uc + itemsize, ref.uc + itemsize, done * itemsize) != 0)
+	{	printf ("\n\nLine %d : %s %s output differs from scalar code.\n\n", __LINE__, simd->name, kernel) ;
+		exit (1) ;
+		} ;
+
+	memset (dest.uc, 0, sizeof (dest.uc)) ;
+	memset (ref.uc, 0, sizeof (ref.uc)) ;
+} /* simd_check */
+
+/* Store the top three bytes of value as a packed 24 bit sample. */
+static void
+put_tribyte (unsigned char *ptr, int value, int big_endian)
+{	ptr [big_endian ? 2 : 0] = value >> 8 ;
+	ptr [1] = value >> 16 ;
+	ptr [big_endian ? 0 : 2] = value >> 24 ;
+} /* put_tribyte */
+
+static int
+clip_float (float scaled_value)
+{	if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+		return 0x7FFFFFFF ;
+	if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+		return -0x7FFFFFFF - 1 ;
+	return lrintf (scaled_value) ;
+} /* clip_float */
+
+static int
+clip_double (double scaled_value)
+{	if (CPU_CLIPS_POSITIVE == 0 && scaled_value >= (1.0 * 0x7FFFFFFF))
+		return 0x7FFFFFFF ;
+	if (CPU_CLIPS_NEGATIVE == 0 && scaled_value <= (-8.0 * 0x10000000))
+		return -0x7FFFFFFF - 1 ;
+	return lrint (scaled_value) ;
+} /* clip_double */
+
+static void
+simd_pcm24_test (const PSF_SIMD *simd, int big_endian)
+{	const unsigned char *uc = src.uc + 1 ;
+	const int *i = src.i + 1 ;
+	const float *f = fsrc + 1 ;
+	const double *d = dsrc + 1 ;
+	const float normf = 1.0 / ((float) 0x80000000) ;
+	const double normd = 1.0 / ((double) 0x80000000) ;
+	int k, done, clip ;
+
+	/* Not every instruction set has 24 bit kernels. */
+	if (simd->pcm24_to_i == psf_simd_get (PSF_SIMD_NONE)->pcm24_to_i)
+		return ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		ref.i [k + 1] = big_endian ? psf_get_be24 (uc, 3 * k) : psf_get_le24 (uc, 3 * k) ;
+	done = simd->pcm24_to_i (uc, dest.i + 1, SIMD_TEST_LEN, big_endian) ;
+	simd_check (simd, "pcm24_to_i", done, sizeof (int)) ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		ref.f [k + 1] = ((float) (big_endian ? psf_get_be24 (uc, 3 * k) : psf_get_le24 (uc, 3 * k))) * normf ;
+	done = simd->pcm24_to_f (uc, dest.f + 1, SIMD_TEST_LEN, big_endian, normf) ;
+	simd_check (simd, "pcm24_to_f", done, sizeof (float)) ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		ref.d [k + 1] = ((double) (big_endian ? psf_get_be24 (uc, 3 * k) : psf_get_le24 (uc, 3 * k))) * normd ;
+	done = simd->pcm24_to_d (uc, dest.d + 1, SIMD_TEST_LEN, big_endian, normd) ;
+	simd_check (simd, "pcm24_to_d", done, sizeof (double)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		put_tribyte (ref.uc + 3 + 3 * k, i [k], big_endian) ;
+	done = simd->i_to_pcm24 (i, dest.uc + 3, SIMD_TEST_LEN, big_endian) ;
+	simd_check (simd, "i_to_pcm24", done, 3) ;
+
+	for (clip = 0 ; clip < 2 ; clip++)
+	{	float fnorm = clip ? (8.0 * 0x10000000) : (1.0 * 0x7FFFFF) ;
+		double dnorm = clip ? (8.0 * 0x10000000) : (1.0 * 0x7FFFFF) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			put_tribyte (ref.uc + 3 + 3 * k, clip ? clip_float (f [k] * fnorm) : arith_shift_left (lrintf (f [k] * fnorm), 8), big_endian) ;
+		done = simd->f_to_pcm24 (f, dest.uc + 3, SIMD_TEST_LEN, big_endian, fnorm, clip) ;
+		simd_check (simd, clip ? "f_to_pcm24 (clip)" : "f_to_pcm24", done, 3) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			put_tribyte (ref.uc + 3 + 3 * k, clip ? clip_double (d [k] * dnorm) : arith_shift_left (lrint (d [k] * dnorm), 8), big_endian) ;
+		done = simd->d_to_pcm24 (d, dest.uc + 3, SIMD_TEST_LEN, big_endian, dnorm, clip) ;
+		simd_check (simd, clip ? "d_to_pcm24 (clip)" : "d_to_pcm24", done, 3) ;
+		} ;
+
+	/* The kernels must leave NaNs to the scalar code. */
+	fsrc [100] = NAN ;
+	dsrc [100] = NAN ;
+	for (clip = 0 ; clip < 2 ; clip++)
+	{	if (simd->f_to_pcm24 (f, dest.uc + 1, SIMD_TEST_LEN, big_endian, 1.0f, clip) >= 100 ||
+				simd->d_to_pcm24 (d, dest.uc + 1, SIMD_TEST_LEN, big_endian, 1.0, clip) >= 100)
+		{	printf ("\n\nLine %d : %s 24 bit kernel converted a NaN.\n\n", __LINE__, simd->name) ;
+			exit (1) ;
+			} ;
+		} ;
+	fsrc [100] = 0.5f ;
+	dsrc [100] = 0.5 ;
+	memset (dest.uc, 0, sizeof (dest.uc)) ;
+} /* simd_pcm24_test */
+
+static short
+clip_short (int value)
+{	return value > 0x7FFF ? 0x7FFF : (value < -0x8000 ? -0x8000 : value) ;
+} /* clip_short */
+
+static void
+simd_clip_test (const PSF_SIMD *simd, int swap)
+{	const float *f = fsrc + 1 ;
+	const double *d = dsrc + 1 ;
+	short value ;
+	int k, done, shift, ivalue ;
+
+	/* Shift 0 rounds straight to short like common.c, 16 takes the top half like pcm.c. */
+	for (shift = 0 ; shift <= 16 ; shift += 16)
+	{	float fnorm = shift ? (8.0 * 0x10000000) : (1.0 * 0x8000) ;
+		double dnorm = shift ? (8.0 * 0x10000000) : (1.0 * 0x8000) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		{	value = clip_short (clip_float (f [k] * fnorm) >> shift) ;
+			ref.s [k + 1] = swap ? ENDSWAP_16 (value) : value ;
+			} ;
+		done = simd->f_to_s_clip (f, dest.s + 1, SIMD_TEST_LEN, fnorm, shift, swap) ;
+		simd_check (simd, "f_to_s_clip", done, sizeof (short)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		{	value = clip_short (clip_double (d [k] * dnorm) >> shift) ;
+			ref.s [k + 1] = swap ? ENDSWAP_16 (value) : value ;
+			} ;
+		done = simd->d_to_s_clip (d, dest.s + 1, SIMD_TEST_LEN, dnorm, shift, swap) ;
+		simd_check (simd, "d_to_s_clip", done, sizeof (short)) ;
+		} ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+	{	ivalue = clip_float (f [k] * (8.0f * 0x10000000)) ;
+		ref.i [k + 1] = swap ? (int) ENDSWAP_32 (ivalue) : ivalue ;
+		} ;
+	done = simd->f_to_i_clip (f, dest.i + 1, SIMD_TEST_LEN, 8.0 * 0x10000000, swap) ;
+	simd_check (simd, "f_to_i_clip", done, sizeof (int)) ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+	{	ivalue = clip_double (d [k] * (8.0 * 0x10000000)) ;
+		ref.i [k + 1] = swap ? (int) ENDSWAP_32 (ivalue) : ivalue ;
+		} ;
+	done = simd->d_to_i_clip (d, dest.i + 1, SIMD_TEST_LEN, 8.0 * 0x10000000, swap) ;
+	simd_check (simd, "d_to_i_clip", done, sizeof (int)) ;
+
+	/* The kernels must leave NaNs to the scalar code. */
+	fsrc [100] = NAN ;
+	dsrc [100] = NAN ;
+	if (simd->f_to_s_clip (f, dest.s + 1, SIMD_TEST_LEN, 1.0f, 0, swap) >= 100 ||
+			simd->f_to_i_clip (f, dest.i + 1, SIMD_TEST_LEN, 1.0f, swap) >= 100 ||
+			simd->d_to_s_clip (d, dest.s + 1, SIMD_TEST_LEN, 1.0, 0, swap) >= 100 ||
+			simd->d_to_i_clip (d, dest.i + 1, SIMD_TEST_LEN, 1.0, swap) >= 100)
+	{	printf ("\n\nLine %d : %s clip kernel converted a NaN.\n\n", __LINE__, simd->name) ;
+		exit (1) ;
+		} ;
+	fsrc [100] = 0.5f ;
+	dsrc [100] = 0.5 ;
+	memset (dest.uc, 0, sizeof (dest.uc)) ;
+} /* simd_clip_test */
+
+/* G.711 reference code, equivalent to the tables in ulaw.c and alaw.c. */
+static short
+g711_decode (unsigned char code, int law)
+{	int x, e, mag ;
+
+	if (law == PSF_G711_ALAW)
+	{	x = code ^ 0x55 ;
+		e = (x >> 4) & 7 ;
+		mag = (e == 0) ? ((x & 0xF) << 4) + 8 : (((x & 0xF) << 4) + 0x108) << (e - 1) ;
+		return (x & 0x80) ? mag : -mag ;
+		} ;
+
+	x = code ^ 0xFF ;
+	e = (x >> 4) & 7 ;
+	mag = ((((x & 0xF) << 3) + 0x84) << e) - 0x84 ;
+	return (x & 0x80) ? -mag : mag ;
+} /* g711_decode */
+
+static unsigned char
+g711_encode (int index, int negative, int law)
+{	int b, e ;
+
+	if (law == PSF_G711_ALAW)
+	{	b = index > 0x7FF ? 0x7FF : index ;
+		for (e = 0 ; e < 7 && b >= (0x10 << e) ; e++)
+			;
+		b = ((e << 4) | ((b >> (e > 0 ? e - 1 : 0)) & 0xF)) ^ 0xD5 ;
+		return negative ? b & 0x7F : b ;
+		} ;
+
+	b = index + 33 > 0x1FFF ? 0x1FFF : index + 33 ;
+	for (e = 0 ; e < 7 && b >= (0x40 << e) ; e++)
+		;
+	b = ((e << 4) | ((b >> (e + 1)) & 0xF)) ^ 0xFF ;
+	return negative ? b & 0x7F : b ;
+} /* g711_encode */
+
+static void
+simd_g711_test (const PSF_SIMD *simd, int law)
+{	const unsigned char *uc = src.uc + 1 ;
+	const short *s = src.s + 1 ;
+	const int *i = src.i + 1 ;
+	const float *f = fsrc + 1 ;
+	const double *d = dsrc + 1 ;
+	const float normf = 1.0 / ((float) 0x8000) ;
+	const double normd = 1.0 / ((double) 0x8000) ;
+	int k, done, shift ;
+	float fnorm ;
+	double dnorm ;
+
+	/* Not every instruction set has G.711 decode kernels. */
+	if (simd->g711_to_s != psf_simd_get (PSF_SIMD_NONE)->g711_to_s)
+	{	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.s [k + 1] = g711_decode (uc [k], law) ;
+		done = simd->g711_to_s (uc, dest.s + 1, SIMD_TEST_LEN, law) ;
+		simd_check (simd, "g711_to_s", done, sizeof (short)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.i [k + 1] = ((uint32_t) g711_decode (uc [k], law)) << 16 ;
+		done = simd->g711_to_i (uc, dest.i + 1, SIMD_TEST_LEN, law) ;
+		simd_check (simd, "g711_to_i", done, sizeof (int)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.f [k + 1] = normf * g711_decode (uc [k], law) ;
+		done = simd->g711_to_f (uc, dest.f + 1, SIMD_TEST_LEN, law, normf) ;
+		simd_check (simd, "g711_to_f", done, sizeof (float)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.d [k + 1] = normd * g711_decode (uc [k], law) ;
+		done = simd->g711_to_d (uc, dest.d + 1, SIMD_TEST_LEN, law, normd) ;
+		simd_check (simd, "g711_to_d", done, sizeof (double)) ;
+		} ;
+
+	/* The encoders, working from the same table index as ulaw.c and alaw.c. */
+	shift = (law == PSF_G711_ALAW) ? 4 : 2 ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		ref.uc [k + 1] = g711_encode (s [k] >= 0 ? s [k] >> shift : -s [k] >> shift, s [k] < 0, law) ;
+	done = simd->s_to_g711 (s, dest.uc + 1, SIMD_TEST_LEN, law) ;
+	simd_check (simd, "s_to_g711", done, 1) ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+	{	if (i [k] == INT_MIN)
+			ref.uc [k + 1] = g711_encode (INT_MAX >> (16 + shift), 0, law) ;
+		else
+			ref.uc [k + 1] = g711_encode ((i [k] >= 0 ? i [k] : -i [k]) >> (16 + shift), i [k] < 0, law) ;
+		} ;
+	done = simd->i_to_g711 (i, dest.uc + 1, SIMD_TEST_LEN, law) ;
+	simd_check (simd, "i_to_g711", done, 1) ;
+
+	/* Scaled so the +/-1.25 test data stays inside the tables. */
+	fnorm = (law == PSF_G711_ALAW) ? (0.8 * 0x7FFF) / 16.0 : 0.2 * 0x7FFF ;
+	dnorm = fnorm ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		ref.uc [k + 1] = g711_encode (abs ((int) lrintf (fnorm * f [k])), f [k] < 0, law) ;
+	done = simd->f_to_g711 (f, dest.uc + 1, SIMD_TEST_LEN, law, fnorm) ;
+	simd_check (simd, "f_to_g711", done, 1) ;
+
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		ref.uc [k + 1] = g711_encode (abs ((int) lrint (dnorm * d [k])), d [k] < 0, law) ;
+	done = simd->d_to_g711 (d, dest.uc + 1, SIMD_TEST_LEN, law, dnorm) ;
+	simd_check (simd, "d_to_g711", done, 1) ;
+
+	/* Values outside the tables and NaNs must be left to the scalar code. */
+	fsrc [100] = 1.5f ;
+	dsrc [100] = 1.5 ;
+	fnorm = (law == PSF_G711_ALAW) ? (1.0 * 0x7FFF) / 16.0 : 0.25 * 0x7FFF ;
+	if (simd->f_to_g711 (f, dest.uc + 1, SIMD_TEST_LEN, law, fnorm) >= 100 ||
+			simd->d_to_g711 (d, dest.uc + 1, SIMD_TEST_LEN, law, fnorm) >= 100)
+	{	printf ("\n\nLine %d : %s G.711 kernel encoded a value outside the table.\n\n", __LINE__, simd->name) ;
+		exit (1) ;
+		} ;
+	fsrc [100] = NAN ;
+	dsrc [100] = NAN ;
+	if (simd->f_to_g711 (f, dest.uc + 1, SIMD_TEST_LEN, law, fnorm) >= 100 ||
+			simd->d_to_g711 (d, dest.uc + 1, SIMD_TEST_LEN, law, fnorm) >= 100)
+	{	printf ("\n\nLine %d : %s G.711 kernel encoded a NaN.\n\n", __LINE__, simd->name) ;
+		exit (1) ;
+		} ;
+	fsrc [100] = 0.5f ;
+	dsrc [100] = 0.5 ;
+	memset (dest.uc, 0, sizeof (dest.uc)) ;
+} /* simd_g711_test */
+
+/* The general case of unpc_block () in ALAC/dp_dec.c, from sample start. */
+static void
+alac_unpc (const int *pc, int *out, int start, int num, short *coefs, int numactive, int chanshift, int denshift)
+{	int j, k, sum1, top, del, del0, sg, sgn, dd ;
+
+	for (j = start ; j < num ; j++)
+	{	top = out [j - numactive - 1] ;
+		sum1 = 0 ;
+		for (k = 0 ; k < numactive ; k++)
+			sum1 += coefs [k] * (out [j - 1 - k] - top) ;
+
+		del = del0 = pc [j] ;
+		sg = (del > 0) - (del < 0) ;
+		del += top + ((sum1 + (1 << (denshift - 1))) >> denshift) ;
+		out [j] = arith_shift_left (del, chanshift) >> chanshift ;
+
+		for (k = numactive - 1 ; sg != 0 && k >= 0 ; k--)
+		{	dd = top - out [j - 1 - k] ;
+			sgn = sg * ((dd > 0) - (dd < 0)) ;
+			coefs [k] -= sgn ;
+			del0 -= (numactive - k) * ((sgn * dd) >> denshift) ;
+			if (sg * del0 <= 0)
+				break ;
+			} ;
+		} ;
+} /* alac_unpc */
+
+static void
+simd_alac_test (const PSF_SIMD *simd)
+{	static const int chanbits [] = { 16, 17, 24, 25 } ;
+	static int u [SIMD_TEST_LEN], v [SIMD_TEST_LEN] ;
+	short coefs [8], ref_coefs [8] ;
+	int k, numactive, chanshift, denshift, mixres, shift, test, lim, done ;
+
+	/* Stereo unmixing, with and without the matrix. */
+	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+	{	u [k] = src.i [k] >> 9 ;
+		v [k] = src.i [SIMD_TEST_LEN - k] >> 9 ;
+		} ;
+
+	for (shift = 8 ; shift <= 16 ; shift += 4)
+		for (mixres = 0 ; mixres < 4 ; mixres += 3)
+		{	for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			{	ref.i [2 * k + 2] = mixres ? u [k] + v [k] - ((mixres * v [k]) >> 2) : u [k] ;
+				ref.i [2 * k + 3] = mixres ? ref.i [2 * k + 2] - v [k] : v [k] ;
+				ref.i [2 * k + 2] = arith_shift_left (ref.i [2 * k + 2], shift) ;
+				ref.i [2 * k + 3] = arith_shift_left (ref.i [2 * k + 3], shift) ;
+				} ;
+			done = simd->alac_unmix (u, v, dest.i + 2, SIMD_TEST_LEN, 2, mixres, shift) ;
+			simd_check (simd, "alac_unmix", done, 2 * sizeof (int)) ;
+			} ;
+
+	/* Not every instruction set has a predictor kernel. */
+	if (simd->alac_unpc == psf_simd_get (PSF_SIMD_NONE)->alac_unpc)
+		return ;
+
+	/*
+	**	The predictor, for the tap counts the encoder uses. Larger residuals
+	**	keep the coefficients moving, the last tests start them at the limits
+	**	of a short to check they wrap around like the scalar ones.
+	*/
+	for (test = 0 ; test < 48 ; test++)
+	{	numactive = (test & 1) ? 8 : 4 ;
+		chanshift = 32 - chanbits [(test >> 1) & 3] ;
+		denshift = 1 + (test * 5) % 15 ;
+		lim = numactive + 1 ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			u [k] = src.i [k] >> (8 + test % 20) ;
+		for (k = 0 ; k < numactive ; k++)
+			coefs [k] = ref_coefs [k] = test >= 40 ? (k & 1 ? 0x7fff : -0x8000) : (rand () % 2048) - 1024 ;
+
+		ref.i [0] = dest.i [0] = u [0] ;
+		for (k = 1 ; k < lim ; k++)
+			ref.i [k] = dest.i [k] = arith_shift_left (u [k] + ref.i [k - 1], chanshift) >> chanshift ;
+
+		alac_unpc (u, ref.i, lim, SIMD_TEST_LEN, ref_coefs, numactive, chanshift, denshift) ;
+		done = simd->alac_unpc (u, dest.i, SIMD_TEST_LEN, coefs, numactive, chanshift, denshift) ;
+		if (done != SIMD_TEST_LEN - lim)
+		{	printf ("\n\nLine %d : %s alac_unpc predicted %d of %d samples.\n\n", __LINE__, simd->name, done, SIMD_TEST_LEN - lim) ;
+			exit (1) ;
+			} ;
+
+		if (memcmp (dest.i, ref.i, SIMD_TEST_LEN * sizeof (int)) != 0 || memcmp (coefs, ref_coefs, numactive * sizeof (short)) != 0)
+		{	printf ("\n\nLine %d : %s alac_unpc (numactive %d, chanshift %d, denshift %d) differs from scalar code.\n\n",
+						__LINE__, simd->name, numactive, chanshift, denshift) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	memset (dest.uc, 0, sizeof (dest.uc)) ;
+	memset (ref.uc, 0, sizeof (ref.uc)) ;
+} /* simd_alac_test */
+
+/* The FLAC decoder's conversions from flac_buffer_copy () in flac.c. */
+static void
+simd_planar_test (const PSF_SIMD *simd)
+{	static const int bits [] = { 8, 12, 16, 20, 24, 32 } ;
+	static int left [SIMD_TEST_LEN], right [SIMD_TEST_LEN] ;
+	static double ddest [2 * SIMD_TEST_LEN], dref [2 * SIMD_TEST_LEN] ;
+	const int *chan [2] = { left, right } ;
+	float normf ;
+	double normd ;
+	int k, j, b, channels, shift, done ;
+
+	for (b = 0 ; b < ARRAY_LEN (bits) ; b++)
+	{	/* Samples of the right width, sign extended. */
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		{	left [k] = arith_shift_left (src.i [k], 32 - bits [b]) >> (32 - bits [b]) ;
+			right [k] = arith_shift_left (src.i [SIMD_TEST_LEN - k], 32 - bits [b]) >> (32 - bits [b]) ;
+			} ;
+		normf = 1.0f / (1u << (bits [b] - 1)) ;
+		normd = 1.0 / (1u << (bits [b] - 1)) ;
+
+		for (channels = 1 ; channels <= 2 ; channels++)
+		{	shift = 16 - bits [b] ;
+			for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+				for (j = 0 ; j < channels ; j++)
+					ref.s [k * channels + j + channels] = shift < 0 ? chan [j][k] >> -shift : ((uint16_t) chan [j][k]) << shift ;
+			done = simd->planar_to_s (chan, channels, dest.s + channels, SIMD_TEST_LEN, shift) ;
+			simd_check (simd, "planar_to_s", done, channels * sizeof (short)) ;
+
+			shift = 32 - bits [b] ;
+			for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+				for (j = 0 ; j < channels ; j++)
+					ref.i [k * channels + j + channels] = ((uint32_t) chan [j][k]) << shift ;
+			done = simd->planar_to_i (chan, channels, dest.i + channels, SIMD_TEST_LEN, shift) ;
+			simd_check (simd, "planar_to_i", done, channels * sizeof (int)) ;
+
+			for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+				for (j = 0 ; j < channels ; j++)
+					ref.f [k * channels + j + channels] = chan [j][k] * normf ;
+			done = simd->planar_to_f (chan, channels, dest.f + channels, SIMD_TEST_LEN, normf) ;
+			simd_check (simd, "planar_to_f", done, channels * sizeof (float)) ;
+
+			/* dest only has room for one channel of doubles. */
+			for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+				for (j = 0 ; j < channels ; j++)
+					dref [k * channels + j] = chan [j][k] * normd ;
+			done = simd->planar_to_d (chan, channels, ddest, SIMD_TEST_LEN, normd) ;
+			if (done < SIMD_TEST_LEN - 64 || done > SIMD_TEST_LEN || memcmp (ddest, dref, done * channels * sizeof (double)) != 0)
+			{	printf ("\n\nLine %d : %s planar_to_d (%d channels) output differs from scalar code.\n\n", __LINE__, simd->name, channels) ;
+				exit (1) ;
+				} ;
+			} ;
+		} ;
+
+	/* Three or more channels are left to the scalar code. */
+	if (simd->planar_to_f (chan, 3, dest.f, SIMD_TEST_LEN, 1.0f) != 0)
+	{	printf ("\n\nLine %d : %s planar_to_f converted three channels.\n\n", __LINE__, simd->name) ;
+		exit (1) ;
+		} ;
+} /* simd_planar_test */
+
+/* The GSM 06.10 primitives from GSM610/gsm610_priv.h. */
+static short
+gsm_add (int a, int b)
+{	int sum = a + b ;
+	return sum > 32767 ? 32767 : (sum < -32768 ? -32768 : sum) ;
+} /* gsm_add */
+
+static short
+gsm_mult_r (short a, short b)
+{	return (a * b + 16384) >> 15 ;
+} /* gsm_mult_r */
+
+/* Short_term_analysis_filtering () and Short_term_synthesis_filtering () from GSM610/short_term.c. */
+static void
+gsm_st_analysis (short *u, const short *rp, short *s, int count)
+{	short di, sav, ui ;
+	int k, i ;
+
+	for (k = 0 ; k < count ; k++)
+	{	di = sav = s [k] ;
+		for (i = 0 ; i < 8 ; i++)
+		{	ui = u [i] ;
+			u [i] = sav ;
+			sav = gsm_add (ui, gsm_mult_r (rp [i], di)) ;
+			di = gsm_add (di, gsm_mult_r (rp [i], ui)) ;
+			} ;
+		s [k] = di ;
+		} ;
+} /* gsm_st_analysis */
+
+static void
+gsm_st_synthesis (short *v, const short *rrp, const short *wt, short *sr, int count)
+{	short sri ;
+	int k, i ;
+
+	for (k = 0 ; k < count ; k++)
+	{	sri = wt [k] ;
+		for (i = 8 ; i-- ; )
+		{	sri = gsm_add (sri, - gsm_mult_r (rrp [i], v [i])) ;
+			v [i + 1] = gsm_add (v [i], gsm_mult_r (rrp [i], sri)) ;
+			} ;
+		sr [k] = v [0] = sri ;
+		} ;
+} /* gsm_st_synthesis */
+
+/* The float versions of Autocorrelation () in lpc.c and Calculation_of_the_LTP_parameters () in long_term.c. */
+static void
+gsm_acf (const float *s, int *acf)
+{	int i, k ;
+
+	for (k = 0 ; k < 9 ; k++)
+	{	acf [k] = 0 ;
+		for (i = k ; i < 160 ; i++)
+			acf [k] += (int) (s [i] * s [i - k]) ;
+		} ;
+} /* gsm_acf */
+
+static void
+gsm_ltp_xcorr (const float *wt, const float *dp, float *xcorr)
+{	float product ;
+	int lag, k ;
+
+	for (lag = 40 ; lag <= 120 ; lag++)
+	{	xcorr [lag - 40] = 0.0f ;
+		for (k = 0 ; k < 40 ; k++)
+		{	product = wt [k] * dp [k - lag] ;
+			xcorr [lag - 40] += product ;
+			} ;
+		} ;
+} /* gsm_ltp_xcorr */
+
+/*
+**	Run the filters over a long random signal in the block sizes the codec
+**	uses, with new random coefficients for each block and the state carried
+**	over. Random coefficients saturate far more often than real ones.
+*/
+static void
+simd_gsm_test (const PSF_SIMD *simd)
+{	static const int blocks [] = { 13, 14, 13, 120 } ;
+	short rp [8], u [8], ref_u [8], v [9], ref_v [9] ;
+	float fs [160], fref [81], fdest [81], wt [40], dp_base [120], *dp = dp_base + 120 ;
+	int acf [9], ref_acf [9] ;
+	int k, block, pos, count, done, test ;
+
+	memset (u, 0, sizeof (u)) ;
+	memset (ref_u, 0, sizeof (ref_u)) ;
+	memset (v, 0, sizeof (v)) ;
+	memset (ref_v, 0, sizeof (ref_v)) ;
+
+	for (block = pos = 0 ; pos + 120 <= 2 * SIMD_TEST_LEN ; block++, pos += count)
+	{	count = blocks [block & 3] ;
+		for (k = 0 ; k < 8 ; k++)
+			rp [k] = (block & 7) == 5 ? (k & 1 ? 32767 : -32767) : (rand () % 65535) - 32767 ;
+
+		memcpy (ref.s + pos, src.s + pos, count * sizeof (short)) ;
+		memcpy (dest.s + pos, src.s + pos, count * sizeof (short)) ;
+		gsm_st_analysis (ref_u, rp, ref.s + pos, count) ;
+		done = simd->gsm_st_analysis (u, rp, dest.s + pos, count) ;
+		if (done != count || memcmp (dest.s + pos, ref.s + pos, count * sizeof (short)) != 0 || memcmp (u, ref_u, sizeof (u)) != 0)
+		{	printf ("\n\nLine %d : %s gsm_st_analysis block %d differs from scalar code.\n\n", __LINE__, simd->name, block) ;
+			exit (1) ;
+			} ;
+
+		gsm_st_synthesis (ref_v, rp, src.s + pos, ref.s + pos, count) ;
+		done = simd->gsm_st_synthesis (v, rp, src.s + pos, dest.s + pos, count) ;
+		if (done != count || memcmp (dest.s + pos, ref.s + pos, count * sizeof (short)) != 0 || memcmp (v, ref_v, sizeof (v)) != 0)
+		{	printf ("\n\nLine %d : %s gsm_st_synthesis block %d differs from scalar code.\n\n", __LINE__, simd->name, block) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	/* Scaled samples like Autocorrelation () uses, then larger ones. */
+	for (test = 0 ; test < 40 ; test++)
+	{	for (k = 0 ; k < 160 ; k++)
+			fs [k] = src.s [test * 40 + k] >> (test < 30 ? 4 : 3) ;
+
+		gsm_acf (fs, ref_acf) ;
+		done = simd->gsm_acf (fs, acf) ;
+		if (done != 9 || memcmp (acf, ref_acf, sizeof (acf)) != 0)
+		{	printf ("\n\nLine %d : %s gsm_acf test %d differs from scalar code.\n\n", __LINE__, simd->name, test) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	memset (dest.uc, 0, sizeof (dest.uc)) ;
+	memset (ref.uc, 0, sizeof (ref.uc)) ;
+
+	/* Not every instruction set has an LTP kernel. */
+	if (simd->gsm_ltp_xcorr == psf_simd_get (PSF_SIMD_NONE)->gsm_ltp_xcorr)
+		return ;
+
+	/* Scaled residuals against full scale ones, big enough to round. */
+	for (test = 0 ; test < 40 ; test++)
+	{	for (k = 0 ; k < 40 ; k++)
+			wt [k] = src.s [test * 40 + k] >> (test < 30 ? 9 : 0) ;
+		for (k = 0 ; k < 120 ; k++)
+			dp_base [k] = src.s [SIMD_TEST_LEN + test * 20 + k] ;
+
+		gsm_ltp_xcorr (wt, dp, fref) ;
+		done = simd->gsm_ltp_xcorr (wt, dp, fdest) ;
+		if (done != 81 || memcmp (fdest, fref, sizeof (fref)) != 0)
+		{	printf ("\n\nLine %d : %s gsm_ltp_xcorr test %d differs from scalar code.\n\n", __LINE__, simd->name, test) ;
+			exit (1) ;
+			} ;
+		} ;
+} /* simd_gsm_test */
+
+/* The scalar loop from command.c. */
+static void
+peak_d (const double *src, int count, int channels, double *peaks)
+{	double temp ;
+	int k ;
+
+	for (k = 0 ; k < count ; k++)
+	{	temp = fabs (src [k]) ;
+		peaks [k % channels] = temp > peaks [k % channels] ? temp : peaks [k % channels] ;
+		} ;
+} /* peak_d */
+
+static void
+simd_peak_test (const PSF_SIMD *simd)
+{	static double data [SIMD_TEST_LEN] ;
+	double peaks [2], ref_peaks [2] ;
+	int k, channels, count, done ;
+
+	/* Some NaNs, which must be passed over, and a negative peak. */
+	memcpy (data, dsrc + 1, sizeof (data)) ;
+	for (k = 7 ; k < SIMD_TEST_LEN ; k += 101)
+		data [k] = NAN ;
+	data [SIMD_TEST_LEN / 2] = -3.0 ;
+
+	for (channels = 1 ; channels <= 2 ; channels++)
+	{	count = SIMD_TEST_LEN - SIMD_TEST_LEN % channels ;
+		peaks [0] = peaks [1] = ref_peaks [0] = ref_peaks [1] = 0.5 ;
+
+		done = simd->peak_d (data, count, channels, peaks) ;
+		if (done < count - 64 || done > count || done % channels != 0)
+		{	printf ("\n\nLine %d : %s peak_d (%d channels) did %d of %d samples.\n\n", __LINE__, simd->name, channels, done, count) ;
+			exit (1) ;
+			} ;
+
+		peak_d (data, done, channels, ref_peaks) ;
+		if (memcmp (peaks, ref_peaks, channels * sizeof (double)) != 0)
+		{	printf ("\n\nLine %d : %s peak_d (%d channels) differs from scalar code.\n\n", __LINE__, simd->name, channels) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	if (simd->peak_d (data, SIMD_TEST_LEN - 1, 3, peaks) != 0)
+	{	printf ("\n\nLine %d : %s peak_d did three channels.\n\n", __LINE__, simd->name) ;
+		exit (1) ;
+		} ;
+} /* simd_peak_test */
+
+static void
+simd_kernel_test (const PSF_SIMD *simd)
+{	const unsigned char *uc = src.uc + 1 ;
+	const short *s = src.s + 1 ;
+	const int *i = src.i + 1 ;
+	const float normf = 1.0f / 0x8000 ;
+	const double normd = 1.0 / 0x80000000 ;
+	int k, done, flag ;
+
+	for (flag = 0 ; flag < 2 ; flag++)
+	{	/* Byte swapping. */
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.s [k + 1] = ENDSWAP_16 (s [k]) ;
+		done = simd->swap16 (s, dest.s + 1, SIMD_TEST_LEN) ;
+		simd_check (simd, "swap16", done, sizeof (short)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.i [k + 1] = ENDSWAP_32 (i [k]) ;
+		done = simd->swap32 (i, dest.i + 1, SIMD_TEST_LEN) ;
+		simd_check (simd, "swap32", done, sizeof (int)) ;
+
+		/* 8 bit reads, flag selects unsigned data. */
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.s [k + 1] = flag ? (((uint32_t) uc [k]) - 0x80) << 8 : (uint32_t) ((uint16_t) (signed char) uc [k]) << 8 ;
+		done = simd->pcm8_to_s (uc, dest.s + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "pcm8_to_s", done, sizeof (short)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.i [k + 1] = arith_shift_left (flag ? ((int) uc [k]) - 128 : (int) (signed char) uc [k], 24) ;
+		done = simd->pcm8_to_i (uc, dest.i + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "pcm8_to_i", done, sizeof (int)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.f [k + 1] = (flag ? ((int) uc [k]) - 128 : (int) (signed char) uc [k]) * normf ;
+		done = simd->pcm8_to_f (uc, dest.f + 1, SIMD_TEST_LEN, flag, normf) ;
+		simd_check (simd, "pcm8_to_f", done, sizeof (float)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.d [k + 1] = (flag ? ((int) uc [k]) - 128 : (int) (signed char) uc [k]) * normd ;
+		done = simd->pcm8_to_d (uc, dest.d + 1, SIMD_TEST_LEN, flag, normd) ;
+		simd_check (simd, "pcm8_to_d", done, sizeof (double)) ;
+
+		/* 16 and 32 bit reads, flag selects byte swapping. */
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.i [k + 1] = arith_shift_left (flag ? (short) ENDSWAP_16 (s [k]) : s [k], 16) ;
+		done = simd->pcm16_to_i (s, dest.i + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "pcm16_to_i", done, sizeof (int)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.f [k + 1] = ((float) (flag ? (short) ENDSWAP_16 (s [k]) : s [k])) * normf ;
+		done = simd->pcm16_to_f (s, dest.f + 1, SIMD_TEST_LEN, flag, normf) ;
+		simd_check (simd, "pcm16_to_f", done, sizeof (float)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.d [k + 1] = ((double) (flag ? (short) ENDSWAP_16 (s [k]) : s [k])) * normd ;
+		done = simd->pcm16_to_d (s, dest.d + 1, SIMD_TEST_LEN, flag, normd) ;
+		simd_check (simd, "pcm16_to_d", done, sizeof (double)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.s [k + 1] = (flag ? (int) ENDSWAP_32 (i [k]) : i [k]) >> 16 ;
+		done = simd->pcm32_to_s (i, dest.s + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "pcm32_to_s", done, sizeof (short)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.f [k + 1] = ((float) (flag ? (int) ENDSWAP_32 (i [k]) : i [k])) * normf ;
+		done = simd->pcm32_to_f (i, dest.f + 1, SIMD_TEST_LEN, flag, normf) ;
+		simd_check (simd, "pcm32_to_f", done, sizeof (float)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.d [k + 1] = ((double) (flag ? (int) ENDSWAP_32 (i [k]) : i [k])) * normd ;
+		done = simd->pcm32_to_d (i, dest.d + 1, SIMD_TEST_LEN, flag, normd) ;
+		simd_check (simd, "pcm32_to_d", done, sizeof (double)) ;
+
+		/* Writes. */
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.uc [k + 1] = flag ? (s [k] >> 8) + 0x80 : s [k] >> 8 ;
+		done = simd->s_to_pcm8 (s, dest.uc + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "s_to_pcm8", done, 1) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+			ref.uc [k + 1] = flag ? (i [k] >> 24) + 128 : i [k] >> 24 ;
+		done = simd->i_to_pcm8 (i, dest.uc + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "i_to_pcm8", done, 1) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		{	short value = i [k] >> 16 ;
+			ref.s [k + 1] = flag ? ENDSWAP_16 (value) : value ;
+			} ;
+		done = simd->i_to_pcm16 (i, dest.s + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "i_to_pcm16", done, sizeof (short)) ;
+
+		for (k = 0 ; k < SIMD_TEST_LEN ; k++)
+		{	int value = arith_shift_left (s [k], 16) ;
+			ref.i [k + 1] = flag ? (int) ENDSWAP_32 (value) : value ;
+			} ;
+		done = simd->s_to_pcm32 (s, dest.i + 1, SIMD_TEST_LEN, flag) ;
+		simd_check (simd, "s_to_pcm32", done, sizeof (int)) ;
+
+		simd_pcm24_test (simd, flag) ;
+		simd_clip_test (simd, flag) ;
+		simd_g711_test (simd, flag ? PSF_G711_ALAW : PSF_G711_ULAW) ;
+		} ;
+
+	simd_alac_test (simd) ;
+	simd_planar_test (simd) ;
+	simd_gsm_test (simd) ;
+	simd_peak_test (simd) ;
+} /* simd_kernel_test */
+
+void
+test_simd (void)
+{	const PSF_SIMD *simd ;
+	char name [64] ;
+	unsigned k ;
+	int level ;
+
+	srand (0x5eed) ;
+	for (k = 0 ; k < sizeof (src.uc) ; k++)
+		src.uc [k] = rand () >> 7 ;
+
+	/* Mostly in range, with some to clip. */
+	for (k = 0 ; k < ARRAY_LEN (fsrc) ; k++)
+	{	fsrc [k] = (rand () - RAND_MAX / 2) * (2.5 / RAND_MAX) ;
+		dsrc [k] = (rand () - RAND_MAX / 2) * (2.5 / RAND_MAX) ;
+		} ;
+
+	/* Make sure the extreme values are in there. */
+	src.s [2] = 0x7fff ;
+	src.s [3] = -0x8000 ;
+	src.i [4] = 0x7fffffff ;
+	src.i [5] = -0x7fffffff - 1 ;
+
+	for (level = PSF_SIMD_SSE2 ; level <= PSF_SIMD_NEON ; level++)
+	{	if ((simd = psf_simd_get (level)) == NULL)
+			continue ;
+
+		snprintf (name, sizeof (name), "Testing %s conversion kernels", simd->name) ;
+		print_test_name (name) ;
+		simd_kernel_test (simd) ;
+		puts ("ok") ;
+		} ;
+} /* test_simd */
@@ -0,0 +1,100 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "thread_pool.h"
+#include "test_main.h"
+
+#define	POOL_TEST_JOBS	1000
+
+typedef struct
+{	int		workers ;
+	int		runs [POOL_TEST_JOBS] ;
+	int		worker [POOL_TEST_JOBS] ;
+} POOL_TEST ;
+
+static void
+pool_test_job (void *data, int job, int worker)
+{	POOL_TEST *test = data ;
+
+	/* Each job has its own slot, so no locking is needed. */
+	test->runs [job] ++ ;
+	test->worker [job] = worker ;
+} /* pool_test_job */
+
+static void
+pool_test (PSF_THREAD_POOL *pool, int jobs)
+{	static POOL_TEST test ;
+	int k ;
+
+	memset (&test, 0, sizeof (test)) ;
+	test.workers = psf_thread_pool_workers (pool) ;
+
+	psf_thread_pool_run (pool, jobs, pool_test_job, &test) ;
+
+	for (k = 0 ; k < POOL_TEST_JOBS ; k++)
+	{	if (test.runs [k] != (k < jobs ? 1 : 0))
+		{	printf ("\n\nLine %d : job %d of %d ran %d times.\n\n", __LINE__, k, jobs, test.runs [k]) ;
+			exit (1) ;
+			} ;
+		if (test.worker [k] < 0 || test.worker [k] >= test.workers)
+		{	printf ("\n\nLine %d : job %d ran on worker %d of %d.\n\n", __LINE__, k, test.worker [k], test.workers) ;
+			exit (1) ;
+			} ;
+		} ;
+} /* pool_test */
+
+void
+test_thread_pool (void)
+{	PSF_THREAD_POOL *pool ;
+	int workers, k ;
+
+	print_test_name ("Testing thread pool") ;
+
+	if (psf_cpu_count () < 1 || psf_cpu_count () > PSF_MAX_THREADS)
+	{	printf ("\n\nLine %d : bad cpu count %d.\n\n", __LINE__, psf_cpu_count ()) ;
+		exit (1) ;
+		} ;
+
+	/* A NULL pool runs everything in the calling thread. */
+	pool_test (NULL, POOL_TEST_JOBS) ;
+
+	for (workers = 2 ; workers <= 8 ; workers *= 2)
+	{	pool = psf_thread_pool_new (workers) ;
+
+		if (pool != NULL && psf_thread_pool_workers (pool) > workers)
+		{	printf ("\n\nLine %d : asked for %d workers, got %d.\n\n", __LINE__, workers, psf_thread_pool_workers (pool)) ;
+			exit (1) ;
+			} ;
+
+		/* Reuse the pool with different numbers of jobs. */
+		for (k = 0 ; k < 20 ; k++)
+			pool_test (pool, (k * 53) % (POOL_TEST_JOBS + 1)) ;
+		pool_test (pool, POOL_TEST_JOBS) ;
+
+		psf_thread_pool_free (pool) ;
+		} ;
+
+	puts ("ok") ;
+} /* test_thread_pool */
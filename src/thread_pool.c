@@ -0,0 +1,226 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include	"sfconfig.h"
+
+#include	<stdlib.h>
+
+#if HAVE_UNISTD_H
+#include	<unistd.h>
+#endif
+
+#if HAVE_PTHREAD
+#include	<pthread.h>
+#endif
+
+#include	"common.h"
+#include	"thread_pool.h"
+
+int
+psf_cpu_count (void)
+{	long count = 1 ;
+
+#if HAVE_UNISTD_H && defined (_SC_NPROCESSORS_ONLN)
+	count = sysconf (_SC_NPROCESSORS_ONLN) ;
+#endif
+
+	if (count < 1)
+		return 1 ;
+	return count > PSF_MAX_THREADS ? PSF_MAX_THREADS : (int) count ;
+} /* psf_cpu_count */
+
+#if HAVE_PTHREAD
+
+struct PSF_THREAD_POOL
+{	pthread_mutex_t	lock ;
+	pthread_cond_t	start ;		/* Signalled when there are new jobs or on quit. */
+	pthread_cond_t	done ;		/* Signalled when the last job finishes. */
+
+	psf_job_func	func ;
+	void			*data ;
+	int				jobs, next_job, unfinished ;
+	int				quit ;
+
+	int				workers, started ;
+	pthread_t		threads [] ;
+} ;
+
+typedef struct
+{	PSF_THREAD_POOL	*pool ;
+	int				worker ;
+} WORKER_START ;
+
+/* Called with the lock held, returns with it held. */
+static void
+run_jobs (PSF_THREAD_POOL *pool, int worker)
+{	int job ;
+
+	while (pool->next_job < pool->jobs)
+	{	job = pool->next_job ++ ;
+
+		pthread_mutex_unlock (&pool->lock) ;
+		pool->func (pool->data, job, worker) ;
+		pthread_mutex_lock (&pool->lock) ;
+
+		if (-- pool->unfinished == 0)
+			pthread_cond_signal (&pool->done) ;
+		} ;
+} /* run_jobs */
+
+static void *
+worker_main (void *arg)
+{	PSF_THREAD_POOL *pool = ((WORKER_START *) arg)->pool ;
+	int worker = ((WORKER_START *) arg)->worker ;
+
+	free (arg) ;
+
+	pthread_mutex_lock (&pool->lock) ;
+	while (pool->quit == 0)
+	{	if (pool->next_job < pool->jobs)
+			run_jobs (pool, worker) ;
+		else
+			pthread_cond_wait (&pool->start, &pool->lock) ;
+		} ;
+	pthread_mutex_unlock (&pool->lock) ;
+
+	return NULL ;
+} /* worker_main */
+
+PSF_THREAD_POOL *
+psf_thread_pool_new (int workers)
+{	PSF_THREAD_POOL *pool ;
+	WORKER_START *start ;
+
+	if (workers < 2)
+		return NULL ;
+	if (workers > PSF_MAX_THREADS)
+		workers = PSF_MAX_THREADS ;
+
+	if ((pool = calloc (1, sizeof (PSF_THREAD_POOL) + (workers - 1) * sizeof (pthread_t))) == NULL)
+		return NULL ;
+
+	pthread_mutex_init (&pool->lock, NULL) ;
+	pthread_cond_init (&pool->start, NULL) ;
+	pthread_cond_init (&pool->done, NULL) ;
+
+	/* Worker 0 is whichever thread calls psf_thread_pool_run (). */
+	for (pool->started = 0 ; pool->started < workers - 1 ; pool->started++)
+	{	if ((start = malloc (sizeof (WORKER_START))) == NULL)
+			break ;
+		start->pool = pool ;
+		start->worker = pool->started + 1 ;
+		if (pthread_create (&pool->threads [pool->started], NULL, worker_main, start) != 0)
+		{	free (start) ;
+			break ;
+			} ;
+		} ;
+
+	if (pool->started == 0)
+	{	psf_thread_pool_free (pool) ;
+		return NULL ;
+		} ;
+
+	pool->workers = pool->started + 1 ;
+
+	return pool ;
+} /* psf_thread_pool_new */
+
+void
+psf_thread_pool_free (PSF_THREAD_POOL *pool)
+{	int k ;
+
+	if (pool == NULL)
+		return ;
+
+	pthread_mutex_lock (&pool->lock) ;
+	pool->quit = 1 ;
+	pthread_cond_broadcast (&pool->start) ;
+	pthread_mutex_unlock (&pool->lock) ;
+
+	for (k = 0 ; k < pool->started ; k++)
+		pthread_join (pool->threads [k], NULL) ;
+
+	pthread_cond_destroy (&pool->done) ;
+	pthread_cond_destroy (&pool->start) ;
+	pthread_mutex_destroy (&pool->lock) ;
+
+	free (pool) ;
+} /* psf_thread_pool_free */
+
+int
+psf_thread_pool_workers (const PSF_THREAD_POOL *pool)
+{	return pool == NULL ? 1 : pool->workers ;
+} /* psf_thread_pool_workers */
+
+void
+psf_thread_pool_run (PSF_THREAD_POOL *pool, int jobs, psf_job_func func, void *data)
+{	int job ;
+
+	if (pool == NULL || jobs < 2)
+	{	for (job = 0 ; job < jobs ; job++)
+			func (data, job, 0) ;
+		return ;
+		} ;
+
+	pthread_mutex_lock (&pool->lock) ;
+
+	pool->func = func ;
+	pool->data = data ;
+	pool->jobs = jobs ;
+	pool->next_job = 0 ;
+	pool->unfinished = jobs ;
+	pthread_cond_broadcast (&pool->start) ;
+
+	run_jobs (pool, 0) ;
+
+	while (pool->unfinished > 0)
+		pthread_cond_wait (&pool->done, &pool->lock) ;
+
+	pool->jobs = pool->next_job = 0 ;
+	pool->func = NULL ;
+	pool->data = NULL ;
+
+	pthread_mutex_unlock (&pool->lock) ;
+} /* psf_thread_pool_run */
+
+#else
+
+PSF_THREAD_POOL *
+psf_thread_pool_new (int UNUSED (workers))
+{	return NULL ;
+} /* psf_thread_pool_new */
+
+void
+psf_thread_pool_free (PSF_THREAD_POOL * UNUSED (pool))
+{
+} /* psf_thread_pool_free */
+
+int
+psf_thread_pool_workers (const PSF_THREAD_POOL * UNUSED (pool))
+{	return 1 ;
+} /* psf_thread_pool_workers */
+
+void
+psf_thread_pool_run (PSF_THREAD_POOL * UNUSED (pool), int jobs, psf_job_func func, void *data)
+{	int job ;
+
+	for (job = 0 ; job < jobs ; job++)
+		func (data, job, 0) ;
+} /* psf_thread_pool_run */
+
+#endif
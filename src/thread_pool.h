@@ -0,0 +1,53 @@
+/*
+** Copyright (C) 2026 The libsndfile authors
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation; either version 2.1 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef SNDFILE_THREAD_POOL_H
+#define SNDFILE_THREAD_POOL_H
+
+/*
+**	A small pool of worker threads for codecs that can split their work into
+**	independent jobs.
+**
+**	psf_thread_pool_run () hands out jobs 0 to (jobs - 1) to the workers and
+**	returns once they have all finished. The calling thread is worker 0 and
+**	takes jobs as well, so a pool of N workers starts N - 1 threads. Each job
+**	is also passed the number of the worker running it, which can be used to
+**	pick per worker scratch memory. Jobs may run in any order.
+**
+**	Without thread support psf_thread_pool_new () returns NULL. A NULL pool
+**	is valid everywhere and runs all the jobs in the calling thread, so the
+**	callers do not need a separate serial code path.
+*/
+
+#define	PSF_MAX_THREADS		64
+
+typedef struct PSF_THREAD_POOL PSF_THREAD_POOL ;
+
+typedef void (*psf_job_func) (void *data, int job, int worker) ;
+
+/* Number of processors available, or 1 if it can't be found. */
+int psf_cpu_count (void) ;
+
+PSF_THREAD_POOL * psf_thread_pool_new (int workers) ;
+void psf_thread_pool_free (PSF_THREAD_POOL *pool) ;
+
+int psf_thread_pool_workers (const PSF_THREAD_POOL *pool) ;
+
+void psf_thread_pool_run (PSF_THREAD_POOL *pool, int jobs, psf_job_func func, void *data) ;
+
+#endif /* SNDFILE_THREAD_POOL_H */
@@ -23,6 +23,7 @@
 
 #include	"sndfile.h"
 #include	"common.h"
+#include	"simd.h"
 
 static sf_count_t ulaw_read_ulaw2s (SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
 static sf_count_t ulaw_read_ulaw2i (SF_PRIVATE *psf, int *ptr, sf_count_t len) ;
@@ -42,6 +43,7 @@ ulaw_init (SF_PRIVATE *psf)
 		psf->read_int		= ulaw_read_ulaw2i ;
 		psf->read_float		= ulaw_read_ulaw2f ;
 		psf->read_double	= ulaw_read_ulaw2d ;
+		psf->can_select_channels = SF_TRUE ;
 		} ;
 
 	if (psf->file.mode == SFM_WRITE || psf->file.mode == SFM_RDWR)
@@ -793,31 +795,46 @@ unsigned char ulaw_encode [8193] =
 
 static inline void
 ulaw2s_array (unsigned char *buffer, int count, short *ptr)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_s (buffer, ptr, count, PSF_G711_ULAW) ;
+	while (--count >= done)
 		ptr [count] = ulaw_decode [(int) buffer [count]] ;
 } /* ulaw2s_array */
 
 static inline void
 ulaw2i_array (unsigned char *buffer, int count, int *ptr)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_i (buffer, ptr, count, PSF_G711_ULAW) ;
+	while (--count >= done)
 		ptr [count] = ((uint32_t) ulaw_decode [buffer [count]]) << 16 ;
 } /* ulaw2i_array */
 
 static inline void
 ulaw2f_array (unsigned char *buffer, int count, float *ptr, float normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_f (buffer, ptr, count, PSF_G711_ULAW, normfact) ;
+	while (--count >= done)
 		ptr [count] = normfact * ulaw_decode [(int) buffer [count]] ;
 } /* ulaw2f_array */
 
 static inline void
 ulaw2d_array (const unsigned char *buffer, int count, double *ptr, double normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->g711_to_d (buffer, ptr, count, PSF_G711_ULAW, normfact) ;
+	while (--count >= done)
 		ptr [count] = normfact * ulaw_decode [(int) buffer [count]] ;
 } /* ulaw2d_array */
 
 static inline void
 s2ulaw_array (const short *ptr, int count, unsigned char *buffer)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->s_to_g711 (ptr, buffer, count, PSF_G711_ULAW) ;
+	while (--count >= done)
 	{	if (ptr [count] >= 0)
 			buffer [count] = ulaw_encode [ptr [count] / 4] ;
 		else
@@ -827,7 +844,10 @@ s2ulaw_array (const short *ptr, int count, unsigned char *buffer)
 
 static inline void
 i2ulaw_array (const int *ptr, int count, unsigned char *buffer)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->i_to_g711 (ptr, buffer, count, PSF_G711_ULAW) ;
+	while (--count >= done)
 	{	if (ptr [count] == INT_MIN)
 			buffer [count] = ulaw_encode [INT_MAX >> (16 + 2)] ;
 		else if (ptr [count] >= 0)
@@ -839,7 +859,10 @@ i2ulaw_array (const int *ptr, int count, unsigned char *buffer)
 
 static inline void
 f2ulaw_array (const float *ptr, int count, unsigned char *buffer, float normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->f_to_g711 (ptr, buffer, count, PSF_G711_ULAW, normfact) ;
+	while (--count >= done)
 	{	if (ptr [count] >= 0)
 			buffer [count] = ulaw_encode [lrintf (normfact * ptr [count])] ;
 		else
@@ -849,7 +872,10 @@ f2ulaw_array (const float *ptr, int count, unsigned char *buffer, float normfact
 
 static inline void
 d2ulaw_array (const double *ptr, int count, unsigned char *buffer, double normfact)
-{	while (--count >= 0)
+{	int done ;
+
+	done = psf_simd ()->d_to_g711 (ptr, buffer, count, PSF_G711_ULAW, normfact) ;
+	while (--count >= done)
 	{	if (!isfinite (ptr [count]))
 			buffer [count] = 0 ;
 		else if (ptr [count] >= 0)
@@ -873,7 +899,7 @@ ulaw_read_ulaw2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		ulaw2s_array (ubuf.ucbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -895,7 +921,7 @@ ulaw_read_ulaw2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		ulaw2i_array (ubuf.ucbuf, readcount, ptr + total) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -920,7 +946,7 @@ ulaw_read_ulaw2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		ulaw2f_array (ubuf.ucbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
@@ -944,7 +970,7 @@ ulaw_read_ulaw2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.ucbuf, 1, bufferlen, psf) ;
+		readcount = psf_fread_samples (ubuf.ucbuf, 1, bufferlen, psf) ;
 		ulaw2d_array (ubuf.ucbuf, readcount, ptr + total, normfact) ;
 		total += readcount ;
 		if (readcount < bufferlen)
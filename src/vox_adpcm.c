@@ -39,8 +39,21 @@
 #include	"sndfile.h"
 #include	"sfendian.h"
 #include	"common.h"
+#include	"checkpoint.h"
 #include	"ima_oki_adpcm.h"
 
+typedef struct
+{	IMA_OKI_ADPCM	adpcm ;
+
+	/* Decoded samples not yet returned start at adpcm.pcm [pcm_indx]. */
+	int			pcm_indx ;
+	sf_count_t	frame ;
+} VOX_PRIVATE ;
+
+/* Decoder state at a checkpoint. */
+typedef struct
+{	int		last_output, step_index ;
+} VOX_CHECKPOINT ;
 
 static sf_count_t vox_read_s (SF_PRIVATE *psf, short *ptr, sf_count_t len) ;
 static sf_count_t vox_read_i (SF_PRIVATE *psf, int *ptr, sf_count_t len) ;
@@ -52,7 +65,10 @@ static sf_count_t vox_write_i (SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 static sf_count_t vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len) ;
 static sf_count_t vox_write_d (SF_PRIVATE *psf, const double *ptr, sf_count_t len) ;
 
-static int vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int len) ;
+static int vox_read_block (SF_PRIVATE *psf, VOX_PRIVATE *pvox, short *ptr, int len) ;
+
+static sf_count_t vox_seek (SF_PRIVATE *psf, int mode, sf_count_t offset) ;
+static void vox_checkpoint_add (SF_PRIVATE *psf, VOX_PRIVATE *pvox) ;
 
 /*------------------------------------------------------------------------------
 */
@@ -60,7 +76,7 @@ static int vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int
 static int
 codec_close (SF_PRIVATE * psf)
 {
-	IMA_OKI_ADPCM * p = (IMA_OKI_ADPCM *) psf->codec_data ;
+	IMA_OKI_ADPCM * p = &((VOX_PRIVATE *) psf->codec_data)->adpcm ;
 
 	if (p->errors)
 		psf_log_printf (psf, "*** Warning : ADPCM state errors: %d\n", p->errors) ;
@@ -69,7 +85,7 @@ codec_close (SF_PRIVATE * psf)
 
 int
 vox_adpcm_init (SF_PRIVATE *psf)
-{	IMA_OKI_ADPCM *pvox = NULL ;
+{	VOX_PRIVATE *pvox = NULL ;
 
 	if (psf->file.mode == SFM_RDWR)
 		return SFE_BAD_MODE_RW ;
@@ -77,11 +93,11 @@ vox_adpcm_init (SF_PRIVATE *psf)
 	if (psf->file.mode == SFM_WRITE && psf->sf.channels != 1)
 		return SFE_CHANNEL_COUNT ;
 
-	if ((pvox = malloc (sizeof (IMA_OKI_ADPCM))) == NULL)
+	if ((pvox = malloc (sizeof (VOX_PRIVATE))) == NULL)
 		return SFE_MALLOC_FAILED ;
 
 	psf->codec_data = (void*) pvox ;
-	memset (pvox, 0, sizeof (IMA_OKI_ADPCM)) ;
+	memset (pvox, 0, sizeof (VOX_PRIVATE)) ;
 
 	if (psf->file.mode == SFM_WRITE)
 	{	psf->write_short	= vox_write_s ;
@@ -113,34 +129,109 @@ vox_adpcm_init (SF_PRIVATE *psf)
 	if (psf_fseek (psf, 0 , SEEK_SET) == -1)
 		return SFE_BAD_SEEK ;
 
-	ima_oki_adpcm_init (pvox, IMA_OKI_ADPCM_TYPE_OKI) ;
+	ima_oki_adpcm_init (&pvox->adpcm, IMA_OKI_ADPCM_TYPE_OKI) ;
+
+	/* Each code byte holds two samples, so a checkpoint only needs the decoder state. */
+	if (psf->file.mode == SFM_READ)
+	{	if ((psf->checkpoints = psf_checkpoints_new (PSF_CHECKPOINT_INTERVAL, sizeof (VOX_CHECKPOINT))) == NULL)
+			return SFE_MALLOC_FAILED ;
+		vox_checkpoint_add (psf, pvox) ;
+		psf->seek = vox_seek ;
+		psf->sf.seekable = psf->is_pipe ? SF_FALSE : SF_TRUE ;
+		} ;
 
 	return 0 ;
 } /* vox_adpcm_init */
 
+static void
+vox_checkpoint_add (SF_PRIVATE *psf, VOX_PRIVATE *pvox)
+{	VOX_CHECKPOINT snapshot ;
+
+	snapshot.last_output = pvox->adpcm.last_output ;
+	snapshot.step_index = pvox->adpcm.step_index ;
+	psf_checkpoints_add (psf->checkpoints, pvox->frame, &snapshot) ;
+} /* vox_checkpoint_add */
+
+static sf_count_t
+vox_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
+{	VOX_PRIVATE		*pvox ;
+	VOX_CHECKPOINT	snapshot ;
+	BUF_UNION		ubuf ;
+	sf_count_t		frame ;
+	int				len, count ;
+
+	if ((pvox = psf->codec_data) == NULL || mode != SFM_READ || offset < 0)
+	{	psf->error = SFE_BAD_SEEK ;
+		return	PSF_SEEK_ERROR ;
+		} ;
+
+	/* Go back to a checkpoint, unless decoding on from here is quicker. */
+	frame = psf_checkpoints_find (psf->checkpoints, offset, NULL) ;
+	if (offset < pvox->frame || frame > pvox->frame)
+	{	if ((frame = psf_checkpoints_find (psf->checkpoints, offset, &snapshot)) < 0
+				|| psf_fseek (psf, psf->dataoffset + frame / 2, SEEK_SET) < 0)
+		{	psf->error = SFE_BAD_SEEK ;
+			return	PSF_SEEK_ERROR ;
+			} ;
+
+		pvox->adpcm.last_output = snapshot.last_output ;
+		pvox->adpcm.step_index = snapshot.step_index ;
+		pvox->adpcm.pcm_count = 0 ;
+		pvox->pcm_indx = 0 ;
+		pvox->frame = frame ;
+		} ;
+
+	while (pvox->frame < offset)
+	{	len = (int) SF_MIN (offset - pvox->frame, (sf_count_t) ARRAY_LEN (ubuf.sbuf)) ;
+		count = vox_read_block (psf, pvox, ubuf.sbuf, len) ;
+		if (count < len)
+			break ;
+		} ;
+
+	return pvox->frame ;
+} /* vox_seek */
+
 /*==============================================================================
 */
 
 static int
-vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int len)
-{	int	indx = 0, k ;
+vox_read_block (SF_PRIVATE *psf, VOX_PRIVATE *pvox, short *ptr, int len)
+{	IMA_OKI_ADPCM *adpcm = &pvox->adpcm ;
+	sf_count_t ahead ;
+	int	indx = 0, k ;
 
 	while (indx < len)
-	{	pvox->code_count = (len - indx > IMA_OKI_ADPCM_PCM_LEN) ? IMA_OKI_ADPCM_CODE_LEN : (len - indx + 1) / 2 ;
+	{	/* Hand out what is left of the last block first. */
+		if (pvox->pcm_indx < adpcm->pcm_count)
+		{	k = SF_MIN (len - indx, adpcm->pcm_count - pvox->pcm_indx) ;
+			memcpy (&(ptr [indx]), &(adpcm->pcm [pvox->pcm_indx]), k * sizeof (short)) ;
+			pvox->pcm_indx += k ;
+			pvox->frame += k ;
+			indx += k ;
+			continue ;
+			} ;
+
+		/* Blocks end at checkpoints, which always fall on a code byte. */
+		if ((ahead = psf_checkpoints_ahead (psf->checkpoints, pvox->frame)) == 0)
+		{	vox_checkpoint_add (psf, pvox) ;
+			ahead = psf_checkpoints_interval (psf->checkpoints) ;
+			} ;
 
-		if ((k = psf_fread (pvox->codes, 1, pvox->code_count, psf)) != pvox->code_count)
+		adpcm->code_count = (len - indx > IMA_OKI_ADPCM_PCM_LEN) ? IMA_OKI_ADPCM_CODE_LEN : (len - indx + 1) / 2 ;
+		if (ahead / 2 < adpcm->code_count)
+			adpcm->code_count = (int) (ahead / 2) ;
+
+		if ((k = psf_fread (adpcm->codes, 1, adpcm->code_count, psf)) != adpcm->code_count)
 		{	if (psf_ftell (psf) != psf->filelength)
-				psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, pvox->code_count) ;
+				psf_log_printf (psf, "*** Warning : short read (%d != %d).\n", k, adpcm->code_count) ;
 			if (k == 0)
 				break ;
 			} ;
 
-		pvox->code_count = k ;
-
-		ima_oki_adpcm_decode_block (pvox) ;
+		adpcm->code_count = k ;
 
-		memcpy (&(ptr [indx]), pvox->pcm, pvox->pcm_count * sizeof (short)) ;
-		indx += pvox->pcm_count ;
+		ima_oki_adpcm_decode_block (adpcm) ;
+		pvox->pcm_indx = 0 ;
 		} ;
 
 	return indx ;
@@ -149,13 +240,13 @@ vox_read_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, short *ptr, int len)
 
 static sf_count_t
 vox_read_s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM 	*pvox ;
+{	VOX_PRIVATE	*pvox ;
 	int			readcount, count ;
 	sf_count_t	total = 0 ;
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	while (len > 0)
 	{	readcount = (len > 0x10000000) ? 0x10000000 : (int) len ;
@@ -173,7 +264,7 @@ vox_read_s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 
 static sf_count_t
 vox_read_i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, readcount, count ;
@@ -181,7 +272,7 @@ vox_read_i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	sptr = ubuf.sbuf ;
 	bufferlen = ARRAY_LEN (ubuf.sbuf) ;
@@ -201,7 +292,7 @@ vox_read_i	(SF_PRIVATE *psf, int *ptr, sf_count_t len)
 
 static sf_count_t
 vox_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, readcount, count ;
@@ -210,7 +301,7 @@ vox_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_float == SF_TRUE) ? 1.0 / ((float) 0x8000) : 1.0 ;
 
@@ -232,7 +323,7 @@ vox_read_f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 
 static sf_count_t
 vox_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, readcount, count ;
@@ -241,7 +332,7 @@ vox_read_d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_double == SF_TRUE) ? 1.0 / ((double) 0x8000) : 1.0 ;
 
@@ -286,18 +377,18 @@ vox_write_block (SF_PRIVATE *psf, IMA_OKI_ADPCM *pvox, const short *ptr, int len
 
 static sf_count_t
 vox_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM 	*pvox ;
+{	VOX_PRIVATE	*pvox ;
 	int			writecount, count ;
 	sf_count_t	total = 0 ;
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	while (len)
 	{	writecount = (len > 0x10000000) ? 0x10000000 : (int) len ;
 
-		count = vox_write_block (psf, pvox, ptr, writecount) ;
+		count = vox_write_block (psf, &pvox->adpcm, ptr, writecount) ;
 
 		total += count ;
 		len -= count ;
@@ -310,7 +401,7 @@ vox_write_s (SF_PRIVATE *psf, const short *ptr, sf_count_t len)
 
 static sf_count_t
 vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, writecount, count ;
@@ -318,7 +409,7 @@ vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	sptr = ubuf.sbuf ;
 	bufferlen = ARRAY_LEN (ubuf.sbuf) ;
@@ -326,7 +417,7 @@ vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 	{	writecount = (len >= bufferlen) ? bufferlen : (int) len ;
 		for (k = 0 ; k < writecount ; k++)
 			sptr [k] = ptr [total + k] >> 16 ;
-		count = vox_write_block (psf, pvox, sptr, writecount) ;
+		count = vox_write_block (psf, &pvox->adpcm, sptr, writecount) ;
 		total += count ;
 		len -= writecount ;
 		if (count != writecount)
@@ -338,7 +429,7 @@ vox_write_i	(SF_PRIVATE *psf, const int *ptr, sf_count_t len)
 
 static sf_count_t
 vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, writecount, count ;
@@ -347,7 +438,7 @@ vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_float == SF_TRUE) ? (1.0 * 0x7FFF) : 1.0 ;
 
@@ -357,7 +448,7 @@ vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 	{	writecount = (len >= bufferlen) ? bufferlen : (int) len ;
 		for (k = 0 ; k < writecount ; k++)
 			sptr [k] = lrintf (normfact * ptr [total + k]) ;
-		count = vox_write_block (psf, pvox, sptr, writecount) ;
+		count = vox_write_block (psf, &pvox->adpcm, sptr, writecount) ;
 		total += count ;
 		len -= writecount ;
 		if (count != writecount)
@@ -369,7 +460,7 @@ vox_write_f (SF_PRIVATE *psf, const float *ptr, sf_count_t len)
 
 static sf_count_t
 vox_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
-{	IMA_OKI_ADPCM *pvox ;
+{	VOX_PRIVATE	*pvox ;
 	BUF_UNION	ubuf ;
 	short		*sptr ;
 	int			k, bufferlen, writecount, count ;
@@ -378,7 +469,7 @@ vox_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 
 	if (! psf->codec_data)
 		return 0 ;
-	pvox = (IMA_OKI_ADPCM*) psf->codec_data ;
+	pvox = (VOX_PRIVATE*) psf->codec_data ;
 
 	normfact = (psf->norm_double == SF_TRUE) ? (1.0 * 0x7FFF) : 1.0 ;
 
@@ -388,7 +479,7 @@ vox_write_d	(SF_PRIVATE *psf, const double *ptr, sf_count_t len)
 	{	writecount = (len >= bufferlen) ? bufferlen : (int) len ;
 		for (k = 0 ; k < writecount ; k++)
 			sptr [k] = lrint (normfact * ptr [total + k]) ;
-		count = vox_write_block (psf, pvox, sptr, writecount) ;
+		count = vox_write_block (psf, &pvox->adpcm, sptr, writecount) ;
 		total += count ;
 		len -= writecount ;
 		if (count != writecount)
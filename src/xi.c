@@ -28,6 +28,7 @@
 #include "sndfile.h"
 #include "sfendian.h"
 #include "common.h"
+#include "checkpoint.h"
 
 #define	MAX_XI_SAMPLES	16
 
@@ -46,6 +47,9 @@ typedef struct
 
 	/* Data for encoder and decoder. */
 	short	last_16 ;
+
+	/* Frames decoded since the start of the data. */
+	sf_count_t	frame ;
 } XI_PRIVATE ;
 
 static int	xi_close		(SF_PRIVATE *psf) ;
@@ -55,6 +59,7 @@ static int	dpcm_init 		(SF_PRIVATE *psf) ;
 
 
 static sf_count_t	dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset) ;
+static int	dpcm_checkpoint (SF_PRIVATE *psf, XI_PRIVATE *pxi, int len) ;
 
 /*------------------------------------------------------------------------------
 ** Public function.
@@ -208,6 +213,13 @@ dpcm_init (SF_PRIVATE *psf)
 							psf->filelength - psf->dataoffset ;
 	psf->sf.frames = psf->datalength / psf->blockwidth ;
 
+	/* The decoder state is just the last sample, so checkpoints are cheap. */
+	if (psf->file.mode == SFM_READ)
+	{	if ((psf->checkpoints = psf_checkpoints_new (PSF_CHECKPOINT_INTERVAL, sizeof (short))) == NULL)
+			return SFE_MALLOC_FAILED ;
+		psf->sf.seekable = SF_TRUE ;
+		} ;
+
 	return 0 ;
 } /* dpcm_init */
 
@@ -218,7 +230,8 @@ static sf_count_t
 dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			total, bufferlen, len ;
+	sf_count_t	frame ;
+	int			bufferlen, len, count ;
 
 	if ((pxi = psf->codec_data) == NULL)
 		return SFE_INTERNAL ;
@@ -231,6 +244,7 @@ dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 	if (offset == 0)
 	{	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
 		pxi->last_16 = 0 ;
+		pxi->frame = 0 ;
 		return 0 ;
 		} ;
 
@@ -245,28 +259,50 @@ dpcm_seek (SF_PRIVATE *psf, int mode, sf_count_t offset)
 		return	PSF_SEEK_ERROR ;
 		} ;
 
-	psf_fseek (psf, psf->dataoffset, SEEK_SET) ;
-
-	if ((SF_CODEC (psf->sf.format)) == SF_FORMAT_DPCM_16)
-	{	total = offset ;
-		bufferlen = ARRAY_LEN (ubuf.sbuf) ;
-		while (total > 0)
-		{	len = (total > bufferlen) ? bufferlen : total ;
-			total -= dpcm_read_dles2s (psf, ubuf.sbuf, len) ;
-			} ;
-		}
-	else
-	{	total = offset ;
-		bufferlen = ARRAY_LEN (ubuf.sbuf) ;
-		while (total > 0)
-		{	len = (total > bufferlen) ? bufferlen : total ;
-			total -= dpcm_read_dsc2s (psf, ubuf.sbuf, len) ;
+	/*
+	**	Go back to a checkpoint, unless decoding on from here is quicker.
+	**	Without checkpoints start from the beginning.
+	*/
+	frame = psf_checkpoints_find (psf->checkpoints, offset, NULL) ;
+	if (psf->checkpoints == NULL || offset < pxi->frame || frame > pxi->frame)
+	{	if ((frame = psf_checkpoints_find (psf->checkpoints, offset, &pxi->last_16)) < 0)
+		{	frame = 0 ;
+			pxi->last_16 = 0 ;
 			} ;
+		psf_fseek (psf, psf->dataoffset + frame * psf->blockwidth, SEEK_SET) ;
+		pxi->frame = frame ;
 		} ;
 
-	return offset ;
+	bufferlen = ARRAY_LEN (ubuf.sbuf) ;
+	while (pxi->frame < offset)
+	{	len = (int) SF_MIN (offset - pxi->frame, (sf_count_t) bufferlen) ;
+		if ((SF_CODEC (psf->sf.format)) == SF_FORMAT_DPCM_16)
+			count = dpcm_read_dles2s (psf, ubuf.sbuf, len) ;
+		else
+			count = dpcm_read_dsc2s (psf, ubuf.sbuf, len) ;
+		if (count < len)
+			break ;
+		} ;
+
+	return pxi->frame ;
 } /* dpcm_seek */
 
+/*
+**	Take a snapshot if one is due at the current frame and return how much of
+**	len can be read before the next one.
+*/
+static int
+dpcm_checkpoint (SF_PRIVATE *psf, XI_PRIVATE *pxi, int len)
+{	sf_count_t ahead ;
+
+	if ((ahead = psf_checkpoints_ahead (psf->checkpoints, pxi->frame)) == 0)
+	{	psf_checkpoints_add (psf->checkpoints, pxi->frame, &pxi->last_16) ;
+		ahead = psf_checkpoints_interval (psf->checkpoints) ;
+		} ;
+
+	return ahead < len ? (int) ahead : len ;
+} /* dpcm_checkpoint */
+
 
 static int
 xi_write_header (SF_PRIVATE *psf, int UNUSED (calc_length))
@@ -511,7 +547,7 @@ static sf_count_t
 dpcm_read_dsc2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 
 	if ((pxi = psf->codec_data) == NULL)
@@ -522,10 +558,12 @@ dpcm_read_dsc2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), readlen, psf) ;
 		dsc2s_array (pxi, ubuf.scbuf, readcount, ptr + total) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -537,7 +575,7 @@ static sf_count_t
 dpcm_read_dsc2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 
 	if ((pxi = psf->codec_data) == NULL)
@@ -548,10 +586,12 @@ dpcm_read_dsc2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), readlen, psf) ;
 		dsc2i_array (pxi, ubuf.scbuf, readcount, ptr + total) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -563,7 +603,7 @@ static sf_count_t
 dpcm_read_dsc2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 	float		normfact ;
 
@@ -577,10 +617,12 @@ dpcm_read_dsc2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), readlen, psf) ;
 		dsc2f_array (pxi, ubuf.scbuf, readcount, ptr + total, normfact) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -592,7 +634,7 @@ static sf_count_t
 dpcm_read_dsc2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 	double		normfact ;
 
@@ -606,10 +648,12 @@ dpcm_read_dsc2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.scbuf, sizeof (signed char), readlen, psf) ;
 		dsc2d_array (pxi, ubuf.scbuf, readcount, ptr + total, normfact) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -624,7 +668,7 @@ static sf_count_t
 dpcm_read_dles2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 
 	if ((pxi = psf->codec_data) == NULL)
@@ -635,10 +679,12 @@ dpcm_read_dles2s (SF_PRIVATE *psf, short *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.sbuf, sizeof (short), readlen, psf) ;
 		dles2s_array (pxi, ubuf.sbuf, readcount, ptr + total) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -650,7 +696,7 @@ static sf_count_t
 dpcm_read_dles2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 
 	if ((pxi = psf->codec_data) == NULL)
@@ -661,10 +707,12 @@ dpcm_read_dles2i (SF_PRIVATE *psf, int *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.sbuf, sizeof (short), readlen, psf) ;
 		dles2i_array (pxi, ubuf.sbuf, readcount, ptr + total) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -676,7 +724,7 @@ static sf_count_t
 dpcm_read_dles2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 	float		normfact ;
 
@@ -690,10 +738,12 @@ dpcm_read_dles2f (SF_PRIVATE *psf, float *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.sbuf, sizeof (short), readlen, psf) ;
 		dles2f_array (pxi, ubuf.sbuf, readcount, ptr + total, normfact) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
@@ -705,7 +755,7 @@ static sf_count_t
 dpcm_read_dles2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 {	BUF_UNION	ubuf ;
 	XI_PRIVATE	*pxi ;
-	int			bufferlen, readcount ;
+	int			bufferlen, readlen, readcount ;
 	sf_count_t	total = 0 ;
 	double		normfact ;
 
@@ -719,10 +769,12 @@ dpcm_read_dles2d (SF_PRIVATE *psf, double *ptr, sf_count_t len)
 	while (len > 0)
 	{	if (len < bufferlen)
 			bufferlen = (int) len ;
-		readcount = psf_fread (ubuf.sbuf, sizeof (short), bufferlen, psf) ;
+		readlen = dpcm_checkpoint (psf, pxi, bufferlen) ;
+		readcount = psf_fread (ubuf.sbuf, sizeof (short), readlen, psf) ;
 		dles2d_array (pxi, ubuf.sbuf, readcount, ptr + total, normfact) ;
+		pxi->frame += readcount ;
 		total += readcount ;
-		if (readcount < bufferlen)
+		if (readcount < readlen)
 			break ;
 		len -= readcount ;
 		} ;
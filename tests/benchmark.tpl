@@ -63,6 +63,7 @@
 #define	BUFFER_SIZE		(1 << 18)
 #define	BLOCK_COUNT		(30)
 #define	TEST_DURATION	(5)		/* 5 Seconds. */
+#define	SMALL_WRITE_LEN	(256)
 
 typedef struct
 {	double	write_rate ;
@@ -78,6 +79,8 @@ static void calc_raw_performance (PERF_STATS *stats) ;
 [+ ENDFOR data_type
 +]
 
+static void	calc_small_write_performance (int format, int write_buffer_size, double write_rate) ;
+
 static int cpu_is_big_endian (void) ;
 
 static const char* get_subtype_str (int subtype) ;
@@ -128,6 +131,14 @@ main (int argc, char *argv [])
 		calc_float_performance	(format_major | SF_FORMAT_FLOAT , stats.read_rate, stats.write_rate) ;
 		} ;
 
+	if (argc < 2 || strcmp ("--small-writes", argv [1]) == 0)
+	{	printf ("\nSmall (%d frame) writes :\n", SMALL_WRITE_LEN) ;
+		format_major = cpu_is_big_endian () ? SF_FORMAT_AIFF : SF_FORMAT_WAV ;
+
+		calc_small_write_performance (format_major | SF_FORMAT_PCM_16, 0, stats.write_rate) ;
+		calc_small_write_performance (format_major | SF_FORMAT_PCM_16, 1 << 16, stats.write_rate) ;
+		} ;
+
 	puts ("") ;
 
 	free (data) ;
@@ -316,6 +327,69 @@ calc_[+ (get "type_name") +]_performance (int format, double read_rate, double w
 [+ ENDFOR data_type
 +]
 
+static void
+calc_small_write_performance (int format, int write_buffer_size, double write_rate)
+{	SNDFILE *file ;
+	SF_INFO	sfinfo ;
+	clock_t start_clock, clock_time ;
+	double	performance ;
+	int k, retval, op_count ;
+	short *short_data ;
+	const char *filename ;
+
+	filename = "benchmark.dat" ;
+
+	short_data = data ;
+	for (k = 0 ; k < BUFFER_SIZE ; k++)
+		short_data [k] = 32700.0 * sin (2 * M_PI * k / 32000.0) ;
+
+	printf ("    Write short   to  %s (%6d byte buffer) : ", get_subtype_str (format & SF_FORMAT_SUBMASK), write_buffer_size) ;
+	fflush (stdout) ;
+
+	sfinfo.channels = 1 ;
+	sfinfo.format = format ;
+	sfinfo.frames = 1 ;
+	sfinfo.samplerate = 32000 ;
+
+	clock_time = 0 ;
+	op_count = 0 ;
+	start_clock = clock () ;
+
+	while (clock_time < (CLOCKS_PER_SEC * TEST_DURATION))
+	{	if (! (file = sf_open (filename, SFM_WRITE, &sfinfo)))
+		{	printf ("Error : not able to open file : %s\n", filename) ;
+			perror ("") ;
+			exit (1) ;
+			} ;
+
+		/* Turn off the addition of a PEAK chunk. */
+		sf_command (file, SFC_SET_ADD_PEAK_CHUNK, NULL, SF_FALSE) ;
+
+		if (write_buffer_size > 0 && sf_command (file, SFC_SET_WRITE_BUFFER_SIZE, &write_buffer_size, sizeof (write_buffer_size)) != SF_TRUE)
+		{	printf ("Error : not able to set write buffer size.\n") ;
+			exit (1) ;
+			} ;
+
+		for (k = 0 ; k < BLOCK_COUNT * (BUFFER_SIZE / SMALL_WRITE_LEN) ; k++)
+		{	if ((retval = sf_writef_short (file, short_data + (k * SMALL_WRITE_LEN) % BUFFER_SIZE, SMALL_WRITE_LEN)) != SMALL_WRITE_LEN)
+			{	printf ("Error : sf_writef_short returned %d (should have been %d)\n", retval, SMALL_WRITE_LEN) ;
+				exit (1) ;
+				} ;
+			} ;
+
+		sf_close (file) ;
+
+		clock_time = clock () - start_clock ;
+		op_count ++ ;
+		} ;
+
+	performance = (1.0 * BUFFER_SIZE) * BLOCK_COUNT * op_count ;
+	performance *= (1.0 * CLOCKS_PER_SEC) / clock_time ;
+	printf ("%6.2f%% of raw write\n", 100.0 * performance / write_rate) ;
+
+	unlink (filename) ;
+} /* calc_small_write_performance */
+
 /*==============================================================================
 */
 
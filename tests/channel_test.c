@@ -41,11 +41,29 @@
 #define LOG_BUFFER_SIZE	1024
 
 static	void	channel_test			(void) ;
+static	void	planar_test				(int channels, int stride) ;
+static	void	select_test				(const char *filename, int format) ;
 static	double	max_diff		(const float *a, const float *b, unsigned int len, unsigned int * position) ;
 
 int
 main (void) // int argc, char *argv [])
 {	channel_test () ;
+
+	planar_test (1, 1) ;
+	planar_test (2, 1) ;
+	planar_test (6, 2) ;
+	planar_test (64, 3) ;
+
+	select_test ("select.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_U8) ;
+	select_test ("select.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;
+	select_test ("select.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_24) ;
+	select_test ("select.au", SF_FORMAT_AU | SF_FORMAT_PCM_32) ;
+	select_test ("select.wav", SF_FORMAT_WAV | SF_FORMAT_FLOAT) ;
+	select_test ("select.au", SF_FORMAT_AU | SF_FORMAT_DOUBLE) ;
+	select_test ("select.wav", SF_FORMAT_WAV | SF_FORMAT_ULAW) ;
+	select_test ("select.au", SF_FORMAT_AU | SF_FORMAT_ALAW) ;
+	if (HAVE_EXTERNAL_XIPH_LIBS)
+		select_test ("select.flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16) ;
 	return 0 ;
 } /* main */
 
@@ -121,6 +139,166 @@ channel_test (void)
 	return ;
 } /* channel_test */
 
+#define	PLANAR_FRAMES	3000
+
+static void
+planar_test (int channels, int stride)
+{	static short	interleaved [PLANAR_FRAMES * 64] ;
+	SNDFILE	*file ;
+	SF_INFO	sfinfo ;
+	short	**sptrs ;
+	int		**iptrs ;
+	sf_count_t count ;
+	int		ch, k ;
+	char	filename [256] ;
+
+	snprintf (filename, sizeof (filename), "planar_%d_%d.wav", channels, stride) ;
+	print_test_name (__func__, filename) ;
+
+	sptrs = calloc (channels, sizeof (short *)) ;
+	iptrs = calloc (channels, sizeof (int *)) ;
+	exit_if_true (sptrs == NULL || iptrs == NULL, "\n\nLine %d : calloc failed.\n\n", __LINE__) ;
+
+	for (ch = 0 ; ch < channels ; ch++)
+	{	sptrs [ch] = calloc (PLANAR_FRAMES * stride, sizeof (short)) ;
+		/* Room past the end to check zero filling on short reads. */
+		iptrs [ch] = calloc ((PLANAR_FRAMES + 100) * stride, sizeof (int)) ;
+		exit_if_true (sptrs [ch] == NULL || iptrs [ch] == NULL, "\n\nLine %d : calloc failed.\n\n", __LINE__) ;
+
+		for (k = 0 ; k < PLANAR_FRAMES ; k++)
+			sptrs [ch][k * stride] = (short) (k * 7 + ch * 1031) ;
+		} ;
+
+	sf_info_setup (&sfinfo, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 48000, channels) ;
+
+	/* Write the file from the channel buffers. */
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+
+	count = sf_writef_short_planar (file, (const short * const *) sptrs, 0, PLANAR_FRAMES) ;
+	exit_if_true (count != 0 || sf_error (file) == 0,
+			"\n\nLine %d : Stride 0 was not rejected.\n\n", __LINE__) ;
+
+	count = sf_writef_short_planar (file, (const short * const *) sptrs, stride, PLANAR_FRAMES) ;
+	exit_if_true (count != PLANAR_FRAMES,
+			"\n\nLine %d : Wrote %" PRId64 " of %d frames.\n\n", __LINE__, count, PLANAR_FRAMES) ;
+	sf_close (file) ;
+
+	/* Read it back interleaved. */
+	sf_info_clear (&sfinfo) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	test_readf_short_or_die (file, 0, interleaved, PLANAR_FRAMES, __LINE__) ;
+
+	for (k = 0 ; k < PLANAR_FRAMES ; k++)
+		for (ch = 0 ; ch < channels ; ch++)
+			exit_if_true (interleaved [k * channels + ch] != sptrs [ch][k * stride],
+					"\n\nLine %d : Mismatch at frame %d, channel %d.\n\n", __LINE__, k, ch) ;
+
+	/* And planar again, asking for more frames than there are. */
+	for (ch = 0 ; ch < channels ; ch++)
+		for (k = 0 ; k < (PLANAR_FRAMES + 100) * stride ; k++)
+			iptrs [ch][k] = -1 ;
+
+	test_seek_or_die (file, 0, SEEK_SET, 0, channels, __LINE__) ;
+	count = sf_readf_int_planar (file, iptrs, stride, PLANAR_FRAMES + 100) ;
+	exit_if_true (count != PLANAR_FRAMES,
+			"\n\nLine %d : Read %" PRId64 " of %d frames.\n\n", __LINE__, count, PLANAR_FRAMES) ;
+
+	for (ch = 0 ; ch < channels ; ch++)
+		for (k = 0 ; k < PLANAR_FRAMES + 100 ; k++)
+		{	int expected = k < PLANAR_FRAMES ? sptrs [ch][k * stride] * 0x10000 : 0 ;
+
+			exit_if_true (iptrs [ch][k * stride] != expected,
+					"\n\nLine %d : Frame %d, channel %d : %d should be %d.\n\n", __LINE__, k, ch, iptrs [ch][k * stride], expected) ;
+			if (stride > 1)
+				exit_if_true (iptrs [ch][k * stride + 1] != -1,
+						"\n\nLine %d : Frame %d, channel %d : wrote between strides.\n\n", __LINE__, k, ch) ;
+			} ;
+
+	sf_close (file) ;
+	unlink (filename) ;
+
+	for (ch = 0 ; ch < channels ; ch++)
+	{	free (sptrs [ch]) ;
+		free (iptrs [ch]) ;
+		} ;
+	free (sptrs) ;
+	free (iptrs) ;
+
+	puts ("ok") ;
+} /* planar_test */
+
+#define	SELECT_CHANNELS	7
+#define	SELECT_FRAMES	3000
+
+static void
+select_test (const char *filename, int format)
+{	static short	data [SELECT_FRAMES * SELECT_CHANNELS] ;
+	static float	full [SELECT_FRAMES * SELECT_CHANNELS] ;
+	static float	part [(SELECT_FRAMES + 10) * 3] ;
+	static int		ipart [SELECT_FRAMES * 3] ;
+	int				select [3] = { 6, 1, 3 }, bad [2] = { 0, SELECT_CHANNELS } ;
+	SNDFILE			*file ;
+	SF_INFO			sfinfo ;
+	sf_count_t		count ;
+	int				ch, k ;
+
+	print_test_name (__func__, filename) ;
+
+	for (k = 0 ; k < SELECT_FRAMES ; k++)
+		for (ch = 0 ; ch < SELECT_CHANNELS ; ch++)
+			data [k * SELECT_CHANNELS + ch] = (short) (((k * 37 + ch * 4099) % 0x8000) - 0x4000) ;
+
+	sf_info_setup (&sfinfo, format, 44100, SELECT_CHANNELS) ;
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	test_writef_short_or_die (file, 0, data, SELECT_FRAMES, __LINE__) ;
+	sf_close (file) ;
+
+	/* Read all channels, then just the selected ones, and compare. */
+	sf_info_clear (&sfinfo) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	test_readf_float_or_die (file, 0, full, SELECT_FRAMES, __LINE__) ;
+
+	exit_if_true (sf_command (file, SFC_SET_READ_CHANNELS, bad, sizeof (bad)) != SF_FALSE,
+			"\n\nLine %d : Channel %d was accepted.\n\n", __LINE__, SELECT_CHANNELS) ;
+	exit_if_true (sf_command (file, SFC_SET_READ_CHANNELS, select, sizeof (select)) != SF_TRUE,
+			"\n\nLine %d : SFC_SET_READ_CHANNELS failed : %s\n\n", __LINE__, sf_strerror (file)) ;
+
+	test_seek_or_die (file, 0, SEEK_SET, 0, SELECT_CHANNELS, __LINE__) ;
+	count = sf_readf_float (file, part, SELECT_FRAMES + 10) ;
+	exit_if_true (count != SELECT_FRAMES,
+			"\n\nLine %d : Read %" PRId64 " of %d frames.\n\n", __LINE__, count, SELECT_FRAMES) ;
+
+	for (k = 0 ; k < SELECT_FRAMES ; k++)
+		for (ch = 0 ; ch < 3 ; ch++)
+			exit_if_true (part [3 * k + ch] != full [SELECT_CHANNELS * k + select [ch]],
+					"\n\nLine %d : Frame %d, channel %d : %f should be %f.\n\n", __LINE__,
+					k, select [ch], part [3 * k + ch], full [SELECT_CHANNELS * k + select [ch]]) ;
+
+	for (k = 3 * SELECT_FRAMES ; k < (int) ARRAY_LEN (part) ; k++)
+		exit_if_true (part [k] != 0.0, "\n\nLine %d : part [%d] is not zero.\n\n", __LINE__, k) ;
+
+	/* Items reads must be whole frames of the selected channels. */
+	test_seek_or_die (file, 100, SEEK_SET, 100, SELECT_CHANNELS, __LINE__) ;
+	exit_if_true (sf_read_int (file, ipart, 4) != 0,
+			"\n\nLine %d : Misaligned read was accepted.\n\n", __LINE__) ;
+	test_read_int_or_die (file, 0, ipart, 3 * 1000, __LINE__) ;
+	test_seek_or_die (file, 0, SEEK_CUR, 1100, SELECT_CHANNELS, __LINE__) ;
+
+	/* Clearing the selection reads every channel again. */
+	exit_if_true (sf_command (file, SFC_SET_READ_CHANNELS, NULL, 0) != SF_TRUE,
+			"\n\nLine %d : Clearing SFC_SET_READ_CHANNELS failed.\n\n", __LINE__) ;
+	test_seek_or_die (file, 0, SEEK_SET, 0, SELECT_CHANNELS, __LINE__) ;
+	test_readf_float_or_die (file, 0, full, SELECT_FRAMES, __LINE__) ;
+	for (k = 0 ; k < 3 * SELECT_FRAMES ; k++)
+		exit_if_true (part [k] != full [SELECT_CHANNELS * (k / 3) + select [k % 3]],
+				"\n\nLine %d : Mismatch at item %d.\n\n", __LINE__, k) ;
+
+	sf_close (file) ;
+	unlink (filename) ;
+
+	puts ("ok") ;
+} /* select_test */
+
 static double
 max_diff (const float *a, const float *b, unsigned int len, unsigned int * position)
 {	double mdiff = 0.0, diff ;
@@ -46,6 +46,7 @@ static	void	float_norm_test			(const char *filename) ;
 static	void	double_norm_test		(const char *filename) ;
 static	void	format_tests			(void) ;
 static	void	calc_peak_test			(int filetype, const char *filename, int channels) ;
+static	void	threaded_peak_test		(const char *filename, int channels) ;
 static	void	truncate_test			(const char *filename, int filetype) ;
 static	void	instrument_test			(const char *filename, int filetype) ;
 static	void	cue_test				(const char *filename, int filetype) ;
@@ -125,6 +126,8 @@ main (int argc, char *argv [])
 		calc_peak_test (SF_ENDIAN_LITTLE	| SF_FORMAT_RAW, "le-peak.raw", 1) ;
 		calc_peak_test (SF_ENDIAN_BIG		| SF_FORMAT_RAW, "be-peak.raw", 7) ;
 		calc_peak_test (SF_ENDIAN_LITTLE	| SF_FORMAT_RAW, "le-peak.raw", 7) ;
+		threaded_peak_test ("threaded-peak.wav", 2) ;
+		threaded_peak_test ("threaded-peak.wav", 3) ;
 		test_count ++ ;
 		} ;
 
@@ -667,6 +670,146 @@ calc_peak_test (int filetype, const char *filename, int channels)
 	printf ("ok\n") ;
 } /* calc_peak_test */
 
+/*
+**	A file long enough for the peaks to be found on worker threads, with the
+**	peak of each channel in a different place. The result is kept until the
+**	next write.
+*/
+#define	THREADED_PEAK_FRAMES	(300000 + 13)
+
+static void
+threaded_peak_write (const char *filename, SF_INFO *sfinfo, const sf_count_t *peak_frame, int peak_scale)
+{	static short	data [BUFFER_LEN] ;
+	SNDFILE		*file ;
+	sf_count_t	frame, frames ;
+	int			k, chan, channels = sfinfo->channels, chunk ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, sfinfo, SF_TRUE, __LINE__) ;
+
+	chunk = BUFFER_LEN / channels ;
+	for (frame = 0 ; frame < THREADED_PEAK_FRAMES ; frame += frames)
+	{	frames = THREADED_PEAK_FRAMES - frame < chunk ? THREADED_PEAK_FRAMES - frame : chunk ;
+		for (k = 0 ; k < frames ; k++)
+			for (chan = 0 ; chan < channels ; chan++)
+				data [k * channels + chan] = frame + k == peak_frame [chan] ? -1000 * peak_scale * (chan + 1) : ((frame + k) * 37 + chan * 11) % 1001 - 500 ;
+		test_writef_short_or_die (file, 0, data, frames, __LINE__) ;
+		} ;
+
+	sf_close (file) ;
+} /* threaded_peak_write */
+
+static void
+threaded_peak_test (const char *filename, int channels)
+{	static short	data [BUFFER_LEN] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	char		label [128], moved [128] ;
+	double		peaks [3], serial [3], norm_peaks [3], peak ;
+	sf_count_t	peak_frame [3] ;
+	int			k, chan, threads = 4 ;
+
+	snprintf (label, sizeof (label), "threaded_peak_test (%d channels)", channels) ;
+	print_test_name (label, filename) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= 44100 ;
+	sfinfo.format		= SF_FORMAT_WAV | SF_FORMAT_PCM_16 ;
+	sfinfo.channels		= channels ;
+
+	for (chan = 0 ; chan < channels ; chan++)
+		peak_frame [chan] = (chan + 1) * (THREADED_PEAK_FRAMES / (channels + 1)) + 5 * chan ;
+	peak_frame [0] = THREADED_PEAK_FRAMES - 1 ;
+
+	threaded_peak_write (filename, &sfinfo, peak_frame, 1) ;
+
+	/* Scan in this thread first. */
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_TRUE, __LINE__) ;
+	sf_command (file, SFC_CALC_MAX_ALL_CHANNELS, serial, channels * sizeof (double)) ;
+	sf_close (file) ;
+
+	for (chan = 0 ; chan < channels ; chan++)
+		if (serial [chan] != 1000.0 * (chan + 1))
+		{	printf ("\n\nLine %d : channel %d peak should be %d (is %f).\n\n", __LINE__, chan, 1000 * (chan + 1), serial [chan]) ;
+			exit (1) ;
+			} ;
+
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	sf_command (file, SFC_SET_THREADS, &threads, sizeof (threads)) ;
+
+#if HAVE_PREAD
+	/*
+	** Move the open file away and put one with other peaks in its place.
+	** The workers have to read the open file, not whatever has its name.
+	*/
+	snprintf (moved, sizeof (moved), "moved-%s", filename) ;
+	if (rename (filename, moved) != 0)
+	{	printf ("\n\nLine %d : rename (%s, %s) failed.\n\n", __LINE__, filename, moved) ;
+		exit (1) ;
+		} ;
+	threaded_peak_write (filename, &sfinfo, peak_frame, 2) ;
+#else
+	snprintf (moved, sizeof (moved), "%s", filename) ;
+#endif
+
+	/* Twice each, the second time from the cache. */
+	for (k = 0 ; k < 2 ; k++)
+	{	sf_command (file, SFC_CALC_MAX_ALL_CHANNELS, peaks, channels * sizeof (double)) ;
+		sf_command (file, SFC_CALC_NORM_MAX_ALL_CHANNELS, norm_peaks, channels * sizeof (double)) ;
+		for (chan = 0 ; chan < channels ; chan++)
+			if (peaks [chan] != serial [chan] || norm_peaks [chan] != serial [chan] / 32768.0)
+			{	printf ("\n\nLine %d : channel %d peak should be %f (is %f, normalised %f).\n\n", __LINE__, chan, serial [chan], peaks [chan], norm_peaks [chan]) ;
+				exit (1) ;
+				} ;
+
+		sf_command (file, SFC_CALC_SIGNAL_MAX, &peak, sizeof (peak)) ;
+		if (peak != 1000.0 * channels)
+		{	printf ("\n\nLine %d : peak should be %d (is %f).\n\n", __LINE__, 1000 * channels, peak) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	/* The read position is left alone. */
+	if (sf_seek (file, 0, SEEK_CUR) != 0)
+	{	printf ("\n\nLine %d : read position moved to %" PRId64 ".\n\n", __LINE__, sf_seek (file, 0, SEEK_CUR)) ;
+		exit (1) ;
+		} ;
+
+#if HAVE_PREAD
+	/* Make sure the peaks really were found on the worker threads. */
+	if (string_in_log_buffer (file, "Peak scan : 4 threads.") == 0)
+	{	printf ("\n\nLine %d : the peaks were not found on worker threads.\n\n", __LINE__) ;
+		dump_log_buffer (file) ;
+		exit (1) ;
+		} ;
+#endif
+
+	sf_close (file) ;
+
+	if (strcmp (moved, filename) != 0)
+		unlink (moved) ;
+
+	/* A write drops the old result. */
+	file = test_open_file_or_die (filename, SFM_RDWR, &sfinfo, SF_TRUE, __LINE__) ;
+	sf_command (file, SFC_CALC_SIGNAL_MAX, &peak, sizeof (peak)) ;
+
+	for (chan = 0 ; chan < channels ; chan++)
+		data [chan] = 20000 ;
+	test_seek_or_die (file, 100, SEEK_SET, 100, channels, __LINE__) ;
+	test_writef_short_or_die (file, 0, data, 1, __LINE__) ;
+
+	sf_command (file, SFC_CALC_SIGNAL_MAX, &peak, sizeof (peak)) ;
+	if (peak != 20000.0)
+	{	printf ("\n\nLine %d : peak after write should be 20000 (is %f).\n\n", __LINE__, peak) ;
+		exit (1) ;
+		} ;
+
+	sf_close (file) ;
+
+	unlink (filename) ;
+
+	puts ("ok") ;
+} /* threaded_peak_test */
+
 static void
 truncate_test (const char *filename, int filetype)
 {	SNDFILE 	*file ;
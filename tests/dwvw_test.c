@@ -56,10 +56,12 @@ dwvw_test (const char *filename, int format, int bit_width)
 {	static	int		write_buf [BUFFER_SIZE] ;
 	static	int		read_buf [BUFFER_SIZE] ;
 
+	static	const	int	seek_pos [] = { 9000, 100, 8191, 8192, 8193, 9999, 3 } ;
+
 	SNDFILE	*file ;
 	SF_INFO sfinfo ;
 	double 	value ;
-	int		k, bit_mask ;
+	int		k, bit_mask, pos ;
 
 	srand (123456) ;
 
@@ -101,6 +103,20 @@ dwvw_test (const char *filename, int format, int bit_width)
 			} ;
 		} ;
 
+	/* Seek both ways around the checkpoint taken while counting frames. */
+	for (k = 0 ; k < (int) ARRAY_LEN (seek_pos) ; k++)
+	{	pos = seek_pos [k] ;
+		if (sf_seek (file, pos, SEEK_SET) != pos)
+		{	printf ("Error (line %d) : seek to %d failed : %s\n", __LINE__, pos, sf_strerror (file)) ;
+			exit (1) ;
+			} ;
+		if (sf_read_int (file, read_buf, 1) != 1 || read_buf [0] != write_buf [pos])
+		{	printf ("Error (line %d) : %d != %d after seek to %d\n", __LINE__,
+				write_buf [pos] >> (32 - bit_width), read_buf [0] >> (32 - bit_width), pos) ;
+			exit (1) ;
+			} ;
+		} ;
+
 	sf_close (file) ;
 
 	unlink (filename) ;
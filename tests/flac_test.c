@@ -0,0 +1,308 @@
+/*
+** Copyright (C) 2007-2016 Erik de Castro Lopo <erikd@mega-nerd.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "sfconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include "sf_unistd.h"
+#endif
+
+#include	<sndfile.h>
+
+#include	"utils.h"
+
+#define	SAMPLE_RATE			44100
+#define	DATA_LENGTH			(20 * SAMPLE_RATE)
+#define	SEEK_SPACING		(SAMPLE_RATE / 2)
+#define	SEEK_POINTS			((DATA_LENGTH + SEEK_SPACING - 1) / SEEK_SPACING)
+
+/* Big enough that reads of THREADS_READ frames are done in parallel. */
+#define	THREADS_FRAMES		(1 << 20)
+#define	THREADS_CHANNELS	2
+#define	THREADS_READ		(300 * 1000)
+
+/* Sizes from the FLAC format specification. */
+#define	FLAC_BLOCK_HEADER_LEN	4
+#define	FLAC_SEEK_POINT_LEN		18
+#define	FLAC_TYPE_SEEKTABLE		3
+
+static short data_out [DATA_LENGTH] ;
+static short data_in [DATA_LENGTH] ;
+
+static void
+gen_test_data (void)
+{	unsigned k ;
+
+	/* Not too compressible, so the file has plenty of frames of differing sizes. */
+	for (k = 0 ; k < ARRAY_LEN (data_out) ; k++)
+		data_out [k] = (short) ((k * 37) ^ (k >> 3)) ;
+} /* gen_test_data */
+
+static unsigned
+read_be (const unsigned char *ptr, int bytes)
+{	unsigned value = 0 ;
+
+	while (bytes-- > 0)
+		value = (value << 8) + *ptr++ ;
+
+	return value ;
+} /* read_be */
+
+static sf_count_t
+read_be64 (const unsigned char *ptr)
+{	return (((sf_count_t) read_be (ptr, 4)) << 32) + read_be (ptr + 4, 4) ;
+} /* read_be64 */
+
+static void
+check_seek_table_or_die (const char *filename)
+{	unsigned char *buffer ;
+	sf_count_t sample, previous_sample = -1, offset, previous_offset = -1 ;
+	long length, indx = 4, table = -1, audio ;
+	unsigned k, block_len, points = 0, frame_samples ;
+	FILE *file ;
+
+	if ((file = fopen (filename, "rb")) == NULL)
+	{	printf ("\n\nLine %d : fopen (%s) failed.\n", __LINE__, filename) ;
+		exit (1) ;
+		} ;
+
+	fseek (file, 0, SEEK_END) ;
+	length = ftell (file) ;
+	fseek (file, 0, SEEK_SET) ;
+
+	if ((buffer = malloc (length)) == NULL || fread (buffer, 1, length, file) != (size_t) length)
+	{	printf ("\n\nLine %d : reading %s failed.\n", __LINE__, filename) ;
+		exit (1) ;
+		} ;
+	fclose (file) ;
+
+	exit_if_true (memcmp (buffer, "fLaC", 4) != 0, "\n\nLine %d : %s is not a FLAC file.\n", __LINE__, filename) ;
+
+	/* Walk the metadata blocks up to the first frame. */
+	for (;;)
+	{	exit_if_true (indx + FLAC_BLOCK_HEADER_LEN > length, "\n\nLine %d : metadata runs past the end of the file.\n", __LINE__) ;
+		block_len = read_be (buffer + indx + 1, 3) ;
+		if ((buffer [indx] & 0x7F) == FLAC_TYPE_SEEKTABLE)
+		{	table = indx + FLAC_BLOCK_HEADER_LEN ;
+			points = block_len / FLAC_SEEK_POINT_LEN ;
+			} ;
+		indx += FLAC_BLOCK_HEADER_LEN + block_len ;
+		if (buffer [indx - FLAC_BLOCK_HEADER_LEN - block_len] & 0x80)
+			break ;
+		} ;
+	audio = indx ;
+
+	exit_if_true (table < 0, "\n\nLine %d : no SEEKTABLE block.\n", __LINE__) ;
+	exit_if_true (points != SEEK_POINTS, "\n\nLine %d : %u seek points, should be %d.\n", __LINE__, points, SEEK_POINTS) ;
+
+	for (k = 0 ; k < points ; k++)
+	{	/* A placeholder has all bits of the sample number set. */
+		exit_if_true (read_be (buffer + table + k * FLAC_SEEK_POINT_LEN, 4) == 0xFFFFFFFF,
+			"\n\nLine %d : seek point %u is still a placeholder.\n", __LINE__, k) ;
+
+		sample = read_be64 (buffer + table + k * FLAC_SEEK_POINT_LEN) ;
+		offset = read_be64 (buffer + table + k * FLAC_SEEK_POINT_LEN + 8) ;
+		frame_samples = read_be (buffer + table + k * FLAC_SEEK_POINT_LEN + 16, 2) ;
+
+		exit_if_true (sample <= previous_sample || offset <= previous_offset,
+			"\n\nLine %d : seek point %u (%" PRId64 ", %" PRId64 ") does not follow (%" PRId64 ", %" PRId64 ").\n",
+			__LINE__, k, sample, offset, previous_sample, previous_offset) ;
+
+		/* Each point is the frame holding a multiple of the spacing. */
+		exit_if_true (sample > (sf_count_t) k * SEEK_SPACING || sample + frame_samples <= (sf_count_t) k * SEEK_SPACING,
+			"\n\nLine %d : seek point %u (%" PRId64 " + %u) does not hold sample %u.\n", __LINE__, k, sample, frame_samples, k * SEEK_SPACING) ;
+
+		/* The offset must land on a frame sync code. */
+		exit_if_true (audio + offset + 2 > length || buffer [audio + offset] != 0xFF || (buffer [audio + offset + 1] & 0xFE) != 0xF8,
+			"\n\nLine %d : seek point %u offset %" PRId64 " is not the start of a frame.\n", __LINE__, k, offset) ;
+
+		previous_sample = sample ;
+		previous_offset = offset ;
+		} ;
+
+	free (buffer) ;
+} /* check_seek_table_or_die */
+
+static void
+flac_seek_table_test (void)
+{	const char * filename = "flac_seek_table.flac" ;
+	SF_SEEK_TABLE_INFO seek_table ;
+	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	sf_count_t pos ;
+	unsigned k ;
+
+	print_test_name ("flac_seek_table_test", filename) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16 ;
+	sfinfo.channels = 1 ;
+	sfinfo.samplerate = SAMPLE_RATE ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+
+	seek_table.spacing = SEEK_SPACING ;
+	seek_table.frames = DATA_LENGTH ;
+
+	exit_if_true (sf_command (file, SFC_SET_SEEK_TABLE, &seek_table, 0) != SF_FALSE || sf_error (file) == 0,
+		"\n\nLine %d : bad datasize was not rejected with an error.\n", __LINE__) ;
+	exit_if_true (sf_command (file, SFC_SET_SEEK_TABLE, &seek_table, sizeof (seek_table)) != SF_TRUE,
+		"\n\nLine %d : sf_command (SFC_SET_SEEK_TABLE) failed.\n", __LINE__) ;
+
+	test_writef_short_or_die (file, 0, data_out, DATA_LENGTH / 2, __LINE__) ;
+
+	exit_if_true (sf_command (file, SFC_SET_SEEK_TABLE, &seek_table, sizeof (seek_table)) != SF_FALSE || sf_error (file) == 0,
+		"\n\nLine %d : SFC_SET_SEEK_TABLE after writing was not rejected with an error.\n", __LINE__) ;
+
+	test_writef_short_or_die (file, 0, data_out + DATA_LENGTH / 2, DATA_LENGTH - DATA_LENGTH / 2, __LINE__) ;
+	sf_close (file) ;
+
+	check_seek_table_or_die (filename) ;
+
+	/* Seek through the file, around each seek point and in between. */
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+
+	exit_if_true (sfinfo.frames != DATA_LENGTH, "\n\nLine %d : %" PRId64 " frames, should be %d.\n", __LINE__, sfinfo.frames, DATA_LENGTH) ;
+	exit_if_true (sf_command (file, SFC_SET_SEEK_TABLE, &seek_table, sizeof (seek_table)) != SF_FALSE || sf_error (file) == 0,
+		"\n\nLine %d : SFC_SET_SEEK_TABLE in read mode was not rejected with an error.\n", __LINE__) ;
+
+	for (k = 0 ; k < 3 * SEEK_POINTS ; k++)
+	{	/* Backwards and forwards : 0, last, 1, last - 1, ... with an offset into each spacing. */
+		pos = (k / 2) % SEEK_POINTS ;
+		pos = (k & 1) ? (SEEK_POINTS - 1 - pos) * SEEK_SPACING : pos * SEEK_SPACING ;
+		pos += (k * 1237) % SEEK_SPACING ;
+		if (pos + 100 > DATA_LENGTH)
+			pos = DATA_LENGTH - 100 ;
+
+		test_seek_or_die (file, pos, SEEK_SET, pos, sfinfo.channels, __LINE__) ;
+		test_readf_short_or_die (file, k, data_in, 100, __LINE__) ;
+		exit_if_true (memcmp (data_in, data_out + pos, 100 * sizeof (short)) != 0,
+			"\n\nLine %d : data mismatch after seek to %" PRId64 ".\n", __LINE__, pos) ;
+		} ;
+
+	sf_close (file) ;
+	unlink (filename) ;
+
+	puts ("ok") ;
+} /* flac_seek_table_test */
+
+/*
+**	Large reads of a file with SFC_SET_THREADS set are decoded on worker
+**	threads. They have to give exactly what the serial decoder gives, after
+**	seeks to any sample as well as from the start of the file.
+*/
+static void
+flac_threads_test (int threads)
+{	const char * filename = "flac_threads.flac" ;
+	SNDFILE * serial, * threaded ;
+	SF_INFO sfinfo ;
+	short *source ;
+	int *expected, *decoded ;
+	sf_count_t pos, frames ;
+	unsigned k ;
+	char name [64] ;
+
+	snprintf (name, sizeof (name), "flac_threads_test (%d)", threads) ;
+	print_test_name (name, filename) ;
+
+	source = malloc (THREADS_FRAMES * THREADS_CHANNELS * sizeof (short)) ;
+	expected = malloc (THREADS_FRAMES * THREADS_CHANNELS * sizeof (int)) ;
+	decoded = malloc (THREADS_FRAMES * THREADS_CHANNELS * sizeof (int)) ;
+	exit_if_true (source == NULL || expected == NULL || decoded == NULL, "\n\nLine %d : malloc failed.\n", __LINE__) ;
+
+	for (k = 0 ; k < THREADS_FRAMES * THREADS_CHANNELS ; k++)
+		source [k] = (short) ((k * 37) ^ (k >> 3) ^ ((k & 1) << 14)) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16 ;
+	sfinfo.channels = THREADS_CHANNELS ;
+	sfinfo.samplerate = SAMPLE_RATE ;
+
+	serial = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	test_writef_short_or_die (serial, 0, source, THREADS_FRAMES, __LINE__) ;
+	sf_close (serial) ;
+
+	/* The serial decoder is the reference, and it has to be lossless. */
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	serial = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	test_readf_int_or_die (serial, 0, expected, THREADS_FRAMES, __LINE__) ;
+	sf_close (serial) ;
+
+	for (k = 0 ; k < THREADS_FRAMES * THREADS_CHANNELS ; k++)
+		exit_if_true (expected [k] != source [k] * 0x10000,
+			"\n\nLine %d : serial decode differs from the source at %u.\n", __LINE__, k) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	threaded = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	exit_if_true (sf_command (threaded, SFC_SET_THREADS, &threads, sizeof (threads)) != threads,
+		"\n\nLine %d : sf_command (SFC_SET_THREADS, %d) failed.\n", __LINE__, threads) ;
+
+	test_readf_int_or_die (threaded, 0, decoded, THREADS_FRAMES, __LINE__) ;
+	for (k = 0 ; k < THREADS_FRAMES * THREADS_CHANNELS ; k++)
+		exit_if_true (decoded [k] != expected [k],
+			"\n\nLine %d : threaded decode differs at %u (%d should be %d).\n", __LINE__, k, decoded [k], expected [k]) ;
+
+	/* Random seeks, mostly to the middle of a frame, each followed by a read big enough to go parallel. */
+	srand (threads) ;
+	for (k = 0 ; k < 20 ; k++)
+	{	pos = ((sf_count_t) rand () * 4099) % (THREADS_FRAMES - THREADS_READ / 2) ;
+		frames = THREADS_FRAMES - pos < THREADS_READ ? THREADS_FRAMES - pos : THREADS_READ ;
+
+		test_seek_or_die (threaded, pos, SEEK_SET, pos, THREADS_CHANNELS, __LINE__) ;
+		test_readf_int_or_die (threaded, k, decoded, frames, __LINE__) ;
+		exit_if_true (memcmp (decoded, expected + pos * THREADS_CHANNELS, frames * THREADS_CHANNELS * sizeof (int)) != 0,
+			"\n\nLine %d : threaded decode after seek to %" PRId64 " differs.\n", __LINE__, pos) ;
+		} ;
+
+	/* Make sure the reads above really were done on the worker threads. */
+	exit_if_true (string_in_log_buffer (threaded, "decoding large reads on") == 0,
+		"\n\nLine %d : large reads were not decoded on worker threads.\n", __LINE__) ;
+	exit_if_true (string_in_log_buffer (threaded, "carrying on serially") != 0,
+		"\n\nLine %d : a parallel read fell back to the serial decoder.\n", __LINE__) ;
+
+	sf_close (threaded) ;
+	unlink (filename) ;
+
+	free (source) ;
+	free (expected) ;
+	free (decoded) ;
+
+	puts ("ok") ;
+} /* flac_threads_test */
+
+int
+main (void)
+{
+	if (HAVE_EXTERNAL_XIPH_LIBS)
+	{	gen_test_data () ;
+		flac_seek_table_test () ;
+		flac_threads_test (2) ;
+		flac_threads_test (4) ;
+		}
+	else
+		puts ("    No FLAC tests because FLAC support was not compiled in.") ;
+
+	return 0 ;
+} /* main */
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <math.h>
 #include <inttypes.h>
+#include <time.h>
 
 #if HAVE_UNISTD_H
 #include <unistd.h>
@@ -42,6 +43,12 @@ static void	short_lrw_test	(const char *filename, int filetype, const short * ou
 static void	int_lrw_test	(const char *filename, int filetype, const int * output, int out_len) ;
 static void	float_lrw_test	(const char *filename, int filetype, const float * output, int out_len) ;
 static void	double_lrw_test	(const char *filename, int filetype, const double * output, int out_len) ;
+static void	alac_seek_test	(const char *filename, int filetype) ;
+static void	alac_seek_cost_test	(const char *filename, int filetype) ;
+static void	alac_threads_test	(int filetype) ;
+static void	adpcm_threads_test	(const char *filename, int filetype) ;
+
+static unsigned char * threads_test_slurp (const char *filename, long *length) ;
 
 
 static short	short_data [BUFFER_LENGTH] ;
@@ -58,6 +65,7 @@ main (int argc, char *argv [])
 	{	printf ("Usage : %s <test>\n", argv [0]) ;
 		printf ("    Where <test> is one of the following:\n") ;
 		printf ("           alac        - test CAF/ALAC file functions\n") ;
+		printf ("           adpcm       - test threaded IMA and MS ADPCM coding\n") ;
 		printf ("           all         - perform all tests\n") ;
 		exit (1) ;
 		} ;
@@ -77,6 +85,16 @@ main (int argc, char *argv [])
 		int_lrw_test	("alac.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_32, int_data, ARRAY_LEN (int_data)) ;
 		float_lrw_test	("alac.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_32, float_data, ARRAY_LEN (float_data)) ;
 		double_lrw_test	("alac.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_32, double_data, ARRAY_LEN (double_data)) ;
+		alac_seek_test	("alac.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_16) ;
+		alac_seek_cost_test	("alac.caf", SF_FORMAT_CAF | SF_FORMAT_ALAC_16) ;
+		alac_threads_test	(SF_FORMAT_CAF | SF_FORMAT_ALAC_16) ;
+		alac_threads_test	(SF_FORMAT_CAF | SF_FORMAT_ALAC_24) ;
+		} ;
+
+	if (do_all || strcmp (argv [1], "adpcm") == 0)
+	{	adpcm_threads_test	("ima_threads.wav", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM) ;
+		adpcm_threads_test	("ima_threads.aiff", SF_FORMAT_AIFF | SF_FORMAT_IMA_ADPCM) ;
+		adpcm_threads_test	("msadpcm_threads.wav", SF_FORMAT_WAV | SF_FORMAT_MS_ADPCM) ;
 		} ;
 
 	return 0 ;
@@ -270,3 +288,459 @@ double_lrw_test (const char *filename, int filetype, const double * output, int
 	return ;
 } /* double_lrw_test */
 
+/*
+** A few thousand ALAC packets whose sizes all differ, so that a seek which
+** lands on the wrong packet reads the wrong data.
+*/
+#define	SEEK_TEST_FRAMES	(2000 * 4096 + 1234)
+#define	SEEK_TEST_COUNT		2000
+#define	SEEK_TEST_READ		300
+
+static short
+seek_test_value (sf_count_t frame)
+{	return (short) (((frame % 509) - 254) * (1 + (frame / 4096) % 37)) ;
+} /* seek_test_value */
+
+static void
+seek_test_write (const char *filename, int filetype, sf_count_t frames)
+{	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	frame, count ;
+	short		buffer [BUFFER_LENGTH] ;
+	int			k ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= SAMPLE_RATE ;
+	sfinfo.channels		= 1 ;
+	sfinfo.format		= filetype ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_TRUE, __LINE__) ;
+	for (frame = 0 ; frame < frames ; frame += count)
+	{	count = frames - frame < BUFFER_LENGTH ? frames - frame : BUFFER_LENGTH ;
+		for (k = 0 ; k < count ; k++)
+			buffer [k] = seek_test_value (frame + k) ;
+		test_write_short_or_die (file, 0, buffer, count, __LINE__) ;
+		} ;
+	sf_close (file) ;
+} /* seek_test_write */
+
+static void
+alac_seek_test (const char *filename, int filetype)
+{	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	frame, pos ;
+	clock_t		start ;
+	double		elapsed ;
+	short		buffer [BUFFER_LENGTH] ;
+	int			k ;
+
+	print_test_name ("alac_seek_test", filename) ;
+
+	seek_test_write (filename, filetype, SEEK_TEST_FRAMES) ;
+
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_TRUE, __LINE__) ;
+	exit_if_true (sfinfo.frames != SEEK_TEST_FRAMES,
+		"\n\nLine %d: Incorrect number of frames in file (%" PRId64 " should be %d)\n", __LINE__, sfinfo.frames, SEEK_TEST_FRAMES) ;
+
+	srand (0x5eec) ;
+	start = clock () ;
+	for (k = 0 ; k < SEEK_TEST_COUNT ; k++)
+	{	/* Alternate between the far end and the start of the file. */
+		pos = ((sf_count_t) rand () * 4096 + rand () % 4096) % (SEEK_TEST_FRAMES - SEEK_TEST_READ) ;
+		if (k & 1)
+			pos = SEEK_TEST_FRAMES - SEEK_TEST_READ - pos / 1000 ;
+
+		test_seek_or_die (file, pos, SEEK_SET, pos, sfinfo.channels, __LINE__) ;
+		test_readf_short_or_die (file, 0, buffer, SEEK_TEST_READ, __LINE__) ;
+
+		for (frame = 0 ; frame < SEEK_TEST_READ ; frame++)
+			exit_if_true (buffer [frame] != seek_test_value (pos + frame),
+				"\n\nLine %d: Frame %" PRId64 " after seek to %" PRId64 " is %d, should be %d.\n", __LINE__,
+				frame, pos, buffer [frame], seek_test_value (pos + frame)) ;
+		} ;
+	elapsed = ((double) (clock () - start)) / CLOCKS_PER_SEC ;
+
+	sf_close (file) ;
+	unlink (filename) ;
+
+	printf ("ok (%.1f us per seek)\n", 1e6 * elapsed / SEEK_TEST_COUNT) ;
+} /* alac_seek_test */
+
+/*
+** The cost of a seek must not grow with the length of the file. Open files of
+** two lengths through virtual I/O, with the read cache off so that every read
+** and seek reaches the callbacks, and count the calls made by each sf_seek ().
+*/
+#define	SEEK_COST_SHORT		(250 * 4096 + 99)
+#define	SEEK_COST_LONG		(16 * 250 * 4096 + 99)
+#define	SEEK_COST_COUNT		500
+#define	SEEK_COST_MAX		8
+
+typedef struct
+{	const unsigned char *data ;
+	sf_count_t	length, offset ;
+	int			reads, seeks ;
+} SEEK_COST_VIO ;
+
+static sf_count_t
+seek_cost_get_filelen (void *user_data)
+{	SEEK_COST_VIO *vio = user_data ;
+
+	return vio->length ;
+} /* seek_cost_get_filelen */
+
+static sf_count_t
+seek_cost_seek (sf_count_t offset, int whence, void *user_data)
+{	SEEK_COST_VIO *vio = user_data ;
+
+	switch (whence)
+	{	case SEEK_SET :
+			break ;
+		case SEEK_CUR :
+			offset += vio->offset ;
+			break ;
+		case SEEK_END :
+			offset += vio->length ;
+			break ;
+		default :
+			return -1 ;
+		} ;
+
+	vio->seeks ++ ;
+	vio->offset = offset < 0 ? 0 : (offset > vio->length ? vio->length : offset) ;
+
+	return vio->offset ;
+} /* seek_cost_seek */
+
+static sf_count_t
+seek_cost_read (void *ptr, sf_count_t count, void *user_data)
+{	SEEK_COST_VIO *vio = user_data ;
+
+	vio->reads ++ ;
+	if (count > vio->length - vio->offset)
+		count = vio->length - vio->offset ;
+	memcpy (ptr, vio->data + vio->offset, count) ;
+	vio->offset += count ;
+
+	return count ;
+} /* seek_cost_read */
+
+static sf_count_t
+seek_cost_write (const void *ptr, sf_count_t count, void *user_data)
+{	(void) ptr ;
+	(void) count ;
+	(void) user_data ;
+	return 0 ;
+} /* seek_cost_write */
+
+static sf_count_t
+seek_cost_tell (void *user_data)
+{	SEEK_COST_VIO *vio = user_data ;
+
+	return vio->offset ;
+} /* seek_cost_tell */
+
+/* Returns the most read and seek calls made by any one of the seeks. */
+static int
+seek_cost_measure (const char *filename, int filetype, sf_count_t frames)
+{	SF_VIRTUAL_IO	vio = { seek_cost_get_filelen, seek_cost_seek, seek_cost_read, seek_cost_write, seek_cost_tell } ;
+	SEEK_COST_VIO	data ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	pos ;
+	unsigned char *contents ;
+	long		length ;
+	short		value ;
+	int			k, zero = 0, calls, max_calls = 0 ;
+
+	seek_test_write (filename, filetype, frames) ;
+	contents = threads_test_slurp (filename, &length) ;
+
+	memset (&data, 0, sizeof (data)) ;
+	data.data = contents ;
+	data.length = length ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	if ((file = sf_open_virtual (&vio, SFM_READ, &sfinfo, &data)) == NULL)
+	{	printf ("\n\nLine %d: sf_open_virtual failed : %s\n", __LINE__, sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+	exit_if_true (sfinfo.frames != frames,
+		"\n\nLine %d: Incorrect number of frames in file (%" PRId64 " should be %" PRId64 ")\n", __LINE__, sfinfo.frames, frames) ;
+	sf_command (file, SFC_SET_VIRTUAL_IO_BLOCK_SIZE, &zero, sizeof (zero)) ;
+
+	srand (0xc057) ;
+	for (k = 0 ; k < SEEK_COST_COUNT ; k++)
+	{	/* Seek anywhere, but often near the end where summing sizes costs most. */
+		pos = ((sf_count_t) rand () * 4096 + rand () % 4096) % frames ;
+		if (k & 1)
+			pos = frames - 1 - pos / 1000 ;
+
+		data.reads = data.seeks = 0 ;
+		test_seek_or_die (file, pos, SEEK_SET, pos, sfinfo.channels, __LINE__) ;
+		calls = data.reads + data.seeks ;
+		if (calls > max_calls)
+			max_calls = calls ;
+
+		test_readf_short_or_die (file, 0, &value, 1, __LINE__) ;
+		exit_if_true (value != seek_test_value (pos),
+			"\n\nLine %d: Frame %" PRId64 " is %d, should be %d.\n", __LINE__, pos, value, seek_test_value (pos)) ;
+		} ;
+
+	sf_close (file) ;
+	free (contents) ;
+
+	return max_calls ;
+} /* seek_cost_measure */
+
+static void
+alac_seek_cost_test (const char *filename, int filetype)
+{	int short_calls, long_calls ;
+
+	print_test_name ("alac_seek_cost_test", filename) ;
+
+	short_calls = seek_cost_measure (filename, filetype, SEEK_COST_SHORT) ;
+	long_calls = seek_cost_measure (filename, filetype, SEEK_COST_LONG) ;
+
+	exit_if_true (short_calls > SEEK_COST_MAX || long_calls > SEEK_COST_MAX,
+		"\n\nLine %d: A seek made up to %d I/O calls on a short file and %d on a long one (limit %d).\n", __LINE__,
+		short_calls, long_calls, SEEK_COST_MAX) ;
+	exit_if_true (long_calls > short_calls,
+		"\n\nLine %d: Seeks in a file 16 times longer made up to %d I/O calls rather than %d.\n", __LINE__,
+		long_calls, short_calls) ;
+
+	printf ("ok (at most %d I/O calls per seek)\n", long_calls) ;
+} /* alac_seek_cost_test */
+
+/*
+** Files written with different numbers of encoder threads must be identical
+** and decode to the original data. They are not byte for byte the same as the
+** serial encoder's file, but must decode to exactly the same samples.
+*/
+#define	THREADS_TEST_FRAMES		(50 * 4096 + 777)
+#define	THREADS_TEST_CHANNELS	3
+
+static int
+threads_test_value (sf_count_t frame, int channel)
+{	return (int) ((((frame * (channel + 3)) % 1021) - 510) * (1 + (frame / 4096) % 23)) << 16 ;
+} /* threads_test_value */
+
+/* Read the whole file into memory and delete it. */
+static unsigned char *
+threads_test_slurp (const char *filename, long *length)
+{	FILE		*fp ;
+	unsigned char *data ;
+
+	if ((fp = fopen (filename, "rb")) == NULL)
+	{	printf ("\n\nLine %d: fopen ('%s') failed.\n", __LINE__, filename) ;
+		exit (1) ;
+		} ;
+	fseek (fp, 0, SEEK_END) ;
+	*length = ftell (fp) ;
+	fseek (fp, 0, SEEK_SET) ;
+
+	if ((data = malloc (*length)) == NULL || fread (data, 1, *length, fp) != (size_t) *length)
+	{	printf ("\n\nLine %d: reading '%s' failed.\n", __LINE__, filename) ;
+		exit (1) ;
+		} ;
+	fclose (fp) ;
+	unlink (filename) ;
+
+	return data ;
+} /* threads_test_slurp */
+
+static unsigned char *
+threads_test_write (const char *filename, int filetype, int threads, int *decoded, long *length)
+{	static int	buffer [BUFFER_LENGTH * THREADS_TEST_CHANNELS] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	frame, count ;
+	int			k, ch ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= SAMPLE_RATE ;
+	sfinfo.channels		= THREADS_TEST_CHANNELS ;
+	sfinfo.format		= filetype ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_TRUE, __LINE__) ;
+	exit_if_true (sf_command (file, SFC_SET_THREADS, &threads, sizeof (threads)) != threads,
+		"\n\nLine %d: sf_command (SFC_SET_THREADS, %d) failed.\n", __LINE__, threads) ;
+
+	/* Odd sized writes so that blocks are split across calls. */
+	for (frame = 0 ; frame < THREADS_TEST_FRAMES ; frame += count)
+	{	count = THREADS_TEST_FRAMES - frame < 3001 ? THREADS_TEST_FRAMES - frame : 3001 ;
+		for (k = 0 ; k < count ; k++)
+			for (ch = 0 ; ch < THREADS_TEST_CHANNELS ; ch++)
+				buffer [k * THREADS_TEST_CHANNELS + ch] = threads_test_value (frame + k, ch) ;
+		test_writef_int_or_die (file, 0, buffer, count, __LINE__) ;
+		} ;
+
+	/* Too late to change now. */
+	exit_if_true (sf_command (file, SFC_SET_THREADS, &threads, sizeof (threads)) != SF_FALSE,
+		"\n\nLine %d: SFC_SET_THREADS should fail after writing.\n", __LINE__) ;
+	sf_close (file) ;
+
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_TRUE, __LINE__) ;
+	exit_if_true (sfinfo.frames != THREADS_TEST_FRAMES,
+		"\n\nLine %d: Incorrect number of frames in file (%" PRId64 " should be %d)\n", __LINE__, sfinfo.frames, THREADS_TEST_FRAMES) ;
+	test_readf_int_or_die (file, 0, decoded, THREADS_TEST_FRAMES, __LINE__) ;
+	for (frame = 0 ; frame < THREADS_TEST_FRAMES ; frame++)
+		for (ch = 0 ; ch < THREADS_TEST_CHANNELS ; ch++)
+			exit_if_true ((decoded [frame * THREADS_TEST_CHANNELS + ch] ^ threads_test_value (frame, ch)) & 0xFFFFFF00,
+				"\n\nLine %d: Frame %" PRId64 " channel %d is %d, should be %d (%d threads).\n", __LINE__,
+				frame, ch, decoded [frame * THREADS_TEST_CHANNELS + ch], threads_test_value (frame, ch), threads) ;
+	sf_close (file) ;
+
+	return threads_test_slurp (filename, length) ;
+} /* threads_test_write */
+
+static void
+alac_threads_test (int filetype)
+{	static const int threads [] = { 2, 3, 8 } ;
+	const char	*filename = "alac_threads.caf" ;
+	unsigned char *first = NULL, *data ;
+	int			*serial, *threaded ;
+	long		first_length, length ;
+	unsigned	k ;
+
+	print_test_name ("alac_threads_test", filename) ;
+
+	serial = malloc (THREADS_TEST_FRAMES * THREADS_TEST_CHANNELS * sizeof (int)) ;
+	threaded = malloc (THREADS_TEST_FRAMES * THREADS_TEST_CHANNELS * sizeof (int)) ;
+	exit_if_true (serial == NULL || threaded == NULL, "\n\nLine %d: malloc failed.\n", __LINE__) ;
+
+	/* The serial encoder's file differs, but must decode to the same samples. */
+	free (threads_test_write (filename, filetype, 1, serial, &length)) ;
+
+	for (k = 0 ; k < ARRAY_LEN (threads) ; k++)
+	{	data = threads_test_write (filename, filetype, threads [k], threaded, &length) ;
+		exit_if_true (memcmp (threaded, serial, THREADS_TEST_FRAMES * THREADS_TEST_CHANNELS * sizeof (int)) != 0,
+			"\n\nLine %d: File written with %d threads decodes differently to the serial one.\n", __LINE__, threads [k]) ;
+
+		if (k == 0)
+		{	first = data ;
+			first_length = length ;
+			continue ;
+			} ;
+
+		exit_if_true (length != first_length || memcmp (data, first, length) != 0,
+			"\n\nLine %d: File written with %d threads differs from the one written with %d.\n", __LINE__, threads [k], threads [0]) ;
+		free (data) ;
+		} ;
+	free (first) ;
+	free (serial) ;
+	free (threaded) ;
+
+	puts ("ok") ;
+} /* alac_threads_test */
+
+/*
+** Threaded ADPCM reads must match serial ones exactly. MS ADPCM files written
+** with threads must match the serial file, IMA ADPCM ones must match each other.
+*/
+#define	ADPCM_TEST_CHANNELS		2
+
+static short
+adpcm_test_value (sf_count_t frame, int channel)
+{	return (short) lrint ((4000 + 3000 * sin (0.0003 * frame)) * sin (0.01 * (channel + 1) * frame)) ;
+} /* adpcm_test_value */
+
+static void
+adpcm_test_write (const char *filename, int filetype, int threads)
+{	static short buffer [BUFFER_LENGTH * ADPCM_TEST_CHANNELS] ;
+	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	frame, count ;
+	int			k, ch ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.samplerate	= SAMPLE_RATE ;
+	sfinfo.channels		= ADPCM_TEST_CHANNELS ;
+	sfinfo.format		= filetype ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_TRUE, __LINE__) ;
+	sf_command (file, SFC_SET_THREADS, &threads, sizeof (threads)) ;
+
+	for (frame = 0 ; frame < THREADS_TEST_FRAMES ; frame += count)
+	{	count = THREADS_TEST_FRAMES - frame < 3001 ? THREADS_TEST_FRAMES - frame : 3001 ;
+		for (k = 0 ; k < count ; k++)
+			for (ch = 0 ; ch < ADPCM_TEST_CHANNELS ; ch++)
+				buffer [k * ADPCM_TEST_CHANNELS + ch] = adpcm_test_value (frame + k, ch) ;
+		test_writef_short_or_die (file, 0, buffer, count, __LINE__) ;
+		} ;
+
+	sf_close (file) ;
+} /* adpcm_test_write */
+
+static void
+adpcm_test_read (const char *filename, int threads, sf_count_t seek, short *data, sf_count_t *frames)
+{	SNDFILE		*file ;
+	SF_INFO		sfinfo ;
+	sf_count_t	count ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_TRUE, __LINE__) ;
+	sf_command (file, SFC_SET_THREADS, &threads, sizeof (threads)) ;
+
+	if (seek > 0)
+		test_seek_or_die (file, seek, SEEK_SET, seek, ADPCM_TEST_CHANNELS, __LINE__) ;
+
+	*frames = 0 ;
+	while ((count = sf_readf_short (file, data + *frames * ADPCM_TEST_CHANNELS, 3001)) > 0)
+		*frames += count ;
+
+	sf_close (file) ;
+} /* adpcm_test_read */
+
+static void
+adpcm_threads_test (const char *filename, int filetype)
+{	static const int threads [] = { 2, 3 } ;
+	static short serial [(THREADS_TEST_FRAMES + 4096) * ADPCM_TEST_CHANNELS] ;
+	static short threaded [(THREADS_TEST_FRAMES + 4096) * ADPCM_TEST_CHANNELS] ;
+	unsigned char *first, *data ;
+	sf_count_t	serial_frames, threaded_frames, seek ;
+	long		first_length, length ;
+	int			k ;
+
+	print_test_name ("adpcm_threads_test", filename) ;
+
+	adpcm_test_write (filename, filetype, 1) ;
+
+	for (seek = 0 ; seek < THREADS_TEST_FRAMES ; seek += THREADS_TEST_FRAMES / 3)
+	{	adpcm_test_read (filename, 1, seek, serial, &serial_frames) ;
+		adpcm_test_read (filename, threads [1], seek, threaded, &threaded_frames) ;
+		exit_if_true (serial_frames != threaded_frames
+				|| memcmp (serial, threaded, serial_frames * ADPCM_TEST_CHANNELS * sizeof (short)) != 0,
+			"\n\nLine %d: Threaded read from frame %" PRId64 " differs from serial read.\n", __LINE__, seek) ;
+		} ;
+
+	/* The reference file is the serial one for MS ADPCM, the first threaded one for IMA. */
+	if ((filetype & SF_FORMAT_SUBMASK) == SF_FORMAT_MS_ADPCM)
+		first = threads_test_slurp (filename, &first_length) ;
+	else
+	{	unlink (filename) ;
+		adpcm_test_write (filename, filetype, threads [0]) ;
+		first = threads_test_slurp (filename, &first_length) ;
+		} ;
+
+	for (k = 0 ; k < (int) ARRAY_LEN (threads) ; k++)
+	{	adpcm_test_write (filename, filetype, threads [k]) ;
+
+		/* Lossy, so only check that the threaded file decodes to something close. */
+		adpcm_test_read (filename, 1, 0, threaded, &threaded_frames) ;
+		exit_if_true (threaded_frames < THREADS_TEST_FRAMES,
+			"\n\nLine %d: Only %" PRId64 " frames in file written with %d threads.\n", __LINE__, threaded_frames, threads [k]) ;
+		for (seek = 0 ; seek < THREADS_TEST_FRAMES * ADPCM_TEST_CHANNELS ; seek++)
+			exit_if_true (abs (threaded [seek] - adpcm_test_value (seek / ADPCM_TEST_CHANNELS, seek % ADPCM_TEST_CHANNELS)) > 2000,
+				"\n\nLine %d: Sample %" PRId64 " is %d, should be close to %d (%d threads).\n", __LINE__, seek,
+				threaded [seek], adpcm_test_value (seek / ADPCM_TEST_CHANNELS, seek % ADPCM_TEST_CHANNELS), threads [k]) ;
+
+		data = threads_test_slurp (filename, &length) ;
+		exit_if_true (length != first_length || memcmp (data, first, length) != 0,
+			"\n\nLine %d: File written with %d threads differs from the reference file.\n", __LINE__, threads [k]) ;
+		free (data) ;
+		} ;
+	free (first) ;
+
+	puts ("ok") ;
+} /* adpcm_threads_test */
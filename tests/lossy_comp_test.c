@@ -1555,7 +1555,7 @@ channels = 1 ;
 		{	test_readf_short_or_die (file, m, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_short (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (short)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (short)) ;
 			smoothed_diff_short (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -1777,7 +1777,7 @@ channels = 1 ;
 		{	test_readf_int_or_die (file, m, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_int (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (int)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (int)) ;
 			smoothed_diff_int (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -2022,7 +2022,7 @@ channels = 1 ;
 		{	test_read_float_or_die (file, 0, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_float (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (float)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (float)) ;
 			smoothed_diff_float (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -2263,7 +2263,7 @@ channels = 1 ;
 		{	test_read_double_or_die (file, m, data, datalen / 7, __LINE__) ;
 
 			smoothed_diff_double (data, datalen / 7) ;
-			memcpy (smooth, orig + m * datalen / 7, datalen / 7 * sizeof (double)) ;
+			memcpy (smooth, orig + m * (datalen / 7), datalen / 7 * sizeof (double)) ;
 			smoothed_diff_double (smooth, datalen / 7) ;
 
 			for (k = 0 ; k < datalen / 7 ; k++)
@@ -36,6 +36,10 @@
 #define	SAMPLE_RATE			48000
 #define	DATA_LENGTH			(SAMPLE_RATE / 8)
 
+#define	INDEX_SEEK_FRAMES	(60 * SAMPLE_RATE)
+#define	INDEX_SEEK_READ		1000
+#define	INDEX_SEEK_COUNT	50
+
 typedef union
 {	double d [DATA_LENGTH] ;
 	float f [DATA_LENGTH] ;
@@ -404,6 +408,111 @@ ogg_opus_original_samplerate_test (void)
 	unlink (filename) ;
 } /* ogg_opus_original_samplerate_test */
 
+static double
+abs_diff_sum (const float *a, const float *b, int count)
+{	double sum = 0.0 ;
+	int k ;
+
+	for (k = 0 ; k < count ; k++)
+		sum += fabs (a [k] - b [k]) ;
+
+	return sum ;
+} /* abs_diff_sum */
+
+/*
+**	After a seek the decoder only converges on what a linear read gives, so
+**	check that the audio is close and lines up better than one frame either
+**	side.
+*/
+static void
+check_aligned_or_die (const float *data, const float *linear, sf_count_t pos, int line_num)
+{	double diff ;
+	int k ;
+
+	for (k = 0 ; k < INDEX_SEEK_READ ; k++)
+		if (fabs (data [k] - linear [pos + k]) > 0.1)
+		{	printf ("\n\nLine %d : seek to %" PRId64 " is out by %f at %d.\n", line_num, pos, data [k] - linear [pos + k], k) ;
+			exit (1) ;
+			} ;
+
+	diff = abs_diff_sum (data, linear + pos, INDEX_SEEK_READ) ;
+	if ((pos > 0 && abs_diff_sum (data, linear + pos - 1, INDEX_SEEK_READ) <= diff)
+			|| abs_diff_sum (data, linear + pos + 1, INDEX_SEEK_READ) <= diff)
+	{	printf ("\n\nLine %d : seek to %" PRId64 " is not at the right frame.\n", line_num, pos) ;
+		exit (1) ;
+		} ;
+} /* check_aligned_or_die */
+
+/*
+**	Seek around a long file, first with the page index filling up as it
+**	goes and then with it built in advance, and check that every seek
+**	lands where a linear read of the file says it should.
+*/
+static void
+ogg_opus_index_seek_test (const char * filename, int format)
+{	static float data [INDEX_SEEK_READ] ;
+	float *linear ;
+
+	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	sf_count_t pos ;
+	unsigned k, m ;
+	int build ;
+
+	print_test_name (__func__, filename) ;
+
+	if ((linear = malloc (INDEX_SEEK_FRAMES * sizeof (float))) == NULL)
+	{	printf ("\n\nLine %d : malloc failed.\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	/* A tone that keeps changing, so that every part of the file is different. */
+	for (k = 0 ; k < INDEX_SEEK_FRAMES ; k++)
+		linear [k] = (float) (0.5 * sin (2.0 * M_PI * (200.0 + k / 2000.0) * k / SAMPLE_RATE)) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = format ;
+	sfinfo.channels = 1 ;
+	sfinfo.samplerate = SAMPLE_RATE ;
+
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	for (k = 0 ; k < INDEX_SEEK_FRAMES ; k += SAMPLE_RATE)
+		test_writef_float_or_die (file, k, linear + k, SAMPLE_RATE, __LINE__) ;
+	sf_close (file) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	exit_if_true (sfinfo.frames != INDEX_SEEK_FRAMES, "\n\nLine %d : %" PRId64 " frames, should be %d.\n", __LINE__, sfinfo.frames, INDEX_SEEK_FRAMES) ;
+	test_readf_float_or_die (file, 0, linear, INDEX_SEEK_FRAMES, __LINE__) ;
+	sf_close (file) ;
+
+	for (build = 0 ; build < 2 ; build++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+
+		if (build)
+			exit_if_true (sf_command (file, SFC_BUILD_SEEK_INDEX, NULL, 0) != SF_TRUE,
+				"\n\nLine %d : sf_command (SFC_BUILD_SEEK_INDEX) failed.\n", __LINE__) ;
+
+		/* Each position twice, so the second time round its pages are in the index. */
+		for (m = 0 ; m < 2 * INDEX_SEEK_COUNT ; m++)
+		{	k = m < INDEX_SEEK_COUNT ? m : 2 * INDEX_SEEK_COUNT - 1 - m ;
+			pos = ((sf_count_t) k * 104729) % (INDEX_SEEK_FRAMES - INDEX_SEEK_READ) ;
+
+			test_seek_or_die (file, pos, SEEK_SET, pos, sfinfo.channels, __LINE__) ;
+			test_readf_float_or_die (file, m, data, INDEX_SEEK_READ, __LINE__) ;
+			check_aligned_or_die (data, linear, pos, __LINE__) ;
+			} ;
+
+		sf_close (file) ;
+		} ;
+
+	free (linear) ;
+
+	puts ("ok") ;
+	unlink (filename) ;
+} /* ogg_opus_index_seek_test */
+
 
 int
 main (void)
@@ -415,6 +524,7 @@ main (void)
 		ogg_opus_double_test () ;
 
 		ogg_opus_stereo_seek_test ("ogg_opus_seek.opus", SF_FORMAT_OGG | SF_FORMAT_OPUS) ;
+		ogg_opus_index_seek_test ("ogg_opus_index_seek.opus", SF_FORMAT_OGG | SF_FORMAT_OPUS) ;
 		ogg_opus_original_samplerate_test () ;
 		}
 	else
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #else
@@ -36,6 +37,10 @@
 #define	SAMPLE_RATE			44100
 #define	DATA_LENGTH			(SAMPLE_RATE / 8)
 
+#define	INDEX_SEEK_FRAMES	(60 * SAMPLE_RATE)
+#define	INDEX_SEEK_READ		1000
+#define	INDEX_SEEK_COUNT	50
+
 typedef union
 {	double d [DATA_LENGTH] ;
 	float f [DATA_LENGTH] ;
@@ -328,6 +333,76 @@ ogg_stereo_seek_test (const char * filename, int format)
 	unlink (filename) ;
 } /* ogg_stereo_seek_test */
 
+/*
+**	Seek around a long file, first with the page index filling up as it
+**	goes and then with it built in advance, and check that every seek
+**	gives exactly what a linear read of the file gives.
+*/
+static void
+ogg_index_seek_test (const char * filename, int format)
+{	static float data [INDEX_SEEK_READ] ;
+	float *linear ;
+
+	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	sf_count_t pos ;
+	unsigned k, m ;
+	int build ;
+
+	print_test_name (__func__, filename) ;
+
+	if ((linear = malloc (INDEX_SEEK_FRAMES * sizeof (float))) == NULL)
+	{	printf ("\n\nLine %d : malloc failed.\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	/* A tone that keeps changing, so that every part of the file is different. */
+	for (k = 0 ; k < INDEX_SEEK_FRAMES ; k++)
+		linear [k] = (float) (0.5 * sin (2.0 * M_PI * (200.0 + k / 2000.0) * k / SAMPLE_RATE)) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = format ;
+	sfinfo.channels = 1 ;
+	sfinfo.samplerate = SAMPLE_RATE ;
+
+	/* In blocks, libvorbis puts the analysis buffer on the stack. */
+	file = test_open_file_or_die (filename, SFM_WRITE, &sfinfo, SF_FALSE, __LINE__) ;
+	for (k = 0 ; k < INDEX_SEEK_FRAMES ; k += SAMPLE_RATE)
+		test_writef_float_or_die (file, k, linear + k, SAMPLE_RATE, __LINE__) ;
+	sf_close (file) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+	exit_if_true (sfinfo.frames != INDEX_SEEK_FRAMES, "\n\nLine %d : %" PRId64 " frames, should be %d.\n", __LINE__, sfinfo.frames, INDEX_SEEK_FRAMES) ;
+	test_readf_float_or_die (file, 0, linear, INDEX_SEEK_FRAMES, __LINE__) ;
+	sf_close (file) ;
+
+	for (build = 0 ; build < 2 ; build++)
+	{	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+		file = test_open_file_or_die (filename, SFM_READ, &sfinfo, SF_FALSE, __LINE__) ;
+
+		if (build)
+			exit_if_true (sf_command (file, SFC_BUILD_SEEK_INDEX, NULL, 0) != SF_TRUE,
+				"\n\nLine %d : sf_command (SFC_BUILD_SEEK_INDEX) failed.\n", __LINE__) ;
+
+		/* Each position twice, so the second time round its pages are in the index. */
+		for (m = 0 ; m < 2 * INDEX_SEEK_COUNT ; m++)
+		{	k = m < INDEX_SEEK_COUNT ? m : 2 * INDEX_SEEK_COUNT - 1 - m ;
+			pos = ((sf_count_t) k * 104729) % (INDEX_SEEK_FRAMES - INDEX_SEEK_READ) ;
+
+			test_seek_or_die (file, pos, SEEK_SET, pos, sfinfo.channels, __LINE__) ;
+			test_readf_float_or_die (file, m, data, INDEX_SEEK_READ, __LINE__) ;
+			compare_float_or_die (data, linear + pos, INDEX_SEEK_READ, __LINE__) ;
+			} ;
+
+		sf_close (file) ;
+		} ;
+
+	free (linear) ;
+
+	puts ("ok") ;
+	unlink (filename) ;
+} /* ogg_index_seek_test */
 
 int
 main (void)
@@ -340,6 +415,7 @@ main (void)
 
 		/*-ogg_stereo_seek_test ("pcm.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;-*/
 		ogg_stereo_seek_test ("vorbis_seek.ogg", SF_FORMAT_OGG | SF_FORMAT_VORBIS) ;
+		ogg_index_seek_test ("vorbis_index_seek.ogg", SF_FORMAT_OGG | SF_FORMAT_VORBIS) ;
 		}
 	else
 		puts ("    No Ogg/Vorbis tests because Ogg/Vorbis support was not compiled in.") ;
@@ -26,12 +26,16 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <inttypes.h>
 
 #include <sndfile.h>
 
 #include "utils.h"
 
 static void vio_test (const char *fname, int format) ;
+static void vio_cache_test (const char *fname, int format) ;
+static void memory_io_test (const char *fname, int format) ;
+static void memory_io_error_test (void) ;
 
 int
 main (void)
@@ -41,6 +45,15 @@ main (void)
 	vio_test ("vio_float.au", SF_FORMAT_AU | SF_FORMAT_FLOAT) ;
 	vio_test ("vio_pcm24.paf", SF_FORMAT_PAF | SF_FORMAT_PCM_24) ;
 
+	vio_cache_test ("vio_cache.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;
+	vio_cache_test ("vio_cache.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_16) ;
+
+	memory_io_test ("mem_pcm16.wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16) ;
+	memory_io_test ("mem_pcm24.aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_24) ;
+	memory_io_test ("mem_float.au", SF_FORMAT_AU | SF_FORMAT_FLOAT) ;
+	memory_io_test ("mem_pcm24.paf", SF_FORMAT_PAF | SF_FORMAT_PCM_24) ;
+	memory_io_error_test () ;
+
 	return 0 ;
 } /* main */
 
@@ -49,6 +62,7 @@ main (void)
 
 typedef struct
 {	sf_count_t offset, length ;
+	int calls ;
 	unsigned char data [16 * 1024] ;
 } VIO_DATA ;
 
@@ -63,6 +77,8 @@ static sf_count_t
 vfseek (sf_count_t offset, int whence, void *user_data)
 {	VIO_DATA *vf = (VIO_DATA *) user_data ;
 
+	vf->calls ++ ;
+
 	switch (whence)
 	{	case SEEK_SET :
 			vf->offset = offset ;
@@ -86,6 +102,8 @@ static sf_count_t
 vfread (void *ptr, sf_count_t count, void *user_data)
 {	VIO_DATA *vf = (VIO_DATA *) user_data ;
 
+	vf->calls ++ ;
+
 	/*
 	**	This will break badly for files over 2Gig in length, but
 	**	is sufficient for testing.
@@ -103,6 +121,8 @@ static sf_count_t
 vfwrite (const void *ptr, sf_count_t count, void *user_data)
 {	VIO_DATA *vf = (VIO_DATA *) user_data ;
 
+	vf->calls ++ ;
+
 	/*
 	**	This will break badly for files over 2Gig in length, but
 	**	is sufficient for testing.
@@ -126,6 +146,8 @@ static sf_count_t
 vftell (void *user_data)
 {	VIO_DATA *vf = (VIO_DATA *) user_data ;
 
+	vf->calls ++ ;
+
 	return vf->offset ;
 } /* vftell */
 
@@ -235,3 +257,213 @@ vio_test (const char *fname, int format)
 	puts ("ok") ;
 } /* vio_test */
 
+
+/*------------------------------------------------------------------------------
+*/
+
+static int
+vio_cache_read_test (VIO_DATA *vio_data, int block_size)
+{	static short data [64] ;
+
+	SF_VIRTUAL_IO vio ;
+	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	int k ;
+
+	vio.get_filelen = vfget_filelen ;
+	vio.seek = vfseek ;
+	vio.read = vfread ;
+	vio.write = vfwrite ;
+	vio.tell = vftell ;
+
+	vio_data->offset = 0 ;
+	vio_data->calls = 0 ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+
+	if ((file = sf_open_virtual (&vio, SFM_READ, &sfinfo, vio_data)) == NULL)
+	{	printf ("\n\nLine %d : sf_open_virtual failed with error : ", __LINE__) ;
+		fflush (stdout) ;
+		puts (sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	if (sf_command (file, SFC_SET_VIRTUAL_IO_BLOCK_SIZE, &block_size, sizeof (block_size)) != (block_size > 0))
+	{	printf ("\n\nLine %d : SFC_SET_VIRTUAL_IO_BLOCK_SIZE failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	/* Small reads with a seek backwards after each one. */
+	for (k = 0 ; k < 12 ; k++)
+	{	sf_read_short (file, data, ARRAY_LEN (data)) ;
+		check_short_data (data, ARRAY_LEN (data), k * ARRAY_LEN (data) / 2, __LINE__) ;
+
+		if (sf_seek (file, - (sf_count_t) ARRAY_LEN (data) / 4, SEEK_CUR) < 0)
+		{	printf ("\n\nLine %d : sf_seek failed.\n\n", __LINE__) ;
+			exit (1) ;
+			} ;
+		} ;
+
+	sf_close (file) ;
+
+	return vio_data->calls ;
+} /* vio_cache_read_test */
+
+static void
+vio_cache_test (const char *fname, int format)
+{	static VIO_DATA vio_data ;
+	static short data [1024] ;
+
+	SF_VIRTUAL_IO vio ;
+	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	int cached, uncached ;
+
+	print_test_name ("virtual i/o cache test", fname) ;
+
+	vio.get_filelen = vfget_filelen ;
+	vio.seek = vfseek ;
+	vio.read = vfread ;
+	vio.write = vfwrite ;
+	vio.tell = vftell ;
+
+	vio_data.offset = 0 ;
+	vio_data.length = 0 ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = format ;
+	sfinfo.channels = 2 ;
+	sfinfo.samplerate = 44100 ;
+
+	if ((file = sf_open_virtual (&vio, SFM_WRITE, &sfinfo, &vio_data)) == NULL)
+	{	printf ("\n\nLine %d : sf_open_virtual failed with error : ", __LINE__) ;
+		fflush (stdout) ;
+		puts (sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	gen_short_data (data, ARRAY_LEN (data), 0) ;
+	sf_write_short (file, data, ARRAY_LEN (data)) ;
+	sf_close (file) ;
+
+	cached = vio_cache_read_test (&vio_data, 4096) ;
+	uncached = vio_cache_read_test (&vio_data, 0) ;
+
+	if (cached >= uncached / 2)
+	{	printf ("\n\nLine %d : %d callbacks with cache, %d without.\n\n", __LINE__, cached, uncached) ;
+		exit (1) ;
+		} ;
+
+	puts ("ok") ;
+} /* vio_cache_test */
+
+/*------------------------------------------------------------------------------
+*/
+
+static void
+memory_io_test (const char *fname, int format)
+{	static short data [256] ;
+
+	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	void *mem = NULL ;
+	sf_count_t memlen = 0 ;
+
+	print_test_name ("memory i/o test", fname) ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+	sfinfo.format = format ;
+	sfinfo.channels = 2 ;
+	sfinfo.samplerate = 44100 ;
+
+	if ((file = sf_open_memory_write (&mem, &memlen, &sfinfo)) == NULL)
+	{	printf ("\n\nLine %d : sf_open_memory_write failed with error : ", __LINE__) ;
+		fflush (stdout) ;
+		puts (sf_strerror (NULL)) ;
+		exit (1) ;
+		} ;
+
+	gen_short_data (data, ARRAY_LEN (data), 0) ;
+	sf_write_short (file, data, ARRAY_LEN (data)) ;
+
+	gen_short_data (data, ARRAY_LEN (data), 1) ;
+	sf_write_short (file, data, ARRAY_LEN (data)) ;
+
+	gen_short_data (data, ARRAY_LEN (data), 2) ;
+	sf_write_short (file, data, ARRAY_LEN (data)) ;
+
+	sf_close (file) ;
+
+	if (mem == NULL || memlen <= 3 * SIGNED_SIZEOF (data) / 2)
+	{	printf ("\n\nLine %d : bad memory buffer (%p, %" PRId64 ").\n\n", __LINE__, mem, memlen) ;
+		exit (1) ;
+		} ;
+
+	/* Now test read, including a seek back to the start. */
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+
+	if ((file = sf_open_memory (mem, memlen, &sfinfo)) == NULL)
+	{	printf ("\n\nLine %d : sf_open_memory failed with error : ", __LINE__) ;
+		fflush (stdout) ;
+		puts (sf_strerror (NULL)) ;
+
+		dump_data_to_file (fname, mem, (unsigned int) memlen) ;
+		exit (1) ;
+		} ;
+
+	sf_read_short (file, data, ARRAY_LEN (data)) ;
+	check_short_data (data, ARRAY_LEN (data), 0, __LINE__) ;
+
+	sf_read_short (file, data, ARRAY_LEN (data)) ;
+	check_short_data (data, ARRAY_LEN (data), 1, __LINE__) ;
+
+	sf_read_short (file, data, ARRAY_LEN (data)) ;
+	check_short_data (data, ARRAY_LEN (data), 2, __LINE__) ;
+
+	if (sf_seek (file, ARRAY_LEN (data) / 2, SEEK_SET) != ARRAY_LEN (data) / 2)
+	{	printf ("\n\nLine %d : sf_seek failed.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	sf_read_short (file, data, ARRAY_LEN (data)) ;
+	check_short_data (data, ARRAY_LEN (data), 1, __LINE__) ;
+
+	sf_close (file) ;
+	sf_memory_free (mem) ;
+
+	puts ("ok") ;
+} /* memory_io_test */
+
+static void
+memory_io_error_test (void)
+{	SNDFILE * file ;
+	SF_INFO sfinfo ;
+	void *mem = NULL ;
+	sf_count_t memlen = 0 ;
+
+	print_test_name ("memory i/o error test", "") ;
+
+	memset (&sfinfo, 0, sizeof (sfinfo)) ;
+
+	if ((file = sf_open_memory (NULL, 100, &sfinfo)) != NULL || sf_error (NULL) == 0)
+	{	printf ("\n\nLine %d : sf_open_memory accepted a NULL pointer.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	/* An invalid format must fail and leave no buffer behind. */
+	sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_VORBIS ;
+	sfinfo.channels = 1 ;
+	sfinfo.samplerate = 44100 ;
+
+	if ((file = sf_open_memory_write (&mem, &memlen, &sfinfo)) != NULL)
+	{	printf ("\n\nLine %d : sf_open_memory_write accepted a bad format.\n\n", __LINE__) ;
+		exit (1) ;
+		} ;
+
+	if (mem != NULL || memlen != 0)
+	{	printf ("\n\nLine %d : failed open left a buffer (%p, %" PRId64 ").\n\n", __LINE__, mem, memlen) ;
+		exit (1) ;
+		} ;
+
+	puts ("ok") ;
+} /* memory_io_error_test */